@@ -69,13 +69,7 @@ ArchiveFile* SzArchive::OpenFile(const char* name)
 		if (strcmp(name, szname))
 			continue;
 
-		size_t offset = 0;
-		size_t out_size_processed = 0;
-		SRes res = SzArEx_Extract(&szarchive, &lookStream.vt, i, &block_idx, &out_buffer, &out_buffer_size, &offset, &out_size_processed, &g_Alloc, &g_Alloc);
-		if (res != SZ_OK)
-			return NULL;
-
-		return new SzArchiveFile(out_buffer, offset, (u32)out_size_processed);
+		return OpenIndex(i);
 	}
 	return NULL;
 }
@@ -93,17 +87,31 @@ ArchiveFile* SzArchive::OpenFileByCrc(u32 crc)
 		if (crc != szarchive.CRCs.Vals[i])
 			continue;
 
-		size_t offset = 0;
-		size_t out_size_processed = 0;
-		SRes res = SzArEx_Extract(&szarchive, &lookStream.vt, i, &block_idx, &out_buffer, &out_buffer_size, &offset, &out_size_processed, &g_Alloc, &g_Alloc);
-		if (res != SZ_OK)
-			return NULL;
-
-		return new SzArchiveFile(out_buffer, offset, (u32)out_size_processed);
+		return OpenIndex(i);
 	}
 	return NULL;
 }
 
+// The member is only extracted if it isn't already in the archive cache
+ArchiveFile* SzArchive::OpenIndex(UInt32 index)
+{
+	u32 crc = SzBitWithVals_Check(&szarchive.CRCs, index) ? szarchive.CRCs.Vals[index] : 0;
+	return new CachedArchiveFile(crc, (u32)SzArEx_GetFileSize(&szarchive, index), [this, index]() {
+		return Extract(index);
+	});
+}
+
+ArchiveFile* SzArchive::Extract(UInt32 index)
+{
+	size_t offset = 0;
+	size_t out_size_processed = 0;
+	SRes res = SzArEx_Extract(&szarchive, &lookStream.vt, index, &block_idx, &out_buffer, &out_buffer_size, &offset, &out_size_processed, &g_Alloc, &g_Alloc);
+	if (res != SZ_OK)
+		return NULL;
+
+	return new SzArchiveFile(out_buffer, offset, (u32)out_size_processed);
+}
+
 SzArchive::~SzArchive()
 {
 	if (lookStream.buf != NULL)
@@ -40,6 +40,8 @@ public:
 
 private:
 	virtual bool Open(const char* path) override;
+	ArchiveFile *OpenIndex(UInt32 index);
+	ArchiveFile *Extract(UInt32 index);
 
 	CSzArEx szarchive;
 	UInt32 block_idx;				/* it can have any value before first call (if outBuffer = 0) */
@@ -56,13 +58,29 @@ public:
 	SzArchiveFile(u8 *data, u32 offset, u32 length) : data(data), offset(offset), length(length) {}
 	virtual u32 Read(void *buffer, u32 length) override
 	{
-		length = std::min(length, this->length);
-		memcpy(buffer, data + offset, length);
+		length = ReadAt(position, buffer, length);
+		position += length;
 		return length;
 	}
+	virtual u32 ReadAt(u32 offset, void *buffer, u32 length) override
+	{
+		if (offset >= this->length)
+			return 0;
+		length = std::min(length, this->length - offset);
+		memcpy(buffer, data + this->offset + offset, length);
+		return length;
+	}
+	virtual u32 Size() override { return length; }
+	virtual bool CanReadInPlace() override { return true; }
+	virtual bool GetRawData(RawData& raw) override
+	{
+		raw.data = data + offset;
+		return true;
+	}
 
 private:
 	u8 *data;
 	u32 offset;
 	u32 length;
+	u32 position = 0;
 };
@@ -19,6 +19,8 @@
     along with reicast.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "ZipArchive.h"
+#include <algorithm>
+#include <vector>
 
 ZipArchive::~ZipArchive()
 {
@@ -28,51 +30,157 @@ ZipArchive::~ZipArchive()
 bool ZipArchive::Open(const char* path)
 {
 	zip = zip_open(path, 0, NULL);
-	return (zip != NULL);
+	if (zip == NULL)
+		return false;
+	this->path = path;
+	return true;
 }
 
 ArchiveFile* ZipArchive::OpenFile(const char* name)
 {
-	zip_file *zip_file = zip_fopen(zip, name, 0);
-	if (zip_file == NULL)
+	int index = zip_name_locate(zip, name, 0);
+	if (index < 0)
 		return NULL;
 
-	return new ZipArchiveFile(zip_file);
+	return OpenIndex(index);
 }
 
-struct zip_file *zip_fopen_by_crc(struct zip *za, u32 crc, int flags)
+ArchiveFile* ZipArchive::OpenFileByCrc(u32 crc)
 {
-    int i, n;
-    struct zip_stat stat;
+	if (crc == 0)
+		return NULL;
 
-    if (crc == 0) {
-        return NULL;
-    }
+	int n = zip_get_num_files(zip);
+	for (int i = 0; i < n; i++)
+	{
+		struct zip_stat stat;
+		if (zip_stat_index(zip, i, 0, &stat) < 0)
+			return NULL;
 
-    n = zip_get_num_files(za);
-    for (i = 0; i < n; i++) {
-        if (zip_stat_index(za, i, flags, &stat) < -1) {
-            return NULL;
-        }
+		if (stat.crc == crc)
+			return OpenIndex(i);
+	}
 
-        if (stat.crc == crc) {
-            return zip_fopen_index(za, i, flags);
-        }
-    }
+	return NULL;
+}
 
-    return NULL;
+static u32 get16(const u8 *p)
+{
+	return p[0] | (p[1] << 8);
 }
 
-ArchiveFile* ZipArchive::OpenFileByCrc(u32 crc)
+static u32 get32(const u8 *p)
+{
+	return get16(p) | (get16(p + 2) << 16);
+}
+
+// Offset of a member data in the zip file, read from its central directory entry and local header.
+// Returns -1 if not found.
+static long memberDataOffset(FILE *f, int index, const char *name)
+{
+	// The end of central directory record is followed by a comment of up to 64 KB
+	fseek(f, 0, SEEK_END);
+	long fileSize = ftell(f);
+	long tailSize = std::min(fileSize, 22L + 65535L);
+	std::vector<u8> tail(tailSize);
+	fseek(f, fileSize - tailSize, SEEK_SET);
+	if (fread(tail.data(), 1, tailSize, f) != (size_t)tailSize)
+		return -1;
+	long eocd = tailSize - 22;
+	while (eocd >= 0 && get32(&tail[eocd]) != 0x06054b50)
+		eocd--;
+	if (eocd < 0)
+		return -1;
+	u32 dirOffset = get32(&tail[eocd + 16]);
+	if (dirOffset == 0xffffffff)
+		// zip64
+		return -1;
+
+	fseek(f, dirOffset, SEEK_SET);
+	for (int i = 0; ; i++)
+	{
+		u8 header[46];
+		if (fread(header, 1, sizeof(header), f) != sizeof(header) || get32(header) != 0x02014b50)
+			return -1;
+		u32 nameLength = get16(&header[28]);
+		if (i < index)
+		{
+			fseek(f, nameLength + get16(&header[30]) + get16(&header[32]), SEEK_CUR);
+			continue;
+		}
+		std::string entryName(nameLength, '\0');
+		if (fread(&entryName[0], 1, nameLength, f) != nameLength || entryName != name)
+			return -1;
+		u32 localOffset = get32(&header[42]);
+		if (localOffset == 0xffffffff)
+			return -1;
+
+		u8 localHeader[30];
+		fseek(f, localOffset, SEEK_SET);
+		if (fread(localHeader, 1, sizeof(localHeader), f) != sizeof(localHeader) || get32(localHeader) != 0x04034b50)
+			return -1;
+		return localOffset + sizeof(localHeader) + get16(&localHeader[26]) + get16(&localHeader[28]);
+	}
+}
+
+ArchiveFile* ZipArchive::OpenIndex(int index)
 {
-	zip_file *zip_file = zip_fopen_by_crc(zip, crc, 0);
-	if (zip_file == NULL)
+	struct zip_stat stat;
+	if (zip_stat_index(zip, index, 0, &stat) < 0)
 		return NULL;
 
-	return new ZipArchiveFile(zip_file);
+	if (stat.comp_method == ZIP_CM_STORE && stat.encryption_method == ZIP_EM_NONE)
+	{
+		FILE *f = fopen(path.c_str(), "rb");
+		if (f != NULL)
+		{
+			long offset = memberDataOffset(f, index, stat.name);
+			if (offset >= 0)
+				return new ZipStoredFile(f, offset, (u32)stat.size);
+			fclose(f);
+		}
+	}
+	u32 size = (u32)stat.size;
+	return new CachedArchiveFile(stat.crc, size, [this, index, size]() -> ArchiveFile* {
+		zip_file *zip_file = zip_fopen_index(zip, index, 0);
+		if (zip_file == NULL)
+			return NULL;
+		return new ZipArchiveFile(zip_file, size);
+	});
 }
 
 u32 ZipArchiveFile::Read(void* buffer, u32 length)
 {
-	return zip_fread(zip_file, buffer, length);
+	int read = zip_fread(zip_file, buffer, length);
+	if (read <= 0)
+		return 0;
+	position += read;
+	return read;
+}
+
+u32 ZipArchiveFile::ReadAt(u32 offset, void *buffer, u32 length)
+{
+	if (offset < position)
+		return 0;
+	u8 skipped[4096];
+	while (position < offset)
+		if (Read(skipped, std::min<u32>(sizeof(skipped), offset - position)) == 0)
+			return 0;
+	return Read(buffer, length);
+}
+
+u32 ZipStoredFile::Read(void* buffer, u32 length)
+{
+	u32 read = ReadAt(position, buffer, length);
+	position += read;
+	return read;
+}
+
+u32 ZipStoredFile::ReadAt(u32 offset, void *buffer, u32 length)
+{
+	if (offset >= size)
+		return 0;
+	length = std::min(length, size - offset);
+	fseek(file, this->offset + offset, SEEK_SET);
+	return fread(buffer, 1, length, file);
 }
@@ -22,6 +22,7 @@
 
 #include "archive.h"
 #include <zip.h>
+#include <string>
 
 class ZipArchive : public Archive
 {
@@ -34,17 +35,48 @@ public:
 
 private:
 	virtual bool Open(const char* path) override;
+	ArchiveFile *OpenIndex(int index);
 
 	struct zip *zip;
+	std::string path;
 };
 
 class ZipArchiveFile : public ArchiveFile
 {
 public:
-	ZipArchiveFile(struct zip_file *zip_file) : zip_file(zip_file) {}
+	ZipArchiveFile(struct zip_file *zip_file, u32 size) : zip_file(zip_file), size(size) {}
 	virtual ~ZipArchiveFile() { zip_fclose(zip_file); }
 	virtual u32 Read(void* buffer, u32 length) override;
+	// Only forward seeks are possible in compressed members, and they move the Read() position
+	virtual u32 ReadAt(u32 offset, void *buffer, u32 length) override;
+	virtual u32 Size() override { return size; }
 
 private:
 	struct zip_file *zip_file;
+	u32 size;
+	u32 position = 0;
+};
+
+// Stored members are read directly from the zip file
+class ZipStoredFile : public ArchiveFile
+{
+public:
+	ZipStoredFile(FILE *file, long offset, u32 size) : file(file), offset(offset), size(size) {}
+	virtual ~ZipStoredFile() { fclose(file); }
+	virtual u32 Read(void* buffer, u32 length) override;
+	virtual u32 ReadAt(u32 offset, void *buffer, u32 length) override;
+	virtual u32 Size() override { return size; }
+	virtual bool CanReadInPlace() override { return true; }
+	virtual bool GetRawData(RawData& raw) override
+	{
+		raw.fd = fileno(file);
+		raw.offset = offset;
+		return true;
+	}
+
+private:
+	FILE *file;
+	long offset;
+	u32 size;
+	u32 position = 0;
 };
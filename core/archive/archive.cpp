@@ -24,6 +24,13 @@
 #ifndef _MSC_VER
 #include "ZipArchive.h"
 #endif
+#include "stdclass.h"
+
+#include <algorithm>
+#include <vector>
+
+// The oldest cache files are deleted above this size
+constexpr u64 ARCHIVE_CACHE_MAX_SIZE = 4ull * 1024 * 1024 * 1024;
 
 Archive *OpenArchive(const char *path)
 {
@@ -47,3 +54,145 @@ Archive *OpenArchive(const char *path)
 
 
 
+
+static std::string cacheDir()
+{
+	std::string dir = get_writable_data_path("archive_cache/");
+	if (!file_exists(dir))
+		make_directory(dir);
+	return dir;
+}
+
+CachedArchiveFile::CachedArchiveFile(u32 crc, u32 size, std::function<ArchiveFile*()> source)
+	: size(size), openSource(source)
+{
+	// Small members are kept in memory
+	if (crc != 0 && size >= CHUNK_SIZE)
+	{
+		std::string dir = cacheDir();
+		char name[32];
+		sprintf(name, "%08x-%08x.bin", crc, size);
+		std::string path = dir + name;
+		cache = fopen(path.c_str(), "r+b");
+		if (cache != nullptr)
+		{
+			fseek(cache, 0, SEEK_END);
+			long cached = ftell(cache);
+			if ((u32)cached >= size)
+				cachedChunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+			else
+				// the last chunk may have been partially written
+				cachedChunks = cached / CHUNK_SIZE;
+			DEBUG_LOG(COMMON, "Archive cache: %s has %d/%d chunks", name, cachedChunks, (size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+		}
+		else
+		{
+			// Make room for the new file
+			trim_directory(dir, ARCHIVE_CACHE_MAX_SIZE - std::min<u64>(size, ARCHIVE_CACHE_MAX_SIZE));
+			cache = fopen(path.c_str(), "w+b");
+		}
+	}
+	if (cache == nullptr)
+		// No crc or the cache isn't writable
+		memoryCache.resize(size);
+}
+
+CachedArchiveFile::~CachedArchiveFile()
+{
+	if (cache != nullptr)
+		fclose(cache);
+}
+
+// Decompresses the member until the given offset is cached
+bool CachedArchiveFile::Decompress(u32 end)
+{
+	std::vector<u8> chunk;
+	while (cachedChunks * CHUNK_SIZE < end)
+	{
+		if (chunk.empty())
+			chunk.resize(CHUNK_SIZE);
+		const u32 offset = cachedChunks * CHUNK_SIZE;
+		if (source == nullptr || sourcePosition > offset)
+		{
+			source.reset(openSource());
+			sourcePosition = 0;
+			if (source == nullptr)
+				return false;
+		}
+		// Skip the chunks cached by a previous run
+		while (sourcePosition < offset)
+		{
+			u32 read = source->Read(chunk.data(), std::min(CHUNK_SIZE, offset - sourcePosition));
+			if (read == 0)
+				return false;
+			sourcePosition += read;
+		}
+		const u32 length = std::min(CHUNK_SIZE, size - offset);
+		u32 read = 0;
+		while (read < length)
+		{
+			u32 rc = source->Read(&chunk[read], length - read);
+			if (rc == 0)
+				break;
+			read += rc;
+		}
+		sourcePosition += read;
+		if (read != length)
+		{
+			WARN_LOG(COMMON, "Archive cache: decompression failed at offset %x", offset + read);
+			return false;
+		}
+		if (cache == nullptr)
+			memcpy(&memoryCache[offset], chunk.data(), length);
+		else
+		{
+			fseek(cache, offset, SEEK_SET);
+			if (fwrite(chunk.data(), 1, length, cache) != length)
+				return false;
+			fflush(cache);
+		}
+		cachedChunks++;
+	}
+	if (cachedChunks * CHUNK_SIZE >= size)
+		// Fully cached
+		source.reset();
+
+	return true;
+}
+
+u32 CachedArchiveFile::ReadAt(u32 offset, void *buffer, u32 length)
+{
+	if (offset >= size)
+		return 0;
+	length = std::min(length, size - offset);
+	if (!Decompress(offset + length))
+		return 0;
+	if (cache == nullptr)
+	{
+		memcpy(buffer, &memoryCache[offset], length);
+		return length;
+	}
+	fseek(cache, offset, SEEK_SET);
+	return fread(buffer, 1, length, cache);
+}
+
+bool CachedArchiveFile::GetRawData(RawData& raw)
+{
+	if (!CanReadInPlace())
+		return false;
+	if (cache == nullptr)
+		raw.data = memoryCache.data();
+	else
+	{
+		raw.fd = fileno(cache);
+		raw.offset = 0;
+	}
+	return true;
+}
+
+u32 CachedArchiveFile::Read(void *buffer, u32 length)
+{
+	u32 read = ReadAt(position, buffer, length);
+	position += read;
+	return read;
+}
@@ -21,12 +21,62 @@
 #pragma once
 
 #include "types.h"
+#include <functional>
+#include <memory>
+#include <vector>
 
 class ArchiveFile
 {
 public:
 	virtual ~ArchiveFile() {}
 	virtual u32 Read(void *buffer, u32 length) = 0;
+	// Random access read. Doesn't change the position of Read()
+	virtual u32 ReadAt(u32 offset, void *buffer, u32 length) = 0;
+	// Uncompressed size
+	virtual u32 Size() = 0;
+	// True if ReadAt() never decompresses anything
+	virtual bool CanReadInPlace() { return false; }
+
+	// Where the data lies when it can be read in place: in memory, or in a file at the given offset
+	struct RawData
+	{
+		const u8 *data = nullptr;
+		int fd = -1;
+		u64 offset = 0;
+	};
+	// For readers that can't call ReadAt(), like the fault handler. False if the data can't be read in place.
+	virtual bool GetRawData(RawData& raw) { return false; }
+};
+
+// Random access to a compressed archive member through an on-disk cache of its decompressed data.
+// The member is only decompressed when reading past the cached data, up to the chunk being read.
+// The cache is kept between runs so the next ones don't decompress the member at all.
+class CachedArchiveFile : public ArchiveFile
+{
+public:
+	// source opens the member for sequential reading. It's only called if the cache is incomplete.
+	CachedArchiveFile(u32 crc, u32 size, std::function<ArchiveFile*()> source);
+	virtual ~CachedArchiveFile();
+	virtual u32 Read(void *buffer, u32 length) override;
+	virtual u32 ReadAt(u32 offset, void *buffer, u32 length) override;
+	virtual u32 Size() override { return size; }
+	virtual bool CanReadInPlace() override { return cachedChunks * CHUNK_SIZE >= size; }
+	virtual bool GetRawData(RawData& raw) override;
+
+	static constexpr u32 CHUNK_SIZE = 1024 * 1024;
+
+private:
+	bool Decompress(u32 end);
+
+	u32 size;
+	u32 position = 0;
+	// Members are decompressed sequentially so the cached chunks are always the first ones
+	u32 cachedChunks = 0;
+	FILE *cache = nullptr;
+	std::vector<u8> memoryCache;
+	std::function<ArchiveFile*()> openSource;
+	std::unique_ptr<ArchiveFile> source;
+	u32 sourcePosition = 0;
 };
 
 class Archive
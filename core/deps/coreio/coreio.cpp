@@ -9,6 +9,7 @@
 #include <string>
 #include <iomanip>
 #include <cctype>
+#include <algorithm>
 
 #define TRUE 1
 #define FALSE 0
@@ -17,6 +18,14 @@
 #include <string>
 #include <sstream>
 
+#if HOST_OS == OS_WINDOWS
+	#include <windows.h>
+	#include <io.h>
+#else
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
 #if FEAT_HAS_COREIO_HTTP
 	#if HOST_OS == OS_LINUX || HOST_OS == OS_DARWIN
 		#include <sys/socket.h>
@@ -197,6 +206,8 @@ struct CORE_FILE {
 	FILE* f;
 	std::string path;
 	size_t seek_ptr;
+	void* map;
+	size_t map_size;
 
 	std::string host;
 	int port;
@@ -209,6 +220,8 @@ core_file* core_fopen(const char* filename)
 	CORE_FILE* rv = new CORE_FILE();
 	rv->f = 0;
 	rv->path = p;
+	rv->map = 0;
+	rv->map_size = 0;
 #if FEAT_HAS_COREIO_HTTP
 	if (p.substr(0,7)=="http://") {
 		rv->host = p.substr(7,p.npos);
@@ -279,6 +292,13 @@ int core_fclose(core_file* fc)
 {
 	CORE_FILE* f = (CORE_FILE*)fc;
 
+	if (f->map) {
+#if HOST_OS == OS_WINDOWS
+		UnmapViewOfFile(f->map);
+#else
+		munmap(f->map, f->map_size);
+#endif
+	}
 	if (f->f) {
 		fclose(f->f);
 	}
@@ -306,3 +326,50 @@ size_t core_fsize(core_file* fc)
 	}
     return 0;
 }
+
+const void* core_fmap(core_file* fc, size_t* size)
+{
+	CORE_FILE* f = (CORE_FILE*)fc;
+
+	// Disc images can be larger than the free address space of 32-bit hosts
+	if (sizeof(void*) < 8 || !f->f)
+		return 0;
+	if (!f->map) {
+		size_t file_size = core_fsize(fc);
+		if (file_size == 0)
+			return 0;
+#if HOST_OS == OS_WINDOWS
+		HANDLE mapping = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(f->f)), NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+			return 0;
+		// The view keeps the mapping object alive
+		void* map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if (map == NULL)
+			return 0;
+#else
+		void* map = mmap(0, file_size, PROT_READ, MAP_SHARED, fileno(f->f), 0);
+		if (map == MAP_FAILED)
+			return 0;
+#endif
+		f->map = map;
+		f->map_size = file_size;
+	}
+	*size = f->map_size;
+
+	return f->map;
+}
+
+void core_fadvise(core_file* fc, size_t offs, size_t len)
+{
+	CORE_FILE* f = (CORE_FILE*)fc;
+
+	if (!f->map || offs >= f->map_size)
+		return;
+	len = std::min(len, f->map_size - offs);
+#if HOST_OS != OS_WINDOWS
+	// madvise needs a page aligned address
+	size_t page_offs = offs % sysconf(_SC_PAGESIZE);
+	madvise((u8*)f->map + offs - page_offs, len + page_offs, MADV_WILLNEED);
+#endif
+}
@@ -10,4 +10,9 @@ size_t core_fseek(core_file* fc, size_t offs, size_t origin);
 int core_fread(core_file* fc, void* buff, size_t len);
 int core_fclose(core_file* fc);
 size_t core_fsize(core_file* fc);
-size_t core_ftell(core_file* fc);
\ No newline at end of file
+size_t core_ftell(core_file* fc);
+// Maps the whole file read-only in memory. Returns NULL if the file can't be mapped.
+// The mapping is released when the file is closed.
+const void* core_fmap(core_file* fc, size_t* size);
+// Hint that the given range of a mapped file will be read soon
+void core_fadvise(core_file* fc, size_t offs, size_t len);
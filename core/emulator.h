@@ -19,6 +19,7 @@
     along with flycast.  If not, see <https://www.gnu.org/licenses/>.
  */
 #pragma once
+#include "types.h"
 #include <atomic>
 
 void InitSettings();
@@ -38,6 +39,7 @@ void dc_exit();
 void dc_resume();
 void dc_savestate();
 void dc_loadstate();
+bool dc_restore_state(const void *data, u32 total_size);
 void dc_load_game(const char *path);
 bool dc_is_load_done();
 void dc_cancel_load();
@@ -88,7 +88,7 @@ const int AICA_TICK = 145125;	// 44.1 KHz / 32
 static int AicaUpdate(int tag, int c, int j)
 {
 	arm_Run(32);
-	if (!settings.aica.NoBatch && !settings.aica.DSPEnabled)
+	if (!settings.aica.NoBatch)
 		AICA_Sample32();
 
 	return AICA_TICK;
@@ -104,7 +104,7 @@ void libAICA_TimeStep()
 	SCIPD->SAMPLE_DONE = 1;
 	MCIPD->SAMPLE_DONE = 1;
 
-	if (settings.aica.NoBatch || settings.aica.DSPEnabled)
+	if (settings.aica.NoBatch)
 		AICA_Sample();
 
 	//Make sure sh4/arm interrupt system is up to date :)
@@ -1,4 +1,5 @@
 #include "dsp.h"
+#include "aica.h"
 
 /*
 	DSP rec_v1
@@ -93,6 +94,65 @@ void DecodeInst(u32 *IPtr,_INST *i)
 	i->NXADR = IPtr[3] & 0x80;
 }
 
+void dsp_lower(DSPProgram& program)
+{
+	DSPStep steps[128];
+	program.stopped = true;
+	for (u32 step = 0; step < 128; step++)
+	{
+		u32 *mpro = &DSPData->MPRO[step * 4];
+		if (mpro[0] != 0 || mpro[1] != 0 || mpro[2] != 0 || mpro[3] != 0)
+			program.stopped = false;
+		DSPStep& s = steps[step];
+		DecodeInst(mpro, &s.op);
+		s.step = step;
+		if ((step & 1) == 0)
+		{
+			// memory only allowed on odd steps
+			s.op.MRD = false;
+			s.op.MWT = false;
+		}
+		s.mulZero = s.op.XSEL && s.op.IRA > 0x31;
+	}
+	program.steps.clear();
+	if (program.stopped)
+		return;
+
+	// Backward liveness of the registers that carry values between steps.
+	// FRC_REG, Y_REG and ADRS_REG are reset before each sample so they are dead at the end.
+	bool accLive = false;
+	bool frcLive = false;
+	bool yregLive = false;
+	bool adrsLive = false;
+	for (int step = 127; step >= 0; step--)
+	{
+		DSPStep& s = steps[step];
+		_INST& op = s.op;
+		if (!frcLive)
+			op.FRCL = false;
+		if (!yregLive)
+			op.YRL = false;
+		if (!adrsLive)
+			op.ADRL = false;
+		s.computeAcc = accLive;
+		s.computeShifted = op.TWT || op.FRCL || op.MWT || (op.ADRL && op.SHIFT == 3) || op.EWT;
+		s.loadInputs = (s.computeAcc && op.XSEL && !s.mulZero) || op.YRL || (op.ADRL && op.SHIFT != 3);
+
+		// Registers are read before being written in a step
+		const bool readsY = s.computeAcc && !s.mulZero;
+		frcLive = (frcLive && !op.FRCL) || (readsY && op.YSEL == 0);
+		yregLive = (yregLive && !op.YRL) || (readsY && op.YSEL >= 2);
+		adrsLive = (adrsLive && !op.ADRL) || ((op.MRD || op.MWT) && op.ADREB);
+		accLive = s.computeShifted || (s.computeAcc && !op.ZERO && op.BSEL);
+	}
+	for (const DSPStep& s : steps)
+	{
+		const _INST& op = s.op;
+		if (s.computeAcc || s.computeShifted || op.IWT || op.YRL || op.MRD || op.ADRL)
+			program.steps.push_back(s);
+	}
+}
+
 #if HOST_CPU == CPU_X86 && FEAT_DSPREC == DYNAREC_JIT
 #include "aica.h"
 #include "aica_mem.h"
@@ -1,5 +1,6 @@
 #pragma once
 #include "types.h"
+#include <vector>
 
 struct dsp_t
 {
@@ -126,3 +127,28 @@ struct _INST
 void DecodeInst(u32 *IPtr,_INST *i);
 u16 DYNACALL PACK(s32 val);
 s32 DYNACALL UNPACK(u16 val);
+
+// A step of the DSP program, as lowered for the recompilers.
+// Register writes that are never read are removed from the decoded instruction.
+struct DSPStep
+{
+	_INST op;
+	u32 step;			// position in the program: COEF index and MEMVAL slot
+	bool loadInputs;	// INPUTS is read
+	bool computeAcc;	// ACC is read by the next step
+	bool computeShifted;	// SHIFTED is read by this step
+	bool mulZero;		// X is an unconnected input so X * Y is always 0
+};
+
+// DSP program lowered from DSPData->MPRO. Coefficients are read from DSPData->COEF when the program runs.
+// Steps without any effect, such as most NOPs, are dropped.
+struct DSPProgram
+{
+	std::vector<DSPStep> steps;
+	bool stopped;		// the program is empty
+};
+
+void dsp_lower(DSPProgram& program);
+
+// Reference interpreter, also built with the recompilers
+void AICADSP_Step(struct dsp_t *DSP);
@@ -34,7 +34,7 @@ class DSPAssembler : public MacroAssembler
 public:
 	DSPAssembler(u8 *code_buffer, size_t size) : MacroAssembler(code_buffer, size), aica_ram_lit(NULL) {}
 
-	void Compile(struct dsp_t *DSP)
+	void Compile(struct dsp_t *DSP, const DSPProgram& program)
 	{
 		this->DSP = DSP;
 		DEBUG_LOG(AICA_ARM, "DSPAssembler::DSPCompile recompiling for arm64 at %p", GetBuffer()->GetStartAddress<void*>());
@@ -106,14 +106,12 @@ public:
 		Disassemble(instr_start, instr_cur);
 		instr_start = instr_cur;
 #endif
-		for (int step = 0; step < 128; ++step)
+		for (const DSPStep& s : program.steps)
 		{
-			u32 *mpro = &DSPData->MPRO[step * 4];
-			_INST op;
-			DecodeInst(mpro, &op);
-			const u32 COEF = step;
+			const _INST& op = s.op;
+			const u32 step = s.step;
 
-			if (op.XSEL || op.YRL || (op.ADRL && op.SHIFT != 3))
+			if (s.loadInputs)
 			{
 				if (op.IRA <= 0x1f)
 					//INPUTS = DSP->MEMS[op.IRA];
@@ -143,73 +141,80 @@ public:
 				Str(w1, dsp_operand(DSP->MEMS, op.IWA));
 			}
 
-			// Operand sel
-			// B
-			if (!op.ZERO)
+			const Register* X_alias = &X;
+			if (s.computeAcc)
 			{
-				if (op.BSEL)
-					//B = ACC;
-					Mov(B, ACC);
-				else
+				// Operand sel
+				// B
+				if (!op.ZERO)
 				{
-					//B = DSP->TEMP[(TRA + DSP->regs.MDEC_CT) & 0x7F];
-					if (op.TRA)
-						Add(w1, MDEC_CT, op.TRA);
+					if (op.BSEL)
+						//B = ACC;
+						Mov(B, ACC);
 					else
-						Mov(w1, MDEC_CT);
-					Bfc(w1, 7, 25);
-					Ldr(B, dsp_operand(DSP->TEMP, x1));
+					{
+						//B = DSP->TEMP[(TRA + DSP->regs.MDEC_CT) & 0x7F];
+						if (op.TRA)
+							Add(w1, MDEC_CT, op.TRA);
+						else
+							Mov(w1, MDEC_CT);
+						Bfc(w1, 7, 25);
+						Ldr(B, dsp_operand(DSP->TEMP, x1));
+					}
 				}
-				if (op.NEGB)
-					//B = 0 - B;
-					Neg(B, B);
-			}
 
-			// X
-			const Register* X_alias = &X;
-			if (op.XSEL)
-				//X = INPUTS;
-				X_alias = &INPUTS;
-			else
-			{
-				//X = DSP->TEMP[(TRA + DSP->regs.MDEC_CT) & 0x7F];
-				if (!op.ZERO && !op.BSEL)
-					X_alias = &B;
-				else
+				if (!s.mulZero)
 				{
-					if (op.TRA)
-						Add(w1, MDEC_CT, op.TRA);
+					// X
+					if (op.XSEL)
+						//X = INPUTS;
+						X_alias = &INPUTS;
+					else if (!op.ZERO && !op.BSEL)
+					{
+						// Same TEMP value as B
+						if (op.NEGB)
+							Mov(X, B);
+						else
+							X_alias = &B;
+					}
 					else
-						Mov(w1, MDEC_CT);
-					Bfc(w1, 7, 25);
-					Ldr(X, dsp_operand(DSP->TEMP, x1));
+					{
+						//X = DSP->TEMP[(TRA + DSP->regs.MDEC_CT) & 0x7F];
+						if (op.TRA)
+							Add(w1, MDEC_CT, op.TRA);
+						else
+							Mov(w1, MDEC_CT);
+						Bfc(w1, 7, 25);
+						Ldr(X, dsp_operand(DSP->TEMP, x1));
+					}
+
+					// Y
+					if (op.YSEL == 0)
+						//Y = FRC_REG;
+						Mov(Y, FRC_REG);
+					else if (op.YSEL == 1)
+					{
+						//Y = DSPData->COEF[step] >> 3;	//COEF is 16 bits
+						Ldr(Y, dspdata_operand(DSPData->COEF, step));
+						Sbfx(Y, Y, 3, 13);
+					}
+					else if (op.YSEL == 2)
+						//Y = Y_REG >> 11;
+						Asr(Y, Y_REG, 11);
+					else if (op.YSEL == 3)
+						//Y = (Y_REG >> 4) & 0x0FFF;
+						Ubfx(Y, Y_REG, 4, 12);
 				}
+				if (!op.ZERO && op.NEGB)
+					//B = 0 - B;
+					Neg(B, B);
 			}
 
-			// Y
-			if (op.YSEL == 0)
-			{
-				//Y = FRC_REG;
-				Mov(Y, FRC_REG);
-			}
-			else if (op.YSEL == 1)
-			{
-				//Y = DSPData->COEF[COEF] >> 3;	//COEF is 16 bits
-				Ldr(Y, dspdata_operand(DSPData->COEF, COEF));
-				Sbfx(Y, Y, 3, 13);
-			}
-			else if (op.YSEL == 2)
-				//Y = Y_REG >> 11;
-				Asr(Y, Y_REG, 11);
-			else if (op.YSEL == 3)
-				//Y = (Y_REG >> 4) & 0x0FFF;
-				Ubfx(Y, Y_REG, 4, 12);
-
 			if (op.YRL)
 				//Y_REG = INPUTS;
 				Mov(Y_REG, INPUTS);
 
-			if (op.TWT || op.FRCL || op.MWT || (op.ADRL && op.SHIFT == 3) || op.EWT)
+			if (s.computeShifted)
 			{
 				// Shifter
 				// There's a 1-step delay at the output of the X*Y + B adder. So we use the ACC value from the previous step.
@@ -249,18 +254,31 @@ public:
 				}
 			}
 
-			// ACCUM
-			//ACC = (((s64)X * (s64)Y) >> 12) + B;
-			const Register& X64 = Register::GetXRegFromCode(X_alias->GetCode());
-			const Register& Y64 = Register::GetXRegFromCode(Y.GetCode());
-			Sxtw(X64, *X_alias);
-			Sxtw(Y64, Y);
-			Mul(x0, X64, Y64);
-			Asr(x0, x0, 12);
-			if (op.ZERO)
-				Mov(ACC, w0);
-			else
-				Add(ACC, w0, B);
+			if (s.computeAcc)
+			{
+				// ACCUM
+				//ACC = (((s64)X * (s64)Y) >> 12) + B;
+				if (s.mulZero)
+				{
+					if (op.ZERO)
+						Mov(ACC, 0);
+					else
+						Mov(ACC, B);
+				}
+				else
+				{
+					const Register& X64 = Register::GetXRegFromCode(X_alias->GetCode());
+					const Register& Y64 = Register::GetXRegFromCode(Y.GetCode());
+					Sxtw(X64, *X_alias);
+					Sxtw(Y64, Y);
+					Mul(x0, X64, Y64);
+					Asr(x0, x0, 12);
+					if (op.ZERO)
+						Mov(ACC, w0);
+					else
+						Add(ACC, w0, B);
+				}
+			}
 
 			if (op.TWT)
 			{
@@ -283,32 +301,30 @@ public:
 					Asr(FRC_REG, SHIFTED, 11);
 			}
 
-			if (step & 1)
+			// memory only allowed on odd steps
+			const Register& ADDR = w11;
+			if (op.MRD)
 			{
-				const Register& ADDR = w11;
-				if (op.MRD)			// memory only allowed on odd. DoA inserts NOPs on even
-				{
-					//MEMVAL[(step + 2) & 3] = UNPACK(*(u16 *)&aica_ram[ADDR & ARAM_MASK]);
-					CalculateADDR(ADDR, op, ADRS_REG, MDEC_CT);
-					Ldr(x1, GetAicaRam());
-					MemOperand aram_op(x1, Register::GetXRegFromCode(ADDR.GetCode()));
-					Ldrh(w0, aram_op);
-					GenCallRuntime(UNPACK);
-					Mov(w2, w0);
-					Str(w2, dsp_operand(DSP->MEMVAL, (step + 2) & 3));
-				}
-				if (op.MWT)
-				{
-					// *(u16 *)&aica_ram[ADDR & ARAM_MASK] = PACK(SHIFTED);
-					Mov(w0, SHIFTED);
-					GenCallRuntime(PACK);
-					Mov(w2, w0);
-
-					CalculateADDR(ADDR, op, ADRS_REG, MDEC_CT);
-					Ldr(x1, GetAicaRam());
-					MemOperand aram_op(x1, Register::GetXRegFromCode(ADDR.GetCode()));
-					Strh(w2, aram_op);
-				}
+				//MEMVAL[(step + 2) & 3] = UNPACK(*(u16 *)&aica_ram[ADDR & ARAM_MASK]);
+				CalculateADDR(ADDR, op, ADRS_REG, MDEC_CT);
+				Ldr(x1, GetAicaRam());
+				MemOperand aram_op(x1, Register::GetXRegFromCode(ADDR.GetCode()));
+				Ldrh(w0, aram_op);
+				GenCallRuntime(UNPACK);
+				Mov(w2, w0);
+				Str(w2, dsp_operand(DSP->MEMVAL, (step + 2) & 3));
+			}
+			if (op.MWT)
+			{
+				// *(u16 *)&aica_ram[ADDR & ARAM_MASK] = PACK(SHIFTED);
+				Mov(w0, SHIFTED);
+				GenCallRuntime(PACK);
+				Mov(w2, w0);
+
+				CalculateADDR(ADDR, op, ADRS_REG, MDEC_CT);
+				Ldr(x1, GetAicaRam());
+				MemOperand aram_op(x1, Register::GetXRegFromCode(ADDR.GetCode()));
+				Strh(w2, aram_op);
 			}
 
 			if (op.ADRL)
@@ -330,6 +346,7 @@ public:
 			}
 #if 0
 			instr_cur = GetBuffer()->GetEndAddress<Instruction*>();
+			const u32 *mpro = &DSPData->MPRO[step * 4];
 			DEBUG_LOG(AICA_ARM, "DSP STEP %d: %04x %04x %04x %04x", step, mpro[0], mpro[1], mpro[2], mpro[3]);
 			Disassemble(instr_start, instr_cur);
 			instr_start = instr_cur;
@@ -468,19 +485,11 @@ private:
 
 void dsp_recompile()
 {
-	dsp.Stopped = true;
-	for (int i = 127; i >= 0; --i)
-	{
-		u32 *IPtr = DSPData->MPRO + i * 4;
-
-		if (IPtr[0] != 0 || IPtr[1] != 0 || IPtr[2 ]!= 0 || IPtr[3] != 0)
-		{
-			dsp.Stopped = false;
-			break;
-		}
-	}
+	DSPProgram program;
+	dsp_lower(program);
+	dsp.Stopped = program.stopped;
 	DSPAssembler assembler(&dsp.DynCode[0], sizeof(dsp.DynCode));
-	assembler.Compile(&dsp);
+	assembler.Compile(&dsp, program);
 }
 
 void dsp_init()
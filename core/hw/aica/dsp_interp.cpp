@@ -6,9 +6,6 @@
 //
 
 #include "build.h"
-
-#if FEAT_DSPREC != DYNAREC_JIT
-
 #include "dsp.h"
 #include "aica.h"
 #include "aica_if.h"
@@ -18,14 +15,7 @@
 #define verify(...)
 #endif
 
-void AICADSP_Init(struct dsp_t *DSP)
-{
-	memset(DSP, 0, sizeof(*DSP));
-	DSP->RBL = 0x8000 - 1;
-	DSP->Stopped = 1;
-	dsp.regs.MDEC_CT = 1;
-}
-
+// Also used as a reference for the recompilers
 void AICADSP_Step(struct dsp_t *DSP)
 {
 	s32 ACC = 0;		//26 bit
@@ -254,6 +244,16 @@ void AICADSP_Step(struct dsp_t *DSP)
 //      fclose(f);
 }
 
+#if FEAT_DSPREC != DYNAREC_JIT
+
+void AICADSP_Init(struct dsp_t *DSP)
+{
+	memset(DSP, 0, sizeof(*DSP));
+	DSP->RBL = 0x8000 - 1;
+	DSP->Stopped = 1;
+	dsp.regs.MDEC_CT = 1;
+}
+
 void AICADSP_Start(struct dsp_t *DSP)
 {
 	dsp.Stopped = 1;
@@ -47,7 +47,7 @@ class DSPAssembler : public Xbyak::CodeGenerator
 public:
 	DSPAssembler(u8 *code_buffer, size_t size) : Xbyak::CodeGenerator(size, code_buffer) {}
 
-	void Compile(struct dsp_t *DSP)
+	void Compile(struct dsp_t *DSP, const DSPProgram& program)
 	{
 		this->DSP = DSP;
 		DEBUG_LOG(AICA_ARM, "DSPAssembler::DSPCompile recompiling for x86/64 at %p", this->getCode());
@@ -107,14 +107,12 @@ public:
 		xor_(ADRS_REG, ADRS_REG);
 		mov(MDEC_CT, dword[rbx + dsp_operand(&DSP->regs.MDEC_CT)]);
 
-		for (int step = 0; step < 128; ++step)
+		for (const DSPStep& s : program.steps)
 		{
-			u32 *mpro = &DSPData->MPRO[step * 4];
-			_INST op;
-			DecodeInst(mpro, &op);
-			const u32 COEF = step;
+			const _INST& op = s.op;
+			const u32 step = s.step;
 
-			if (op.XSEL || op.YRL || (op.ADRL && op.SHIFT != 3))
+			if (s.loadInputs)
 			{
 				if (op.IRA <= 0x1f)
 					//INPUTS = DSP->MEMS[op.IRA];
@@ -144,78 +142,87 @@ public:
 				mov(dword[rbx + dsp_operand(DSP->MEMS, op.IWA)], eax);
 			}
 
-			// Operand sel
-			// B
-			if (!op.ZERO)
+			Xbyak::Reg32 X_alias = X;
+			if (s.computeAcc)
 			{
-				if (op.BSEL)
-					//B = ACC;
-					mov(B, ACC);
-				else
+				// Operand sel
+				// B
+				if (!op.ZERO)
 				{
-					//B = DSP->TEMP[(TRA + DSP->regs.MDEC_CT) & 0x7F];
-					mov(eax, MDEC_CT);
-					if (op.TRA)
-						add(eax, op.TRA);
-					and_(eax, 0x7f);
-					mov(B, dword[rbx + rax * 4]);
+					if (op.BSEL)
+						//B = ACC;
+						mov(B, ACC);
+					else
+					{
+						//B = DSP->TEMP[(TRA + DSP->regs.MDEC_CT) & 0x7F];
+						mov(eax, MDEC_CT);
+						if (op.TRA)
+							add(eax, op.TRA);
+						and_(eax, 0x7f);
+						mov(B, dword[rbx + rax * 4]);
+					}
 				}
-				if (op.NEGB)
-					//B = 0 - B;
-					neg(B);
-			}
 
-			// X
-			Xbyak::Reg32 X_alias = X;
-			if (op.XSEL)
-				//X = INPUTS;
-				X_alias = INPUTS;
-			else
-			{
-				//X = DSP->TEMP[(TRA + DSP->regs.MDEC_CT) & 0x7F];
-				if (!op.ZERO && !op.BSEL)
-					X_alias = B;
-				else
+				if (!s.mulZero)
 				{
-					mov(eax, MDEC_CT);
-					if (op.TRA)
-						add(eax, op.TRA);
-					and_(eax, 0x7f);
-					mov(X, dword[rbx + rax * 4]);
+					// X
+					if (op.XSEL)
+						//X = INPUTS;
+						X_alias = INPUTS;
+					else if (!op.ZERO && !op.BSEL)
+					{
+						// Same TEMP value as B
+						if (op.NEGB)
+							mov(X, B);
+						else
+							X_alias = B;
+					}
+					else
+					{
+						//X = DSP->TEMP[(TRA + DSP->regs.MDEC_CT) & 0x7F];
+						mov(eax, MDEC_CT);
+						if (op.TRA)
+							add(eax, op.TRA);
+						and_(eax, 0x7f);
+						mov(X, dword[rbx + rax * 4]);
+					}
+
+					// Y
+					if (op.YSEL == 0)
+					{
+						//Y = FRC_REG;
+						mov(Y, dword[rbx + dsp_operand(&DSP->FRC_REG)]);
+					}
+					else if (op.YSEL == 2)
+					{
+						//Y = Y_REG >> 11;
+						mov(Y, Y_REG);
+						sar(Y, 11);
+					}
+					else if (op.YSEL == 3)
+					{
+						//Y = (Y_REG >> 4) & 0x0FFF;
+						mov(Y, Y_REG);
+						sar(Y, 4);
+						and_(Y, 0x0fff);
+					}
+					else if (op.YSEL == 1)
+					{
+						//Y = DSPData->COEF[step] >> 3;	//COEF is 16 bits
+						movsx(Y, word[rbp + dspdata_operand(DSPData->COEF, step)]);
+						sar(Y, 3);
+					}
 				}
-			}
-
-			// Y
-			if (op.YSEL == 0)
-			{
-				//Y = FRC_REG;
-				mov(Y, dword[rbx + dsp_operand(&DSP->FRC_REG)]);
-			}
-			else if (op.YSEL == 1)
-			{
-				//Y = DSPData->COEF[COEF] >> 3;	//COEF is 16 bits
-				movsx(Y, word[rbp + dspdata_operand(DSPData->COEF, COEF)]);
-				sar(Y, 3);
-			}
-			else if (op.YSEL == 2)
-			{
-				//Y = Y_REG >> 11;
-				mov(Y, Y_REG);
-				sar(Y, 11);
-			}
-			else if (op.YSEL == 3)
-			{
-				//Y = (Y_REG >> 4) & 0x0FFF;
-				mov(Y, Y_REG);
-				sar(Y, 4);
-				and_(Y, 0x0fff);
+				if (!op.ZERO && op.NEGB)
+					//B = 0 - B;
+					neg(B);
 			}
 
 			if (op.YRL)
 				//Y_REG = INPUTS;
 				mov(Y_REG, INPUTS);
 
-			if (op.TWT || op.FRCL || op.MWT || (op.ADRL && op.SHIFT == 3) || op.EWT)
+			if (s.computeShifted)
 			{
 				// Shifter
 				// There's a 1-step delay at the output of the X*Y + B adder. So we use the ACC value from the previous step.
@@ -256,16 +263,29 @@ public:
 				// edx contains SHIFTED
 			}
 
-			// ACCUM
-			//ACC = (((s64)X * (s64)Y) >> 12) + B;
-			const Xbyak::Reg64 Xlong = X_alias.cvt64();
-			movsxd(Xlong, X_alias);
-			movsxd(rax, Y);
-			imul(rax, Xlong);
-			sar(rax, 12);
-			mov(ACC, eax);
-			if (!op.ZERO)
-				add(ACC, B);
+			if (s.computeAcc)
+			{
+				// ACCUM
+				//ACC = (((s64)X * (s64)Y) >> 12) + B;
+				if (s.mulZero)
+				{
+					if (op.ZERO)
+						xor_(ACC, ACC);
+					else
+						mov(ACC, B);
+				}
+				else
+				{
+					const Xbyak::Reg64 Xlong = X_alias.cvt64();
+					movsxd(Xlong, X_alias);
+					movsxd(rax, Y);
+					imul(rax, Xlong);
+					sar(rax, 12);
+					mov(ACC, eax);
+					if (!op.ZERO)
+						add(ACC, B);
+				}
+			}
 
 			if (op.TWT)
 			{
@@ -289,17 +309,17 @@ public:
 				mov(dword[rbx + dsp_operand(&DSP->FRC_REG)], ecx);
 			}
 
-			if (step & 1)
+			if (op.MRD || op.MWT)		// memory only allowed on odd steps
 			{
-				if (op.MRD || op.MWT)
-				{
-					if ((op.ADRL && op.SHIFT == 3) || op.EWT)
-						push(rdx);
-					if (op.ADRL && op.SHIFT != 3)
-						push(INPUTS.cvt64());
-				}
+				if ((op.ADRL && op.SHIFT == 3) || op.EWT)
+					push(rdx);
+				if (op.ADRL && op.SHIFT != 3)
+					push(INPUTS.cvt64());
 				const Xbyak::Reg32 ADDR = Y;
-				if (op.MRD)			// memory only allowed on odd. DoA inserts NOPs on even
+				if (op.MRD && op.MWT)
+					// SHIFTED doesn't survive the UNPACK call
+					mov(dword[rbx + dsp_operand(&DSP->SHIFTED)], edx);
+				if (op.MRD)
 				{
 					//MEMVAL[(step + 2) & 3] = UNPACK(*(u16 *)&aica_ram[ADDR & ARAM_MASK]);
 					CalculateADDR(ADDR, op, ADRS_REG, MDEC_CT);
@@ -311,20 +331,20 @@ public:
 				if (op.MWT)
 				{
 					// *(u16 *)&aica_ram[ADDR & ARAM_MASK] = PACK(SHIFTED);
-					mov(call_arg0, edx);	// SHIFTED
+					if (op.MRD)
+						mov(call_arg0, dword[rbx + dsp_operand(&DSP->SHIFTED)]);
+					else
+						mov(call_arg0, edx);	// SHIFTED
 					GenCall(PACK);
 
 					CalculateADDR(ADDR, op, ADRS_REG, MDEC_CT);
 					mov(rcx, (uintptr_t)&aica_ram[0]);
 					mov(word[rcx + ADDR.cvt64()], ax);
 				}
-				if (op.MRD || op.MWT)
-				{
-					if (op.ADRL && op.SHIFT != 3)
-						pop(INPUTS.cvt64());
-					if ((op.ADRL && op.SHIFT == 3) || op.EWT)
-						pop(rdx);
-				}
+				if (op.ADRL && op.SHIFT != 3)
+					pop(INPUTS.cvt64());
+				if ((op.ADRL && op.SHIFT == 3) || op.EWT)
+					pop(rdx);
 			}
 
 			if (op.ADRL)
@@ -430,19 +450,11 @@ private:
 
 void dsp_recompile()
 {
-	dsp.Stopped = true;
-	for (int i = 127; i >= 0; --i)
-	{
-		u32 *IPtr = DSPData->MPRO + i * 4;
-
-		if (IPtr[0] != 0 || IPtr[1] != 0 || IPtr[2 ]!= 0 || IPtr[3] != 0)
-		{
-			dsp.Stopped = false;
-			break;
-		}
-	}
+	DSPProgram program;
+	dsp_lower(program);
+	dsp.Stopped = program.stopped;
 	DSPAssembler assembler(pCodeBuffer, sizeof(CodeBuffer));
-	assembler.Compile(&dsp);
+	assembler.Compile(&dsp, program);
 }
 
 void dsp_init()
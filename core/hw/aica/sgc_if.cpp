@@ -27,6 +27,14 @@
 
 #include <algorithm>
 #include <cmath>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #undef FAR
 
@@ -152,6 +160,75 @@ static const s32 qtable[32] = {
 
 DSP_OUT_VOL_REG* dsp_out_vol;
 
+#if defined(__SSE2__) || defined(_M_X64)
+static __forceinline __m128i mullo32(__m128i a, __m128i b)
+{
+#ifdef __SSE4_1__
+	return _mm_mullo_epi32(a, b);
+#else
+	// low 32 bits of the products are the same for signed and unsigned operands
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+#endif
+
+// Applies the left, right and DSP send volumes of a channel to a batch of its samples and accumulates them.
+// Same results as ChannelEx::Step: samples are 16-bit and volumes x.15 so the products fit in 32 bits.
+// Without DSP (mixs is null), channels with no direct output use the DSP send instead.
+static void MixSamples(u32 count, const SampleType *samples, const s32 *volL, const s32 *volR, const s32 *volDsp,
+		SampleType *mixl, SampleType *mixr, SampleType *mixs)
+{
+	u32 i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+	const __m128i noDsp = _mm_set1_epi32(mixs == nullptr ? -1 : 0);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i sample = _mm_load_si128((const __m128i *)&samples[i]);
+		__m128i l = _mm_srai_epi32(mullo32(sample, _mm_load_si128((const __m128i *)&volL[i])), 15);
+		__m128i r = _mm_srai_epi32(mullo32(sample, _mm_load_si128((const __m128i *)&volR[i])), 15);
+		__m128i d = _mm_srai_epi32(mullo32(sample, _mm_load_si128((const __m128i *)&volDsp[i])), 11);
+		if (mixs != nullptr)
+			_mm_store_si128((__m128i *)&mixs[i], _mm_add_epi32(_mm_load_si128((const __m128i *)&mixs[i]), d));
+		// l and r have the same sign so their sum is zero only if both are
+		__m128i silent = _mm_and_si128(_mm_cmpeq_epi32(_mm_add_epi32(l, r), _mm_setzero_si128()), noDsp);
+		d = _mm_and_si128(_mm_srai_epi32(d, 4), silent);
+		_mm_store_si128((__m128i *)&mixl[i], _mm_add_epi32(_mm_load_si128((const __m128i *)&mixl[i]), _mm_add_epi32(l, d)));
+		_mm_store_si128((__m128i *)&mixr[i], _mm_add_epi32(_mm_load_si128((const __m128i *)&mixr[i]), _mm_add_epi32(r, d)));
+	}
+#elif defined(__aarch64__)
+	const uint32x4_t noDsp = vdupq_n_u32(mixs == nullptr ? 0xFFFFFFFF : 0);
+	for (; i + 4 <= count; i += 4)
+	{
+		int32x4_t sample = vld1q_s32(&samples[i]);
+		int32x4_t l = vshrq_n_s32(vmulq_s32(sample, vld1q_s32(&volL[i])), 15);
+		int32x4_t r = vshrq_n_s32(vmulq_s32(sample, vld1q_s32(&volR[i])), 15);
+		int32x4_t d = vshrq_n_s32(vmulq_s32(sample, vld1q_s32(&volDsp[i])), 11);
+		if (mixs != nullptr)
+			vst1q_s32(&mixs[i], vaddq_s32(vld1q_s32(&mixs[i]), d));
+		// l and r have the same sign so their sum is zero only if both are
+		uint32x4_t silent = vandq_u32(vceqq_s32(vaddq_s32(l, r), vdupq_n_s32(0)), noDsp);
+		d = vandq_s32(vshrq_n_s32(d, 4), vreinterpretq_s32_u32(silent));
+		vst1q_s32(&mixl[i], vaddq_s32(vld1q_s32(&mixl[i]), vaddq_s32(l, d)));
+		vst1q_s32(&mixr[i], vaddq_s32(vld1q_s32(&mixr[i]), vaddq_s32(r, d)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		SampleType oLeft = FPMul(samples[i], volL[i], 15);
+		SampleType oRight = FPMul(samples[i], volR[i], 15);
+		SampleType oDsp = FPMul(samples[i], volDsp[i], 11);
+		if (mixs != nullptr)
+			mixs[i] += oDsp;
+		else if (oLeft + oRight == 0)
+			oLeft = oRight = oDsp >> 4;
+		mixl[i] += oLeft;
+		mixr[i] += oRight;
+	}
+}
+
+
 #pragma pack(push, 1)
 //All regs are 16b , aligned to 32b (upper bits 0?)
 struct ChannelCommonData
@@ -456,72 +533,80 @@ struct ChannelEx
 
 		return rv;
 	}
-	__forceinline bool Step(SampleType& oLeft, SampleType& oRight, SampleType& oDsp)
+	// Generates the next sample of the channel, before volume and mixing, and its attenuation offset
+	__forceinline bool StepSample(SampleType& sample, u32& ofsatt)
 	{
 		if (!enabled)
-		{
-			oLeft=oRight=oDsp=0;
 			return false;
+
+		sample = InterpolateSample();
+
+		// Low-pass filter
+		if (FEG.active)
+		{
+			u32 fv = FEG.GetValue();
+			s32 f = (((fv & 0xFF) | 0x100) << 4) >> ((fv >> 8) ^ 0x1F);
+			f = std::max(1, f);
+			sample = f * sample + (0x2000 - f + FEG.q) * FEG.prev1 - FEG.q * FEG.prev2;
+			sample >>= 13;
+			clip16(sample);
+			FEG.prev2 = FEG.prev1;
+			FEG.prev1 = sample;
+		}
+
+		//Volume & Mixer processing
+		//All attenuations are added together then applied and mixed :)
+
+		//offset is up to 511
+		//*Att is up to 511
+		//logtable handles up to 1024, anything >=255 is mute
+
+		if (ccd->VOFF == 1)
+		{
+			ofsatt = 0;
 		}
 		else
 		{
-			SampleType sample = InterpolateSample();
+			ofsatt = lfo.alfo + (AEG.GetValue() >> 2);
+			ofsatt = std::min(ofsatt, (u32)255); // make sure it never gets more 255 -- it can happen with some alfo/aeg combinations
+		}
 
-			// Low-pass filter
-			if (FEG.active)
-			{
-				u32 fv = FEG.GetValue();
-				s32 f = (((fv & 0xFF) | 0x100) << 4) >> ((fv >> 8) ^ 0x1F);
-				f = std::max(1, f);
-				sample = f * sample + (0x2000 - f + FEG.q) * FEG.prev1 - FEG.q * FEG.prev2;
-				sample >>= 13;
-				clip16(sample);
-				FEG.prev2 = FEG.prev1;
-				FEG.prev1 = sample;
-			}
+		StepAEG(this);
+		StepFEG(this);
+		StepStream(this);
+		lfo.Step(this);
+		return true;
+	}
 
-			//Volume & Mixer processing
-			//All attenuations are added together then applied and mixed :)
+	__forceinline bool Step(SampleType& oLeft, SampleType& oRight, SampleType& oDsp)
+	{
+		SampleType sample;
+		u32 ofsatt;
+		if (!StepSample(sample, ofsatt))
+		{
+			oLeft=oRight=oDsp=0;
+			return false;
+		}
+		u32 const max_att = ((16 << 4) - 1) - ofsatt;
 
-			//offset is up to 511
-			//*Att is up to 511
-			//logtable handles up to 1024, anything >=255 is mute
+		s32* logtable = ofsatt + tl_lut;
 
-			u32 ofsatt;
-			if (ccd->VOFF == 1)
-			{
-				ofsatt = 0;
-			}
-			else
-			{
-				ofsatt = lfo.alfo + (AEG.GetValue() >> 2);
-				ofsatt = std::min(ofsatt, (u32)255); // make sure it never gets more 255 -- it can happen with some alfo/aeg combinations
-			}
-			u32 const max_att = ((16 << 4) - 1) - ofsatt;
-			
-			s32* logtable = ofsatt + tl_lut;
-
-			u32 dl = std::min(VolMix.DLAtt, max_att);
-			u32 dr = std::min(VolMix.DRAtt, max_att);
-			u32 ds = std::min(VolMix.DSPAtt, max_att);
-
-			oLeft = FPMul(sample, logtable[dl], 15);
-			oRight = FPMul(sample, logtable[dr], 15);
-			oDsp = FPMul(sample, logtable[ds], 11);	// 20 bits
-
-			clip_verify(((s16)oLeft)==oLeft);
-			clip_verify(((s16)oRight)==oRight);
-			clip_verify((oDsp << 12) >> 12 == oDsp);
-			clip_verify(sample*oLeft>=0);
-			clip_verify(sample*oRight>=0);
-			clip_verify((s64)sample*oDsp>=0);
-
-			StepAEG(this);
-			StepFEG(this);
-			StepStream(this);
-			lfo.Step(this);
-			return true;
-		}
+		u32 dl = std::min(VolMix.DLAtt, max_att);
+		u32 dr = std::min(VolMix.DRAtt, max_att);
+		u32 ds = std::min(VolMix.DSPAtt, max_att);
+
+		oLeft = FPMul(sample, logtable[dl], 15);
+		oRight = FPMul(sample, logtable[dr], 15);
+		oDsp = FPMul(sample, logtable[ds], 11);	// 20 bits
+
+		clip_verify(((s16)oLeft)==oLeft);
+		clip_verify(((s16)oRight)==oRight);
+		clip_verify((oDsp << 12) >> 12 == oDsp);
+		clip_verify(sample*oLeft>=0);
+		clip_verify(sample*oRight>=0);
+		clip_verify((s64)sample*oDsp>=0);
+
+		return true;
 	}
 
 	__forceinline void Step(SampleType& mixl, SampleType& mixr)
@@ -544,6 +629,33 @@ struct ChannelEx
 			Chans[i].Step(mixl, mixr);
 	}
 
+	// Generates the next 32 samples of the channel and adds them to the batch mix buffers.
+	// The DSP sends are kept per sample in mixs[ISEL] so that the DSP can run on the whole batch afterwards.
+	// mixs is null if the DSP is disabled.
+	void StepBatch(SampleType *mixl, SampleType *mixr, SampleType (*mixs)[32])
+	{
+		alignas(16) SampleType samples[32];
+		alignas(16) s32 volL[32];
+		alignas(16) s32 volR[32];
+		alignas(16) s32 volDsp[32];
+
+		u32 count = 0;
+		for (; count < 32; count++)
+		{
+			u32 ofsatt;
+			//stop working on this channel if its turned off ...
+			if (!StepSample(samples[count], ofsatt))
+				break;
+			u32 const max_att = ((16 << 4) - 1) - ofsatt;
+			const s32* logtable = ofsatt + tl_lut;
+			volL[count] = logtable[std::min(VolMix.DLAtt, max_att)];
+			volR[count] = logtable[std::min(VolMix.DRAtt, max_att)];
+			volDsp[count] = logtable[std::min(VolMix.DSPAtt, max_att)];
+		}
+		if (count != 0)
+			MixSamples(count, samples, volL, volR, volDsp, mixl, mixr, mixs != nullptr ? mixs[ccd->ISEL] : nullptr);
+	}
+
 	void SetAegState(_EG_state newstate)
 	{
 		StepAEG=AEG_STEP_LUT[newstate];
@@ -1355,33 +1467,33 @@ void WriteCommonReg8(u32 reg,u32 data)
 s16 cdda_sector[CDDA_SIZE]={0};
 u32 cdda_index=CDDA_SIZE<<1;
 
-//no DSP for now in this version
-void AICA_Sample32()
+void sgc_MixChannels(SampleType& mixl, SampleType& mixr)
 {
-	SampleType mxlr[64];
-	memset(mxlr,0,sizeof(mxlr));
+	ChannelEx::StepAll(mixl, mixr);
+}
 
+void sgc_MixChannels32(SampleType *mixl, SampleType *mixr, SampleType (*mixs)[32])
+{
 	//Generate 32 samples for each channel, before moving to next channel
 	//much more cache efficient !
-	u32 sg=0;
 	for (int ch = 0; ch < 64; ch++)
-	{
-		for (int i=0;i<32;i++)
-		{
-			SampleType oLeft,oRight,oDsp;
-			//stop working on this channel if its turned off ...
-			if (!Chans[ch].Step(oLeft, oRight, oDsp))
-				break;
-
-			sg++;
+		Chans[ch].StepBatch(mixl, mixr, mixs);
+}
 
-			if (oLeft + oRight == 0)
-				oLeft = oRight = oDsp;
+void AICA_Sample32()
+{
+	alignas(16) SampleType mixlBuf[32];
+	alignas(16) SampleType mixrBuf[32];
+	// DSP sends (MIXS) of each sample
+	alignas(16) static SampleType mixs[16][32];
+	memset(mixlBuf, 0, sizeof(mixlBuf));
+	memset(mixrBuf, 0, sizeof(mixrBuf));
+	const bool dspEnabled = settings.aica.DSPEnabled;
+	if (dspEnabled)
+		memset(mixs, 0, sizeof(mixs));
+
+	sgc_MixChannels32(mixlBuf, mixrBuf, dspEnabled ? mixs : nullptr);
 
-			mxlr[i*2+0] += oLeft;
-			mxlr[i*2+1] += oRight;
-		}
-	}
 	//OK , generated all Channels  , now DSP/ect + final mix ;p
 	//CDDA EXTS input
 	
@@ -1389,8 +1501,8 @@ void AICA_Sample32()
 	{
 		SampleType mixl,mixr;
 
-		mixl=mxlr[i*2+0];
-		mixr=mxlr[i*2+1];
+		mixl=mixlBuf[i];
+		mixr=mixrBuf[i];
 
 		if (cdda_index>=CDDA_SIZE)
 		{
@@ -1409,20 +1521,27 @@ void AICA_Sample32()
 		{
 			VOLPAN(EXTS0L,dsp_out_vol[16].EFSDL,dsp_out_vol[16].EFPAN,mixl,mixr);
 			VOLPAN(EXTS0R,dsp_out_vol[17].EFSDL,dsp_out_vol[17].EFPAN,mixl,mixr);
-		}
 
-		/*
-		no dsp for now -- needs special handling of oDSP for ch paraller version ...
-		if (settings.aica.DSPEnabled)
+			DSPData->EXTS[0] = EXTS0L;
+			DSPData->EXTS[1] = EXTS0R;
+		}
+		else
 		{
+			DSPData->EXTS[0] = 0;
+			DSPData->EXTS[1] = 0;
+		}
+		if (dspEnabled)
+		{
+			for (int j = 0; j < 16; j++)
+				dsp.MIXS[j] = mixs[j][i];
 			dsp_step();
 
-			for (int i=0;i<16;i++)
-			{
-				VOLPAN( (*(s16*)&DSPData->EFREG[i]) ,dsp_out_vol[i].EFSDL,dsp_out_vol[i].EFPAN,mixl,mixr);
-			}
+			for (int j = 0; j < 16; j++)
+				VOLPAN(*(s16*)&DSPData->EFREG[j], dsp_out_vol[j].EFSDL, dsp_out_vol[j].EFPAN, mixl, mixr);
 		}
-		*/
+
+		if (fast_forward_mode || settings.aica.NoSound)
+			continue;
 
 		//Mono !
 		if (CommonData->Mono)
@@ -1450,17 +1569,14 @@ void AICA_Sample32()
 		//Sample is ready ! clip/saturate and store :}
 
 #ifdef CLIP_WARN
-		if (((s16)mixl) != mixl)
-			printf("Clipped mixl %d\n",mixl);
-		if (((s16)mixr) != mixr)
-			printf("Clipped mixr %d\n",mixr);
+		if (((s16)mixl) != mixl || ((s16)mixr) != mixr)
+			printf("Clipped mixl %d mixr %d\n", mixl, mixr);
 #endif
 
 		clip16(mixl);
 		clip16(mixr);
 
-		if (!fast_forward_mode && !settings.aica.NoSound)
-			WriteSample(mixr,mixl);
+		WriteSample(mixr,mixl);
 	}
 }
 
@@ -1471,7 +1587,7 @@ void AICA_Sample()
 	mixr = 0;
 	memset(dsp.MIXS,0,sizeof(dsp.MIXS));
 
-	ChannelEx::StepAll(mixl,mixr);
+	sgc_MixChannels(mixl, mixr);
 	
 	//OK , generated all Channels  , now DSP/ect + final mix ;p
 	//CDDA EXTS input
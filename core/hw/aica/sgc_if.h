@@ -53,6 +53,12 @@ struct DSP_OUT_VOL_REG
 //#define SAMPLE_TYPE_SHIFT (8)
 typedef s32 SampleType;
 
+// Generates the next sample of all channels. The DSP sends are added to dsp.MIXS
+void sgc_MixChannels(SampleType& mixl, SampleType& mixr);
+// Generates the next 32 samples of all channels. The DSP sends of each sample are added to mixs,
+// which is null if the DSP is disabled
+void sgc_MixChannels32(SampleType *mixl, SampleType *mixr, SampleType (*mixs)[32]);
+
 void ReadCommonReg(u32 reg,bool byte);
 void WriteCommonReg8(u32 reg,u32 data);
 #define clip(x,min,max) do { if ((x)<(min)) (x)=(min); else if ((x)>(max)) (x)=(max); } while (false)
@@ -6346,6 +6346,10 @@ if(cond_res) {
       reg[15].I += offset;
       armNextPC = reg[15].I;
       reg[15].I += 4;
+#ifdef ARM_IDLE_LOOP_BRANCH
+      if (offset < 0)
+        ARM_IDLE_LOOP_BRANCH(armNextPC, armNextPC - offset - 8);
+#endif
     }
     break;
   CASE_256(0xb00)
@@ -6401,3 +6405,8 @@ if(cond_res) {
     // END
   }
 }
+#ifdef ARM_IDLE_LOOP_EXIT
+else if ((opcode & 0x0E000000) == 0x0A000000)
+  // B, BL not taken
+  ARM_IDLE_LOOP_EXIT();
+#endif
@@ -32,6 +32,8 @@ extern void vmem_platform_flush_cache(void *icache_start, void *icache_end, void
 extern u32 arm_single_op(u32 opcode);
 extern "C" void arm_dispatch();
 extern "C" void arm_exit();
+extern "C" s32 arm_IdleLoop(u32 nextPc, s32 cycles, u32 loopPc, u32 loopCycles);
+extern void armv_link(u32 pc);
 
 extern u8* icPtr;
 extern u8* ICache;
@@ -125,7 +127,27 @@ void armv_intpr(u32 opcd)
 	assembler->Sub(w27, w27, w0);
 }
 
-void armv_end(void* codestart, u32 cycl)
+void *armv_jump(void *target)
+{
+	ptrdiff_t offset = reinterpret_cast<uintptr_t>(target) - assembler->GetBuffer()->GetStartAddress<uintptr_t>();
+	Label target_label;
+	assembler->BindToOffset(&target_label, offset);
+	// must be a single B to be patched
+	vixl::ExactAssemblyScope scope(assembler, kInstructionSize);
+	void *site = assembler->GetCursorAddress<void *>();
+	assembler->b(&target_label);
+
+	return site;
+}
+
+void armv_patch_jump(void *site, void *target)
+{
+	ptrdiff_t offset = reinterpret_cast<uintptr_t>(target) - reinterpret_cast<uintptr_t>(site);
+	*(u32 *)site = 0x14000000 | ((offset >> 2) & 0x03FFFFFF);	// B
+	vmem_platform_flush_cache(site, (u8 *)site + 4, site, (u8 *)site + 4);
+}
+
+void armv_end(void* codestart, u32 cycl, const ArmBlockEnd& end)
 {
 	//Normal block end
 	//cycle counter rv
@@ -140,7 +162,38 @@ void armv_end(void* codestart, u32 cycl)
 	offset = reinterpret_cast<uintptr_t>(arm_dispatch) - assembler->GetBuffer()->GetStartAddress<uintptr_t>();
 	Label arm_dispatch_label;
 	assembler->BindToOffset(&arm_dispatch_label, offset);
-	assembler->B(&arm_dispatch_label);
+
+	if (end.idleLoop)
+	{
+		// w27 = arm_IdleLoop(next pc, w27, loop pc, cycles)
+		assembler->Ldr(w0, arm_reg_operand(R15_ARM_NEXT));
+		assembler->Mov(w1, w27);
+		assembler->Mov(w2, end.nextPc[0]);
+		assembler->Mov(w3, cycl);
+		armv_call((void*)&arm_IdleLoop);
+		assembler->Adds(w27, w0, 0);
+		assembler->B(&arm_exit_label, mi);
+	}
+
+	if (end.linkCount == 0)
+		assembler->B(&arm_dispatch_label);
+	else
+	{
+		// pending interrupts are handled by arm_dispatch
+		assembler->Ldr(w1, arm_reg_operand(INTR_PEND));
+		assembler->Cbnz(w1, &arm_dispatch_label);
+		if (end.linkCount == 2)
+		{
+			Label not_taken_label;
+			assembler->Ldr(w0, arm_reg_operand(R15_ARM_NEXT));
+			assembler->Mov(w2, end.nextPc[0]);
+			assembler->Cmp(w0, w2);
+			assembler->B(&not_taken_label, ne);
+			armv_link(end.nextPc[0]);
+			assembler->Bind(&not_taken_label);
+		}
+		armv_link(end.nextPc[end.linkCount - 1]);
+	}
 
 	assembler->FinalizeCode();
 	verify(assembler->GetBuffer()->GetCursorOffset() <= assembler->GetBuffer()->GetCapacity());
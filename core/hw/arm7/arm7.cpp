@@ -1,9 +1,13 @@
 #include "arm7.h"
 #include "arm_mem.h"
+#include "profiler/profiler.h"
+#if defined(HAS_PROFILE)
+#include <chrono>
+#endif
 
 #define arm_printf(...) DEBUG_LOG(AICA_ARM, __VA_ARGS__)
 
-#define CPUReadMemoryQuick(addr) (*(u32*)&aica_ram[addr&ARAM_MASK])
+#define CPUReadMemoryQuick(addr) (*(u32*)&aica_ram[(addr)&ARAM_MASK])
 #define CPUReadByte arm_ReadMem8
 #define CPUReadMemory arm_ReadMem32
 #define CPUReadHalfWord arm_ReadMem16
@@ -24,6 +28,15 @@
 
 #define ARM_CYCLES_PER_SAMPLE 256
 
+#if defined(HAS_PROFILE)
+#define ARM_PROFILE_START() auto profileStart = std::chrono::steady_clock::now()
+#define ARM_PROFILE_END() prof.counters.arm7.host_time += \
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - profileStart).count()
+#else
+#define ARM_PROFILE_START()
+#define ARM_PROFILE_END()
+#endif
+
 alignas(8) reg_pair arm_Reg[RN_ARM_REG_COUNT];
 
 void CPUSwap(u32 *a, u32 *b)
@@ -54,17 +67,260 @@ void CPUSoftwareInterrupt(int comment);
 void CPUUndefinedException();
 void libAICA_TimeStep();
 
+//
+// Idle loop detection
+//
+// Sound drivers spend most of their time polling an AICA register or a flag in wave memory.
+// Such a loop doesn't write memory and recomputes the same registers and flags at each iteration.
+// Nothing else can change memory until the end of the current sample, so once the loop has branched
+// back twice in a row, the remaining iterations of the sample can be skipped. The first iteration
+// must run since some register reads have side effects (LP, MIDI status).
+//
+#define IDLE_LOOP_MAX_OPS 16
+
+enum
+{
+	IDLE_FLAG_N = 1 << 16,
+	IDLE_FLAG_Z = 1 << 17,
+	IDLE_FLAG_C = 1 << 18,
+	IDLE_FLAG_V = 1 << 19,
+};
+
+// Start of the idle loop that just branched back, reset at each sample
+static u32 idleLoopPc = ~0u;
+
+static u32 CondFlags(u32 cond)
+{
+	switch (cond)
+	{
+	case 0x0: // EQ
+	case 0x1: // NE
+		return IDLE_FLAG_Z;
+	case 0x2: // CS
+	case 0x3: // CC
+		return IDLE_FLAG_C;
+	case 0x4: // MI
+	case 0x5: // PL
+		return IDLE_FLAG_N;
+	case 0x6: // VS
+	case 0x7: // VC
+		return IDLE_FLAG_V;
+	case 0x8: // HI
+	case 0x9: // LS
+		return IDLE_FLAG_C | IDLE_FLAG_Z;
+	case 0xA: // GE
+	case 0xB: // LT
+		return IDLE_FLAG_N | IDLE_FLAG_V;
+	case 0xC: // GT
+	case 0xD: // LE
+		return IDLE_FLAG_N | IDLE_FLAG_Z | IDLE_FLAG_V;
+	default:
+		return 0;
+	}
+}
+
+// Returns true if the count opcodes at pc are an idle loop ending with a branch back to pc
+static bool arm_IsIdleLoop(u32 pc, u32 count)
+{
+	if (count == 0 || count > IDLE_LOOP_MAX_OPS)
+		return false;
+
+	// registers and flags read and unconditionally written by each opcode
+	u32 reads[IDLE_LOOP_MAX_OPS];
+	u32 writes[IDLE_LOOP_MAX_OPS];
+	// everything the loop may write
+	u32 loopWrites = 0;
+
+	for (u32 i = 0; i < count; i++)
+	{
+		u32 opcd = CPUReadMemoryQuick(pc + i * 4);
+		u32 cond = opcd >> 28;
+		reads[i] = 0;
+		writes[i] = 0;
+
+		if (i == count - 1)
+		{
+			// B back to the loop start
+			if (cond == 0xF || (opcd & 0x0F000000) != 0x0A000000)
+				return false;
+			s32 offset = ((s32)opcd << 8) >> 6;
+			if (pc + i * 4 + 8 + offset != pc)
+				return false;
+			reads[i] = CondFlags(cond);
+			break;
+		}
+		if (cond != 0xE)
+			return false;
+
+		if ((opcd & 0x0C000000) == 0)
+		{
+			// Data processing
+			bool I = opcd & (1 << 25);
+			bool S = opcd & (1 << 20);
+			u32 op = (opcd >> 21) & 15;
+			u32 Rd = (opcd >> 12) & 15;
+			bool test = op >= 8 && op <= 11;	// TST, TEQ, CMP, CMN
+			bool logical = op <= 1 || op == 8 || op == 9 || op >= 12;
+
+			if (!I && (opcd & 0x90) == 0x90)
+				return false;	// MUL, SWP, LDRH/STRH
+			if (test && !S)
+				return false;	// MRS, MSR
+			if (!test && Rd == 15)
+				return false;
+
+			if (op != 13 && op != 15)	// MOV, MVN
+				reads[i] |= 1 << ((opcd >> 16) & 15);
+			if (op >= 5 && op <= 7)		// ADC, SBC, RSC
+				reads[i] |= IDLE_FLAG_C;
+
+			// shifter carry out: always, never or depending on the shift register
+			bool carryOut;
+			bool carryMaybe = false;
+			if (I)
+			{
+				carryOut = ((opcd >> 8) & 15) != 0;
+			}
+			else
+			{
+				reads[i] |= 1 << (opcd & 15);
+				if (opcd & (1 << 4))
+				{
+					reads[i] |= 1 << ((opcd >> 8) & 15);
+					carryOut = false;
+					carryMaybe = true;
+				}
+				else
+				{
+					u32 shift = (opcd >> 5) & 3;
+					u32 amount = (opcd >> 7) & 31;
+					if (shift == 3 && amount == 0)
+						reads[i] |= IDLE_FLAG_C;	// RRX
+					carryOut = shift != 0 || amount != 0;
+				}
+			}
+
+			if (!test)
+				writes[i] |= 1 << Rd;
+			if (S)
+			{
+				if (!logical)
+					writes[i] |= IDLE_FLAG_N | IDLE_FLAG_Z | IDLE_FLAG_C | IDLE_FLAG_V;
+				else
+				{
+					writes[i] |= IDLE_FLAG_N | IDLE_FLAG_Z;
+					if (carryOut)
+						writes[i] |= IDLE_FLAG_C;
+					else if (carryMaybe)
+						loopWrites |= IDLE_FLAG_C;
+				}
+			}
+		}
+		else if ((opcd & 0x0C100000) == 0x04100000)
+		{
+			// LDR, LDRB
+			bool I = opcd & (1 << 25);
+			bool P = opcd & (1 << 24);
+			bool W = opcd & (1 << 21);
+			u32 Rn = (opcd >> 16) & 15;
+			u32 Rd = (opcd >> 12) & 15;
+
+			if (I && (opcd & (1 << 4)))
+				return false;	// undefined
+			if (Rd == 15 || (Rn == 15 && (W || !P)))
+				return false;
+
+			reads[i] |= 1 << Rn;
+			if (I)
+			{
+				reads[i] |= 1 << (opcd & 15);
+				if ((opcd & 0xFE0) == 0x060)
+					reads[i] |= IDLE_FLAG_C;	// RRX
+			}
+			if (W || !P)
+				writes[i] |= 1 << Rn;
+			writes[i] |= 1 << Rd;
+		}
+		else
+		{
+			// Memory writes, branches, etc.
+			return false;
+		}
+		loopWrites |= writes[i];
+	}
+
+	// Each value read must be computed earlier in the same iteration or not be modified by the loop
+	u32 written = 0;
+	for (u32 i = 0; i < count; i++)
+	{
+		if (reads[i] & loopWrites & ~written)
+			return false;
+		written |= writes[i];
+	}
+	return true;
+}
+
 #if FEAT_AREC == DYNAREC_NONE
 
 //
 // ARM7 interpreter
 //
+
+// Last loop analyzed. The interpreter checks it again if its code changes.
+static struct
+{
+	u32 pc;
+	u32 count;
+	u32 opcodes[IDLE_LOOP_MAX_OPS];
+	bool idle;
+	u32 lastTicks;		// clock ticks at the previous iteration, valid if idleLoopPc == pc
+} idleLoop;
+
+// Called when a branch from branchPc back to pc is taken. Returns the updated clock ticks.
+static u32 arm_IdleLoopBranch(u32 pc, u32 branchPc, u32 clockTicks, u32 cycleCount)
+{
+	u32 count = (branchPc - pc) / 4 + 1;
+	if (count > IDLE_LOOP_MAX_OPS)
+		return clockTicks;
+
+	bool same = pc == idleLoop.pc && count == idleLoop.count;
+	for (u32 i = 0; same && i < count; i++)
+		same = idleLoop.opcodes[i] == CPUReadMemoryQuick(pc + i * 4);
+	if (!same)
+	{
+		idleLoop.pc = pc;
+		idleLoop.count = count;
+		for (u32 i = 0; i < count; i++)
+			idleLoop.opcodes[i] = CPUReadMemoryQuick(pc + i * 4);
+		idleLoop.idle = arm_IsIdleLoop(pc, count);
+		idleLoopPc = ~0u;
+	}
+	if (!idleLoop.idle)
+		return clockTicks;
+
+	if (idleLoopPc == pc && clockTicks < cycleCount)
+	{
+		// Skip whole iterations and let the last one run, so that the sample ends at the same point
+		u32 loopTicks = clockTicks - idleLoop.lastTicks;
+		u32 skipped = (cycleCount - 1 - clockTicks) / loopTicks * loopTicks;
+		clockTicks += skipped;
+		prof.counters.arm7.idle_cycles += skipped;
+	}
+	idleLoopPc = pc;
+	idleLoop.lastTicks = clockTicks;
+
+	return clockTicks;
+}
+#define ARM_IDLE_LOOP_BRANCH(pc, branchPc) clockTicks = arm_IdleLoopBranch(pc, branchPc, clockTicks, CycleCount)
+#define ARM_IDLE_LOOP_EXIT() idleLoopPc = ~0u
+
 void arm_Run_(u32 CycleCount)
 {
 	if (!Arm7Enabled)
 		return;
 
 	u32 clockTicks = 0;
+	idleLoopPc = ~0u;
 	while (clockTicks < CycleCount)
 	{
 		if (reg[INTR_PEND].I)
@@ -81,10 +337,14 @@ void arm_Run(u32 samples)
 {
 	for (u32 i = 0; i < samples; i++)
 	{
+		ARM_PROFILE_START();
 		arm_Run_(ARM_CYCLES_PER_SAMPLE);
+		ARM_PROFILE_END();
 		libAICA_TimeStep();
 	}
 }
+#undef ARM_IDLE_LOOP_BRANCH
+#undef ARM_IDLE_LOOP_EXIT
 #endif
 
 void armt_init();
@@ -319,6 +579,7 @@ void CPUFiq()
 	armIrqEnable = false;
 	armFiqEnable = false;
 	update_armintc();
+	idleLoopPc = ~0u;
 
 	armNextPC = 0x1c;
 }
@@ -355,6 +616,7 @@ void update_armintc()
 // ARM7 Recompiler
 //
 
+#include <map>
 #include "virt_arm.h"
 
 #if defined(__APPLE__)
@@ -635,7 +897,11 @@ enum OpType
 void armv_call(void* target);
 void armv_setup();
 void armv_intpr(u32 opcd);
-void armv_end(void* codestart, u32 cycles);
+void armv_end(void* codestart, u32 cycles, const ArmBlockEnd& end);
+#if HOST_CPU != CPU_X86
+void *armv_jump(void *target);
+void armv_patch_jump(void *site, void *target);
+#endif
 void armv_check_pc(u32 pc);
 void armv_check_cache(u32 opcd, u32 pc);
 void armv_imm_to_reg(u32 regn, u32 imm);
@@ -652,6 +918,44 @@ extern "C" void DYNACALL
 		arm_mainloop(u32 cycl, void* regs, void* entrypoints);
 extern "C" void DYNACALL arm_compilecode();
 
+#if HOST_CPU != CPU_X86
+// Block exits waiting for their target to be compiled: target pc -> jump to patch
+static std::multimap<u32, void*> pendingLinks;
+
+// Jumps to the block at pc, or to arm_dispatch until it is compiled
+void armv_link(u32 pc)
+{
+	pc &= ARAM_SIZE_MAX - 1;
+	void *entry = EntryPoints[pc / 4];
+	if (entry != (void*)&arm_compilecode)
+	{
+		armv_jump(entry);
+		prof.counters.arm7.linked++;
+	}
+	else
+		pendingLinks.insert(std::make_pair(pc, armv_jump((void*)&arm_dispatch)));
+}
+#endif
+
+// Called by idle loop blocks at the end of each iteration. Returns the updated cycle counter.
+extern "C" s32 DYNACALL arm_IdleLoop(u32 nextPc, s32 cycles, u32 loopPc, u32 loopCycles)
+{
+	if (nextPc != loopPc)
+		// exiting the loop
+		idleLoopPc = ~0u;
+	else if (idleLoopPc != loopPc)
+		// first iteration
+		idleLoopPc = loopPc;
+	else
+	{
+		// Skip to the iteration that would run out of cycles
+		s32 remaining = cycles % (s32)loopCycles - (s32)loopCycles;
+		prof.counters.arm7.idle_cycles += cycles - remaining;
+		cycles = remaining;
+	}
+	return cycles;
+}
+
 template <bool Load, bool Byte>
 u32 DYNACALL DoMemOp(u32 addr,u32 data)
 {
@@ -1326,7 +1630,7 @@ void armv_intpr(u32 opcd)
 	x86e->Emit(op_call,x86_ptr_imm(&arm_single_op));
 }
 
-void armv_end(void* codestart, u32 cycles)
+void armv_end(void* codestart, u32 cycles, const ArmBlockEnd& end)
 {
 	//Normal block end
 	//Move counter to EAX for return, pop ESI, ret
@@ -1544,7 +1848,23 @@ void armv_intpr(u32 opcd)
 	SUB(r5, r5, r0, false);
 }
 
-void armv_end(void* codestart, u32 cycl)
+void *armv_jump(void *target)
+{
+	void *site = EMIT_GET_PTR();
+	JUMP((u32)target);
+	verify((*(u32 *)site & 0xFF000000) == 0xEA000000);	//must be a single B to be patched
+
+	return site;
+}
+
+void armv_patch_jump(void *site, void *target)
+{
+	s32 offset = (u8 *)target - ((u8 *)site + 8);
+	*(u32 *)site = 0xEA000000 | ((offset >> 2) & 0xFFFFFF);
+	armFlushICache(site, (u8 *)site + 4);
+}
+
+void armv_end(void* codestart, u32 cycl, const ArmBlockEnd& end)
 {
 	//Normal block end
 	//cycle counter rv
@@ -1563,7 +1883,37 @@ void armv_end(void* codestart, u32 cycl)
 		SUB(r5,r5,togo,true);
 	}
 	JUMP((u32)&arm_exit,CC_MI);	//statically predicted as not taken
-	JUMP((u32)&arm_dispatch);
+
+	if (end.idleLoop)
+	{
+		//r5 = arm_IdleLoop(next pc, r5, loop pc, cycles)
+		LoadReg(r0,R15_ARM_NEXT);
+		MOV(r1,r5);
+		MOV32(r2,end.nextPc[0]);
+		MOV32(r3,cycl);
+		CALL((u32)&arm_IdleLoop);
+		MOV(r5,r0,true);
+		JUMP((u32)&arm_exit,CC_MI);
+	}
+
+	if (end.linkCount == 0)
+		JUMP((u32)&arm_dispatch);
+	else
+	{
+		//pending interrupts are handled by arm_dispatch
+		LoadReg(r1,INTR_PEND);
+		CMP(r1,0);
+		JUMP((u32)&arm_dispatch,CC_NE);
+		if (end.linkCount == 2)
+		{
+			LoadReg(r0,R15_ARM_NEXT);
+			MOV32(r2,end.nextPc[0]);
+			CMP(r0,r2);
+			B(0,CC_NE);		//skip next instruction
+			armv_link(end.nextPc[0]);
+		}
+		armv_link(end.nextPc[end.linkCount - 1]);
+	}
 
 	armFlushICache(codestart,(void*)EMIT_GET_PTR());
 }
@@ -1586,7 +1936,12 @@ void arm_Run(u32 samples)
 	for (int i = 0; i < samples; i++)
 	{
 		if (Arm7Enabled)
+		{
+			ARM_PROFILE_START();
+			idleLoopPc = ~0u;
 			arm_mainloop(ARM_CYCLES_PER_SAMPLE, arm_Reg, EntryPoints);
+			ARM_PROFILE_END();
+		}
 		libAICA_TimeStep();
 	}
 }
@@ -1671,8 +2026,20 @@ extern "C" void CompileCode()
 	// ram size. The aica ram always wraps to 8 MB anyway.
 	EntryPoints[(armNextPC & (ARAM_SIZE_MAX - 1)) / 4] = rv;
 
+#if HOST_CPU != CPU_X86
+	//link the blocks jumping here
+	auto links = pendingLinks.equal_range(armNextPC & (ARAM_SIZE_MAX - 1));
+	for (auto it = links.first; it != links.second; ++it)
+		armv_patch_jump(it->second, rv);
+	prof.counters.arm7.linked += std::distance(links.first, links.second);
+	pendingLinks.erase(links.first, links.second);
+#endif
+
 	//setup local pc counter
 	u32 pc=armNextPC;
+	const u32 blockPc = pc;
+	ArmBlockEnd blockEnd {};
+	bool fallbacks = false;
 
 	//emitter/block setup
 	armv_setup();
@@ -1786,6 +2153,12 @@ extern "C" void CompileCode()
 					armv_imm_to_reg(R15_ARM_NEXT,pc+8+offs);
 				}
 				Cycles += 3;
+
+				blockEnd.nextPc[0] = pc + 8 + offs;
+				blockEnd.nextPc[1] = pc + 4;
+				blockEnd.linkCount = (op_flags & OP_IS_COND) ? 2 : 1;
+				blockEnd.idleLoop = opt == VOT_B && blockEnd.nextPc[0] == blockPc && !fallbacks
+						&& arm_IsIdleLoop(blockPc, ops);
 			}
 			break;
 
@@ -1982,6 +2355,7 @@ extern "C" void CompileCode()
 		case VOT_Fallback:
 			{
 				//interpreter fallback
+				fallbacks = true;
 
 				// Let the interpreter count cycles
 				Cycles -= 6;
@@ -2048,6 +2422,8 @@ extern "C" void CompileCode()
 			arm_printf("ARM: %06X: Block split %d\n",pc,ops);
 
 			armv_imm_to_reg(R15_ARM_NEXT,pc+4);
+			blockEnd.linkCount = 1;
+			blockEnd.nextPc[0] = pc + 4;
 			break;
 		}
 		
@@ -2055,13 +2431,16 @@ extern "C" void CompileCode()
 		pc+=4;
 	}
 
-	armv_end((void*)rv,Cycles);
+	armv_end((void*)rv, Cycles, blockEnd);
 }
 
 
 
 void FlushCache()
 {
+#if HOST_CPU != CPU_X86
+	pendingLinks.clear();
+#endif
 	icPtr=ICache;
 	for (u32 i = 0; i < ARRAY_SIZE(EntryPoints); i++)
 		EntryPoints[i] = (void*)&arm_compilecode;
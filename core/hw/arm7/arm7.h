@@ -87,3 +87,11 @@ typedef union
 
 	u32 I;
 } reg_pair;
+
+// How a recompiled block ends
+struct ArmBlockEnd
+{
+	u32 linkCount;		// number of static successors: 0 (use arm_dispatch), 1 or 2
+	u32 nextPc[2];		// successors. If there are 2, the first one is taken if R15_ARM_NEXT equals it
+	bool idleLoop;		// the block is an idle loop branching back to nextPc[0]
+};
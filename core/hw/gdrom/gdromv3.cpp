@@ -3,6 +3,7 @@
 	Overly complex implementation of a very ugly device
 */
 
+#include <cmath>
 #include "gdromv3.h"
 #include "hw/holly/holly_intc.h"
 #include "hw/holly/sb.h"
@@ -28,6 +29,17 @@ cdda_t cdda ;
 
 gd_states gd_state;
 DiscType gd_disk_type;
+
+// Accurate load timing. The drive spins at constant angular velocity, 12x at the outer edge of the disc.
+const double DISC_INNER_RADIUS = 23.0;			// mm, at FAD 0
+const double DISC_OUTER_RADIUS = 58.0;			// mm, at the end of the high density area
+const double OUTER_SECTOR_RATE = 12 * 75.0;		// sectors per second at the outer edge
+const double ROTATION_TIME = 60.0 / 2570.0;		// s, the disc spins at about 2570 rpm
+const double SEEK_MIN_TIME = 0.02;				// s, seek to a close track and settle
+const double SEEK_FULL_STROKE_TIME = 0.15;		// s, added for a seek from the inner to the outer edge
+
+u32 head_fad = 150;		// position of the head after the last read or seek
+int read_seek_ticks;		// seek delay of the current DMA read
 /*
 	GD rom reset -> GDS_WAITCMD
 
@@ -93,6 +105,49 @@ void gd_spi_pio_end(const u8* buffer, u32 len, gd_states next_state = gds_pio_en
 void gd_process_spi_cmd();
 void gd_process_ata_cmd();
 
+// The sectors are laid out at constant linear density, so the area read grows linearly with the FAD
+static double gd_radius(u32 fad)
+{
+	const double ratio = std::min(fad, 549150u) / 549150.0;
+	return sqrt(DISC_INNER_RADIUS * DISC_INNER_RADIUS
+			+ (DISC_OUTER_RADIUS * DISC_OUTER_RADIUS - DISC_INNER_RADIUS * DISC_INNER_RADIUS) * ratio);
+}
+
+// Time to read the given number of bytes at the head position
+static int gd_transfer_ticks(u32 bytes)
+{
+	const double sector_rate = OUTER_SECTOR_RATE * gd_radius(head_fad) / DISC_OUTER_RADIUS;
+	return (int)(bytes / (sector_rate * read_params.sector_type) * SH4_MAIN_CLOCK);
+}
+
+// Time to move the head to the given FAD and wait for the sector to come under it
+static int gd_seek_ticks(u32 fad)
+{
+	if (fad == head_fad)
+		return 0;
+	const double distance = fabs(gd_radius(fad) - gd_radius(head_fad)) / (DISC_OUTER_RADIUS - DISC_INNER_RADIUS);
+	const double time = SEEK_MIN_TIME + SEEK_FULL_STROKE_TIME * distance + ROTATION_TIME / 2;
+	return (int)(time * SH4_MAIN_CLOCK);
+}
+
+// Delay of the SPI_CD_SEEK command, 0 if it completes immediately
+static int gd_seek_delay(u32 fad)
+{
+	switch (settings.imgread.LoadTiming)
+	{
+	case GDRomTiming::Accurate:
+		return gd_seek_ticks(fad);
+	case GDRomTiming::Instant:
+		return 0;
+	default:
+#ifdef STRICT_MODE
+		return SH4_MAIN_CLOCK / 50;	// 20 ms
+#else
+		return 0;
+#endif
+	}
+}
+
 static void FillReadBuffer()
 {
 	read_buff.cache_index=0;
@@ -106,6 +161,10 @@ static void FillReadBuffer()
 	libGDR_ReadSector(read_buff.cache,read_params.start_sector,count,read_params.sector_type);
 	read_params.start_sector+=count;
 	read_params.remaining_sectors-=count;
+	head_fad = read_params.start_sector;
+	// Let the disc prepare the next sectors while this buffer is transferred
+	if (read_params.remaining_sectors > 0)
+		libGDR_ReadAhead(read_params.start_sector, read_params.remaining_sectors);
 }
 
 
@@ -193,6 +252,7 @@ void gd_set_state(gd_states state)
 				libGDR_ReadSector((u8*)&pio_buff.data[0],read_params.start_sector,sector_count, read_params.sector_type);
 				read_params.start_sector+=sector_count;
 				read_params.remaining_sectors-=sector_count;
+				head_fad = read_params.start_sector;
 
 				gd_spi_pio_end(0,sector_count*read_params.sector_type,next_state);
 			}
@@ -612,6 +672,8 @@ void gd_process_spi_cmd()
 			printf_spicmd("SPI_CD_READ - Sector=%d Size=%d/%d DMA=%d",read_params.start_sector,read_params.remaining_sectors,read_params.sector_type,Features.CDRead.DMA);
 			if (Features.CDRead.DMA == 1)
 			{
+				if (settings.imgread.LoadTiming == GDRomTiming::Accurate)
+					read_seek_ticks = gd_seek_ticks(read_params.start_sector);
 				gd_set_state(gds_readsector_dma);
 			}
 			else
@@ -812,27 +874,35 @@ void gd_process_spi_cmd()
 			{
 				bool min_sec_frame = param_type == 2;
 				cdda.StartAddr.FAD = cdda.CurrAddr.FAD = GetFAD(&packet_cmd.data_8[2], min_sec_frame);
-#ifdef STRICT_MODE
-				SecNumber.Status = GD_SEEK;
-				GDStatus.DSC = 0;
-				sh4_sched_request(gdrom_schid, SH4_MAIN_CLOCK / 50);	// 20 ms
-#else
-				GDStatus.DSC = 1;
-#endif
+				int ticks = gd_seek_delay(cdda.StartAddr.FAD);
+				head_fad = cdda.StartAddr.FAD;
+				if (ticks > 0)
+				{
+					SecNumber.Status = GD_SEEK;
+					GDStatus.DSC = 0;
+					sh4_sched_request(gdrom_schid, ticks);
+				}
+				else
+					GDStatus.DSC = 1;
 			}
 			else if (param_type == 3)
 			{
 				//stop audio , goto home
 				cdda.StartAddr.FAD = cdda.CurrAddr.FAD = 150;
 				cdda.status = cdda_t::NoInfo;
-#ifdef STRICT_MODE
-				SecNumber.Status = GD_BUSY;
-				GDStatus.DSC = 0;
-				sh4_sched_request(gdrom_schid, SH4_MAIN_CLOCK / 50);	// 20 ms
-#else
-				SecNumber.Status = GD_STANDBY;
-				GDStatus.DSC = 1;
-#endif
+				int ticks = gd_seek_delay(150);
+				head_fad = 150;
+				if (ticks > 0)
+				{
+					SecNumber.Status = GD_BUSY;
+					GDStatus.DSC = 0;
+					sh4_sched_request(gdrom_schid, ticks);
+				}
+				else
+				{
+					SecNumber.Status = GD_STANDBY;
+					GDStatus.DSC = 1;
+				}
 			}
 			else if (param_type == 4)
 			{
@@ -1047,10 +1117,22 @@ static int getGDROMTicks()
 {
 	if (SB_GDST & 1)
 	{
-		if (SB_GDLEN - SB_GDLEND > 10240)
-			return 1000000;										// Large transfers: GD-ROM transfer rate 1.8 MB/s
-		else
-			return std::min((u32)10240, SB_GDLEN - SB_GDLEND) * 2;	// Small transfers: Max G1 bus rate: 50 MHz x 16 bits
+		switch (settings.imgread.LoadTiming)
+		{
+		case GDRomTiming::Accurate:
+			{
+				int ticks = gd_transfer_ticks(std::min((u32)10240, SB_GDLEN - SB_GDLEND)) + read_seek_ticks;
+				read_seek_ticks = 0;
+				return ticks;
+			}
+		case GDRomTiming::Instant:
+			return 0;
+		default:
+			if (SB_GDLEN - SB_GDLEND > 10240)
+				return 1000000;										// Large transfers: GD-ROM transfer rate 1.8 MB/s
+			else
+				return std::min((u32)10240, SB_GDLEN - SB_GDLEND) * 2;	// Small transfers: Max G1 bus rate: 50 MHz x 16 bits
+		}
 	}
 	else
 		return 0;
@@ -1089,7 +1171,11 @@ int GDRomschd(int i, int c, int j)
 		//make sure we don't underrun the cache :)
 		len = std::min(len, read_buff.cache_size);
 
-	len = std::min(len, (u32)10240);
+	if (settings.imgread.LoadTiming == GDRomTiming::Instant)
+		// Transfer all the data at once, so the DMA end and command completion interrupts are raised together
+		len = std::min(len, read_buff.cache_size + read_params.remaining_sectors * read_params.sector_type);
+	else
+		len = std::min(len, (u32)10240);
 	// do we need to do this for GDROM DMA?
 	if(0x8201 != (dmaor &DMAOR_MASK))
 	{
@@ -1211,6 +1297,8 @@ void gdrom_reg_Reset(bool hard)
 	sb_rio_register(SB_GDEN_addr, RIO_WF, 0, &GDROM_DmaEnable);
 	SB_GDST = 0;
 	SB_GDEN = 0;
+	head_fad = 150;
+	read_seek_ticks = 0;
 	// set default hardware information
 	memset(&GD_HardwareInfo, 0, sizeof(GD_HardwareInfo));
 	GD_HardwareInfo.speed = 0x0;
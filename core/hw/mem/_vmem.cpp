@@ -1,5 +1,6 @@
 #include "_vmem.h"
 #include "vmem32.h"
+#include "vmem_snapshot.h"
 #include "hw/aica/aica_if.h"
 #include "hw/pvr/pvr_mem.h"
 #include "hw/sh4/dyna/blockmanager.h"
@@ -452,6 +453,9 @@ bool _vmem_reserve()
 {
 	static_assert((sizeof(Sh4RCB) % PAGE_SIZE) == 0, "sizeof(Sh4RCB) not multiple of PAGE_SIZE");
 
+	if (virt_ram_base != nullptr)
+		// Already reserved. Memory is only mapped once by dc_init()
+		return true;
 	vmemstatus = MemTypeError;
 
 	// Use vmem only if settings mandate so, and if we have proper exception handlers.
@@ -490,6 +494,7 @@ static void _vmem_term_mappings()
 
 void _vmem_init_mappings()
 {
+	vmem_snapshot_reset();
 	_vmem_term_mappings();
 	// Fallback to statically allocated buffers, this results in slow-ops being generated.
 	if (vmemstatus == MemTypeError) {
@@ -605,6 +610,7 @@ void _vmem_init_mappings()
 	if (x) { free(x); x = NULL; }
 
 void _vmem_release() {
+	vmem_snapshot_reset();
 	if (virt_ram_base)
 		vmem_platform_destroy();
 	else {
@@ -620,6 +626,8 @@ void _vmem_enable_mmu(bool enable)
 {
 	if (enable)
 	{
+		// Snapshots can't track writes to user space once it's managed by vmem32
+		vmem_snapshot_complete();
 		vmem32_init();
 	}
 	else
@@ -756,3 +764,139 @@ u32 _vmem_get_vram_offset(void *addr)
 		return (u32)offset;
 	}
 }
+
+// Returns the offset of a writable address in the memory file, or -1
+static u32 _vmem_get_map_offset(void *addr)
+{
+	ptrdiff_t offset = (u8*)addr - virt_ram_base;
+	if (_nvmem_4gb_space())
+	{
+		if (offset < 0 || offset >= 0xE0000000 || (offset >= 0x20000000 && offset < 0x80000000))
+			return -1;
+		if (mmu_enabled() && offset < 0x80000000)
+			// user space is managed by vmem32
+			return -1;
+		offset &= 0x1FFFFFFF;
+		if ((offset >= 0x00800000 && offset < 0x01000000) || (offset >= 0x02800000 && offset < 0x03000000))
+			return MAP_ARAM_START_OFFSET + (offset & ARAM_MASK);
+	}
+	else
+	{
+		if (offset < 0 || offset >= 0x20800000)
+			return -1;
+		if (offset >= 0x20000000)
+			return MAP_ARAM_START_OFFSET + (offset & ARAM_MASK);
+	}
+	if ((offset >> 26) == 3)
+		return MAP_RAM_START_OFFSET + (offset & RAM_MASK);
+
+	return -1;
+}
+
+u32 _vmem_get_ram_offset(void *addr)
+{
+	if (!_nvmem_enabled())
+		return -1;
+	u32 offset = _vmem_get_map_offset(addr);
+	if (offset == (u32)-1 || offset >= MAP_VRAM_START_OFFSET)
+		return -1;
+	return offset - MAP_RAM_START_OFFSET;
+}
+
+u32 _vmem_get_aram_offset(void *addr)
+{
+	if (!_nvmem_enabled())
+		return -1;
+	u32 offset = _vmem_get_map_offset(addr);
+	if (offset == (u32)-1 || offset < MAP_ARAM_START_OFFSET)
+		return -1;
+	return offset - MAP_ARAM_START_OFFSET;
+}
+
+// Locks or unlocks a range of memory in all the writable mirrors of the given areas,
+// in each kernel segment in 4GB mode
+static void _vmem_protect_mirrors(const u32 *areas, unsigned count, u32 area_size, u32 mem_size, u32 addr, u32 size, bool protect)
+{
+	const u32 segments[] = { 0x00000000, 0x80000000, 0xA0000000, 0xC0000000 };
+	for (u32 segment : segments)
+	{
+		if (segment == 0 && mmu_enabled() && _nvmem_4gb_space())
+			// user space is managed by vmem32
+			continue;
+		if (segment != 0 && !_nvmem_4gb_space())
+			break;
+		for (unsigned i = 0; i < count; i++)
+			// Windows cannot lock/unlock a region spanning more than one mapping
+			for (u32 mirror = 0; mirror < area_size; mirror += mem_size)
+			{
+				u8 *p = virt_ram_base + segment + areas[i] + mirror + addr;
+				if (protect)
+					mem_region_lock(p, size);
+				else
+					mem_region_unlock(p, size);
+			}
+	}
+}
+
+void _vmem_protect_ram(u32 addr, u32 size, bool protect)
+{
+	verify(_nvmem_enabled());
+	const u32 areas[] = { 0x0C000000 };
+	_vmem_protect_mirrors(areas, ARRAY_SIZE(areas), 0x04000000, RAM_SIZE, addr & RAM_MASK, size, protect);
+}
+
+void _vmem_protect_aram(u32 addr, u32 size, bool protect)
+{
+	verify(_nvmem_enabled());
+	if (_nvmem_4gb_space())
+	{
+		const u32 areas[] = { 0x00800000, 0x02800000 };
+		_vmem_protect_mirrors(areas, ARRAY_SIZE(areas), 0x00800000, ARAM_SIZE, addr & ARAM_MASK, size, protect);
+	}
+	else
+	{
+		// Only the aica ram mapping outside of the 512MB addr space is writable
+		const u32 areas[] = { 0x20000000 };
+		_vmem_protect_mirrors(areas, ARRAY_SIZE(areas), 0x00800000, ARAM_SIZE, addr & ARAM_MASK, size, protect);
+	}
+}
+
+void _vmem_protect_vram_mirrors(u32 addr, u32 size, bool protect)
+{
+	verify(_nvmem_enabled());
+	addr &= VRAM_MASK;
+	const u32 areas[] = { 0x06000000 };
+	_vmem_protect_mirrors(areas, ARRAY_SIZE(areas), 0x01000000, VRAM_SIZE, addr, size, protect);
+	if (_nvmem_4gb_space())
+		for (u32 mirror = 0; mirror < 0x01000000; mirror += VRAM_SIZE)
+		{
+			u8 *p = virt_ram_base + 0xC4000000 + mirror + addr;	// P3
+			if (protect)
+				mem_region_lock(p, size);
+			else
+				mem_region_unlock(p, size);
+		}
+}
+
+u32 _vmem_get_vram_mirror_offset(void *addr)
+{
+	if (!_nvmem_enabled())
+		return -1;
+	ptrdiff_t offset = (u8*)addr - virt_ram_base;
+	if (_nvmem_4gb_space())
+	{
+		if (offset < 0 || offset >= 0xE0000000 || (offset >= 0x20000000 && offset < 0x80000000))
+			return -1;
+		if ((offset >> 24) == 0xC4)
+			return offset & VRAM_MASK;
+	}
+	else
+	{
+		if (offset < 0 || offset >= 0x20000000)
+			return -1;
+	}
+	if (((offset & 0x1FFFFFFF) >> 24) != 6)
+		return -1;
+
+	return offset & VRAM_MASK;
+}
@@ -117,3 +117,15 @@ void _vmem_enable_mmu(bool enable);
 void _vmem_protect_vram(u32 addr, u32 size);
 void _vmem_unprotect_vram(u32 addr, u32 size);
 u32 _vmem_get_vram_offset(void *addr);
+// Offset in system RAM or AICA RAM of a host address, or -1
+u32 _vmem_get_ram_offset(void *addr);
+u32 _vmem_get_aram_offset(void *addr);
+// Write-protects or unprotects all the writable mirrors of a range of system RAM or AICA RAM.
+// Requires nvmem.
+void _vmem_protect_ram(u32 addr, u32 size, bool protect);
+void _vmem_protect_aram(u32 addr, u32 size, bool protect);
+// Write-protects or unprotects the vram mappings left writable by _vmem_protect_vram(): the 0x06000000 mirror
+// and the P3 segment. Requires nvmem.
+void _vmem_protect_vram_mirrors(u32 addr, u32 size, bool protect);
+// Offset in vram of a host address in these mappings, or -1
+u32 _vmem_get_vram_mirror_offset(void *addr);
@@ -23,6 +23,9 @@
 #include "hw/sh4/dyna/ngen.h"
 #include "hw/sh4/modules/mmu.h"
 
+#include <algorithm>
+#include <chrono>
+#include <map>
 #include <unordered_set>
 #include <mutex>
 
@@ -38,6 +41,9 @@
 #ifndef MAP_NOSYNC
 #define MAP_NOSYNC       0
 #endif
+#ifndef MAP_POPULATE
+#define MAP_POPULATE     0
+#endif
 
 extern bool VramLockedWriteOffset(size_t offset);
 extern std::mutex vramlist_lock;
@@ -64,11 +70,18 @@ struct vram_lock {
 static std::vector<vram_lock> vram_blocks[VRAM_SIZE_MAX / VRAM_PROT_SEGMENT];
 static u8 sram_mapped_pages[USER_SPACE / PAGE_SIZE / 8];	// bit set to 1 if page is mapped
 
-bool vmem32_inited;
+// User space mappings done since the last full flush, by virtual address
+struct mapped_region {
+	u32 size;
+	u32 ppn;
+	u32 offset;
+	bool tlb_write;		// write allowed by the TLB entry
+	bool write;			// mapped writable
+};
+static std::map<u32, mapped_region> mapped_regions;
 
-// stats
-//u64 vmem32_page_faults;
-//u64 vmem32_flush;
+bool vmem32_inited;
+vmem32_stats_t vmem32_stats;
 
 static void* vmem32_map_buffer(u32 dst, u32 addrsz, u32 offset, u32 size, bool write)
 {
@@ -91,7 +104,9 @@ static void* vmem32_map_buffer(u32 dst, u32 addrsz, u32 offset, u32 size, bool w
 	}
 #else
 	u32 prot = PROT_READ | (write ? PROT_WRITE : 0);
-	rv = mmap(&virt_ram_base[dst], size, prot, MAP_SHARED | MAP_NOSYNC | MAP_FIXED, vmem_fd, offset);
+	// Populate the host page tables for the whole TLB entry instead of taking a fault on each page
+	u32 flags = MAP_SHARED | MAP_NOSYNC | MAP_FIXED | (settings.dynarec.vmem32_prefault ? MAP_POPULATE : 0);
+	rv = mmap(&virt_ram_base[dst], size, prot, flags, vmem_fd, offset);
 	if (MAP_FAILED == rv)
 	{
 		ERROR_LOG(VMEM, "MAP1 failed %d", errno);
@@ -101,7 +116,7 @@ static void* vmem32_map_buffer(u32 dst, u32 addrsz, u32 offset, u32 size, bool w
 	for (u32 i = 1; i < map_times; i++)
 	{
 		dst += size;
-		ptr = mmap(&virt_ram_base[dst], size, prot , MAP_SHARED | MAP_NOSYNC | MAP_FIXED, vmem_fd, offset);
+		ptr = mmap(&virt_ram_base[dst], size, prot, flags, vmem_fd, offset);
 		if (MAP_FAILED == ptr)
 		{
 			ERROR_LOG(VMEM, "MAP2 failed %d", errno);
@@ -171,6 +186,23 @@ void vmem32_unprotect_vram(u32 addr, u32 size)
 
 static const u32 page_sizes[] = { 1024, 4 * 1024, 64 * 1024, 1024 * 1024 };
 
+static void vmem32_map_region(u32 vpn, u32 page_size, u32 ppn, u32 offset, bool tlb_write, bool write)
+{
+	verify(vmem32_map_buffer(vpn, page_size, offset, page_size, write) != NULL);
+	if (vpn >= USER_SPACE)
+		return;
+	// The new mapping replaces the regions it overlaps
+	auto it = mapped_regions.lower_bound(vpn >= page_sizes[3] ? vpn - page_sizes[3] + 1 : 0);
+	while (it != mapped_regions.end() && it->first < vpn + page_size)
+	{
+		if (it->first + it->second.size > vpn)
+			it = mapped_regions.erase(it);
+		else
+			it++;
+	}
+	mapped_regions[vpn] = { page_size, ppn, offset, tlb_write, write };
+}
+
 static u32 vmem32_paddr_to_offset(u32 address)
 {
 	u32 low_addr = address & 0x1FFFFFFF;
@@ -258,7 +290,7 @@ static u32 vmem32_map_mmu(u32 address, bool write)
 
 				return MMU_ERROR_NONE;
 			}
-			verify(vmem32_map_buffer(vpn, page_size, offset, page_size, allow_write) != NULL);
+			vmem32_map_region(vpn, page_size, ppn, offset, allow_write, allow_write);
 			u32 end = start + page_size;
 			const std::vector<vram_lock>& blocks = vram_blocks[start / VRAM_PROT_SEGMENT];
 
@@ -293,15 +325,15 @@ static u32 vmem32_map_mmu(u32 address, bool write)
 				else
 				{
 					sram_mapped_pages[start >> 15] |= (1 << ((start >> 12) & 7));
-					verify(vmem32_map_buffer(vpn, page_size, offset, page_size, false) != NULL);
+					vmem32_map_region(vpn, page_size, ppn, offset, allow_write, false);
 				}
 			}
 			else
-				verify(vmem32_map_buffer(vpn, page_size, offset, page_size, allow_write) != NULL);
+				vmem32_map_region(vpn, page_size, ppn, offset, allow_write, allow_write);
 		}
 		else
 			// Not vram or system ram
-			verify(vmem32_map_buffer(vpn, page_size, offset, page_size, allow_write) != NULL);
+			vmem32_map_region(vpn, page_size, ppn, offset, allow_write, allow_write);
 
 		return MMU_ERROR_NONE;
 	}
@@ -338,9 +370,11 @@ bool vmem32_handle_signal(void *fault_addr, bool write, u32 exception_pc)
 {
 	if (!vmem32_inited || (u8*)fault_addr < virt_ram_base || (u8*)fault_addr >= virt_ram_base + VMEM32_SIZE)
 		return false;
-	//vmem32_page_faults++;
+	auto start = std::chrono::steady_clock::now();
+	vmem32_stats.faults++;
 	u32 guest_addr = (u8*)fault_addr - virt_ram_base;
 	u32 rv = vmem32_map_address(guest_addr, write);
+	vmem32_stats.remap_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 	DEBUG_LOG(VMEM, "vmem32_handle_signal handled signal %s @ %p -> %08x rv=%d", write ? "W" : "R", fault_addr, guest_addr, rv);
 	if (rv == MMU_ERROR_NONE)
 		return true;
@@ -358,13 +392,106 @@ bool vmem32_handle_signal(void *fault_addr, bool write, u32 exception_pc)
 }
 #endif
 
-void vmem32_flush_mmu()
+// Returns true if the current TLB entries and ASID still translate the region the same way
+// and no code or texture has been protected in a writable region since it was mapped.
+static bool vmem32_region_valid(u32 vpn, const mapped_region& region)
 {
-	//vmem32_flush++;
-	vram_mapped_pages.clear();
-	memset(sram_mapped_pages, 0, sizeof(sram_mapped_pages));
-	vmem32_unmap_buffer(0, USER_SPACE);
-	// TODO flush P3?
+#ifndef NO_MMU
+	// Overlapping TLB entries raise a multiple hit exception so looking up the first page is enough
+	u32 pa;
+	const TLB_Entry *entry;
+	if (mmu_full_lookup<true>(vpn, &entry, pa) != MMU_ERROR_NONE
+			|| pa != region.ppn
+			|| page_sizes[entry->Data.SZ1 * 2 + entry->Data.SZ0] != region.size
+			|| ((entry->Data.PR & 1) != 0) != region.tlb_write)
+		return false;
+	if (!region.write)
+		return true;
+
+	if (region.offset >= MAP_RAM_START_OFFSET && region.offset < MAP_RAM_START_OFFSET + RAM_SIZE)
+	{
+		u32 start = region.offset - MAP_RAM_START_OFFSET;
+		for (u32 page = 0; page < region.size; page += PAGE_SIZE)
+			if (bm_IsRamPageProtected(start + page))
+				return false;
+	}
+	else if (region.offset >= MAP_VRAM_START_OFFSET && region.offset < MAP_VRAM_START_OFFSET + VRAM_SIZE)
+	{
+		u32 start = region.offset - MAP_VRAM_START_OFFSET;
+		u32 end = start + region.size;
+		std::lock_guard<std::mutex> lock(vramlist_lock);
+		for (u32 segment = start / VRAM_PROT_SEGMENT; segment <= (end - 1) / VRAM_PROT_SEGMENT; segment++)
+			for (const vram_lock& block : vram_blocks[segment])
+				if (block.start < end && block.end >= start)
+					return false;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void vmem32_unmap_changed()
+{
+	u32 unmap_start = 0;
+	u64 unmap_end = 0;
+	for (auto it = mapped_regions.begin(); it != mapped_regions.end(); )
+	{
+		const u32 vpn = it->first;
+		const mapped_region& region = it->second;
+		if (vmem32_region_valid(vpn, region))
+		{
+			it++;
+			continue;
+		}
+		vmem32_stats.unmapped++;
+		vram_mapped_pages.erase(vpn);
+		if (region.offset >= MAP_RAM_START_OFFSET && region.offset < MAP_RAM_START_OFFSET + RAM_SIZE)
+		{
+			u32 start = region.offset - MAP_RAM_START_OFFSET;
+			sram_mapped_pages[start >> 15] &= ~(1 << ((start >> 12) & 7));
+		}
+		// Unmap contiguous regions at once
+		if (vpn != unmap_end)
+		{
+			if (unmap_end != 0)
+				vmem32_unmap_buffer(unmap_start, unmap_end);
+			unmap_start = vpn;
+		}
+		unmap_end = (u64)vpn + region.size;
+		it = mapped_regions.erase(it);
+	}
+	if (unmap_end != 0)
+		vmem32_unmap_buffer(unmap_start, unmap_end);
+}
+
+void vmem32_flush_mmu(bool all)
+{
+	auto start = std::chrono::steady_clock::now();
+	vmem32_stats.flushes++;
+	if (!all && settings.dynarec.vmem32_batch_remap)
+	{
+		vmem32_unmap_changed();
+	}
+	else
+	{
+		vmem32_stats.unmapped += mapped_regions.size();
+		mapped_regions.clear();
+		vram_mapped_pages.clear();
+		memset(sram_mapped_pages, 0, sizeof(sram_mapped_pages));
+		vmem32_unmap_buffer(0, USER_SPACE);
+		// TODO flush P3?
+	}
+	vmem32_stats.remap_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void vmem32_log_stats()
+{
+	if (vmem32_stats.faults == 0 && vmem32_stats.flushes == 0)
+		return;
+	DEBUG_LOG(VMEM, "vmem32: %d faults, %d flushes, %d regions unmapped, %.1f ms remapping",
+			vmem32_stats.faults, vmem32_stats.flushes, vmem32_stats.unmapped, vmem32_stats.remap_time * 1000.0);
+	vmem32_stats = {};
 }
 
 bool vmem32_init()
@@ -25,10 +25,23 @@
 bool vmem32_init();
 void vmem32_term();
 bool vmem32_handle_signal(void *fault_addr, bool write, u32 exception_pc);
-void vmem32_flush_mmu();
+// Unmaps the user space. If all is false and Dynarec.Vmem32BatchRemap is set, only the regions
+// that the TLB or the current ASID no longer translate the same way are unmapped.
+void vmem32_flush_mmu(bool all = true);
 void vmem32_protect_vram(u32 addr, u32 size);
 void vmem32_unprotect_vram(u32 addr, u32 size);
 
+// Logs and resets the stats
+void vmem32_log_stats();
+
+struct vmem32_stats_t {
+	u32 faults;
+	u32 flushes;
+	u32 unmapped;			// regions unmapped by flushes
+	double remap_time;		// seconds spent in the fault handler and flushes
+};
+extern vmem32_stats_t vmem32_stats;
+
 extern bool vmem32_inited;
 static inline bool vmem32_enabled() {
 	return vmem32_inited;
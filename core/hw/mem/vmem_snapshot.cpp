@@ -0,0 +1,236 @@
+/*
+	Copyright 2020 flyinghead
+
+	This file is part of flycast.
+
+    flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//
+// Guest memory pages go through these states during a snapshot:
+// protected -> copying -> copied -> released
+// System RAM and AICA RAM are only written on the emulator thread. Once a page is copied, it stays write-protected
+// until its first write, which unprotects it in all its mirrors. The block manager is notified as well in case it
+// also protected it.
+// Vram pages are released by the texture cache, which may run on the render thread, so their state
+// is only changed under vramlist_lock. The vram mappings that the texture cache doesn't lock are write-protected
+// until the snapshot is complete, and their pages are copied and unprotected on first write.
+//
+#include "vmem_snapshot.h"
+#include "_vmem.h"
+#include "hw/aica/aica_if.h"
+#include "hw/pvr/pvr_mem.h"
+#include "hw/sh4/dyna/blockmanager.h"
+#include "hw/sh4/modules/mmu.h"
+#include "hw/sh4/sh4_mem.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+extern std::mutex vramlist_lock;
+
+enum PageState : u8
+{
+	PageProtected,	// not copied yet
+	PageCopying,
+	PageCopied,		// copied but still write-protected
+	PageReleased,
+};
+
+struct SnapshotArea
+{
+	VArray2 *mem;
+	u8 *dest;
+	std::unique_ptr<std::atomic<u8>[]> pages;
+	u32 pageCount;
+};
+
+enum { AreaRAM, AreaVRAM, AreaARAM };
+static SnapshotArea areas[] = { { &mem_b }, { &vram }, { &aica_ram } };
+
+// Set between vmem_snapshot_start() and vmem_snapshot_protect()
+static bool capturing;
+// Some pages may be protected by a snapshot
+static std::atomic<bool> active;
+// Protects areas dest and pages
+static std::mutex areas_lock;
+// The vram mirrors are write-protected
+static bool vram_mirrors_protected;
+
+static void copy_page(SnapshotArea& area, u32 page)
+{
+	std::atomic<u8>& state = area.pages[page];
+	u8 expected = PageProtected;
+	if (state.compare_exchange_strong(expected, PageCopying))
+	{
+		memcpy(area.dest + page * PAGE_SIZE, area.mem->data + page * PAGE_SIZE, PAGE_SIZE);
+		state = PageCopied;
+	}
+	else
+	{
+		// Wait if another thread is copying it
+		while (state == PageCopying)
+			std::this_thread::yield();
+	}
+}
+
+static void protect_pages(SnapshotArea& area)
+{
+	u32 pageCount = area.mem->size / PAGE_SIZE;
+	if (area.pageCount != pageCount)
+	{
+		area.pages.reset(new std::atomic<u8>[pageCount]);
+		area.pageCount = pageCount;
+	}
+	for (u32 page = 0; page < pageCount; page++)
+		area.pages[page] = PageProtected;
+}
+
+bool vmem_snapshot_start()
+{
+	if (!_nvmem_enabled() || mmu_enabled())
+		return false;
+	vmem_snapshot_complete();
+
+	std::lock_guard<std::mutex> lock(areas_lock);
+	for (auto& area : areas)
+		area.dest = nullptr;
+	capturing = true;
+
+	return true;
+}
+
+bool vmem_snapshot_defer(void *dest, const void *src, u32 size)
+{
+	if (!capturing)
+		return false;
+	for (auto& area : areas)
+		if (src == area.mem->data && size == area.mem->size)
+		{
+			std::lock_guard<std::mutex> lock(areas_lock);
+			area.dest = (u8 *)dest;
+			return true;
+		}
+	return false;
+}
+
+void vmem_snapshot_protect()
+{
+	std::lock_guard<std::mutex> lock(areas_lock);
+	capturing = false;
+	active = true;
+	if (areas[AreaRAM].dest != nullptr)
+	{
+		protect_pages(areas[AreaRAM]);
+		_vmem_protect_ram(0, RAM_SIZE, true);
+	}
+	if (areas[AreaVRAM].dest != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(vramlist_lock);
+		protect_pages(areas[AreaVRAM]);
+		_vmem_protect_vram(0, VRAM_SIZE);
+		_vmem_protect_vram_mirrors(0, VRAM_SIZE, true);
+		vram_mirrors_protected = true;
+	}
+	if (areas[AreaARAM].dest != nullptr)
+	{
+		protect_pages(areas[AreaARAM]);
+		_vmem_protect_aram(0, ARAM_SIZE, true);
+	}
+}
+
+void vmem_snapshot_complete()
+{
+	if (!active)
+		return;
+	std::lock_guard<std::mutex> lock(areas_lock);
+	for (auto& area : areas)
+		if (area.dest != nullptr)
+			for (u32 page = 0; page < area.pageCount; page++)
+				copy_page(area, page);
+	if (vram_mirrors_protected)
+	{
+		_vmem_protect_vram_mirrors(0, VRAM_SIZE, false);
+		vram_mirrors_protected = false;
+	}
+}
+
+void vmem_snapshot_reset()
+{
+	vmem_snapshot_complete();
+
+	std::lock_guard<std::mutex> lock(areas_lock);
+	std::lock_guard<std::mutex> vramLock(vramlist_lock);
+	active = false;
+	for (auto& area : areas)
+	{
+		area.dest = nullptr;
+		area.pages.reset();
+		area.pageCount = 0;
+	}
+}
+
+bool vmem_snapshot_write_fault(void *address)
+{
+	if (!active)
+		return false;
+	u32 vramOffset = _vmem_get_vram_mirror_offset(address);
+	if (vramOffset != (u32)-1)
+	{
+		SnapshotArea& vramArea = areas[AreaVRAM];
+		if (vramArea.pages == nullptr)
+			return false;
+		copy_page(vramArea, vramOffset / PAGE_SIZE);
+		_vmem_protect_vram_mirrors(vramOffset & ~PAGE_MASK, PAGE_SIZE, false);
+		return true;
+	}
+	SnapshotArea *area = &areas[AreaRAM];
+	u32 offset = _vmem_get_ram_offset(address);
+	if (offset == (u32)-1)
+	{
+		area = &areas[AreaARAM];
+		offset = _vmem_get_aram_offset(address);
+		if (offset == (u32)-1)
+			return false;
+	}
+	if (area->pages == nullptr)
+		return false;
+	u32 page = offset / PAGE_SIZE;
+	copy_page(*area, page);
+	u8 expected = PageCopied;
+	if (!area->pages[page].compare_exchange_strong(expected, PageReleased))
+		// Not protected by the snapshot
+		return false;
+
+	offset &= ~PAGE_MASK;
+	if (area == &areas[AreaRAM])
+	{
+		if (bm_IsRamPageProtected(offset))
+			bm_RamWriteAccess(offset);
+		_vmem_protect_ram(offset, PAGE_SIZE, false);
+	}
+	else
+	{
+		_vmem_protect_aram(offset, PAGE_SIZE, false);
+	}
+	return true;
+}
+
+void vmem_snapshot_vram_write(u32 offset)
+{
+	SnapshotArea& area = areas[AreaVRAM];
+	if (active && area.pages != nullptr)
+		copy_page(area, offset / PAGE_SIZE);
+}
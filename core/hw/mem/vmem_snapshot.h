@@ -0,0 +1,44 @@
+/*
+	Copyright 2020 flyinghead
+
+	This file is part of flycast.
+
+    flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "types.h"
+
+//
+// Copy-on-write snapshots of system RAM, VRAM and AICA RAM.
+// After vmem_snapshot_start(), the next dc_serialize() call skips these memory areas. Instead they are write-protected
+// by vmem_snapshot_protect(), and each page is copied to the serialized state before it is first written,
+// or by vmem_snapshot_complete(), which can run on another thread while the emulation goes on.
+// Requires nvmem and isn't available when the MMU is enabled.
+//
+
+// Returns false if memory must be serialized normally
+bool vmem_snapshot_start();
+// Called by rc_serialize. Returns true if the copy to dest is deferred.
+bool vmem_snapshot_defer(void *dest, const void *src, u32 size);
+// Write-protects the deferred memory areas. Must be called right after dc_serialize().
+void vmem_snapshot_protect();
+// Copies all the pages that haven't been written yet
+void vmem_snapshot_complete();
+// Completes the current snapshot and forgets the protected pages. Called when memory is remapped.
+void vmem_snapshot_reset();
+
+// Called by the fault handler. Returns true if the fault has been handled.
+bool vmem_snapshot_write_fault(void *address);
+// Called by the texture cache before unprotecting a vram page
+void vmem_snapshot_vram_write(u32 offset);
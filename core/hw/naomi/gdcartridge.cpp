@@ -15,6 +15,15 @@
 #include "emulator.h"
 #include "rend/gui.h"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <xxhash.h>
+
+// The oldest decrypted images are deleted above this size
+constexpr u64 DECRYPTED_CACHE_MAX_SIZE = 4ull * 1024 * 1024 * 1024;
+
 /*
 
   GPIO pins(main board: EEPROM, DIMM SPDs, option board: PIC16, JPs)
@@ -572,24 +581,21 @@ void GDCartridge::device_start()
 			u32 sectors = file_rounded_size / 2048;
 			read_gdrom(gdrom, file_start, dimm_data, sectors);
 
-			// decrypt loaded data
-			u32 des_subkeys[32];
-			des_generate_subkeys(rev64(key), des_subkeys);
-
-			u32 progress = ~0;
-			for (u32 i = 0; i < file_rounded_size; i += 8)
+			// The decrypted data is cached, keyed by the hash of the encrypted data and the key
+			char cache_name[32];
+			sprintf(cache_name, "%016llx.bin", (unsigned long long)XXH64(dimm_data, file_rounded_size, key));
+			std::string cache_dir = get_writable_data_path("naomi_gd_cache/");
+			std::string cache_path = cache_dir + cache_name;
+			if (!load_decrypted(cache_path, file_rounded_size))
 			{
-				const u32 new_progress = (u32)(((u64)i + 8) * 100 / file_rounded_size);
-				if (progress != new_progress)
+				des_decrypt(key, file_rounded_size);
+				if (!loading_canceled)
 				{
-					if (loading_canceled)
-						break;
-					progress = new_progress;
-					char status_str[16];
-					sprintf(status_str, "Decrypting %d%%", progress);
-					gui_display_notification(status_str, 2000);
+					if (!file_exists(cache_dir))
+						make_directory(cache_dir);
+					trim_directory(cache_dir, DECRYPTED_CACHE_MAX_SIZE - std::min<u64>(file_rounded_size, DECRYPTED_CACHE_MAX_SIZE));
+					save_decrypted(cache_path, file_rounded_size);
 				}
-				*(u64 *)(dimm_data + i) = des_encrypt_decrypt<true>(*(u64 *)(dimm_data + i), des_subkeys);
 			}
 		}
 
@@ -600,6 +606,94 @@ void GDCartridge::device_start()
 	}
 }
 
+// DES blocks are independent so they are decrypted in parallel, one slice per thread
+void GDCartridge::des_decrypt(u64 key, u32 size)
+{
+	u32 des_subkeys[32];
+	des_generate_subkeys(rev64(key), des_subkeys);
+
+	const u32 batch_size = 64 * 1024;
+	std::atomic<u32> decrypted(0);
+	auto decrypt_slice = [&](u32 start, u32 end) {
+		while (start < end && !loading_canceled)
+		{
+			const u32 batch_end = std::min(end, start + batch_size);
+			for (u32 i = start; i < batch_end; i += 8)
+				*(u64 *)(dimm_data + i) = des_encrypt_decrypt<true>(*(u64 *)(dimm_data + i), des_subkeys);
+			decrypted += batch_end - start;
+			start = batch_end;
+		}
+	};
+	const u32 thread_count = std::max(1u, std::min(std::thread::hardware_concurrency(), size / batch_size));
+	const u32 slice_size = (size / 8 + thread_count - 1) / thread_count * 8;
+	std::vector<std::thread> threads;
+	for (u32 i = 1; i < thread_count; i++)
+		threads.emplace_back(decrypt_slice, i * slice_size, std::min(size, (i + 1) * slice_size));
+
+	// This thread decrypts the first slice then reports the progress of the others
+	u32 progress = ~0;
+	for (u32 start = 0; ; start += batch_size)
+	{
+		const u32 new_progress = (u32)((u64)decrypted * 100 / size);
+		if (progress != new_progress)
+		{
+			progress = new_progress;
+			char status_str[16];
+			sprintf(status_str, "Decrypting %d%%", progress);
+			gui_display_notification(status_str, 2000);
+		}
+		if (decrypted == size || loading_canceled)
+			break;
+		if (start < slice_size)
+			decrypt_slice(start, std::min(slice_size, start + batch_size));
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+bool GDCartridge::load_decrypted(const std::string& path, u32 size)
+{
+	FILE *f = fopen(path.c_str(), "rb");
+	if (f == nullptr)
+		return false;
+	fseek(f, 0, SEEK_END);
+	if ((u32)ftell(f) != size)
+	{
+		fclose(f);
+		WARN_LOG(NAOMI, "Invalid decrypted data size in %s", path.c_str());
+		return false;
+	}
+	fseek(f, 0, SEEK_SET);
+	bool loaded = fread(dimm_data, 1, size, f) == size;
+	fclose(f);
+	if (!loaded)
+		throw NaomiCartException("Naomi GDROM: Cannot read " + path);
+	DEBUG_LOG(NAOMI, "Loaded decrypted data from %s", path.c_str());
+
+	return true;
+}
+
+void GDCartridge::save_decrypted(const std::string& path, u32 size)
+{
+	// Written under a temporary name so that an interrupted write can't be loaded
+	std::string temp_path = path + ".tmp";
+	FILE *f = fopen(temp_path.c_str(), "wb");
+	if (f == nullptr)
+	{
+		WARN_LOG(NAOMI, "Cannot create %s", temp_path.c_str());
+		return;
+	}
+	bool written = fwrite(dimm_data, 1, size, f) == size;
+	written = fclose(f) == 0 && written;
+	if (!written || rename(temp_path.c_str(), path.c_str()) != 0)
+	{
+		WARN_LOG(NAOMI, "Cannot write %s", path.c_str());
+		remove(temp_path.c_str());
+	}
+}
+
 void GDCartridge::device_reset()
 {
 	dimm_cur_address = 0;
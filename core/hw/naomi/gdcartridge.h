@@ -71,6 +71,9 @@ private:
 	u64 des_encrypt_decrypt(u64 src, const u32 *des_subkeys);
 	u64 rev64(u64 src);
 	void read_gdrom(Disc *gdrom, u32 sector, u8* dst, u32 count = 1);
+	void des_decrypt(u64 key, u32 size);
+	bool load_decrypted(const std::string& path, u32 size);
+	void save_decrypted(const std::string& path, u32 size);
 };
 
 #endif /* CORE_HW_NAOMI_GDCARTRIDGE_H_ */
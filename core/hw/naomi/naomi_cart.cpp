@@ -20,6 +20,7 @@
 // copyright-holders:MetalliC
 
 #include <memory>
+#include <thread>
 #include "naomi_cart.h"
 #include "naomi_regs.h"
 #include "naomi.h"
@@ -41,6 +42,7 @@ bool bios_loaded = false;
 
 #ifdef _WIN32
 	#include <windows.h>
+	#include <io.h>
 	typedef HANDLE fd_t;
 	#define INVALID_FD INVALID_HANDLE_VALUE
 #else
@@ -193,6 +195,24 @@ static Game *FindGame(const char *filename)
 	return &Games[gameid];
 }
 
+// A ROM file can be loaded on first access if no other file is written at the same place
+static bool CanLoadOnAccess(const Game *game, int romid)
+{
+	const u32 start = game->blobs[romid].offset;
+	const u32 end = start + game->blobs[romid].length;
+	for (int i = 0; game->blobs[i].filename != NULL; i++)
+	{
+		if (i == romid || game->blobs[i].blob_type == Key || game->blobs[i].blob_type == Eeprom)
+			continue;
+		if (game->blobs[i].offset < end && game->blobs[i].offset + game->blobs[i].length > start)
+			return false;
+		if (game->blobs[i].blob_type == Copy
+				&& game->blobs[i].src_offset < end && game->blobs[i].src_offset + game->blobs[i].length > start)
+			return false;
+	}
+	return true;
+}
+
 static void naomi_cart_LoadZip(const char *filename)
 {
 	Game *game = FindGame(filename);
@@ -200,11 +220,11 @@ static void naomi_cart_LoadZip(const char *filename)
 		throw NaomiCartException("Unknown game");
 
 	// Open archive and parent archive if any
-	std::unique_ptr<Archive> archive(OpenArchive(filename));
+	std::shared_ptr<Archive> archive(OpenArchive(filename));
 	if (archive != NULL)
 		INFO_LOG(NAOMI, "Opened %s", filename);
 
-	std::unique_ptr<Archive> parent_archive;
+	std::shared_ptr<Archive> parent_archive;
 	if (game->parent_name != NULL)
 	{
 		parent_archive.reset(OpenArchive((get_game_dir() + game->parent_name).c_str()));
@@ -314,6 +334,16 @@ static void naomi_cart_LoadZip(const char *filename)
 				switch (game->blobs[romid].blob_type)
 				{
 					case Normal:
+						// Compressed members that aren't fully cached yet are decompressed now rather than in the fault handler.
+						// This fills the archive cache so they can be streamed next time.
+						if (CurrentCartridge->IsPaged() && CanLoadOnAccess(game, romid) && file->CanReadInPlace())
+						{
+							// Only read when accessed
+							CurrentCartridge->LoadOnAccess(game->blobs[romid].offset, game->blobs[romid].length, file.release(),
+									{ archive, parent_archive });
+							DEBUG_LOG(NAOMI, "Streamed %s: %x bytes at %07x", game->blobs[romid].filename, game->blobs[romid].length, game->blobs[romid].offset);
+						}
+						else
 						{
 							u8 *dst = (u8 *)CurrentCartridge->GetPtr(game->blobs[romid].offset, len);
 							u32 read = file->Read(dst, game->blobs[romid].length);
@@ -657,17 +687,149 @@ int naomi_cart_GetPlatform(const char *path)
 		return DC_PLATFORM_NAOMI;
 }
 
+// Unit of ROM loading on first access
+constexpr u32 ROM_PAGE_SIZE = 64 * 1024;
+
 Cartridge::Cartridge(u32 size)
 {
-	RomPtr = (u8 *)malloc(size);
 	RomSize = size;
+#ifndef TARGET_NO_EXCEPTIONS
+	// Reserve the ROM without access rights, pages are filled by PageIn() when first accessed
+#ifdef _WIN32
+	RomPtr = (u8 *)VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_NOACCESS);
+#else
+	RomPtr = (u8 *)mem_region_reserve(NULL, size);
+#endif
+	if (RomPtr != NULL)
+	{
+		const u32 pageCount = (size + ROM_PAGE_SIZE - 1) / ROM_PAGE_SIZE;
+		loadedPages.reset(new std::atomic<bool>[pageCount]);
+		for (u32 i = 0; i < pageCount; i++)
+			loadedPages[i] = false;
+		pageBuffer.resize(ROM_PAGE_SIZE);
+		return;
+	}
+#endif
+	RomPtr = (u8 *)malloc(size);
 	memset(RomPtr, 0xFF, RomSize);
 }
 
 Cartridge::~Cartridge()
+{
+	FreeRom();
+}
+
+void Cartridge::FreeRom()
 {
 	if (RomPtr != NULL)
-		free(RomPtr);
+	{
+		if (IsPaged())
+			mem_region_release(RomPtr, RomSize);
+		else
+			free(RomPtr);
+		RomPtr = NULL;
+	}
+	loadedPages.reset();
+	pageBuffer.clear();
+	lazyAreas.clear();
+}
+
+void Cartridge::LoadOnAccess(u32 offset, u32 length, ArchiveFile *file, const std::vector<std::shared_ptr<Archive>>& archives)
+{
+	verify(IsPaged());
+	verify(file->CanReadInPlace());
+	verify(offset + length <= RomSize);
+	ArchiveFile::RawData raw;
+	verify(file->GetRawData(raw));
+	// Wait for the fault handler to be done with lazyAreas
+	while (pageBufferBusy.exchange(true, std::memory_order_acquire))
+		std::this_thread::yield();
+	lazyAreas.push_back({ offset, length, std::unique_ptr<ArchiveFile>(file), raw });
+	for (const auto& archive : archives)
+		if (archive != nullptr && std::find(lazyArchives.begin(), lazyArchives.end(), archive) == lazyArchives.end())
+			lazyArchives.push_back(archive);
+	// Pages already accessed must be filled now
+	for (u32 page = offset / ROM_PAGE_SIZE; page * ROM_PAGE_SIZE < offset + length; page++)
+		if (loadedPages[page])
+		{
+			u32 start = std::max(offset, page * ROM_PAGE_SIZE);
+			u32 end = std::min(offset + length, (page + 1) * ROM_PAGE_SIZE);
+			file->ReadAt(start - offset, RomPtr + start, end - start);
+		}
+	pageBufferBusy.store(false, std::memory_order_release);
+}
+
+// Reads from a file without changing its position. Safe to call from a signal handler.
+static bool ReadRaw(int fd, u64 offset, u8 *buffer, u32 length)
+{
+	while (length > 0)
+	{
+#ifdef _WIN32
+		OVERLAPPED overlapped {};
+		overlapped.Offset = (DWORD)offset;
+		overlapped.OffsetHigh = (DWORD)(offset >> 32);
+		DWORD read;
+		if (!ReadFile((HANDLE)_get_osfhandle(fd), buffer, length, &read, &overlapped) || read == 0)
+			return false;
+#else
+		ssize_t read = pread(fd, buffer, length, offset);
+		if (read < 0 && errno == EINTR)
+			continue;
+		if (read <= 0)
+			return false;
+#endif
+		buffer += read;
+		offset += read;
+		length -= read;
+	}
+	return true;
+}
+
+bool Cartridge::PageIn(void *address)
+{
+	if (!IsPaged() || (u8 *)address < RomPtr || (u8 *)address >= RomPtr + RomSize)
+		return false;
+
+	u32 page = ((u8 *)address - RomPtr) / ROM_PAGE_SIZE;
+	if (loadedPages[page].load(std::memory_order_acquire))
+		// Filled by another thread
+		return true;
+	// The handler can't wait for a lock. If another thread is filling a page, the access is retried
+	// and faults again until it's done.
+	if (pageBufferBusy.exchange(true, std::memory_order_acquire))
+		return true;
+	if (!loadedPages[page].load(std::memory_order_relaxed))
+	{
+		const int savedErrno = errno;
+		const u32 pageStart = page * ROM_PAGE_SIZE;
+		const u32 pageEnd = std::min(pageStart + ROM_PAGE_SIZE, RomSize);
+		// Other threads may fault on this page until it's unlocked, so it's only made accessible once complete
+		memset(pageBuffer.data(), 0xFF, pageEnd - pageStart);
+		for (const LazyArea& area : lazyAreas)
+		{
+			u32 start = std::max(area.offset, pageStart);
+			u32 end = std::min(area.offset + area.length, pageEnd);
+			if (start >= end)
+				continue;
+			u8 *dst = &pageBuffer[start - pageStart];
+			if (area.raw.data != nullptr)
+				memcpy(dst, area.raw.data + start - area.offset, end - start);
+			else
+				ReadRaw(area.raw.fd, area.raw.offset + start - area.offset, dst, end - start);
+		}
+		mem_region_unlock(RomPtr + pageStart, pageEnd - pageStart);
+		memcpy(RomPtr + pageStart, pageBuffer.data(), pageEnd - pageStart);
+		loadedPages[page].store(true, std::memory_order_release);
+		errno = savedErrno;
+	}
+	pageBufferBusy.store(false, std::memory_order_release);
+
+	return true;
+}
+
+bool naomi_cart_PageIn(void *address)
+{
+	return CurrentCartridge != NULL && CurrentCartridge->PageIn(address);
 }
 
 bool Cartridge::Read(u32 offset, u32 size, void* dst)
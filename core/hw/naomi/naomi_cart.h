@@ -1,8 +1,12 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <vector>
 #include "types.h"
+#include "archive/archive.h"
 
 class Cartridge
 {
@@ -25,9 +29,36 @@ public:
 	virtual void SetKey(u32 key) { }
 	virtual void SetKeyData(u8 *key_data) { }
 
+	// True if the ROM pages are only filled on first access
+	bool IsPaged() const { return loadedPages != nullptr; }
+	// Loads this ROM area from the archive file on first access. The archives are kept open until the cartridge is deleted.
+	// The file must be readable in place since it's read by the fault handler, through its raw data.
+	void LoadOnAccess(u32 offset, u32 length, ArchiveFile *file, const std::vector<std::shared_ptr<Archive>>& archives);
+	// Fills the ROM page at this address if it hasn't been accessed yet. Called by the fault handler
+	// so it doesn't lock, allocate or use stdio.
+	bool PageIn(void *address);
+
 protected:
+	void FreeRom();
+
 	u8* RomPtr;
 	u32 RomSize;
+
+private:
+	struct LazyArea
+	{
+		u32 offset;
+		u32 length;
+		std::unique_ptr<ArchiveFile> file;
+		ArchiveFile::RawData raw;
+	};
+	std::vector<LazyArea> lazyAreas;
+	std::vector<std::shared_ptr<Archive>> lazyArchives;
+	std::unique_ptr<std::atomic<bool>[]> loadedPages;
+	// Pages are read here before being unlocked
+	std::vector<u8> pageBuffer;
+	// Set while a page is read into pageBuffer or lazyAreas is modified
+	std::atomic<bool> pageBufferBusy { false };
 };
 
 class NaomiCartridge : public Cartridge
@@ -64,7 +95,7 @@ protected:
 class DecryptedCartridge : public NaomiCartridge
 {
 public:
-	DecryptedCartridge(u8 *rom_ptr, u32 size) : NaomiCartridge(size) { RomPtr = rom_ptr; }
+	DecryptedCartridge(u8 *rom_ptr, u32 size) : NaomiCartridge(size) { FreeRom(); RomPtr = rom_ptr; }
 	virtual ~DecryptedCartridge() override;
 };
 
@@ -94,6 +125,7 @@ public:
 void naomi_cart_LoadRom(const char* file);
 void naomi_cart_Close();
 int naomi_cart_GetPlatform(const char *path);
+bool naomi_cart_PageIn(void *address);
 
 extern char naomi_game_id[];
 extern u8 *naomi_default_eeprom;
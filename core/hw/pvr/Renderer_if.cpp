@@ -7,6 +7,7 @@
 #include "rend/TexCache.h"
 #include "wsi/context.h"
 
+#include <atomic>
 #include <zlib.h>
 
 u32 VertexCount=0;
@@ -20,6 +21,7 @@ bool renderer_reinit_requested = false;	// Signals the renderer thread to reinit
 
 #if !defined(TARGET_NO_THREADS)
 cResetEvent rs, re;
+static std::atomic<bool> emu_wait_cancelled;
 #endif
 static bool swap_pending;
 static bool do_swap;
@@ -179,6 +181,15 @@ TA_context* read_frame(const char* file, u8* vram_ref = NULL) {
 
 bool dump_frame_switch = false;
 
+#if !defined(TARGET_NO_THREADS)
+// Lets the emulator continue once the renderer no longer needs the frame data
+static void rend_release_emu()
+{
+	rend_frameProcessed();
+	re.Set();
+}
+#endif
+
 static bool rend_frame(TA_context* ctx)
 {
 	if (dump_frame_switch) {
@@ -199,7 +210,7 @@ static bool rend_frame(TA_context* ctx)
 #if !defined(TARGET_NO_THREADS)
 	if (!proc || (!ctx->rend.isRTT && !ctx->rend.isRenderFramebuffer))
 		// If rendering to texture, continue locking until the frame is rendered
-		re.Set();
+		rend_release_emu();
 #endif
 
 	return proc && renderer->Render();
@@ -237,7 +248,10 @@ bool rend_single_frame()
 			if (renderer != NULL)
 				renderer->RenderLastFrame();
 
-			if (!rs.Wait(100))
+			// Don't wait if other frames are already queued
+			if (rend_framePending())
+				rs.Reset();
+			else if (!rs.Wait(100))
 				return false;
 			if (do_swap)
 			{
@@ -268,7 +282,7 @@ bool rend_single_frame()
 
 #if !defined(TARGET_NO_THREADS)
 	if (_pvrrc->rend.isRTT)
-		re.Set();
+		rend_release_emu();
 #endif
 
 	//clear up & free data ..
@@ -374,6 +388,7 @@ void* rend_thread(void* p)
 }
 
 bool pend_rend = false;
+static bool pend_rtt;
 
 void rend_resize(int width, int height)
 {
@@ -418,15 +433,18 @@ void rend_start_render()
 			ctx->rend.fog_clamp_max = FOG_CLAMP_MAX;
 		}
 
+		bool isRTT = ctx->rend.isRTT;
 		if (QueueRender(ctx))
 		{
 			palette_update();
 #if !defined(TARGET_NO_THREADS)
+			emu_wait_cancelled = false;
 			rs.Set();
 #else
 			rend_single_frame();
 #endif
 			pend_rend = true;
+			pend_rtt = isRTT;
 		}
 	}
 }
@@ -444,7 +462,11 @@ void rend_end_render()
 
 	if (pend_rend) {
 #if !defined(TARGET_NO_THREADS)
-		re.Wait();
+		// Keep running while previous frames are rendered, until the render queue is full.
+		// Render to texture results can be read back so wait for them.
+		u32 max_pending = pend_rtt ? 1 : rend_queueDepth();
+		while (rend_framesUnprocessed() >= max_pending && !emu_wait_cancelled)
+			re.Wait();
 #else
 		if (renderer != NULL)
 			renderer->Present();
@@ -491,6 +513,7 @@ void rend_cancel_emu_wait()
 {
 	FinishRender(NULL);
 #if !defined(TARGET_NO_THREADS)
+	emu_wait_cancelled = true;
 	re.Set();
 #endif
 }
@@ -5,6 +5,7 @@
 #include "hw/sh4/sh4_sched.h"
 #include "input/gamepad_device.h"
 #include "oslib/oslib.h"
+#include "rewind.h"
 
 //SPG emulation; Scanline/Raster beam registers & interrupts
 
@@ -131,6 +132,7 @@ int spg_line_sched(int tag, int cycl, int jit)
 			vblk_cnt++;
 			//TODO : rend_if_VBlank();
 			rend_vblank();//notify for vblank :)
+			rewind_vblank();
 #ifdef TEST_AUTOMATION
 			replay_input();
 #endif
@@ -2,6 +2,9 @@
 #include "hw/sh4/sh4_sched.h"
 #include "oslib/oslib.h"
 
+#include <algorithm>
+#include <atomic>
+
 extern u32 fskip;
 extern u32 FrameCount;
 
@@ -66,13 +69,24 @@ void SetCurrentTARC(u32 addr)
 	}
 }
 
-static std::mutex mtx_rqueue;
-TA_context* rqueue;
+// Render queue. Contexts are pushed by the emulation thread and popped by the render thread
+// once rendered, so the emulator can start the next frame while the previous one is rendered.
+#define MAX_RENDER_QUEUE 4
+static TA_context* rqueue[MAX_RENDER_QUEUE];
+static std::atomic<u32> rqueue_head;	// next context to render. Only modified by the render thread
+static std::atomic<u32> rqueue_tail;	// next free slot. Only modified by the emulation thread
+static std::atomic<u32> rqueue_processed;	// next context whose data is still needed. Only modified by the render thread
+static std::atomic<u32> rqueue_dropped;
 cResetEvent frame_finished;
 
 static double last_frame1, last_frame2;
 static u64 last_cycles1, last_cycles2;
 
+u32 rend_queueDepth()
+{
+	return std::max(1u, std::min((u32)MAX_RENDER_QUEUE, settings.pvr.RenderQueueDepth));
+}
+
 bool QueueRender(TA_context* ctx)
 {
 	verify(ctx != 0);
@@ -88,61 +102,75 @@ bool QueueRender(TA_context* ctx)
  	last_frame1 = os_GetSeconds();
 
  	bool too_fast = (cycle_span / time_span) > SH4_MAIN_CLOCK;
+ 	u32 depth = rend_queueDepth();
 
  	// Vulkan: rtt frames seem to be discarded often
-	if (rqueue && (too_fast || ctx->rend.isRTT) && settings.pvr.SynchronousRender)
+	if (rend_framesQueued() >= depth && (too_fast || ctx->rend.isRTT) && settings.pvr.SynchronousRender)
 		//wait for a frame if
-		//  we have another one queue'd and
+		//  the queue is full and
 		//  sh4 run at > 120% over the last two frames
 		//  and SynchronousRender is enabled
 		frame_finished.Wait();
 
-	if (rqueue)
+	if (rend_framesQueued() >= depth)
 	{
 		tactx_Recycle(ctx);
 		fskip++;
+		rqueue_dropped++;
 		return false;
 	}
 
 	frame_finished.Reset();
-	mtx_rqueue.lock();
-	TA_context* old = rqueue;
-	rqueue=ctx;
-	mtx_rqueue.unlock();
-
-	verify(!old);
+	u32 tail = rqueue_tail.load(std::memory_order_relaxed);
+	rqueue[tail % MAX_RENDER_QUEUE] = ctx;
+	rqueue_tail.store(tail + 1, std::memory_order_release);
 
 	return true;
 }
 
 TA_context* DequeueRender()
 {
-	mtx_rqueue.lock();
-	TA_context* rv = rqueue;
-	mtx_rqueue.unlock();
+	u32 head = rqueue_head.load(std::memory_order_relaxed);
+	if (head == rqueue_tail.load(std::memory_order_acquire))
+		return nullptr;
 
-	if (rv)
-		FrameCount++;
+	FrameCount++;
 
-	return rv;
+	return rqueue[head % MAX_RENDER_QUEUE];
+}
+
+u32 rend_framesQueued()
+{
+	return rqueue_tail.load(std::memory_order_acquire) - rqueue_head.load(std::memory_order_acquire);
+}
+
+u32 rend_framesUnprocessed()
+{
+	return rqueue_tail.load(std::memory_order_acquire) - rqueue_processed.load(std::memory_order_acquire);
+}
+
+void rend_frameProcessed()
+{
+	rqueue_processed.store(rqueue_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
 }
 
 bool rend_framePending() {
-	mtx_rqueue.lock();
-	TA_context* rv = rqueue;
-	mtx_rqueue.unlock();
+	return rend_framesQueued() != 0;
+}
 
-	return rv != 0;
+u32 rend_framesDropped()
+{
+	return rqueue_dropped;
 }
 
 void FinishRender(TA_context* ctx)
 {
 	if (ctx != NULL)
 	{
-		verify(rqueue == ctx);
-		mtx_rqueue.lock();
-		rqueue = NULL;
-		mtx_rqueue.unlock();
+		u32 head = rqueue_head.load(std::memory_order_relaxed);
+		verify(head != rqueue_tail.load(std::memory_order_acquire) && rqueue[head % MAX_RENDER_QUEUE] == ctx);
+		rqueue_head.store(head + 1, std::memory_order_release);
+		rqueue_processed.store(head + 1, std::memory_order_release);
 
 		tactx_Recycle(ctx);
 	}
@@ -157,6 +157,34 @@ struct rend_context
 		fZ_max= 1.0f;
 		isRenderFramebuffer = false;
 	}
+
+	void Alloc()
+	{
+		verts.InitBytes(4 * 1024 * 1024, &Overrun, "verts");	//up to 4 mb of vtx data/frame = ~ 96k vtx/frame
+		idx.Init(120 * 1024, &Overrun, "idx");				//up to 120K indexes ( idx have stripification overhead )
+		global_param_op.Init(16384, &Overrun, "global_param_op");
+		global_param_pt.Init(4096, &Overrun, "global_param_pt");
+		global_param_mvo.Init(4096, &Overrun, "global_param_mvo");
+		global_param_tr.Init(10240, &Overrun, "global_param_tr");
+		global_param_mvo_tr.Init(4096, &Overrun, "global_param_mvo_tr");
+
+		modtrig.Init(16384, &Overrun, "modtrig");
+		
+		render_passes.Init(sizeof(RenderPass) * 10, &Overrun, "render_passes");	// 10 render passes
+	}
+
+	void Free()
+	{
+		verts.Free();
+		idx.Free();
+		global_param_op.Free();
+		global_param_pt.Free();
+		global_param_tr.Free();
+		modtrig.Free();
+		global_param_mvo.Free();
+		global_param_mvo_tr.Free();
+		render_passes.Free();
+	}
 };
 
 #define TA_DATA_SIZE (8 * 1024 * 1024)
@@ -201,18 +229,7 @@ struct TA_context
 	void Alloc()
 	{
 		tad.Reset((u8*)OS_aligned_malloc(32, TA_DATA_SIZE));
-
-		rend.verts.InitBytes(4 * 1024 * 1024, &rend.Overrun, "verts");	//up to 4 mb of vtx data/frame = ~ 96k vtx/frame
-		rend.idx.Init(120 * 1024, &rend.Overrun, "idx");				//up to 120K indexes ( idx have stripification overhead )
-		rend.global_param_op.Init(16384, &rend.Overrun, "global_param_op");
-		rend.global_param_pt.Init(4096, &rend.Overrun, "global_param_pt");
-		rend.global_param_mvo.Init(4096, &rend.Overrun, "global_param_mvo");
-		rend.global_param_tr.Init(10240, &rend.Overrun, "global_param_tr");
-		rend.global_param_mvo_tr.Init(4096, &rend.Overrun, "global_param_mvo_tr");
-
-		rend.modtrig.Init(16384, &rend.Overrun, "modtrig");
-		
-		rend.render_passes.Init(sizeof(RenderPass) * 10, &rend.Overrun, "render_passes");	// 10 render passes
+		rend.Alloc();
 
 		Reset();
 	}
@@ -231,15 +248,7 @@ struct TA_context
 	{
 		verify(tad.End() - tad.thd_root <= TA_DATA_SIZE);
 		OS_aligned_free(tad.thd_root);
-		rend.verts.Free();
-		rend.idx.Free();
-		rend.global_param_op.Free();
-		rend.global_param_pt.Free();
-		rend.global_param_tr.Free();
-		rend.modtrig.Free();
-		rend.global_param_mvo.Free();
-		rend.global_param_mvo_tr.Free();
-		rend.render_passes.Free();
+		rend.Free();
 	}
 };
 
@@ -273,5 +282,15 @@ void FinishRender(TA_context* ctx);
 void FillBGP(TA_context* ctx);
 bool UsingAutoSort(int pass_number);
 bool rend_framePending();
+// Number of frames queued or being rendered
+u32 rend_framesQueued();
+// Number of frames dropped because the render queue was full
+u32 rend_framesDropped();
+// Maximum number of frames queued or being rendered
+u32 rend_queueDepth();
+// Number of queued frames whose vram and registers may still be read by the renderer
+u32 rend_framesUnprocessed();
+// Called by the render thread once the data of the current frame is no longer needed
+void rend_frameProcessed();
 void SerializeTAContext(void **data, unsigned int *total_size);
 void UnserializeTAContext(void **data, unsigned int *total_size);
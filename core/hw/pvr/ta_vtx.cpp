@@ -11,6 +11,8 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <memory>
 
 u32 ta_type_lut[256];
 extern int screen_height;
@@ -30,8 +32,12 @@ extern int screen_height;
 #define TA_EOL 
 #define TA_V64H 
 	
+// The parser state is thread local so that render passes can be parsed concurrently
+
 //cache state vars
-static u32 tileclip_val = 0;
+static thread_local u32 tileclip_val;
+// Marks tile clip values inherited from the previous render pass
+#define TILECLIP_INHERIT 0x08000000
 
 static u8 f32_su8_tbl[65536];
 #define float_to_satu8(val) f32_su8_tbl[((u32&)val)>>16]
@@ -60,18 +66,23 @@ static u8 float_to_satu8_math(float val)
 }
 
 //vdec state variables
-static ModTriangle* lmr;
+static thread_local ModTriangle* lmr;
 
-static PolyParam* CurrentPP;
-static List<PolyParam>* CurrentPPlist;
+static thread_local PolyParam* CurrentPP;
+static thread_local List<PolyParam>* CurrentPPlist;
 
 //TA state vars	
-alignas(4) static u8 FaceBaseColor[4];
-alignas(4) static u8 FaceOffsColor[4];
-alignas(4) static u8 FaceBaseColor1[4];
-alignas(4) static u8 FaceOffsColor1[4];
-alignas(4) static u32 SFaceBaseColor;
-alignas(4) static u32 SFaceOffsColor;
+alignas(4) static thread_local u8 FaceBaseColor[4];
+alignas(4) static thread_local u8 FaceOffsColor[4];
+alignas(4) static thread_local u8 FaceBaseColor1[4];
+alignas(4) static thread_local u8 FaceOffsColor1[4];
+alignas(4) static thread_local u32 SFaceBaseColor;
+alignas(4) static thread_local u32 SFaceOffsColor;
+// Face colors carry over to the next render pass. These track the ones set by the current pass
+// and whether it used any it didn't set.
+enum : u8 { FACE_BASE = 1, FACE_OFFS = 2, FACE_BASE1 = 4, FACE_OFFS1 = 8 };
+static thread_local u8 FaceColorsSet;
+static thread_local bool FaceColorsInherited;
 
 //misc ones
 static const u32 ListType_None = -1;
@@ -83,11 +94,11 @@ static const u32 SZ64 = 2;
 typedef Ta_Dma* DYNACALL TaListFP(Ta_Dma* data,Ta_Dma* data_end);
 typedef void TACALL TaPolyParamFP(void* ptr);
 
-static TaListFP* TaCmd;
+static thread_local TaListFP* TaCmd;
 	
-static u32 CurrentList;
-static TaListFP* VertexDataFP;
-static bool ListIsFinished[5];
+static thread_local u32 CurrentList;
+static thread_local TaListFP* VertexDataFP;
+static thread_local bool ListIsFinished[5];
 
 static f32 f16(u16 v)
 {
@@ -95,7 +106,9 @@ static f32 f16(u16 v)
 	return *(f32*)&z;
 }
 
-#define vdrc vd_rc
+// Context being filled
+static thread_local rend_context* vdrc_ptr;
+#define vdrc (*vdrc_ptr)
 
 //Splitter function (normally ta_dma_main , modified for split dma's)
 
@@ -678,17 +691,16 @@ public:
 	}
 
 
-	void vdec_init()
+	void vdec_init(rend_context* rc, u32 tileclip)
 	{
-		VDECInit();
+		vdrc_ptr = rc;
+		tileclip_val = tileclip;
 		TaCmd = ta_main;
 		CurrentList = ListType_None;
 		ListIsFinished[0] = ListIsFinished[1] = ListIsFinished[2] = ListIsFinished[3] = ListIsFinished[4] = false;
 		VertexDataFP = NullVertexData;
-		memset(FaceBaseColor, 0xff, sizeof(FaceBaseColor));
-		memset(FaceOffsColor, 0xff, sizeof(FaceOffsColor));
-		memset(FaceBaseColor1, 0xff, sizeof(FaceBaseColor1));
-		memset(FaceOffsColor1, 0xff, sizeof(FaceOffsColor1));
+		FaceColorsSet = 0;
+		FaceColorsInherited = false;
 		SFaceBaseColor = 0;
 		SFaceOffsColor = 0;
 		lmr = NULL;
@@ -761,9 +773,6 @@ public:
 
 		d_pp->texid = -1;
 
-		if (d_pp->pcw.Texture)
-			d_pp->texid = renderer->GetTexture(d_pp->tsp,d_pp->tcw);
-
 		d_pp->tsp1.full = -1;
 		d_pp->tcw1.full = -1;
 		d_pp->texid1 = -1;
@@ -800,6 +809,7 @@ public:
 
 		glob_param_bdc(pp);
 		poly_float_color(FaceBaseColor,FaceColor);
+		FaceColorsSet |= FACE_BASE;
 	}
 
 	// Intensity, use Offset Color
@@ -818,6 +828,7 @@ public:
 
 		poly_float_color(FaceBaseColor,FaceColor);
 		poly_float_color(FaceOffsColor,FaceOffset);
+		FaceColorsSet |= FACE_BASE | FACE_OFFS;
 	}
 
 	// Packed Color, with Two Volumes
@@ -830,8 +841,6 @@ public:
 
 		CurrentPP->tsp1.full = pp->tsp1.full;
 		CurrentPP->tcw1.full = pp->tcw1.full;
-		if (pp->pcw.Texture)
-			CurrentPP->texid1 = renderer->GetTexture(pp->tsp1, pp->tcw1);
 	}
 
 	// Intensity, with Two Volumes
@@ -844,8 +853,6 @@ public:
 
 		CurrentPP->tsp1.full = pp->tsp1.full;
 		CurrentPP->tcw1.full = pp->tcw1.full;
-		if (pp->pcw.Texture)
-			CurrentPP->texid1 = renderer->GetTexture(pp->tsp1, pp->tcw1);
 	}
 
 	__forceinline
@@ -855,6 +862,7 @@ public:
 
 		poly_float_color(FaceBaseColor, FaceColor0);
 		poly_float_color(FaceBaseColor1, FaceColor1);
+		FaceColorsSet |= FACE_BASE | FACE_BASE1;
 	}
 
 	//Poly Strip handling
@@ -949,6 +957,7 @@ public:
 
 	#define vert_face_base_color(baseint) \
 		{ u32 satint=float_to_satu8(vtx->baseint); \
+		FaceColorsInherited |= !(FaceColorsSet & FACE_BASE); \
 		cv->col[0] = FaceBaseColor[0]*satint/256;  \
 		cv->col[1] = FaceBaseColor[1]*satint/256;  \
 		cv->col[2] = FaceBaseColor[2]*satint/256;  \
@@ -956,6 +965,7 @@ public:
 
 	#define vert_face_offs_color(offsint) \
 		{ u32 satint=float_to_satu8(vtx->offsint); \
+		FaceColorsInherited |= !(FaceColorsSet & FACE_OFFS); \
 		cv->spc[0] = FaceOffsColor[0]*satint/256;  \
 		cv->spc[1] = FaceOffsColor[1]*satint/256;  \
 		cv->spc[2] = FaceOffsColor[2]*satint/256;  \
@@ -963,6 +973,7 @@ public:
 
 	#define vert_face_base_color1(baseint) \
 		{ u32 satint=float_to_satu8(vtx->baseint); \
+		FaceColorsInherited |= !(FaceColorsSet & FACE_BASE1); \
 		cv->col1[0] = FaceBaseColor1[0]*satint/256;  \
 		cv->col1[1] = FaceBaseColor1[1]*satint/256;  \
 		cv->col1[2] = FaceBaseColor1[2]*satint/256;  \
@@ -970,6 +981,7 @@ public:
 
 	#define vert_face_offs_color1(offsint) \
 		{ u32 satint=float_to_satu8(vtx->offsint); \
+		FaceColorsInherited |= !(FaceColorsSet & FACE_OFFS1); \
 		cv->spc1[0] = FaceOffsColor1[0]*satint/256;  \
 		cv->spc1[1] = FaceOffsColor1[1]*satint/256;  \
 		cv->spc1[2] = FaceOffsColor1[2]*satint/256;  \
@@ -1224,10 +1236,6 @@ public:
 		d_pp->tileclip=tileclip_val;
 
 		d_pp->texid = -1;
-		
-		if (d_pp->pcw.Texture) {
-			d_pp->texid = renderer->GetTexture(d_pp->tsp,d_pp->tcw);
-		}
 		d_pp->tcw1.full = -1;
 		d_pp->tsp1.full = -1;
 		d_pp->texid1 = -1;
@@ -1416,15 +1424,6 @@ public:
 		lmr->z2=mvv->z2;
 		//update_fz(mvv->z2);
 	}
-
-	static void VDECInit()
-	{
-		vd_rc.Clear();
-
-		//allocate storage for BG poly
-		vd_rc.global_param_op.Append();
-		vd_rc.verts.Append(4);
-	}
 };
 
 static bool ClearZBeforePass(int pass_number);
@@ -1572,6 +1571,166 @@ static void fix_texture_bleeding(const List<PolyParam> *list)
 	}
 }
 
+// Face colors at the end of a render pass. Each context starts with the default ones.
+struct FaceColorState
+{
+	u8 base[4];
+	u8 offs[4];
+	u8 base1[4];
+	u8 offs1[4];
+	u8 set = 0;					// FACE_* colors set by the pass
+	bool inherited = false;		// the pass used colors set by an earlier one
+
+	FaceColorState()
+	{
+		memset(base, 0xff, sizeof(base));
+		memset(offs, 0xff, sizeof(offs));
+		memset(base1, 0xff, sizeof(base1));
+		memset(offs1, 0xff, sizeof(offs1));
+	}
+
+	void Load() const
+	{
+		memcpy(FaceBaseColor, base, sizeof(base));
+		memcpy(FaceOffsColor, offs, sizeof(offs));
+		memcpy(FaceBaseColor1, base1, sizeof(base1));
+		memcpy(FaceOffsColor1, offs1, sizeof(offs1));
+	}
+
+	void Save()
+	{
+		memcpy(base, FaceBaseColor, sizeof(base));
+		memcpy(offs, FaceOffsColor, sizeof(offs));
+		memcpy(base1, FaceBaseColor1, sizeof(base1));
+		memcpy(offs1, FaceOffsColor1, sizeof(offs1));
+		set = FaceColorsSet;
+		inherited = FaceColorsInherited;
+	}
+
+	// Applies the colors set by the next pass
+	void Update(const FaceColorState& pass)
+	{
+		if (pass.set & FACE_BASE)
+			memcpy(base, pass.base, sizeof(base));
+		if (pass.set & FACE_OFFS)
+			memcpy(offs, pass.offs, sizeof(offs));
+		if (pass.set & FACE_BASE1)
+			memcpy(base1, pass.base1, sizeof(base1));
+		if (pass.set & FACE_OFFS1)
+			memcpy(offs1, pass.offs1, sizeof(offs1));
+	}
+
+	bool SameColors(const FaceColorState& other) const
+	{
+		return memcmp(base, other.base, sizeof(base)) == 0 && memcmp(offs, other.offs, sizeof(offs)) == 0
+				&& memcmp(base1, other.base1, sizeof(base1)) == 0 && memcmp(offs1, other.offs1, sizeof(offs1)) == 0;
+	}
+};
+
+// Additional render passes are parsed concurrently into their own context,
+// then appended to the main one.
+struct RenderPassContext
+{
+	rend_context rc;
+	u32 tileclip;		// tile clip value at the end of the pass
+	FaceColorState colors;
+
+	RenderPassContext() { rc.Alloc(); }
+	~RenderPassContext() { rc.Free(); }
+};
+static std::unique_ptr<RenderPassContext> passContexts[ARRAY_SIZE(tad_context::render_passes)];
+static u32 tileclip_carry;	// tile clip value at the end of the last parsed context
+
+static u32 inherit_tileclip(u32 tileclip, u32 previous)
+{
+	if ((tileclip & TILECLIP_INHERIT) == 0)
+		return tileclip;
+	return (tileclip & 0xF0000000) | (previous & ~0xF0000000);
+}
+
+// Returns the tile clip value at the end of the pass.
+// colors holds the face colors at the start of the pass and receives the ones at the end.
+static u32 ta_parse_pass(TA_context* ctx, u32 pass, rend_context* rc, u32 tileclip, FaceColorState& colors)
+{
+	TAFifo0.vdec_init(rc, tileclip);
+	colors.Load();
+
+	Ta_Dma* ta_data = (Ta_Dma*)(pass == 0 ? ctx->tad.thd_root : ctx->tad.render_passes[pass - 1]);
+	Ta_Dma* ta_data_end = ((Ta_Dma*)(pass == ctx->tad.render_pass_count ? ctx->tad.End() : ctx->tad.render_passes[pass])) - 1;
+
+	do
+	{
+		ta_data =TaCmd(ta_data,ta_data_end);
+	}
+	while(ta_data<=ta_data_end);
+
+	colors.Save();
+	return tileclip_val;
+}
+
+template<typename T>
+static T* append_list(List<T>& dst, const List<T>& src)
+{
+	T* p = dst.Append(src.used());
+	memcpy(p, src.head(), src.bytes());
+	return p;
+}
+
+static void merge_polys(List<PolyParam>& dst, const List<PolyParam>& src, u32 vtx_base, u32 tileclip)
+{
+	PolyParam* pp = append_list(dst, src);
+	for (int i = 0; i < src.used(); i++, pp++)
+	{
+		pp->first += vtx_base;
+		pp->tileclip = inherit_tileclip(pp->tileclip, tileclip);
+	}
+}
+
+static void merge_modvols(List<ModifierVolumeParam>& dst, const List<ModifierVolumeParam>& src, u32 modtrig_base)
+{
+	ModifierVolumeParam* mvp = append_list(dst, src);
+	for (int i = 0; i < src.used(); i++)
+		mvp[i].first += modtrig_base;
+}
+
+// Appends the lists of a render pass to the main context
+static void merge_pass(rend_context& dst, const rend_context& src, u32 tileclip)
+{
+	u32 vtx_base = dst.verts.used();
+	u32 modtrig_base = dst.modtrig.used();
+	append_list(dst.verts, src.verts);
+	append_list(dst.modtrig, src.modtrig);
+	merge_polys(dst.global_param_op, src.global_param_op, vtx_base, tileclip);
+	merge_polys(dst.global_param_pt, src.global_param_pt, vtx_base, tileclip);
+	merge_polys(dst.global_param_tr, src.global_param_tr, vtx_base, tileclip);
+	merge_modvols(dst.global_param_mvo, src.global_param_mvo, modtrig_base);
+	merge_modvols(dst.global_param_mvo_tr, src.global_param_mvo_tr, modtrig_base);
+	dst.fZ_max = std::max(dst.fZ_max, src.fZ_max);
+}
+
+// Texture lookups aren't thread safe so they're done once all passes are parsed
+static void get_textures(const List<PolyParam>& list, int first = 0)
+{
+	const PolyParam* last = nullptr;
+	for (PolyParam* pp = list.head() + first; pp != list.end(); pp++)
+	{
+		if (!pp->pcw.Texture)
+			continue;
+		// consecutive strips usually share the same textures
+		if (last != nullptr && last->tsp.full == pp->tsp.full && last->tcw.full == pp->tcw.full
+				&& last->tsp1.full == pp->tsp1.full && last->tcw1.full == pp->tcw1.full)
+		{
+			pp->texid = last->texid;
+			pp->texid1 = last->texid1;
+			continue;
+		}
+		pp->texid = renderer->GetTexture(pp->tsp, pp->tcw);
+		if (pp->tcw1.full != (u32)-1)
+			pp->texid1 = renderer->GetTexture(pp->tsp1, pp->tcw1);
+		last = pp;
+	}
+}
+
 bool ta_parse_vdrc(TA_context* ctx)
 {
 	ctx->rend_inuse.lock();
@@ -1583,7 +1742,10 @@ bool ta_parse_vdrc(TA_context* ctx)
 	ta_parse_cnt++;
 	if (ctx->rend.isRTT || 0 == (ta_parse_cnt %  ( settings.pvr.ta_skip + 1)))
 	{
-		TAFifo0.vdec_init();
+		vd_rc.Clear();
+		//allocate storage for BG poly
+		vd_rc.global_param_op.Append();
+		vd_rc.verts.Append(4);
 		
 		bool empty_context = true;
 		int op_poly_count = 0;
@@ -1597,20 +1759,51 @@ bool ta_parse_vdrc(TA_context* ctx)
 			empty_context = false;
 		}
 
+		int pass_count = ctx->tad.render_pass_count + 1;
+		for (int pass = 1; pass < pass_count; pass++)
+			if (!passContexts[pass])
+				passContexts[pass].reset(new RenderPassContext());
+		u32 tileclip = tileclip_carry;
+		FaceColorState faceColors;
+#ifndef TARGET_NO_OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(std::min(pass_count, std::max(1, (int)settings.pvr.MaxThreads))) if(pass_count > 1)
+#endif
+		for (int pass = 0; pass < pass_count; pass++)
+		{
+			if (pass == 0)
+				tileclip = ta_parse_pass(ctx, pass, &vd_rc, tileclip, faceColors);
+			else
+			{
+				RenderPassContext& passContext = *passContexts[pass];
+				passContext.rc.Clear();
+				passContext.colors = FaceColorState();
+				passContext.tileclip = ta_parse_pass(ctx, pass, &passContext.rc, TILECLIP_INHERIT, passContext.colors);
+			}
+		}
+
 		for (u32 pass = 0; pass <= ctx->tad.render_pass_count; pass++)
 		{
 			ctx->MarkRend(pass);
 			vd_rc.proc_start = ctx->rend.proc_start;
 			vd_rc.proc_end = ctx->rend.proc_end;
 
-			Ta_Dma* ta_data=(Ta_Dma*)vd_rc.proc_start;
-			Ta_Dma* ta_data_end=((Ta_Dma*)vd_rc.proc_end)-1;
-
-			do
+			if (pass > 0)
 			{
-				ta_data =TaCmd(ta_data,ta_data_end);
+				RenderPassContext& passContext = *passContexts[pass];
+				if (passContext.colors.inherited && !faceColors.SameColors(FaceColorState()))
+				{
+					// The pass used face colors set by an earlier one: parse it again with them
+					passContext.rc.Clear();
+					passContext.colors = faceColors;
+					passContext.tileclip = ta_parse_pass(ctx, pass, &passContext.rc, TILECLIP_INHERIT, passContext.colors);
+				}
+				faceColors.Update(passContext.colors);
+				if (passContext.rc.Overrun)
+					ctx->rend.Overrun = true;
+				else
+					merge_pass(vd_rc, passContext.rc, tileclip);
+				tileclip = inherit_tileclip(passContext.tileclip, tileclip);
 			}
-			while(ta_data<=ta_data_end);
 
 			if (ctx->rend.Overrun)
 				break;
@@ -1641,6 +1834,14 @@ bool ta_parse_vdrc(TA_context* ctx)
 				render_pass->z_clear = ClearZBeforePass(pass);
 			}
 		}
+		tileclip_carry = tileclip;
+		if (!ctx->rend.Overrun)
+		{
+			// skip the background polygon
+			get_textures(vd_rc.global_param_op, 1);
+			get_textures(vd_rc.global_param_pt);
+			get_textures(vd_rc.global_param_tr);
+		}
 		rv = !empty_context;
 	}
 	bool overrun = ctx->rend.Overrun;
@@ -0,0 +1,218 @@
+/*
+	Persistent block cache
+
+	Decoding and optimizing a block is the most expensive part of its compilation,
+	so the resulting shil opcode lists are saved to disk and reused on the next boot.
+	Only blocks located in write-protected RAM pages are cached: the constant
+	propagation pass may have folded reads from these pages into the oplist, so an
+	entry is only valid if the whole pages still contain the same data.
+*/
+#include <unordered_map>
+#include <xxhash.h>
+
+#include "blockcache.h"
+#include "blockmanager.h"
+#include "hw/sh4/sh4_core.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/modules/mmu.h"
+
+#if FEAT_SHREC != DYNAREC_NONE
+
+#define BC_MAGIC 0x43424346	// FCBC
+#define BC_VERSION 1
+
+struct bc_header
+{
+	u32 magic;
+	u32 version;
+	u32 op_size;	// sizeof(shil_opcode), changes with the build
+	u32 flags;		// decoder settings the blocks depend on
+	u32 count;
+};
+
+struct bc_block_info
+{
+	u32 hash;
+	u32 sh4_code_size;
+	u32 guest_cycles;
+	u32 guest_opcodes;
+	u32 BranchBlock;
+	u32 NextBlock;
+	u32 BlockType;
+	bool has_fpu_op;
+	bool has_jcond;
+};
+
+struct bc_block
+{
+	bc_block_info info;
+	std::vector<shil_opcode> oplist;
+};
+
+static std::unordered_map<u64, bc_block> block_cache;
+static std::string cache_file;
+static bool cache_dirty;
+
+static u32 bc_flags()
+{
+	return (settings.dynarec.idleskip ? 1 : 0)
+			| (settings.dynarec.safemode ? 2 : 0)
+			| (settings.dynarec.unstable_opt ? 4 : 0);
+}
+
+static u64 bc_key(u32 addr, fpscr_t fpu_cfg)
+{
+	// Only the fpscr bits used by the decoder
+	u32 cfg = fpu_cfg.PR | (fpu_cfg.SZ << 1) | ((fpu_cfg.RM == 1) << 2);
+	return ((u64)cfg << 32) | addr;
+}
+
+// Hash of the 4K pages containing the block
+static bool bc_hash(u32 addr, u32 size, u32& hash)
+{
+	u32 start = addr & ~0xFFF;
+	u32 end = ((addr + size - 1) | 0xFFF) + 1;
+	u8 *ptr = GetMemPtr(start, end - start);
+	if (ptr == nullptr)
+		return false;
+	hash = XXH32(ptr, end - start, 7);
+
+	return true;
+}
+
+static std::string bc_FilePath()
+{
+	std::string name = settings.imgread.ImagePath;
+	size_t lastindex = name.find_last_of("/\\");
+	if (lastindex != std::string::npos)
+		name = name.substr(lastindex + 1);
+	lastindex = name.find_last_of('.');
+	if (lastindex != std::string::npos)
+		name = name.substr(0, lastindex);
+	if (name.empty())
+		name = "bios";
+
+	return get_writable_data_path(name + ".blockcache");
+}
+
+void bc_Load()
+{
+	if (!settings.dynarec.block_cache)
+	{
+		block_cache.clear();
+		cache_file.clear();
+		return;
+	}
+	std::string path = bc_FilePath();
+	if (path == cache_file)
+		return;
+	block_cache.clear();
+	cache_file = path;
+	cache_dirty = false;
+
+	FILE *f = fopen(path.c_str(), "rb");
+	if (f == nullptr)
+		return;
+	bc_header header;
+	if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != BC_MAGIC || header.version != BC_VERSION
+			|| header.op_size != sizeof(shil_opcode) || header.flags != bc_flags())
+	{
+		INFO_LOG(DYNAREC, "Block cache %s is obsolete", path.c_str());
+		fclose(f);
+		return;
+	}
+	for (u32 i = 0; i < header.count; i++)
+	{
+		u64 key;
+		u32 size;
+		bc_block block;
+		if (fread(&key, sizeof(key), 1, f) != 1
+				|| fread(&block.info, sizeof(block.info), 1, f) != 1
+				|| fread(&size, sizeof(size), 1, f) != 1
+				|| size > BLOCK_MAX_SH_OPS_HARD)
+			break;
+		block.oplist.resize(size);
+		if (size != 0 && fread(&block.oplist[0], sizeof(shil_opcode), size, f) != size)
+			break;
+		block_cache[key] = std::move(block);
+	}
+	fclose(f);
+	INFO_LOG(DYNAREC, "Loaded %zd blocks from %s", block_cache.size(), path.c_str());
+}
+
+void bc_Save()
+{
+	if (!cache_dirty)
+		return;
+	FILE *f = fopen(cache_file.c_str(), "wb");
+	if (f == nullptr)
+	{
+		WARN_LOG(DYNAREC, "Cannot save block cache to %s", cache_file.c_str());
+		return;
+	}
+	bc_header header = { BC_MAGIC, BC_VERSION, sizeof(shil_opcode), bc_flags(), (u32)block_cache.size() };
+	fwrite(&header, sizeof(header), 1, f);
+	for (const auto& it : block_cache)
+	{
+		u32 size = it.second.oplist.size();
+		fwrite(&it.first, sizeof(it.first), 1, f);
+		fwrite(&it.second.info, sizeof(it.second.info), 1, f);
+		fwrite(&size, sizeof(size), 1, f);
+		if (size != 0)
+			fwrite(&it.second.oplist[0], sizeof(shil_opcode), size, f);
+	}
+	fclose(f);
+	cache_dirty = false;
+	INFO_LOG(DYNAREC, "Saved %zd blocks to %s", block_cache.size(), cache_file.c_str());
+}
+
+bool bc_Lookup(RuntimeBlockInfo* blk)
+{
+	if (block_cache.empty() || mmu_enabled())
+		return false;
+	auto it = block_cache.find(bc_key(blk->addr, blk->fpu_cfg));
+	if (it == block_cache.end())
+		return false;
+	const bc_block_info& block = it->second.info;
+	// We need to go through the decoder to raise the fpu disabled exception
+	if (block.has_fpu_op && sr.FD == 1)
+		return false;
+	u32 hash;
+	if (!bm_IsCodeProtected(blk->addr, block.sh4_code_size)
+			|| !bc_hash(blk->addr, block.sh4_code_size, hash) || hash != block.hash)
+		return false;
+
+	blk->sh4_code_size = block.sh4_code_size;
+	blk->guest_cycles = block.guest_cycles;
+	blk->guest_opcodes = block.guest_opcodes;
+	blk->BranchBlock = block.BranchBlock;
+	blk->NextBlock = block.NextBlock;
+	blk->BlockType = (BlockEndType)block.BlockType;
+	blk->has_fpu_op = block.has_fpu_op;
+	blk->has_jcond = block.has_jcond;
+	blk->oplist = it->second.oplist;
+
+	return true;
+}
+
+void bc_Store(const RuntimeBlockInfo* blk)
+{
+	if (cache_file.empty() || !blk->read_only || mmu_enabled())
+		return;
+	bc_block block;
+	if (!bc_hash(blk->addr, blk->sh4_code_size, block.info.hash))
+		return;
+	block.info.sh4_code_size = blk->sh4_code_size;
+	block.info.guest_cycles = blk->guest_cycles;
+	block.info.guest_opcodes = blk->guest_opcodes;
+	block.info.BranchBlock = blk->BranchBlock;
+	block.info.NextBlock = blk->NextBlock;
+	block.info.BlockType = blk->BlockType;
+	block.info.has_fpu_op = blk->has_fpu_op;
+	block.info.has_jcond = blk->has_jcond;
+	block.oplist = blk->oplist;
+	block_cache[bc_key(blk->addr, blk->fpu_cfg)] = std::move(block);
+	cache_dirty = true;
+}
+
+#endif  // FEAT_SHREC != DYNAREC_NONE
@@ -0,0 +1,18 @@
+/*
+	Persistent cache of decoded and optimized blocks.
+	Blocks are keyed by address and fpu config, and validated against a hash of
+	the guest code pages so stale entries are never used.
+*/
+#pragma once
+#include "types.h"
+
+struct RuntimeBlockInfo;
+
+// Load the cache of the current game. Does nothing if already loaded. Unloads it if disabled
+void bc_Load();
+// Write the cache to disk if new blocks have been added
+void bc_Save();
+// Fills the block from the cache. Returns false if not found or stale
+bool bc_Lookup(RuntimeBlockInfo* blk);
+// Adds a newly decoded block to the cache
+void bc_Store(const RuntimeBlockInfo* blk);
@@ -10,6 +10,8 @@
 #include "ngen.h"
 
 #include "../sh4_core.h"
+#include "hw/mem/vmem_snapshot.h"
+#include "hw/mem/vmem32.h"
 #include "hw/sh4/sh4_mem.h"
 #include "hw/sh4/sh4_opcode_list.h"
 #include "hw/sh4/sh4_sched.h"
@@ -222,6 +224,13 @@ void bm_DiscardBlock(RuntimeBlockInfo* block)
 void bm_Periodical_1s()
 {
 	bm_CleanupDeletedBlocks();
+	if (tier2_blocks != 0)
+	{
+		DEBUG_LOG(DYNAREC, "Superblocks: %d compiled", tier2_blocks);
+		tier2_blocks = 0;
+	}
+	if (vmem32_enabled())
+		vmem32_log_stats();
 }
 
 void bm_vmem_pagefill(void** ptr, u32 size_bytes)
@@ -234,6 +243,8 @@ void bm_vmem_pagefill(void** ptr, u32 size_bytes)
 
 void bm_Reset()
 {
+	// Unlocking ram would let uncopied pages be overwritten
+	vmem_snapshot_complete();
 	bm_ResetCache();
 	bm_CleanupDeletedBlocks();
 	protected_blocks = 0;
@@ -498,6 +509,17 @@ void bm_Sort()
 }
 #endif
 
+// Calls f with the address of each page containing code of the block
+template<typename F>
+static void bm_ForEachCodePage(const RuntimeBlockInfo* block, F f)
+{
+	for (u32 addr = block->addr & ~PAGE_MASK; addr < block->addr + block->sh4_code_size; addr += PAGE_SIZE)
+		f(addr);
+	for (const auto& range : block->trace_code)
+		for (u32 addr = range.first & ~PAGE_MASK; addr < range.first + range.second; addr += PAGE_SIZE)
+			f(addr);
+}
+
 RuntimeBlockInfo::~RuntimeBlockInfo()
 {
 	if (sh4_code_size != 0)
@@ -538,11 +560,10 @@ void RuntimeBlockInfo::Discard()
 	if (read_only)
 	{
 		// Remove this block from the per-page block lists
-		for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + this->sh4_code_size; addr += PAGE_SIZE)
-		{
+		bm_ForEachCodePage(this, [this](u32 addr) {
 			auto& block_list = blocks_per_page[(addr & RAM_MASK) / PAGE_SIZE];
 			block_list.erase(this);
-		}
+		});
 	}
 }
 
@@ -555,24 +576,37 @@ void RuntimeBlockInfo::SetProtectedFlags()
 		unprotected_blocks++;
 		return;
 	}
-	for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + sh4_code_size; addr += PAGE_SIZE)
+	bool unprotected = false;
+	bm_ForEachCodePage(this, [&unprotected](u32 addr) {
+		unprotected |= unprotected_pages[(addr & RAM_MASK) / PAGE_SIZE];
+	});
+	if (unprotected)
 	{
-		if (unprotected_pages[(addr & RAM_MASK) / PAGE_SIZE])
-		{
-			this->read_only = false;
-			unprotected_blocks++;
-			return;
-		}
+		// Traces are only formed over protected code
+		verify(trace_code.empty());
+		this->read_only = false;
+		unprotected_blocks++;
+		return;
 	}
 	this->read_only = true;
 	protected_blocks++;
-	for (u32 addr = this->addr & ~PAGE_MASK; addr < this->addr + sh4_code_size; addr += PAGE_SIZE)
-	{
+	bm_ForEachCodePage(this, [this](u32 addr) {
 		auto& block_list = blocks_per_page[(addr & RAM_MASK) / PAGE_SIZE];
 		if (block_list.empty())
 			bm_LockPage(addr);
 		block_list.insert(this);
-	}
+	});
+}
+
+bool bm_IsCodeProtected(u32 addr, u32 size)
+{
+	if (!IsOnRam(addr) || (addr & 0x1FFF0000) == 0x0c000000)
+		return false;
+	for (u32 page = addr & ~PAGE_MASK; page < addr + size; page += PAGE_SIZE)
+		if (!bm_IsRamPageProtected(page))
+			return false;
+
+	return true;
 }
 
 void bm_RamWriteAccess(u32 addr)
@@ -39,6 +39,9 @@ struct RuntimeBlockInfo: RuntimeBlockInfo_Core
 	bool has_fpu_op;
 	u32 blockcheck_failures;
 	bool temp_block;
+	u32 hot_runs;	//if not 0, runs left before the block is promoted to tier 2
+	bool tier2;		//superblock spanning static jumps
+	std::vector<std::pair<u32, u32>> trace_code;	//tier 2 code ranges after the first one, as {addr, size}
 
 	u32 BranchBlock; //if not 0xFFFFFFFF then jump target
 	u32 NextBlock;   //if not 0xFFFFFFFF then next block (by position)
@@ -112,3 +115,6 @@ static inline bool bm_IsRamPageProtected(u32 addr)
 	addr &= RAM_MASK;
 	return !unprotected_pages[addr / PAGE_SIZE];
 }
+// Returns true if blocks containing this code would be write-protected.
+// Same conditions as RuntimeBlockInfo::SetProtectedFlags()
+bool bm_IsCodeProtected(u32 addr, u32 size);
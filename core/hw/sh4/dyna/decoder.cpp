@@ -16,9 +16,10 @@
 #include "decoder_opcodes.h"
 
 #define BLOCK_MAX_SH_OPS_SOFT 500
-#define BLOCK_MAX_SH_OPS_HARD 511
+#define SUPERBLOCK_MAX_GAP 256	// max number of bytes skipped by a static jump inside a superblock
 
 static RuntimeBlockInfo* blk;
+static bool trace_jumps;	// superblocks can follow static jumps to other code ranges
 
 static const char idle_hash[] =
        //BIOS
@@ -985,10 +986,61 @@ static void state_Setup(u32 rpc,fpscr_t fpu_cfg)
 	state.info.has_fpu=false;
 }
 
+// Superblocks follow forward static jumps. The skipped bytes are considered part of the block
+// so that write protection and smc checks still cover the whole code.
+static bool dec_IsSuperblockJump(u32 end_pc, u32 target)
+{
+	return !mmu_enabled() && target != 0xFFFFFFFF && target > end_pc && target - end_pc <= SUPERBLOCK_MAX_GAP;
+}
+
+static bool dec_InRange(u32 addr, u32 start, u32 size)
+{
+	return addr >= start && addr - start < size;
+}
+
+// Superblocks also follow static jumps to protected code that isn't part of the block yet.
+// The target code starts a new code range, so the block can only rely on write protection
+// to be discarded when the code changes.
+// start and end_pc delimit the code range being decoded.
+static bool dec_IsTraceJump(const RuntimeBlockInfo* rbi, u32 start, u32 end_pc, u32 target)
+{
+	if (mmu_enabled() || target == 0xFFFFFFFF || target == end_pc
+			|| !bm_IsCodeProtected(start, end_pc - start) || !bm_IsCodeProtected(target, 2))
+		return false;
+	if (dec_InRange(target, start, end_pc - start))
+		return false;
+	if (start != rbi->vaddr && dec_InRange(target, rbi->vaddr, rbi->sh4_code_size))
+		return false;
+	for (const auto& range : rbi->trace_code)
+		if (dec_InRange(target, range.first, range.second))
+			return false;
+
+	return true;
+}
+
+bool dec_CanExtendBlock(const RuntimeBlockInfo* rbi)
+{
+	return rbi->BlockType == BET_StaticJump
+			&& (dec_IsSuperblockJump(rbi->vaddr + rbi->sh4_code_size, rbi->BranchBlock)
+				|| (rbi->read_only && dec_IsTraceJump(rbi, rbi->vaddr, rbi->vaddr + rbi->sh4_code_size, rbi->BranchBlock)));
+}
+
+// Closes the code range being decoded
+static void dec_EndRange(u32 start, u32 end_pc)
+{
+	if (start == blk->vaddr)
+		blk->sh4_code_size = end_pc - start;
+	else
+		blk->trace_code.emplace_back(start, end_pc - start);
+}
+
 bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
 {
 	blk=rbi;
+	trace_jumps = blk->tier2;
+_start:
 	state_Setup(blk->vaddr, blk->fpu_cfg);
+	u32 range_start = blk->vaddr;	// start of the code range being decoded
 	ngen_GetFeatures(&state.ngen);
 	
 	blk->guest_opcodes=0;
@@ -1005,7 +1057,9 @@ bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
 			//there is no break here by design
 		case NDO_NextOp:
 			{
-				if ((blk->oplist.size() >= BLOCK_MAX_SH_OPS_SOFT || blk->guest_cycles >= max_cycles || state.cpu.rpc >= max_pc)
+				if ((blk->oplist.size() >= BLOCK_MAX_SH_OPS_SOFT || blk->guest_cycles >= max_cycles || state.cpu.rpc >= max_pc
+						// code ranges reached by a trace jump end before unprotected pages
+						|| (range_start != blk->vaddr && (state.cpu.rpc & PAGE_MASK) == 0 && !bm_IsCodeProtected(state.cpu.rpc, 2)))
 						&& !state.cpu.is_delayslot)
 				{
 					dec_End(state.cpu.rpc,BET_StaticJump,false);
@@ -1071,12 +1125,43 @@ bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles)
 			break;
 
 		case NDO_End:
+			if (blk->tier2 && state.BlockType == BET_StaticJump
+					&& blk->oplist.size() < BLOCK_MAX_SH_OPS_SOFT && blk->guest_cycles < max_cycles
+					&& (dec_IsSuperblockJump(state.cpu.rpc, state.JumpAddr)
+						|| (trace_jumps && dec_IsTraceJump(blk, range_start, state.cpu.rpc, state.JumpAddr))))
+			{
+				if (!dec_IsSuperblockJump(state.cpu.rpc, state.JumpAddr))
+				{
+					dec_EndRange(range_start, state.cpu.rpc);
+					range_start = state.JumpAddr;
+				}
+				// Continue decoding at the jump target
+				state.cpu.rpc = state.JumpAddr;
+				state.cpu.is_delayslot = false;
+				state.NextOp = NDO_NextOp;
+				state.BlockType = BET_SCL_Intr;
+				state.JumpAddr = 0xFFFFFFFF;
+				state.NextAddr = 0xFFFFFFFF;
+				break;
+			}
 			goto _end;
 		}
 	}
 
 _end:
-	blk->sh4_code_size=state.cpu.rpc-blk->vaddr;
+	dec_EndRange(range_start, state.cpu.rpc);
+	if (!blk->trace_code.empty() && !bm_IsCodeProtected(range_start, state.cpu.rpc - range_start))
+	{
+		// The last code range reaches an unprotected page.
+		// Decode the block again without trace jumps.
+		blk->oplist.clear();
+		blk->trace_code.clear();
+		blk->guest_cycles = 0;
+		blk->has_fpu_op = false;
+		blk->has_jcond = false;
+		trace_jumps = false;
+		goto _start;
+	}
 	blk->NextBlock=state.NextAddr;
 	blk->BranchBlock=state.JumpAddr;
 	blk->BlockType=state.BlockType;
@@ -2,6 +2,8 @@
 #include "shil.h"
 #include "../sh4_if.h"
 
+#define BLOCK_MAX_SH_OPS_HARD 511
+
 #define mkbet(c,s,v) ((c<<3)|(s<<1)|v)
 #define BET_GET_CLS(x) (x>>3)
 
@@ -46,6 +48,7 @@ struct ngen_features
 
 struct RuntimeBlockInfo;
 bool dec_DecodeBlock(RuntimeBlockInfo* rbi,u32 max_cycles);
+bool dec_CanExtendBlock(const RuntimeBlockInfo* rbi);
 
 struct state_t
 {
@@ -18,6 +18,7 @@
 #include <cfloat>
 
 #include "blockmanager.h"
+#include "blockcache.h"
 #include "ngen.h"
 #include "decoder.h"
 
@@ -36,6 +37,8 @@ u8 SH4_TCB[CODE_SIZE + TEMP_CODE_SIZE + 4096]
 	#error SH4_TCB ALLOC
 #endif
 
+#define SUPERBLOCK_HOT_RUNS 1000
+
 u8* CodeCache;
 u8* TempCodeCache;
 uintptr_t cc_rx_offset;
@@ -47,6 +50,8 @@ u32* emit_ptr=0;
 u32* emit_ptr_limit;
 
 std::unordered_set<u32> smc_hotspots;
+static std::unordered_set<u32> hot_blocks;	// compiled as superblocks
+u32 tier2_blocks;
 
 void* emit_GetCCPtr() { return emit_ptr==0?(void*)&CodeCache[LastAddr]:(void*)emit_ptr; }
 void emit_SetBaseAddr() { LastAddr_min = LastAddr; }
@@ -78,7 +83,9 @@ static void recSh4_Run()
 		NOTICE_LOG(DYNAREC, "Warning: Unstable optimizations is on");
 	
 	verify(rcb_noffs(&next_pc)==-184);
+	bc_Load();
 	ngen_mainloop(sh4_dyna_rcb);
+	bc_Save();
 
 	sh4_int_bCpuRun = false;
 }
@@ -157,6 +164,7 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
 	BlockType=BET_SCL_Intr;
 	has_fpu_op = false;
 	temp_block = false;
+	hot_runs = 0;
 	
 	vaddr = rpc;
 	if (mmu_enabled())
@@ -171,8 +179,16 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
 	else
 		addr = vaddr;
 	fpu_cfg=rfpu_cfg;
+	tier2 = settings.dynarec.superblocks && !mmu_enabled() && hot_blocks.count(addr) != 0;
 	
 	oplist.clear();
+	trace_code.clear();
+
+	if (!tier2 && bc_Lookup(this))
+	{
+		SetProtectedFlags();
+		return true;
+	}
 
 #if !defined(NO_MMU)
 	try {
@@ -189,6 +205,8 @@ bool RuntimeBlockInfo::Setup(u32 rpc,fpscr_t rfpu_cfg)
 	SetProtectedFlags();
 
 	AnalyseBlock(this);
+	if (!tier2)
+		bc_Store(this);
 
 	return true;
 }
@@ -208,6 +226,8 @@ DynarecCodeEntryPtr rdv_CompilePC(u32 blockcheck_failures)
 		return NULL;
 	}
 	rbi->blockcheck_failures = blockcheck_failures;
+	if (rbi->tier2)
+		tier2_blocks++;
 	if (smc_hotspots.find(rbi->addr) != smc_hotspots.end())
 	{
 		if (TEMP_CODE_SIZE - TempLastAddr < 16 * 1024)
@@ -220,6 +240,8 @@ DynarecCodeEntryPtr rdv_CompilePC(u32 blockcheck_failures)
 	}
 	bool do_opts = !rbi->temp_block;
 	rbi->staging_runs=do_opts?100:-100;
+	if (settings.dynarec.superblocks && do_opts && !rbi->tier2 && dec_CanExtendBlock(rbi))
+		rbi->hot_runs = SUPERBLOCK_HOT_RUNS;
 	bool block_check = !rbi->read_only;
 	ngen_Compile(rbi, block_check, (pc & 0xFFFFFF) == 0x08300 || (pc & 0xFFFFFF) == 0x10000, false, do_opts);
 	verify(rbi->code!=0);
@@ -296,6 +318,17 @@ DynarecCodeEntryPtr DYNACALL rdv_BlockCheckFail(u32 addr)
 	return (DynarecCodeEntryPtr)CC_RW2RX(rdv_CompilePC(blockcheck_failures));
 }
 
+// addr must be the physical address of the start of the block
+DynarecCodeEntryPtr DYNACALL rdv_PromoteBlock(u32 addr)
+{
+	RuntimeBlockInfoPtr block = bm_GetBlock(addr);
+	hot_blocks.insert(addr);
+	bm_DiscardBlock(block.get());
+	next_pc = addr;
+
+	return (DynarecCodeEntryPtr)CC_RW2RX(rdv_CompilePC(0));
+}
+
 DynarecCodeEntryPtr rdv_FindOrCompile()
 {
 	DynarecCodeEntryPtr rv = bm_GetCodeByVAddr(next_pc);  // Returns exec addr
@@ -404,6 +437,7 @@ static void recSh4_Skip()
 static void recSh4_Reset(bool hard)
 {
 	Sh4_int_Reset(hard);
+	hot_blocks.clear();
 	recSh4_ClearCache();
 	bm_Reset();
 }
@@ -70,6 +70,9 @@
 extern u32* emit_ptr;
 extern u8* CodeCache;
 
+//tier 2 blocks compiled, reset every second
+extern u32 tier2_blocks;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -85,6 +88,8 @@ DynarecCodeEntryPtr DYNACALL rdv_FailedToFindBlock(u32 pc);
 DynarecCodeEntryPtr DYNACALL rdv_FailedToFindBlock_pc();
 //Called when a block check failed, and the block needs to be invalidated
 DynarecCodeEntryPtr DYNACALL rdv_BlockCheckFail(u32 pc);
+//Called when a block has run hot_runs times, to recompile it as a superblock
+DynarecCodeEntryPtr DYNACALL rdv_PromoteBlock(u32 pc);
 //Called to compile code @pc
 DynarecCodeEntryPtr rdv_CompilePC(u32 blockcheck_failures);
 //Finds or compiles code @pc
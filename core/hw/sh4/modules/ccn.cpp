@@ -45,10 +45,11 @@ void CCN_PTEH_write(u32 addr, u32 value)
 {
 	CCN_PTEH_type temp;
 	temp.reg_data = value;
-	if (temp.ASID != CCN_PTEH.ASID && vmem32_enabled())
-		vmem32_flush_mmu();
+	bool asid_changed = temp.ASID != CCN_PTEH.ASID;
 
 	CCN_PTEH = temp;
+	if (asid_changed && vmem32_enabled())
+		vmem32_flush_mmu(false);
 }
 
 void CCN_MMUCR_write(u32 addr, u32 value)
@@ -50,13 +50,14 @@ struct TLB_LinkedEntry {
 static TLB_LinkedEntry full_table[65536];
 static u32 full_table_size;
 static TLB_LinkedEntry *entry_buckets[NBUCKETS];
+SoftTLB_Entry mmu_soft_tlb[SOFT_TLB_SIZE];
 
 static u16 bucket_index(u32 address, int size)
 {
 	return ((address >> 16) ^ ((address & 0xFC00) | size)) & (NBUCKETS - 1);
 }
 
-static void cache_entry(const TLB_Entry &entry)
+static const TLB_Entry *cache_entry(const TLB_Entry &entry)
 {
 	verify(full_table_size < ARRAY_SIZE(full_table));
 	u16 bucket = bucket_index(entry.Address.VPN << 10, entry.Data.SZ1 * 2 + entry.Data.SZ0);
@@ -64,7 +65,8 @@ static void cache_entry(const TLB_Entry &entry)
 	full_table[full_table_size].entry = entry;
 	full_table[full_table_size].next_entry = entry_buckets[bucket];
 	entry_buckets[bucket] = &full_table[full_table_size];
-	full_table_size++;
+
+	return &full_table[full_table_size++].entry;
 }
 
 static void flush_cache()
@@ -73,6 +75,38 @@ static void flush_cache()
 	memset(entry_buckets, 0, sizeof(entry_buckets));
 }
 
+static void soft_tlb_flush()
+{
+	for (SoftTLB_Entry& cached : mmu_soft_tlb)
+		cached.tag = SOFT_TLB_INVALID;
+}
+
+static void soft_tlb_add(u32 va, const TLB_Entry *entry, u32 mask)
+{
+	// 1 KB pages aren't cached, nor addresses that may not be translated depending on sr.MD
+	if (mask == mmu_mask[0] || fast_reg_lut[va >> 29] != 0 || (va & 0xFC000000) == 0x7C000000)
+		return;
+	u32 asid = CCN_PTEH.ASID;
+	SoftTLB_Entry& cached = mmu_soft_tlb[soft_tlb_index(va, asid)];
+	cached.tag = (va & 0xFFFFF000) | (asid << 4);
+	cached.offset = ((entry->Data.PPN << 10) & mask) - (va & mask);
+	cached.entry = entry;
+}
+
+// Drops the cached pages that a new UTLB entry may override
+static void soft_tlb_invalidate(const TLB_Entry& entry, u32 sz)
+{
+	if (entry.Data.SH == 1 || sz == 3)
+	{
+		soft_tlb_flush();
+		return;
+	}
+	u32 address = (entry.Address.VPN << 10) & mmu_mask[1];
+	u32 pages = sz == 2 ? 16 : 1;
+	for (u32 i = 0; i < pages; i++)
+		mmu_soft_tlb[soft_tlb_index(address + i * 4096, entry.Address.ASID)].tag = SOFT_TLB_INVALID;
+}
+
 template<u32 size>
 bool find_entry_by_page_size(u32 address, const TLB_Entry **ret_entry)
 {
@@ -185,12 +219,12 @@ bool UTLB_Sync(u32 entry)
 	TLB_Entry& tlb_entry = UTLB[entry];
 	u32 sz = tlb_entry.Data.SZ1 * 2 + tlb_entry.Data.SZ0;
 
-	lru_entry = &tlb_entry;
 	lru_mask = mmu_mask[sz];
 	lru_address = (tlb_entry.Address.VPN << 10) & lru_mask;
 
 	tlb_entry.Address.VPN = lru_address >> 10;
-	cache_entry(tlb_entry);
+	lru_entry = cache_entry(tlb_entry);
+	soft_tlb_invalidate(tlb_entry, sz);
 
 	if (!mmu_enabled() && (tlb_entry.Address.VPN & (0xFC000000 >> 10)) == (0xE0000000 >> 10))
 	{
@@ -209,6 +243,15 @@ void ITLB_Sync(u32 entry)
 template<bool internal>
 u32 mmu_full_lookup(u32 va, const TLB_Entry** tlb_entry_ret, u32& rv)
 {
+	const SoftTLB_Entry& cached = mmu_soft_tlb[soft_tlb_index(va, CCN_PTEH.ASID)];
+	if (cached.tag == ((va & 0xFFFFF000) | (CCN_PTEH.ASID << 4)))
+	{
+		rv = va + cached.offset;
+		*tlb_entry_ret = cached.entry;
+
+		return MMU_ERROR_NONE;
+	}
+
 	if (lru_entry != NULL)
 	{
 		if (/*lru_entry->Data.V == 1 && */
@@ -221,6 +264,7 @@ u32 mmu_full_lookup(u32 va, const TLB_Entry** tlb_entry_ret, u32& rv)
 			// TODO mask off PPN when updating TLB to avoid doing it at look up time
 			rv = ((lru_entry->Data.PPN << 10) & lru_mask) | (va & (~lru_mask));
 			*tlb_entry_ret = lru_entry;
+			soft_tlb_add(va, lru_entry, lru_mask);
 
 			return MMU_ERROR_NONE;
 		}
@@ -233,29 +277,30 @@ u32 mmu_full_lookup(u32 va, const TLB_Entry** tlb_entry_ret, u32& rv)
 		lru_entry = *tlb_entry_ret;
 		lru_mask = mask;
 		lru_address = ((*tlb_entry_ret)->Address.VPN << 10);
+		soft_tlb_add(va, lru_entry, lru_mask);
 		return MMU_ERROR_NONE;
 	}
 
 #ifdef USE_WINCE_HACK
 	// WinCE hack
 	TLB_Entry entry;
-	if (wince_resolve_address(va, entry))
+	if (!internal && wince_resolve_address(va, entry))
 	{
 		CCN_PTEL.reg_data = entry.Data.reg_data;
 		CCN_PTEA.reg_data = entry.Assistance.reg_data;
 		CCN_PTEH.reg_data = entry.Address.reg_data;
 		UTLB[CCN_MMUCR.URC] = entry;
 
-		*tlb_entry_ret = &UTLB[CCN_MMUCR.URC];
-		lru_entry = *tlb_entry_ret;
+		lru_entry = cache_entry(entry);
+		*tlb_entry_ret = lru_entry;
 
 		u32 sz = lru_entry->Data.SZ1 * 2 + lru_entry->Data.SZ0;
 		lru_mask = mmu_mask[sz];
 		lru_address = va & lru_mask;
 
 		rv = ((lru_entry->Data.PPN << 10) & lru_mask) | (va & (~lru_mask));
-
-		cache_entry(*lru_entry);
+		soft_tlb_invalidate(*lru_entry, sz);
+		soft_tlb_add(va, lru_entry, lru_mask);
 
 		return MMU_ERROR_NONE;
 	}
@@ -264,6 +309,7 @@ u32 mmu_full_lookup(u32 va, const TLB_Entry** tlb_entry_ret, u32& rv)
 	return MMU_ERROR_TLB_MISS;
 }
 template u32 mmu_full_lookup<false>(u32 va, const TLB_Entry** tlb_entry_ret, u32& rv);
+template u32 mmu_full_lookup<true>(u32 va, const TLB_Entry** tlb_entry_ret, u32& rv);
 
 template<u32 translation_type>
 u32 mmu_full_SQ(u32 va, u32& rv)
@@ -342,5 +388,6 @@ void mmu_flush_table()
 {
 	lru_entry = NULL;
 	flush_cache();
+	soft_tlb_flush();
 }
 #endif 	// FAST_MMU
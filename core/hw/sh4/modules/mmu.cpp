@@ -394,6 +394,8 @@ u32 mmu_full_lookup(u32 va, const TLB_Entry** tlb_entry_ret, u32& rv)
 
 	return MMU_ERROR_NONE;
 }
+template u32 mmu_full_lookup<false>(u32 va, const TLB_Entry** tlb_entry_ret, u32& rv);
+template u32 mmu_full_lookup<true>(u32 va, const TLB_Entry** tlb_entry_ret, u32& rv);
 #endif
 
 //Simple QACR translation for mmu (when AT is off)
@@ -64,6 +64,24 @@ template<u32 translation_type>
 u32 mmu_full_SQ(u32 va, u32& rv);
 
 #ifdef FAST_MMU
+// Direct-mapped cache of 4 KB page translations indexed by virtual page number and ASID.
+// Probed before the UTLB lookup and inlined by the dynarecs.
+struct SoftTLB_Entry
+{
+	u32 tag;		// page address | ASID << 4
+	u32 offset;		// physical address - virtual address
+	const TLB_Entry *entry;
+};
+constexpr u32 SOFT_TLB_SIZE = 4096;
+// Lookup tags of aligned accesses never have the low 4 bits set
+constexpr u32 SOFT_TLB_INVALID = 8;
+extern SoftTLB_Entry mmu_soft_tlb[SOFT_TLB_SIZE];
+
+static INLINE u32 soft_tlb_index(u32 va, u32 asid)
+{
+	return ((va >> 12) ^ asid) & (SOFT_TLB_SIZE - 1);
+}
+
 static INLINE u32 mmu_instruction_translation(u32 va, u32& rv)
 {
 	if (va & 1)
@@ -1,4 +1,4 @@
-
+#include <algorithm>
 #include "types.h"
 #include "sh4_interrupts.h"
 #include "sh4_core.h"
@@ -20,55 +20,131 @@
 
 	sh4_sched_now()
 
+	Armed callbacks are kept in an indexed binary min-heap ordered by their
+	64-bit deadline, so re-arming is O(log n) and the next event is at the top.
 */
 u64 sh4_sched_ffb;
 
 
 std::vector<sched_list> sch_list;	// using list as external inside a macro confuses clang and msc
+static std::vector<int> sch_heap;	// ids of the armed callbacks
+static std::vector<int> sch_expired;	// callbacks to run in this tick, by id
+static std::vector<int> sch_deferred;	// expired callbacks to run on the next tick
 
-int sh4_sched_next_id=-1;
+static bool heap_less(int a, int b)
+{
+	if (sch_list[a].deadline != sch_list[b].deadline)
+		return sch_list[a].deadline < sch_list[b].deadline;
+	return a < b;
+}
 
-u32 sh4_sched_remaining(size_t id, u32 reference)
+static void heap_set(size_t pos, int id)
 {
-	if (sch_list[id].end != -1)
-		return sch_list[id].end - reference;
-	else
-		return -1;
+	sch_heap[pos] = id;
+	sch_list[id].heap_pos = pos;
 }
 
-u32 sh4_sched_remaining(size_t id)
+static void heap_sift_up(size_t pos)
 {
-	return sh4_sched_remaining(id, sh4_sched_now());
+	int id = sch_heap[pos];
+	while (pos > 0)
+	{
+		size_t parent = (pos - 1) / 2;
+		if (!heap_less(id, sch_heap[parent]))
+			break;
+		heap_set(pos, sch_heap[parent]);
+		pos = parent;
+	}
+	heap_set(pos, id);
 }
 
-void sh4_sched_ffts()
+static void heap_sift_down(size_t pos)
+{
+	int id = sch_heap[pos];
+	for (;;)
+	{
+		size_t child = pos * 2 + 1;
+		if (child >= sch_heap.size())
+			break;
+		if (child + 1 < sch_heap.size() && heap_less(sch_heap[child + 1], sch_heap[child]))
+			child++;
+		if (!heap_less(sch_heap[child], id))
+			break;
+		heap_set(pos, sch_heap[child]);
+		pos = child;
+	}
+	heap_set(pos, id);
+}
+
+static void heap_remove(size_t id)
 {
-	u32 diff=-1;
-	int slot=-1;
+	int pos = sch_list[id].heap_pos;
+	if (pos == -1)
+		return;
+	sch_list[id].heap_pos = -1;
+	int last = sch_heap.back();
+	sch_heap.pop_back();
+	if ((size_t)pos < sch_heap.size())
+	{
+		heap_set(pos, last);
+		heap_sift_up(pos);
+		heap_sift_down(sch_list[last].heap_pos);
+	}
+}
 
-	for (size_t i=0;i<sch_list.size();i++)
+static void heap_update(size_t id)
+{
+	int pos = sch_list[id].heap_pos;
+	if (pos == -1)
 	{
-		if (sh4_sched_remaining(i)<diff)
-		{
-			slot=i;
-			diff=sh4_sched_remaining(i);
-		}
+		sch_heap.push_back(id);
+		heap_sift_up(sch_heap.size() - 1);
+	}
+	else
+	{
+		heap_sift_up(pos);
+		heap_sift_down(sch_list[id].heap_pos);
 	}
+}
 
+static void sh4_sched_update_next()
+{
 	sh4_sched_ffb-=Sh4cntx.sh4_sched_next;
 
-	sh4_sched_next_id=slot;
-	if (slot!=-1)
-		Sh4cntx.sh4_sched_next=diff;
+	if (!sch_heap.empty())
+	{
+		u64 deadline = sch_list[sch_heap[0]].deadline;
+		Sh4cntx.sh4_sched_next = deadline > sh4_sched_ffb ? (int)(deadline - sh4_sched_ffb) : 0;
+	}
 	else
 		Sh4cntx.sh4_sched_next=SH4_MAIN_CLOCK;
 
 	sh4_sched_ffb+=Sh4cntx.sh4_sched_next;
 }
 
+/*
+	Rebuild the heap from the 32-bit end times, as restored by dc_unserialize
+*/
+void sh4_sched_ffts()
+{
+	u64 now = sh4_sched_now64();
+
+	sch_heap.clear();
+	for (size_t i = 0; i < sch_list.size(); i++)
+	{
+		sch_list[i].heap_pos = -1;
+		if (sch_list[i].end != -1)
+		{
+			sch_list[i].deadline = now + (s32)(sch_list[i].end - (u32)now);
+			heap_update(i);
+		}
+	}
+	sh4_sched_update_next();
+}
+
 int sh4_sched_register(int tag, sh4_sched_callback* ssc)
 {
-	sched_list t={ssc,tag,-1,-1};
+	sched_list t={ssc,tag,-1,-1,0,-1};
 
 	sch_list.push_back(t);
 
@@ -94,20 +170,24 @@ void sh4_sched_request(size_t id, int cycles)
 {
 	verify(cycles== -1 || (cycles >= 0 && cycles <= SH4_MAIN_CLOCK));
 
-	sch_list[id].start=sh4_sched_now();
+	u64 now = sh4_sched_now64();
+	sch_list[id].start = now;
 
 	if (cycles == -1)
 	{
 		sch_list[id].end = -1;
+		heap_remove(id);
 	}
 	else
 	{
 		sch_list[id].end = sch_list[id].start + cycles;
 		if (sch_list[id].end == -1)
 			sch_list[id].end++;
+		sch_list[id].deadline = now + cycles;
+		heap_update(id);
 	}
 
-	sh4_sched_ffts();
+	sh4_sched_update_next();
 }
 
 /* Returns how much time has passed for this callback */
@@ -136,6 +216,25 @@ static void handle_cb(size_t id)
 		sh4_sched_request(id, std::max(0, re_sch - jitter));
 }
 
+// Moves the callbacks expiring by now from the heap to the pending list if their id is above
+// the one being run, or to the deferred list otherwise
+static void sh4_sched_take_expired(u64 now, int running, size_t next_pos)
+{
+	while (!sch_heap.empty() && sch_list[sch_heap[0]].deadline <= now)
+	{
+		int id = sch_heap[0];
+		heap_remove(id);
+		if (id > running)
+		{
+			auto it = std::lower_bound(sch_expired.begin() + next_pos, sch_expired.end(), id);
+			if (it == sch_expired.end() || *it != id)
+				sch_expired.insert(it, id);
+		}
+		else
+			sch_deferred.push_back(id);
+	}
+}
+
 void sh4_sched_tick(int cycles)
 {
 	/*
@@ -145,17 +244,26 @@ void sh4_sched_tick(int cycles)
 
 	if (Sh4cntx.sh4_sched_next<0)
 	{
-		u32 fztime=sh4_sched_now()-cycles;
-		if (sh4_sched_next_id!=-1)
+		u64 now = sh4_sched_now64();
+
+		// Expired callbacks run in id order, like the linear scan did:
+		// a callback armed to expire now by a callback with a lower id runs in the same tick,
+		// otherwise it runs on the next one.
+		sch_expired.clear();
+		sch_deferred.clear();
+		sh4_sched_take_expired(now, -1, 0);
+		for (size_t i = 0; i < sch_expired.size(); i++)
 		{
-			for (size_t i = 0; i < sch_list.size(); i++)
-			{
-				u32 remaining = sh4_sched_remaining(i, fztime);
-				verify(remaining >= 0 || remaining == -1);
-				if (remaining >= 0 && remaining <= (u32)cycles)
-					handle_cb(i);
-			}
+			int id = sch_expired[i];
+			// skip callbacks cancelled or re-armed for later by a previous callback
+			if (sch_list[id].end == -1 || sch_list[id].heap_pos != -1)
+				continue;
+			handle_cb(id);
+			sh4_sched_take_expired(now, id, i + 1);
 		}
-		sh4_sched_ffts();
+		for (int id : sch_deferred)
+			if (sch_list[id].end != -1 && sch_list[id].heap_pos == -1)
+				heap_update(id);
+		sh4_sched_update_next();
 	}
 }
@@ -42,6 +42,9 @@ void sh4_sched_request(size_t id, int cycles);
 */
 void sh4_sched_tick(int cycles);
 
+/*
+	Recompute the pending events from their end times, after loading a state
+*/
 void sh4_sched_ffts();
 
 struct sched_list
@@ -50,6 +53,8 @@ struct sched_list
 	int tag;
 	int start;
 	int end;
+	u64 deadline;	// 64-bit end time, valid when end != -1
+	int heap_pos;	// position in the pending heap, -1 if not armed
 };
 
 #endif //SH4_SCHED_H
@@ -21,6 +21,12 @@ void libGDR_ReadSector(u8 * buff,u32 StartSector,u32 SectorCount,u32 secsz)
 	//	CurrDrive->ReadSector(buff,StartSector,SectorCount,secsz);
 }
 
+void libGDR_ReadAhead(u32 StartSector,u32 SectorCount)
+{
+	if (disc != NULL)
+		disc->ReadAhead(StartSector, SectorCount);
+}
+
 void libGDR_GetToc(u32* toc,u32 area)
 {
 	GetDriveToc(toc,(DiskArea)area);
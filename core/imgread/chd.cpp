@@ -1,36 +1,245 @@
 #include "common.h"
+#include "stdclass.h"
 
 #include "deps/chdr/chd.h"
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 /* tracks are padded to a multiple of this many frames */
 const uint32_t CD_TRACK_PADDING = 4;
 
+// Decompressed hunks kept in memory
+const u32 CHD_CACHE_HUNKS = 64;
+// Hunks decompressed ahead of sequential reads
+const u32 CHD_PREFETCH_HUNKS = 8;
+
 struct CHDDisc : Disc
 {
 	chd_file* chd;
-	u8* hunk_mem;
-	u32 old_hunk;
-
 	u32 hunkbytes;
+	u32 hunkcount;
 	u32 sph;
 
-	CHDDisc()
+	struct CachedHunk
+	{
+		u32 hunk;		// ~0 if unused
+		u32 lastUse;
+		u8* data;
+	};
+	std::vector<CachedHunk> cache;
+	u32 useCounter;
+	u8* readBuffer;			// decompression buffer of the emulator thread
+	u32 lastHunk;
+
+	// chdMutex serializes the access to the chd file, cacheMutex protects the cache and the prefetch request.
+	// chdMutex is always locked first.
+	std::mutex chdMutex;
+	std::mutex cacheMutex;
+
+	cThread prefetchThread;
+	cResetEvent prefetchEvent;
+	std::atomic<bool> prefetchRunning;
+	u32 prefetchHunk;
+	u32 prefetchCount;
+	s32 prefetchStep;
+
+	CHDDisc() : prefetchThread(PrefetchThread, this)
 	{
 		chd=0;
-		hunk_mem=0;
+		readBuffer=0;
+		useCounter=0;
+		lastHunk=~0u;
+		prefetchRunning=false;
+		prefetchHunk=0;
+		prefetchCount=0;
+		prefetchStep=1;
 	}
 
 	bool TryOpen(const char* file);
+	// Calls read with the decompressed data of the hunk
+	template<typename F>
+	void ReadHunk(u32 hunk, F read);
+	virtual void ReadAhead(u32 FAD, u32 count) override;
 
 	~CHDDisc()
 	{
-		delete[] hunk_mem;
+		if (prefetchRunning)
+		{
+			prefetchRunning = false;
+			prefetchEvent.Set();
+			prefetchThread.WaitToEnd();
+		}
+		for (CachedHunk& cached : cache)
+			delete[] cached.data;
+		delete[] readBuffer;
 
 		if (chd)
 			chd_close(chd);
 	}
+
+private:
+	CachedHunk* FindHunk(u32 hunk);
+	CachedHunk* InsertHunk(u32 hunk, u8*& buffer);
+	void Decompress(u32 hunk, u8* buffer);
+	void RequestPrefetch(u32 hunk, u32 count, s32 step);
+	void Prefetch();
+
+	static void* PrefetchThread(void* param)
+	{
+		((CHDDisc*)param)->Prefetch();
+		return nullptr;
+	}
 };
 
+// Returns the cached hunk and marks it as recently used. Must be called with cacheMutex locked.
+CHDDisc::CachedHunk* CHDDisc::FindHunk(u32 hunk)
+{
+	for (CachedHunk& cached : cache)
+		if (cached.hunk == hunk)
+		{
+			cached.lastUse = ++useCounter;
+			return &cached;
+		}
+	return nullptr;
+}
+
+// Replaces the least recently used hunk with the decompressed one. The buffers are swapped.
+// Must be called with cacheMutex locked.
+CHDDisc::CachedHunk* CHDDisc::InsertHunk(u32 hunk, u8*& buffer)
+{
+	CachedHunk* victim = &cache[0];
+	for (CachedHunk& cached : cache)
+		if (cached.lastUse < victim->lastUse)
+			victim = &cached;
+	std::swap(victim->data, buffer);
+	victim->hunk = hunk;
+	victim->lastUse = ++useCounter;
+	return victim;
+}
+
+// Must be called with chdMutex locked
+void CHDDisc::Decompress(u32 hunk, u8* buffer)
+{
+	chd_error err = chd_read(chd, hunk, buffer);
+	if (err != CHDERR_NONE)
+	{
+		WARN_LOG(GDROM, "chd: chd_read failed for hunk %d: %d", hunk, err);
+		memset(buffer, 0, hunkbytes);
+	}
+}
+
+template<typename F>
+void CHDDisc::ReadHunk(u32 hunk, F read)
+{
+	std::unique_lock<std::mutex> lock(cacheMutex);
+	CachedHunk* cached = FindHunk(hunk);
+	if (cached == nullptr)
+	{
+		lock.unlock();
+		std::lock_guard<std::mutex> chdLock(chdMutex);
+		lock.lock();
+		// The prefetch thread may have decompressed it in the meantime
+		cached = FindHunk(hunk);
+		if (cached == nullptr)
+		{
+			lock.unlock();
+			Decompress(hunk, readBuffer);
+			lock.lock();
+			cached = InsertHunk(hunk, readBuffer);
+		}
+	}
+	read((const u8*)cached->data);
+	lock.unlock();
+
+	if (hunk != lastHunk)
+	{
+		// Decompress ahead of sequential reads, in either direction
+		if (hunk == lastHunk + 1)
+			RequestPrefetch(hunk + 1, CHD_PREFETCH_HUNKS, 1);
+		else if (hunk == lastHunk - 1)
+			RequestPrefetch(hunk - 1, CHD_PREFETCH_HUNKS, -1);
+		lastHunk = hunk;
+	}
+}
+
+// Replaces the pending prefetch request, if any
+void CHDDisc::RequestPrefetch(u32 hunk, u32 count, s32 step)
+{
+	if (hunk >= hunkcount)
+		return;
+	if (step > 0)
+		count = std::min(count, hunkcount - hunk);
+	else
+		count = std::min(count, hunk + 1);
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	prefetchHunk = hunk;
+	prefetchCount = count;
+	prefetchStep = step;
+	prefetchEvent.Set();
+}
+
+void CHDDisc::Prefetch()
+{
+	u8* buffer = new u8[hunkbytes];
+	while (prefetchRunning)
+	{
+		u32 hunk = ~0u;
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			if (prefetchCount > 0)
+			{
+				hunk = prefetchHunk;
+				prefetchHunk += prefetchStep;
+				prefetchCount--;
+			}
+		}
+		if (hunk == ~0u)
+		{
+			prefetchEvent.Wait();
+			continue;
+		}
+		std::lock_guard<std::mutex> chdLock(chdMutex);
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			if (FindHunk(hunk) != nullptr)
+				continue;
+		}
+		Decompress(hunk, buffer);
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		InsertHunk(hunk, buffer);
+	}
+	delete[] buffer;
+}
+
+// Copies 16-bit words with their bytes swapped
+static void SwapBytes(u8* dst, const u8* src, u32 len)
+{
+	u32 i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+	}
+#elif defined(__aarch64__)
+	for (; i + 16 <= len; i += 16)
+		vst1q_u8(dst + i, vrev16q_u8(vld1q_u8(src + i)));
+#endif
+	for (; i < len; i += 2)
+	{
+		dst[i] = src[i + 1];
+		dst[i + 1] = src[i];
+	}
+}
+
 struct CHDTrack : TrackFile
 {
 	CHDDisc* disc;
@@ -52,33 +261,69 @@ struct CHDTrack : TrackFile
 	{
 		u32 fad_offs = FAD + Offset;
 		u32 hunk=(fad_offs)/disc->sph;
-		if (disc->old_hunk!=hunk)
-		{
-			chd_read(disc->chd,hunk,disc->hunk_mem); //CHDERR_NONE
-			disc->old_hunk = hunk;
-		}
-
 		u32 hunk_ofs = fad_offs%disc->sph;
 
-		memcpy(dst, disc->hunk_mem + hunk_ofs * (2352+96), fmt);
-
-		if (swap_bytes)
-		{
-			for (u32 i = 0; i < fmt; i += 2)
-			{
-				u8 b = dst[i];
-				dst[i] = dst[i + 1];
-				dst[i + 1] = b;
-			}
-		}
+		disc->ReadHunk(hunk, [&](const u8* data) {
+			const u8* sector = data + hunk_ofs * (2352+96);
+			if (swap_bytes)
+				SwapBytes(dst, sector, fmt);
+			else
+				memcpy(dst, sector, fmt);
+		});
 		*sector_type=fmt==2352?SECFMT_2352:SECFMT_2048_MODE1;
 
 		//While space is reserved for it, the images contain no actual subcodes
 		//memcpy(subcode,disc->hunk_mem+hunk_ofs*(2352+96)+2352,96);
 		*subcode_type=SUBFMT_NONE;
 	}
+
+	virtual u32 ReadSectors(u32 FAD, u32 count, u8* dst, u32 secfmt)
+	{
+		// Audio sectors are only read raw
+		if (!CanConvertSectors(fmt, secfmt) || (swap_bytes && secfmt != fmt))
+			return 0;
+
+		for (u32 done = 0; done < count; )
+		{
+			u32 fad_offs = FAD + done + Offset;
+			u32 hunk = fad_offs / disc->sph;
+			u32 hunk_ofs = fad_offs % disc->sph;
+			u32 sectors = std::min(count - done, disc->sph - hunk_ofs);
+
+			disc->ReadHunk(hunk, [&](const u8* data) {
+				for (u32 i = 0; i < sectors; i++)
+				{
+					const u8* sector = data + (hunk_ofs + i) * (2352+96);
+					u8* out = dst + (done + i) * secfmt;
+					if (swap_bytes)
+						SwapBytes(out, sector, fmt);
+					else
+						ConvertSectors(sector, out, fmt, secfmt, 1, FAD + done + i);
+				}
+			});
+			done += sectors;
+		}
+		return count;
+	}
 };
 
+void CHDDisc::ReadAhead(u32 FAD, u32 count)
+{
+	if (count == 0)
+		return;
+	for (const Track& track : tracks)
+	{
+		if (FAD < track.StartFAD || FAD > track.EndFAD)
+			continue;
+		CHDTrack* chdTrack = (CHDTrack*)track.file;
+		u32 lastFAD = std::min(FAD + count - 1, track.EndFAD);
+		u32 firstHunk = (FAD + chdTrack->Offset) / sph;
+		u32 hunks = (lastFAD + chdTrack->Offset) / sph - firstHunk + 1;
+		RequestPrefetch(firstHunk, std::min(hunks, CHD_PREFETCH_HUNKS), 1);
+		break;
+	}
+}
+
 bool CHDDisc::TryOpen(const char* file)
 {
 	chd_error err=chd_open(file,CHD_OPEN_READ,0,&chd);
@@ -94,8 +339,15 @@ bool CHDDisc::TryOpen(const char* file)
 	const chd_header* head = chd_get_header(chd);
 
 	hunkbytes = head->hunkbytes;
-	hunk_mem = new u8[hunkbytes];
-	old_hunk=0xFFFFFFF;
+	hunkcount = head->totalhunks;
+	readBuffer = new u8[hunkbytes];
+	cache.resize(CHD_CACHE_HUNKS);
+	for (CachedHunk& cached : cache)
+	{
+		cached.hunk = ~0u;
+		cached.lastUse = 0;
+		cached.data = new u8[hunkbytes];
+	}
 
 	sph = hunkbytes/(2352+96);
 
@@ -176,6 +428,9 @@ bool CHDDisc::TryOpen(const char* file)
 
 	FillGDSession();
 
+	prefetchRunning = true;
+	prefetchThread.Start();
+
 	return true;
 }
 
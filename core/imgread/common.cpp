@@ -112,6 +112,24 @@ bool ConvertSector(u8* in_buff , u8* out_buff , int from , int to,int sector)
 	return true;
 }
 
+bool CanConvertSectors(u32 from, u32 to)
+{
+	if (from == to)
+		return to == 2048 || to == 2352;
+	if (to == 2048)
+		return from == 2352 || from == 2336 || from == 2448;
+	return from == 2352 && (to == 2340 || to == 2336 || to == 2328);
+}
+
+void ConvertSectors(const u8* in_buff, u8* out_buff, u32 from, u32 to, u32 count, u32 sector)
+{
+	if (from == to)
+		memcpy(out_buff, in_buff, count * to);
+	else
+		for (u32 i = 0; i < count; i++)
+			ConvertSector((u8*)in_buff + i * from, out_buff + i * to, from, to, sector + i);
+}
+
 Disc* OpenDisc(const char* fn)
 {
 	Disc* rv = NULL;
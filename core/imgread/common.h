@@ -1,5 +1,6 @@
 #pragma once
 #include "types.h"
+#include <algorithm>
 #include <vector>
 
 #include "deps/coreio/coreio.h"
@@ -83,6 +84,9 @@ enum SubcodeFormat
 };
 
 bool ConvertSector(u8* in_buff , u8* out_buff , int from , int to,int sector);
+// Conversions of whole sector runs, for the format pairs Disc::ReadSectors supports
+bool CanConvertSectors(u32 from, u32 to);
+void ConvertSectors(const u8* in_buff, u8* out_buff, u32 from, u32 to, u32 count, u32 sector);
 
 bool InitDrive();
 void TermDrive();
@@ -111,6 +115,10 @@ struct Session
 struct TrackFile
 {
 	virtual void Read(u32 FAD,u8* dst,SectorFormat* sector_type,u8* subcode,SubcodeFormat* subcode_type)=0;
+	// Reads up to count sectors converted to fmt. Returns the number of sectors read, 0 if not supported
+	virtual u32 ReadSectors(u32 FAD,u32 count,u8* dst,u32 fmt) { return 0; }
+	// Hint that the given sectors will be read soon
+	virtual void ReadAhead(u32 FAD,u32 count) { }
 	virtual ~TrackFile() {};
 };
 
@@ -130,9 +138,13 @@ struct Track
 		CTRL = 0;
 		ADDR = 0;
 	}
+	bool Contains(u32 FAD)
+	{
+		return FAD>=StartFAD && (FAD<=EndFAD || EndFAD==0) && file;
+	}
 	bool Read(u32 FAD,u8* dst,SectorFormat* sector_type,u8* subcode,SubcodeFormat* subcode_type)
 	{
-		if (FAD>=StartFAD && (FAD<=EndFAD || EndFAD==0) && file)
+		if (Contains(FAD))
 		{
 			file->Read(FAD,dst,sector_type,subcode,subcode_type);
 			return true;
@@ -165,6 +177,22 @@ struct Disc
 		return false;
 	}
 
+	// Reads a run of sectors from a single track in one go, if its file supports it
+	u32 ReadTrackSectors(u32 FAD,u32 count,u8* dst,u32 fmt)
+	{
+		for (size_t i=tracks.size();i-->0;)
+		{
+			if (tracks[i].Contains(FAD))
+			{
+				if (tracks[i].EndFAD != 0)
+					count = std::min(count, tracks[i].EndFAD - FAD + 1);
+				return tracks[i].file->ReadSectors(FAD,count,dst,fmt);
+			}
+		}
+
+		return 0;
+	}
+
 	void ReadSectors(u32 FAD,u32 count,u8* dst,u32 fmt)
 	{
 		u8 temp[2448];
@@ -188,6 +216,15 @@ struct Disc
 					gui_display_notification(status_str, 2000);
 				}
 			}
+			// Runs are limited to keep reporting the progress
+			u32 read = ReadTrackSectors(FAD, std::min(count - i + 1, 1024u), dst, fmt);
+			if (read > 0)
+			{
+				dst += read * fmt;
+				FAD += read;
+				i += read - 1;
+				continue;
+			}
 			if (ReadSector(FAD,temp,&secfmt,q_subchannel,&subfmt))
 			{
 				//TODO: Proper sector conversions
@@ -225,6 +262,19 @@ struct Disc
 			FAD++;
 		}
 	}
+	// Hint that the given sectors will be read soon
+	virtual void ReadAhead(u32 FAD, u32 count)
+	{
+		for (size_t i=tracks.size();i-->0;)
+		{
+			if (tracks[i].Contains(FAD))
+			{
+				tracks[i].file->ReadAhead(FAD,count);
+				break;
+			}
+		}
+	}
+
 	virtual ~Disc() 
 	{
 		for (size_t i=0;i<tracks.size();i++)
@@ -285,6 +335,8 @@ struct RawTrackFile : TrackFile
 	s32 offset;
 	u32 fmt;
 	bool cleanup;
+	const u8* data;		// mapped file, or NULL
+	size_t size;
 
 	RawTrackFile(core_file* file,u32 file_offs,u32 first_fad,u32 secfmt)
 	{
@@ -293,6 +345,8 @@ struct RawTrackFile : TrackFile
 		this->offset=file_offs-first_fad*secfmt;
 		this->fmt=secfmt;
 		this->cleanup=true;
+		this->size=0;
+		this->data=(const u8*)core_fmap(file,&size);
 	}
 
 	virtual void Read(u32 FAD,u8* dst,SectorFormat* sector_type,u8* subcode,SubcodeFormat* subcode_type)
@@ -311,8 +365,47 @@ struct RawTrackFile : TrackFile
 			verify(false);
 		}
 
-		core_fseek(file,offset+FAD*fmt,SEEK_SET);
-		core_fread(file, dst, fmt);
+		size_t pos=(u32)(offset+FAD*fmt);
+		if (data!=NULL && pos+fmt<=size)
+			memcpy(dst,data+pos,fmt);
+		else
+		{
+			core_fseek(file,offset+FAD*fmt,SEEK_SET);
+			core_fread(file, dst, fmt);
+		}
+	}
+
+	virtual u32 ReadSectors(u32 FAD,u32 count,u8* dst,u32 secfmt)
+	{
+		if (!CanConvertSectors(fmt,secfmt))
+			return 0;
+		size_t pos=(u32)(offset+FAD*fmt);
+		if (data!=NULL)
+		{
+			if (pos>=size)
+				return 0;
+			count=std::min(count,(u32)((size-pos)/fmt));
+			ConvertSectors(data+pos,dst,fmt,secfmt,count,FAD);
+		}
+		else if (secfmt==fmt)
+		{
+			core_fseek(file,pos,SEEK_SET);
+			core_fread(file,dst,count*fmt);
+		}
+		else
+		{
+			u8 temp[16*2448];
+			count=std::min(count,16u);
+			core_fseek(file,pos,SEEK_SET);
+			core_fread(file,temp,count*fmt);
+			ConvertSectors(temp,dst,fmt,secfmt,count,FAD);
+		}
+		return count;
+	}
+
+	virtual void ReadAhead(u32 FAD,u32 count)
+	{
+		core_fadvise(file,(u32)(offset+FAD*fmt),(size_t)count*fmt);
 	}
 	virtual ~RawTrackFile()
 	{
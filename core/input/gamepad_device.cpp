@@ -22,6 +22,7 @@
 #include "oslib/oslib.h"
 #include "rend/gui.h"
 #include "emulator.h"
+#include "rewind.h"
 
 #include <algorithm>
 #include <climits>
@@ -122,6 +123,9 @@ bool GamepadDevice::gamepad_btn_input(u32 code, bool pressed)
 				if (pressed)
 					fast_forward_mode = !fast_forward_mode;
 				break;
+			case EMU_BTN_REWIND:
+				rewind_set_active(pressed);
+				break;
 			case EMU_BTN_TRIGGER_LEFT:
 				lt[port] = pressed ? 255 : 0;
 				break;
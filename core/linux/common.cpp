@@ -25,6 +25,8 @@ bool ngen_Rewrite(unat& addr,unat retadr,unat acc);
 u32* ngen_readm_fail_v2(u32* ptr,u32* regs,u32 saddr);
 bool VramLockedWrite(u8* address);
 bool BM_LockedWrite(u8* address);
+bool naomi_cart_PageIn(void *address);
+bool vmem_snapshot_write_fault(void *address);
 
 #if defined(__APPLE__)
 void sigill_handler(int sn, siginfo_t * si, void *segfault_ctx) {
@@ -62,10 +64,14 @@ void fault_handler (int sn, siginfo_t * si, void *segfault_ctx)
 	if (vmem32_handle_signal(si->si_addr, write, exception_pc))
 		return;
 #endif
+	if (vmem_snapshot_write_fault(si->si_addr))
+		return;
 	if (bm_RamWriteAccess(si->si_addr))
 		return;
 	if (VramLockedWrite((u8*)si->si_addr) || BM_LockedWrite((u8*)si->si_addr))
 		return;
+	if (naomi_cart_PageIn(si->si_addr))
+		return;
 	#if FEAT_SHREC == DYNAREC_JIT
 		#if HOST_CPU==CPU_ARM
 			else if (dyna_cde)
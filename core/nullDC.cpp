@@ -32,6 +32,8 @@
 #include "hw/sh4/dyna/blockmanager.h"
 #include "log/LogManager.h"
 #include "cheats.h"
+#include "rewind.h"
+#include "savestate.h"
 #include "rend/CustomTexture.h"
 #include "hw/maple/maple_devs.h"
 #include "network/naomi_network.h"
@@ -50,6 +52,7 @@ static bool extra_depth_game;
 static bool disable_vmem32_game;
 static int forced_game_region = -1;
 static int forced_game_cable = -1;
+static int forced_load_timing = -1;
 static int saved_screen_stretching = -1;
 
 cThread emu_thread(&dc_run, NULL);
@@ -95,6 +98,17 @@ static void plugins_Reset(bool hard)
 	//libExtDevice_Reset(Manual);
 }
 
+struct LoadTimingGame
+{
+	const char *prod_id;
+	GDRomTiming timing;
+};
+// Games that break with a GD-ROM load timing, by product id. The per-game config overrides it.
+static const LoadTimingGame load_timing_games[] = {
+	// Shenmue (US): streams cutscene audio and FMVs from the disc and needs real drive timing
+	{ "MK-51059", GDRomTiming::Accurate },
+};
+
 static void LoadSpecialSettings()
 {
 	if (settings.platform.system == DC_PLATFORM_DREAMCAST)
@@ -108,6 +122,7 @@ static void LoadSpecialSettings()
 		tr_poly_depth_mask_game = false;
 		extra_depth_game = false;
 		disable_vmem32_game = false;
+		forced_load_timing = -1;
 		forced_game_region = -1;
 		forced_game_cable = -1;
 
@@ -202,6 +217,13 @@ static void LoadSpecialSettings()
 			settings.dynarec.disable_vmem32 = true;
 			disable_vmem32_game = true;
 		}
+		for (const auto& game : load_timing_games)
+			if (!strncmp(game.prod_id, prod_id, strlen(game.prod_id)))
+			{
+				INFO_LOG(BOOT, "Using GD-ROM load timing %d for game %s", (int)game.timing, prod_id);
+				settings.imgread.LoadTiming = game.timing;
+				forced_load_timing = (int)game.timing;
+			}
 		std::string areas(ip_meta.area_symbols, sizeof(ip_meta.area_symbols));
 		bool region_usa = areas.find('U') != std::string::npos;
 		bool region_eu = areas.find('E') != std::string::npos;
@@ -391,6 +413,7 @@ void dc_reset(bool hard)
 	mem_Reset(hard);
 
 	sh4_cpu.Reset(hard);
+	rewind_reset();
 }
 
 static bool reset_requested;
@@ -661,7 +684,7 @@ void* dc_run(void*)
    		{
    			dc_reset(false);
    		}
-	} while (reset_requested);
+	} while (reset_requested || rewind_run());
 
     TermAudio();
 
@@ -672,6 +695,7 @@ void* dc_run(void*)
 void dc_term()
 {
 	dc_cancel_load();
+	savestate_wait();
 	sh4_cpu.Term();
 	if (settings.platform.system != DC_PLATFORM_DREAMCAST)
 		naomi_cart_Close();
@@ -711,6 +735,10 @@ void InitSettings()
 	settings.dynarec.unstable_opt	= false;
 	settings.dynarec.safemode		= false;
 	settings.dynarec.disable_vmem32	= false;
+	settings.dynarec.vmem32_batch_remap = false;
+	settings.dynarec.vmem32_prefault = false;
+	settings.dynarec.block_cache	= false;
+	settings.dynarec.superblocks	= false;
 	settings.dreamcast.cable		= 3;	// TV composite
 	settings.dreamcast.region		= 3;	// default
 	settings.dreamcast.broadcast	= 4;	// default
@@ -718,6 +746,9 @@ void InitSettings()
 	settings.dreamcast.FullMMU      = false;
 	settings.dreamcast.ForceWindowsCE = false;
 	settings.dreamcast.HideLegacyNaomiRoms = true;
+	settings.imgread.LoadTiming		= GDRomTiming::Default;
+	settings.rewind.Enable			= false;
+	settings.rewind.BufferSize		= 64;
 	settings.aica.DSPEnabled		= false;
 	settings.aica.LimitFPS			= true;
 	settings.aica.NoBatch			= false;
@@ -750,6 +781,7 @@ void InitSettings()
 
 	settings.pvr.MaxThreads		    = 3;
 	settings.pvr.SynchronousRender	= true;
+	settings.pvr.RenderQueueDepth	= 2;
 
 	settings.debug.SerialConsole	= false;
 	settings.debug.SerialPTY        = false;
@@ -801,6 +833,10 @@ void LoadSettings(bool game_specific)
 	settings.dynarec.unstable_opt	= cfgLoadBool(config_section, "Dynarec.unstable-opt", settings.dynarec.unstable_opt);
 	settings.dynarec.safemode		= cfgLoadBool(config_section, "Dynarec.safe-mode", settings.dynarec.safemode);
 	settings.dynarec.disable_vmem32 = cfgLoadBool(config_section, "Dynarec.DisableVmem32", settings.dynarec.disable_vmem32);
+	settings.dynarec.vmem32_batch_remap = cfgLoadBool(config_section, "Dynarec.Vmem32BatchRemap", settings.dynarec.vmem32_batch_remap);
+	settings.dynarec.vmem32_prefault = cfgLoadBool(config_section, "Dynarec.Vmem32Prefault", settings.dynarec.vmem32_prefault);
+	settings.dynarec.block_cache	= cfgLoadBool(config_section, "Dynarec.BlockCache", settings.dynarec.block_cache);
+	settings.dynarec.superblocks	= cfgLoadBool(config_section, "Dynarec.Superblocks", settings.dynarec.superblocks);
 	//disable_nvmem can't be loaded, because nvmem init is before cfg load
 	settings.dreamcast.cable		= cfgLoadInt(config_section, "Dreamcast.Cable", settings.dreamcast.cable);
 	settings.dreamcast.region		= cfgLoadInt(config_section, "Dreamcast.Region", settings.dreamcast.region);
@@ -810,6 +846,11 @@ void LoadSettings(bool game_specific)
 	settings.dreamcast.ForceWindowsCE = cfgLoadBool(config_section, "Dreamcast.ForceWindowsCE", settings.dreamcast.ForceWindowsCE);
 	if (settings.dreamcast.ForceWindowsCE)
 		settings.aica.NoBatch = true;
+	settings.imgread.LoadTiming		= (GDRomTiming)cfgLoadInt(config_section, "GDROM.LoadTiming", (int)settings.imgread.LoadTiming);
+	if ((u32)settings.imgread.LoadTiming > (u32)GDRomTiming::Instant)
+		settings.imgread.LoadTiming = GDRomTiming::Default;
+	settings.rewind.Enable			= cfgLoadBool(config_section, "Rewind.Enable", settings.rewind.Enable);
+	settings.rewind.BufferSize		= cfgLoadInt(config_section, "Rewind.BufferSize", settings.rewind.BufferSize);
 	settings.aica.LimitFPS			= cfgLoadBool(config_section, "aica.LimitFPS", settings.aica.LimitFPS)
 			|| cfgLoadInt(config_section, "aica.LimitFPS", 0) == 2;
 	settings.aica.DSPEnabled		= cfgLoadBool(config_section, "aica.DSPEnabled", settings.aica.DSPEnabled);
@@ -853,6 +894,7 @@ void LoadSettings(bool game_specific)
 
 	settings.pvr.MaxThreads		    = cfgLoadInt(config_section, "pvr.MaxThreads", settings.pvr.MaxThreads);
 	settings.pvr.SynchronousRender	= cfgLoadBool(config_section, "pvr.SynchronousRendering", settings.pvr.SynchronousRender);
+	settings.pvr.RenderQueueDepth	= cfgLoadInt(config_section, "pvr.RenderQueueDepth", settings.pvr.RenderQueueDepth);
 
 	settings.debug.SerialConsole	= cfgLoadBool(config_section, "Debug.SerialConsoleEnabled", settings.debug.SerialConsole);
 	settings.debug.SerialPTY		= cfgLoadBool(config_section, "Debug.SerialPTY", settings.debug.SerialPTY);
@@ -956,9 +998,15 @@ void SaveSettings()
 	if (forced_game_region == -1 || forced_game_region != (int)settings.dreamcast.region)
 		cfgSaveInt("config", "Dreamcast.Region", settings.dreamcast.region);
 	cfgSaveInt("config", "Dreamcast.Broadcast", settings.dreamcast.broadcast);
+	if (forced_load_timing == -1 || forced_load_timing != (int)settings.imgread.LoadTiming)
+		cfgSaveInt("config", "GDROM.LoadTiming", (int)settings.imgread.LoadTiming);
+	cfgSaveBool("config", "Rewind.Enable", settings.rewind.Enable);
+	cfgSaveInt("config", "Rewind.BufferSize", settings.rewind.BufferSize);
 	cfgSaveBool("config", "Dreamcast.ForceWindowsCE", settings.dreamcast.ForceWindowsCE);
 	cfgSaveBool("config", "Dynarec.idleskip", settings.dynarec.idleskip);
 	cfgSaveBool("config", "Dynarec.unstable-opt", settings.dynarec.unstable_opt);
+	cfgSaveBool("config", "Dynarec.BlockCache", settings.dynarec.block_cache);
+	cfgSaveBool("config", "Dynarec.Superblocks", settings.dynarec.superblocks);
 	if (!safemode_game || !settings.dynarec.safemode)
 		cfgSaveBool("config", "Dynarec.safe-mode", settings.dynarec.safemode);
 	cfgSaveBool("config", "bios.UseReios", settings.bios.UseReios);
@@ -1010,6 +1058,7 @@ void SaveSettings()
 
 	cfgSaveInt("config", "pvr.MaxThreads", settings.pvr.MaxThreads);
 	cfgSaveBool("config", "pvr.SynchronousRendering", settings.pvr.SynchronousRender);
+	cfgSaveInt("config", "pvr.RenderQueueDepth", settings.pvr.RenderQueueDepth);
 
 	cfgSaveBool("config", "Debug.SerialConsoleEnabled", settings.debug.SerialConsole);
 	cfgSaveBool("config", "Debug.SerialPTY", settings.debug.SerialPTY);
@@ -1058,12 +1107,6 @@ void dc_resume()
 		emu_thread.Start();
 }
 
-static void cleanup_serialize(void *data)
-{
-	if ( data != NULL )
-		free(data) ;
-}
-
 static std::string get_savestate_file_path(bool writable)
 {
 	std::string state_file = settings.imgread.ImagePath;
@@ -1089,69 +1132,57 @@ static std::string get_savestate_file_path(bool writable)
 
 void dc_savestate()
 {
-	std::string filename;
-	unsigned int total_size = 0 ;
-	void *data = NULL ;
-	void *data_ptr = NULL ;
-	FILE *f ;
-
 	dc_stop();
 
-	if ( ! dc_serialize(&data, &total_size) )
+	auto state = std::make_shared<StateSnapshot>();
+	std::vector<StateRange> sections;
+	if (!state->Capture(&sections))
 	{
-		WARN_LOG(SAVESTATE, "Failed to save state - could not initialize total size") ;
+		WARN_LOG(SAVESTATE, "Failed to save state - could not serialize data") ;
 		gui_display_notification("Save state failed", 2000);
-		cleanup_serialize(data) ;
-    	return;
-	}
-
-	data = malloc(total_size) ;
-	if ( data == NULL )
-	{
-		WARN_LOG(SAVESTATE, "Failed to save state - could not malloc %d bytes", total_size) ;
-		gui_display_notification("Save state failed - memory full", 2000);
-		cleanup_serialize(data) ;
     	return;
 	}
 
-	data_ptr = data ;
+	// Guest memory is copied, compressed and written in the background
+	savestate_write_async(get_savestate_file_path(true), state, std::move(sections));
+}
 
-	if ( ! dc_serialize(&data_ptr, &total_size) )
-	{
-		WARN_LOG(SAVESTATE, "Failed to save state - could not serialize data") ;
-		gui_display_notification("Save state failed", 2000);
-		cleanup_serialize(data) ;
-    	return;
-	}
+// Restores a serialized state. The emulator must be stopped.
+bool dc_restore_state(const void *data, u32 total_size)
+{
+	void *data_ptr = const_cast<void *>(data);
 
-	filename = get_savestate_file_path(true);
-	f = fopen(filename.c_str(), "wb") ;
+	custom_texture.Terminate();
+#if FEAT_AREC == DYNAREC_JIT
+    FlushCache();
+#endif
+#ifndef NO_MMU
+    mmu_flush_table();
+#endif
+	bm_Reset();
 
-	if ( f == NULL )
-	{
-		WARN_LOG(SAVESTATE, "Failed to save state - could not open %s for writing", filename.c_str()) ;
-		gui_display_notification("Cannot open save file", 2000);
-		cleanup_serialize(data) ;
-    	return;
-	}
+	u32 unserialized_size = 0;
+	if (!dc_unserialize(&data_ptr, &unserialized_size))
+		return false;
+	if (unserialized_size != total_size)
+		WARN_LOG(SAVESTATE, "Save state error: read %d bytes but used %d", total_size, unserialized_size);
 
-	fwrite(data, 1, total_size, f) ;
-	fclose(f);
+	mmu_set_state();
+	sh4_cpu.ResetCache();
+    dsp.dyndirty = true;
+    sh4_sched_ffts();
+    CalculateSync();
 
-	cleanup_serialize(data) ;
-	INFO_LOG(SAVESTATE, "Saved state to %s size %d", filename.c_str(), total_size) ;
-	gui_display_notification("State saved", 1000);
+	return true;
 }
 
 void dc_loadstate()
 {
     std::string filename;
-	unsigned int total_size = 0 ;
-	void *data = NULL ;
-	void *data_ptr = NULL ;
 	FILE *f ;
 
 	dc_stop();
+	savestate_wait();
 
 	filename = get_savestate_file_path(false);
 	f = fopen(filename.c_str(), "rb") ;
@@ -1160,61 +1191,27 @@ void dc_loadstate()
 	{
 		WARN_LOG(SAVESTATE, "Failed to load state - could not open %s for reading", filename.c_str()) ;
 		gui_display_notification("Save state not found", 2000);
-		cleanup_serialize(data) ;
     	return;
 	}
-	fseek(f, 0, SEEK_END);
-	total_size = ftell(f);
-	fseek(f, 0, SEEK_SET);
-	data = malloc(total_size) ;
-	if ( data == NULL )
-	{
-		WARN_LOG(SAVESTATE, "Failed to load state - could not malloc %d bytes", total_size) ;
-		gui_display_notification("Failed to load state - memory full", 2000);
-		cleanup_serialize(data) ;
-		return;
-	}
-
-	size_t read_size = fread(data, 1, total_size, f) ;
+	std::vector<u8> state;
+	bool read_ok = savestate_read(f, state);
 	fclose(f);
-	if (read_size != total_size)
+	if (!read_ok)
 	{
 		WARN_LOG(SAVESTATE, "Failed to load state - I/O error");
 		gui_display_notification("Failed to load state - I/O error", 2000);
-		cleanup_serialize(data) ;
 		return;
 	}
 
-	data_ptr = data ;
-
-	custom_texture.Terminate();
-#if FEAT_AREC == DYNAREC_JIT
-    FlushCache();
-#endif
-#ifndef NO_MMU
-    mmu_flush_table();
-#endif
-	bm_Reset();
-
-	u32 unserialized_size = 0;
-	if ( ! dc_unserialize(&data_ptr, &unserialized_size) )
+	if (!dc_restore_state(state.data(), state.size()))
 	{
 		WARN_LOG(SAVESTATE, "Failed to load state - could not unserialize data") ;
 		gui_display_notification("Invalid save state", 2000);
-		cleanup_serialize(data) ;
     	return;
 	}
-	if (unserialized_size != total_size)
-		WARN_LOG(SAVESTATE, "Save state error: read %d bytes but used %d", total_size, unserialized_size);
-
-	mmu_set_state();
-	sh4_cpu.ResetCache();
-    dsp.dyndirty = true;
-    sh4_sched_ffts();
-    CalculateSync();
+	rewind_reset();
 
-    cleanup_serialize(data) ;
-    INFO_LOG(SAVESTATE, "Loaded state from %s size %d", filename.c_str(), total_size) ;
+    INFO_LOG(SAVESTATE, "Loaded state from %s size %d", filename.c_str(), (int)state.size()) ;
 }
 
 void dc_load_game(const char *path)
@@ -1,12 +1,18 @@
 #include "audiostream.h"
 
 #include <chrono>
+#include <cstring>
+#include <mutex>
 #include <thread>
 
 using the_clock = std::chrono::high_resolution_clock;
 
 static the_clock::time_point last_time;
 
+static bool capture;
+static std::vector<u32> captured;
+static std::mutex capture_mutex;
+
 static void null_init()
 {
 	last_time = the_clock::time_point();
@@ -18,7 +24,14 @@ static void null_term()
 
 static u32 null_push(const void* frame, u32 samples, bool wait)
 {
-	if (wait)
+	if (capture)
+	{
+		std::lock_guard<std::mutex> lock(capture_mutex);
+		size_t size = captured.size();
+		captured.resize(size + samples);
+		memcpy(&captured[size], frame, samples * sizeof(u32));
+	}
+	else if (wait)
 	{
 		if (last_time.time_since_epoch() != the_clock::duration::zero())
 		{
@@ -33,6 +46,21 @@ static u32 null_push(const void* frame, u32 samples, bool wait)
 	return 1;
 }
 
+void NullAudioCapture(bool enable)
+{
+	std::lock_guard<std::mutex> lock(capture_mutex);
+	capture = enable;
+	captured.clear();
+}
+
+std::vector<u32> NullAudioCaptured()
+{
+	std::lock_guard<std::mutex> lock(capture_mutex);
+	std::vector<u32> frames;
+	frames.swap(captured);
+	return frames;
+}
+
 static audiobackend_t audiobackend_null = {
     "null", // Slug
     "No Audio", // Name
@@ -1,15 +1,35 @@
 #include "audiostream.h"
 #include "cfg/cfg.h"
+#include "stdclass.h"
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
 
 struct SoundFrame { s16 l;s16 r; };
 constexpr u32 SAMPLE_COUNT =  512;
 
-static SoundFrame RingBuffer[SAMPLE_COUNT];
+// Frames written by the emulator and pushed to the backend by the audio thread.
+// Single producer, single consumer: each pointer is only written by one side.
+constexpr u32 RING_SIZE = 4096;
+static SoundFrame RingBuffer[RING_SIZE];
 
-static u32 WritePtr;  //last WRITTEN sample
+static std::atomic<u32> WritePtr;	// next frame to write, free running
+static std::atomic<u32> ReadPtr;	// next frame to read, free running
+
+// Buffered frames the emulator waits for when limiting its speed, and the resampler aims at otherwise
+constexpr u32 TARGET_FILL = SAMPLE_COUNT * 2;
+// Maximum correction of the resampling ratio
+constexpr float MAX_DRIFT = 0.005f;
+
+static void *AudioThread(void *);
+static cThread audioThread(AudioThread, nullptr);
+static std::atomic<bool> audioThreadRunning;
+static cResetEvent dataAvailable;
+static cResetEvent spaceAvailable;
+
+static std::atomic<u32> underruns;
+static std::atomic<u32> overruns;
 
 static audiobackend_t *audiobackend_current = nullptr;
 static std::unique_ptr<std::vector<audiobackend_t *>> audiobackends;	// Using a pointer to avoid out of order init
@@ -79,23 +99,104 @@ audiobackend_t* GetAudioBackend(const std::string& slug)
 	return nullptr;
 }
 
-static u32 PushAudio(void* frame, u32 amt, bool wait)
+// Linear interpolation of two frames, pos is 16.16 fixed point
+static SoundFrame Interpolate(const SoundFrame& f0, const SoundFrame& f1, u32 pos)
 {
-	if (audiobackend_current != nullptr)
-		return audiobackend_current->push(frame, amt, wait);
+	SoundFrame frame;
+	frame.l = (s16)(f0.l + (((s32)f1.l - f0.l) * (s32)pos >> 16));
+	frame.r = (s16)(f0.r + (((s32)f1.r - f0.r) * (s32)pos >> 16));
+	return frame;
+}
 
-	return 0;
+static void *AudioThread(void *)
+{
+	SoundFrame buffer[SAMPLE_COUNT];
+	u32 pos = 0;	// 16.16 position between the current frame and the next one
+	bool starved = false;
+
+	while (audioThreadRunning)
+	{
+		u32 rptr = ReadPtr.load(std::memory_order_relaxed);
+		u32 fill = WritePtr.load(std::memory_order_acquire) - rptr;
+		u32 step = 0x10000;
+		if (!settings.aica.LimitFPS)
+		{
+			// The emulator isn't paced by the audio output: absorb the clock drift by resampling,
+			// slightly faster when frames accumulate and slower when they run out
+			float drift = std::max(-1.f, std::min(1.f, ((float)fill - TARGET_FILL) / TARGET_FILL));
+			step = (u32)(0x10000 * (1.f + drift * MAX_DRIFT));
+		}
+		// frames read to produce a block, including the next frame to interpolate with
+		if (fill < ((pos + SAMPLE_COUNT * step) >> 16) + 1)
+		{
+			if (!starved)
+				underruns++;
+			starved = true;
+			dataAvailable.Wait(20);
+			continue;
+		}
+		starved = false;
+
+		for (u32 i = 0; i < SAMPLE_COUNT; i++)
+		{
+			const SoundFrame& frame = RingBuffer[rptr % RING_SIZE];
+			buffer[i] = pos == 0 ? frame : Interpolate(frame, RingBuffer[(rptr + 1) % RING_SIZE], pos);
+			pos += step;
+			rptr += pos >> 16;
+			pos &= 0xFFFF;
+		}
+		ReadPtr.store(rptr, std::memory_order_release);
+		spaceAvailable.Set();
+
+		audiobackend_current->push(buffer, SAMPLE_COUNT, true);
+	}
+	return nullptr;
 }
 
 void WriteSample(s16 r, s16 l)
 {
-	const u32 ptr=(WritePtr+1)%SAMPLE_COUNT;
-	RingBuffer[ptr].r=r;
-	RingBuffer[ptr].l=l;
-	WritePtr=ptr;
+	static bool overrun;
 
-	if (WritePtr == SAMPLE_COUNT - 1)
-		PushAudio(RingBuffer,SAMPLE_COUNT, settings.aica.LimitFPS);
+	if (!audioThreadRunning)
+		return;
+	const u32 wptr = WritePtr.load(std::memory_order_relaxed);
+	while (wptr - ReadPtr.load(std::memory_order_acquire) >= (settings.aica.LimitFPS ? TARGET_FILL : RING_SIZE))
+	{
+		if (!settings.aica.LimitFPS)
+		{
+			// drop the frame
+			if (!overrun)
+				overruns++;
+			overrun = true;
+			return;
+		}
+		spaceAvailable.Wait(100);
+		if (!audioThreadRunning)
+			return;
+	}
+	overrun = false;
+	RingBuffer[wptr % RING_SIZE].r = r;
+	RingBuffer[wptr % RING_SIZE].l = l;
+	WritePtr.store(wptr + 1, std::memory_order_release);
+
+	if ((wptr + 1) % SAMPLE_COUNT == 0)
+		dataAvailable.Set();
+}
+
+u32 GetAudioLatency()
+{
+	u32 fill = WritePtr.load(std::memory_order_relaxed) - ReadPtr.load(std::memory_order_relaxed);
+	return fill * 1000 / 44100;
+}
+
+u32 GetAudioUnderruns()
+{
+	return underruns;
+}
+
+u32 GetAudioOverruns()
+{
+	return overruns;
 }
 
 void InitAudio()
@@ -120,11 +221,21 @@ void InitAudio()
 
 	INFO_LOG(AUDIO, "Initializing audio backend \"%s\" (%s)...", audiobackend_current->slug.c_str(), audiobackend_current->name.c_str());
 	audiobackend_current->init();
+
+	WritePtr = 0;
+	ReadPtr = 0;
+	dataAvailable.Reset();
+	spaceAvailable.Reset();
+	audioThreadRunning = true;
+	audioThread.Start();
 }
 
 void TermAudio()
 {
 	if (audiobackend_current != nullptr) {
+		audioThreadRunning = false;
+		dataAvailable.Set();
+		audioThread.WaitToEnd();
 		audiobackend_current->term();
 		INFO_LOG(AUDIO, "Terminating audio backend \"%s\" (%s)...", audiobackend_current->slug.c_str(), audiobackend_current->name.c_str());
 		audiobackend_current = nullptr;
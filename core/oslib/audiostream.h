@@ -39,6 +39,17 @@ extern bool RegisterAudioBackend(audiobackend_t* backend);
 extern void InitAudio();
 extern void TermAudio();
 
+// Audio output statistics: buffered audio in ms, and number of underrun and overrun episodes
+u32 GetAudioLatency();
+u32 GetAudioUnderruns();
+u32 GetAudioOverruns();
+
+// Makes the null backend record the frames it receives (left in the low 16 bits) instead of
+// waiting for their duration, so that it can be used as a deterministic sink in tests
+void NullAudioCapture(bool enable);
+// Returns the frames recorded since the last call
+std::vector<u32> NullAudioCaptured();
+
 u32 GetAudioBackendCount();
 audiobackend_t* GetAudioBackend(int num);
 audiobackend_t* GetAudioBackend(const std::string& slug);
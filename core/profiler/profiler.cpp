@@ -81,6 +81,11 @@ void prof_periodical()
 	print_blocks();
 #endif
 
+	// host time per emulated second
+	printf("ARM7: %.2f ms, %.1f%% of cycles idle, %u links\n", prof.counters.arm7.host_time * 1000.0,
+			prof.counters.arm7.idle_cycles * 100.0 / (44100 * 256), prof.counters.arm7.linked);
+	memset(&prof.counters.arm7, 0, sizeof(prof.counters.arm7));
+
 	return;
 
 	printf("TA_VTXC %d,TA_SPRC %d,TA_EOSC %d,TA_PPC %d,TA_SPC %d,TA_EOLC %d,TA_V64HC %d\n", TA_VTXC,TA_SPRC,TA_EOSC,TA_PPC,TA_SPC,TA_EOLC,TA_V64HC);
@@ -133,12 +133,28 @@ struct profiler_cfg
 			}
 		} blkrun;
 
+		struct
+		{
+			double host_time;	//seconds spent running the arm7
+			u64 idle_cycles;	//cycles skipped in idle loops
+			u32 linked;			//block exits linked to the next block
+
+			void print()
+			{
+				print_head("arm7");
+				printf("host_time=%.2fms;\n", host_time * 1000.0);
+				printf("idle_cycles=%llu;\n", (unsigned long long)idle_cycles);
+				print_elem("linked", linked);
+			}
+		} arm7;
+
 		void print()
 		{
 			shil.print();
 			ralloc.print();
 			bm.print();
 			blkrun.print();
+			arm7.print();
 		}
 	} counters;
 };
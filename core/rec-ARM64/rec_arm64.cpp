@@ -45,6 +45,7 @@ using namespace vixl::aarch64;
 #undef do_sqw_nommu
 
 extern "C" void ngen_blockcheckfail(u32 pc);
+extern "C" void ngen_promoteblock(u32 pc);
 extern "C" void ngen_LinkBlock_Generic_stub();
 extern "C" void ngen_LinkBlock_cond_Branch_stub();
 extern "C" void ngen_LinkBlock_cond_Next_stub();
@@ -136,6 +137,12 @@ __asm__
 	"ngen_blockcheckfail:					\n\t"
 		"bl rdv_BlockCheckFail				\n\t"
 		"br x0								\n"
+
+		".hidden ngen_promoteblock			\n\t"
+		".globl ngen_promoteblock			\n\t"
+	"ngen_promoteblock:						\n\t"
+		"bl rdv_PromoteBlock				\n\t"
+		"br x0								\n"
 );
 
 static bool restarting;
@@ -383,6 +390,18 @@ public:
 #endif
 		this->block = block;
 		CheckBlock(force_checks, block);
+		if (block->hot_runs != 0)
+		{
+			Label not_hot;
+			Ldr(x9, reinterpret_cast<uintptr_t>(&block->hot_runs));
+			Ldr(w10, MemOperand(x9));
+			Subs(w10, w10, 1);
+			Str(w10, MemOperand(x9));
+			B(&not_hot, ne);
+			Mov(w0, block->addr);
+			TailCallRuntime(ngen_promoteblock);
+			Bind(&not_hot);
+		}
 		
 		// run register allocator
 		regalloc.DoAlloc(block);
@@ -1168,8 +1187,63 @@ public:
 		return MemOperand(x28, offset);
 	}
 
+	// Translates the address in w0 with the MMU soft TLB, or branches to the miss label.
+	// Only used when there is no fast path to rewrite. Returns false if no code was generated.
+	bool GenSoftTlbLookup(u32 size, Label& miss)
+	{
+#ifdef FAST_MMU
+		if (!mmu_enabled() || vmem32_enabled())
+			return false;
+		static_assert(sizeof(SoftTLB_Entry) == 16, "soft TLB index scaling");
+
+		Mov(x10, reinterpret_cast<uintptr_t>(&CCN_PTEH.reg_data));
+		Ldrb(w10, MemOperand(x10));			// ASID
+		Lsr(w9, w0, 12);
+		Eor(w9, w9, w10);
+		And(w9, w9, SOFT_TLB_SIZE - 1);
+		Mov(x11, reinterpret_cast<uintptr_t>(mmu_soft_tlb));
+		Add(x11, x11, Operand(x9, LSL, 4));
+		// Misaligned addresses never match
+		And(w9, w0, 0xFFFFF000 | (size - 1));
+		Orr(w9, w9, Operand(w10, LSL, 4));
+		Ldr(w10, MemOperand(x11, offsetof(SoftTLB_Entry, tag)));
+		Cmp(w9, w10);
+		B(ne, &miss);
+		Ldr(w10, MemOperand(x11, offsetof(SoftTLB_Entry, offset)));
+		Add(w0, w0, w10);
+
+		return true;
+#else
+		return false;
+#endif
+	}
+
 	void GenReadMemorySlow(u32 size)
 	{
+		Label tlb_miss, done;
+		bool soft_tlb = GenSoftTlbLookup(size, tlb_miss);
+		if (soft_tlb)
+		{
+			switch (size)
+			{
+			case 1:
+				GenCallRuntime(_vmem_ReadMem8);
+				Sxtb(w0, w0);
+				break;
+			case 2:
+				GenCallRuntime(_vmem_ReadMem16);
+				Sxth(w0, w0);
+				break;
+			case 4:
+				GenCallRuntime(_vmem_ReadMem32);
+				break;
+			case 8:
+				GenCallRuntime(_vmem_ReadMem64);
+				break;
+			}
+			B(&done);
+			Bind(&tlb_miss);
+		}
 		Instruction *start_instruction = GetCursorAddress<Instruction *>();
 
 		switch (size)
@@ -1209,10 +1283,34 @@ public:
 			break;
 		}
 		EnsureCodeSize(start_instruction, read_memory_rewrite_size);
+		if (soft_tlb)
+			Bind(&done);
 	}
 
 	void GenWriteMemorySlow(u32 size)
 	{
+		Label tlb_miss, done;
+		bool soft_tlb = GenSoftTlbLookup(size, tlb_miss);
+		if (soft_tlb)
+		{
+			switch (size)
+			{
+			case 1:
+				GenCallRuntime(_vmem_WriteMem8);
+				break;
+			case 2:
+				GenCallRuntime(_vmem_WriteMem16);
+				break;
+			case 4:
+				GenCallRuntime(_vmem_WriteMem32);
+				break;
+			case 8:
+				GenCallRuntime(_vmem_WriteMem64);
+				break;
+			}
+			B(&done);
+			Bind(&tlb_miss);
+		}
 		Instruction *start_instruction = GetCursorAddress<Instruction *>();
 
 		switch (size)
@@ -1250,6 +1348,8 @@ public:
 			break;
 		}
 		EnsureCodeSize(start_instruction, write_memory_rewrite_size);
+		if (soft_tlb)
+			Bind(&done);
 	}
 
 	u32 RelinkBlock(RuntimeBlockInfo *block)
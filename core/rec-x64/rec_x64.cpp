@@ -239,6 +239,10 @@ static void ngen_blockcheckfail(u32 pc) {
 	rdv_BlockCheckFail(pc);
 }
 
+static void ngen_promoteblock(u32 pc) {
+	rdv_PromoteBlock(pc);
+}
+
 static void handle_mem_exception(u32 exception_raised, u32 pc)
 {
 	if (exception_raised)
@@ -357,6 +361,14 @@ public:
 
 		CheckBlock(force_checks, block);
 
+		if (block->hot_runs != 0)
+		{
+			mov(call_regs[0], block->addr);
+			mov(rax, (uintptr_t)&block->hot_runs);
+			sub(dword[rax], 1);
+			jz(reinterpret_cast<const void*>(CC_RX2RW(&ngen_promoteblock)));
+		}
+
 #ifdef _WIN32
 		sub(rsp, 0x28);		// 32-byte shadow space + 8 byte alignment
 #else
@@ -1312,10 +1324,33 @@ public:
 	void GenReadMemorySlow(const shil_opcode& op, RuntimeBlockInfo* block)
 	{
 		const u8 *start_addr = getCurr();
+		u32 size = op.flags & 0x7f;
+		Xbyak::Label tlb_miss, done;
+		bool soft_tlb = GenSoftTlbLookup(size, tlb_miss);
+		if (soft_tlb)
+		{
+			switch (size) {
+			case 1:
+				GenCall(_vmem_ReadMem8);
+				movsx(eax, al);
+				break;
+			case 2:
+				GenCall(_vmem_ReadMem16);
+				movsx(eax, ax);
+				break;
+			case 4:
+				GenCall(_vmem_ReadMem32);
+				break;
+			case 8:
+				GenCall(_vmem_ReadMem64);
+				break;
+			}
+			jmp(done, T_NEAR);
+			L(tlb_miss);
+		}
 		if (mmu_enabled())
 			mov(call_regs[1], block->vaddr + op.guest_offs - (op.delay_slot ? 1 : 0));	// pc
 
-		u32 size = op.flags & 0x7f;
 		switch (size) {
 		case 1:
 			if (!mmu_enabled())
@@ -1347,6 +1382,8 @@ public:
 		default:
 			die("1..8 bytes");
 		}
+		if (soft_tlb)
+			L(done);
 
 		if (mmu_enabled() && vmem32_enabled())
 		{
@@ -1363,10 +1400,31 @@ public:
 	void GenWriteMemorySlow(const shil_opcode& op, RuntimeBlockInfo* block)
 	{
 		const u8 *start_addr = getCurr();
+		u32 size = op.flags & 0x7f;
+		Xbyak::Label tlb_miss, done;
+		bool soft_tlb = GenSoftTlbLookup(size, tlb_miss);
+		if (soft_tlb)
+		{
+			switch (size) {
+			case 1:
+				GenCall(_vmem_WriteMem8);
+				break;
+			case 2:
+				GenCall(_vmem_WriteMem16);
+				break;
+			case 4:
+				GenCall(_vmem_WriteMem32);
+				break;
+			case 8:
+				GenCall(_vmem_WriteMem64);
+				break;
+			}
+			jmp(done, T_NEAR);
+			L(tlb_miss);
+		}
 		if (mmu_enabled())
 			mov(call_regs[2], block->vaddr + op.guest_offs - (op.delay_slot ? 1 : 0));	// pc
 
-		u32 size = op.flags & 0x7f;
 		switch (size) {
 		case 1:
 			if (!mmu_enabled())
@@ -1395,6 +1453,9 @@ public:
 		default:
 			die("1..8 bytes");
 		}
+		if (soft_tlb)
+			L(done);
+
 		if (mmu_enabled() && vmem32_enabled())
 		{
 			Xbyak::Label quick_exit;
@@ -1411,6 +1472,39 @@ public:
 	{
 	}
 
+	// Translates the address in call_regs[0] with the MMU soft TLB, or jumps to the miss label.
+	// Only used when there is no fast path to rewrite. Returns false if no code was generated.
+	bool GenSoftTlbLookup(u32 size, Xbyak::Label& miss)
+	{
+#ifdef FAST_MMU
+		if (!mmu_enabled() || vmem32_enabled())
+			return false;
+		static_assert(sizeof(SoftTLB_Entry) == 16, "soft TLB index scaling");
+
+		mov(rax, (uintptr_t)&CCN_PTEH.reg_data);
+		movzx(r11d, byte[rax]);				// ASID
+		mov(eax, call_regs[0]);
+		shr(eax, 12);
+		xor_(eax, r11d);
+		and_(eax, SOFT_TLB_SIZE - 1);
+		shl(eax, 4);
+		mov(r10, (uintptr_t)mmu_soft_tlb);
+		add(r10, rax);
+		// Misaligned addresses never match
+		shl(r11d, 4);
+		mov(eax, call_regs[0]);
+		and_(eax, 0xFFFFF000 | (size - 1));
+		or_(eax, r11d);
+		cmp(eax, dword[r10 + offsetof(SoftTLB_Entry, tag)]);
+		jne(miss, T_NEAR);
+		add(call_regs[0], dword[r10 + offsetof(SoftTLB_Entry, offset)]);
+
+		return true;
+#else
+		return false;
+#endif
+	}
+
 	void FinalizeRewrite()
 	{
 		ready();
@@ -1,9 +1,11 @@
 #include "TexCache.h"
 #include "CustomTexture.h"
+#include "TexConvSimd.h"
 #include "deps/xbrz/xbrz.h"
 #include "hw/pvr/pvr_mem.h"
 #include "hw/mem/_vmem.h"
 #include "hw/mem/vmem32.h"
+#include "hw/mem/vmem_snapshot.h"
 #include "hw/sh4/modules/mmu.h"
 
 #include <algorithm>
@@ -14,8 +16,8 @@
 #include <omp.h>
 #endif
 
-u8* vq_codebook;
-u32 palette_index;
+thread_local u8* vq_codebook;
+thread_local u32 palette_index;
 bool KillTex=false;
 u32 palette16_ram[1024];
 u32 palette32_ram[1024];
@@ -134,6 +136,38 @@ void palette_update()
 static std::vector<vram_block*> VramLocks[VRAM_SIZE_MAX / PAGE_SIZE];
 VArray2 vram;  // vram 32-64b
 
+// Per-page content tracking, used to revalidate textures whose vram lock fired without
+// their data actually changing.
+// A page is clean when it's write-protected and its hash is up to date. The clean bits are
+// cleared from the write fault handler so they're lock-free. Hashes and versions are only
+// accessed from the render thread.
+#define VRAM_PAGES (VRAM_SIZE_MAX / PAGE_SIZE)
+static std::atomic<u32> vramCleanPages[VRAM_PAGES / 32];
+static u32 vramPageHash[VRAM_PAGES];
+static u32 vramPageVersion[VRAM_PAGES];	// 0 if never hashed
+static u32 vramVersion;
+
+static void vramPageDirty(u32 page)
+{
+	vramCleanPages[page / 32].fetch_and(~(1u << (page % 32)));
+}
+
+// Must be called with the page protected
+static u32 vramPageGetVersion(u32 page)
+{
+	u32 bit = 1u << (page % 32);
+	if ((vramCleanPages[page / 32].fetch_or(bit) & bit) == 0)
+	{
+		u32 hash = XXH32(&vram[page * PAGE_SIZE], PAGE_SIZE, 7);
+		if (hash != vramPageHash[page] || vramPageVersion[page] == 0)
+		{
+			vramPageHash[page] = hash;
+			vramPageVersion[page] = ++vramVersion;
+		}
+	}
+	return vramPageVersion[page];
+}
+
 //List functions
 //
 void vramlock_list_remove(vram_block* block)
@@ -162,7 +196,11 @@ void vramlock_list_add(vram_block* block)
 		std::vector<vram_block*>& list = VramLocks[i];
 		// If the list is empty then we need to protect vram, otherwise it's already been done
 		if (list.empty() || std::all_of(list.begin(), list.end(), [](vram_block *block) { return block == nullptr; }))
+		{
+			// The page may have been written since it was last hashed
+			vramPageDirty(i);
 			_vmem_protect_vram(i * PAGE_SIZE, PAGE_SIZE);
+		}
 		auto it = std::find(list.begin(), list.end(), nullptr);
 		if (it != list.end())
 			*it = block;
@@ -214,6 +252,7 @@ bool VramLockedWriteOffset(size_t offset)
 
 	size_t addr_hash = offset / PAGE_SIZE;
 	std::vector<vram_block *>& list = VramLocks[addr_hash];
+	vramPageDirty(addr_hash);
 
 	{
 		std::lock_guard<std::mutex> lock(vramlist_lock);
@@ -233,6 +272,7 @@ bool VramLockedWriteOffset(size_t offset)
 		}
 		list.clear();
 
+		vmem_snapshot_vram_write((u32)offset);
 		_vmem_unprotect_vram((u32)(offset & ~PAGE_MASK), PAGE_SIZE);
 	}
 
@@ -319,7 +359,7 @@ struct PvrTexInfo
 	TexConvFP8 *TW8;
 };
 
-static const PvrTexInfo format[8] =
+static PvrTexInfo format[8] =
 {	// name     bpp Final format			   Planar		Twiddled	 VQ				Planar(32b)    Twiddled(32b)  VQ (32b)      Palette (8b)
 	{"1555", 	16,	TextureType::_5551,        tex1555_PL,  tex1555_TW,  tex1555_VQ,    tex1555_PL32,  tex1555_TW32,  tex1555_VQ32, nullptr },	    //1555
 	{"565", 	16, TextureType::_565,         tex565_PL,   tex565_TW,   tex565_VQ,     tex565_PL32,   tex565_TW32,   tex565_VQ32,  nullptr },	    //565
@@ -331,6 +371,27 @@ static const PvrTexInfo format[8] =
 	{"ns/1555", 0},	                                                                                                                                // Not supported (1555)
 };
 
+// Replace the scalar converters by their SIMD versions when available
+static void SelectTexConverters()
+{
+	for (u32 i = 0; i < ARRAY_SIZE(format); i++)
+	{
+		const TexConvSimd *simd = GetTexConvSimd(i);
+		if (simd == nullptr)
+			continue;
+		PvrTexInfo& fmt = format[i];
+		if (simd->PL != nullptr) fmt.PL = simd->PL;
+		if (simd->TW != nullptr) fmt.TW = simd->TW;
+		if (simd->VQ != nullptr) fmt.VQ = simd->VQ;
+		if (simd->PL32 != nullptr) fmt.PL32 = simd->PL32;
+		if (simd->TW32 != nullptr) fmt.TW32 = simd->TW32;
+		if (simd->VQ32 != nullptr) fmt.VQ32 = simd->VQ32;
+		if (simd->TW8 != nullptr) fmt.TW8 = simd->TW8;
+	}
+}
+
+static OnLoad stc(&SelectTexConverters);
+
 static const u32 VQMipPoint[11] =
 {
 	0x00000,//1
@@ -389,16 +450,42 @@ void BaseTextureCacheData::PrintTextureName()
 
 //true if : dirty or paletted texture and hashes don't match
 bool BaseTextureCacheData::NeedsUpdate() {
-	bool rc = dirty != 0;
 	if (tex_type != TextureType::_8)
 	{
 		if (tcw.PixelFmt == PixelPal4 && palette_hash != pal_hash_16[tcw.PalSelect])
-			rc = true;
+			return true;
 		else if (tcw.PixelFmt == PixelPal8 && palette_hash != pal_hash_256[tcw.PalSelect >> 4])
-			rc = true;
+			return true;
 	}
 
-	return rc;
+	return dirty != 0 && !RevalidateVram();
+}
+
+void BaseTextureCacheData::LockVram()
+{
+	if (lock_block == nullptr)
+		lock_block = libCore_vramlock_Lock(sa_tex, sa + size - 1, this);
+	// lock_block can be freed by a write fault at any time so don't use it here
+	u32 end = std::min(sa + size - 1, VRAM_SIZE - 1);
+	u32 version = 0;
+	for (u32 page = std::min(sa_tex, end) / PAGE_SIZE; page <= end / PAGE_SIZE; page++)
+		version = std::max(version, vramPageGetVersion(page));
+	vram_version = version;
+}
+
+bool BaseTextureCacheData::RevalidateVram()
+{
+	if (vram_version == 0)
+		return false;
+	u32 old_version = vram_version;
+	// Any write from now on will dirty the texture again
+	dirty = 0;
+	LockVram();
+	if (vram_version == old_version)
+		return true;
+	dirty = FrameCount;
+
+	return false;
 }
 
 bool BaseTextureCacheData::Delete()
@@ -424,6 +511,7 @@ void BaseTextureCacheData::Create()
 	Updates = 0;
 	dirty = FrameCount;
 	lock_block = nullptr;
+	vram_version = 0;
 	custom_image_data = nullptr;
 	custom_load_in_progress = 0;
 
@@ -510,7 +598,7 @@ void BaseTextureCacheData::ComputeHash()
 	texture_hash ^= tcw.full & 0xFC000000;	// everything but texaddr, reserved and stride
 }
 
-void BaseTextureCacheData::Update()
+bool BaseTextureCacheData::StartUpdate()
 {
 	//texture state tracking stuff
 	Updates++;
@@ -518,7 +606,7 @@ void BaseTextureCacheData::Update()
 
 	tex_type = tex->type;
 
-	bool has_alpha = false;
+	decoded.has_alpha = false;
 	if (IsPaletted())
 	{
 		if (IsGpuHandledPaletted(tsp, tcw))
@@ -527,7 +615,7 @@ void BaseTextureCacheData::Update()
 		{
 			tex_type = PAL_TYPE[PAL_RAM_CTRL&3];
 			if (tex_type != TextureType::_565)
-				has_alpha = true;
+				decoded.has_alpha = true;
 		}
 
 		// Get the palette hash to check for future updates
@@ -537,16 +625,14 @@ void BaseTextureCacheData::Update()
 			palette_hash = pal_hash_256[tcw.PalSelect >> 4];
 	}
 
-	::palette_index = this->palette_index; // might be used if pal. tex
-	::vq_codebook = &vram[vq_codebook];    // might be used if VQ tex
-
 	//texture conversion work
 	u32 stride = w;
 
 	if (tcw.StrideSel && tcw.ScanOrder && (tex->PL || tex->PL32))
 		stride = (TEXT_CONTROL & 31) * 32;
+	decoded.stride = stride;
 
-	u32 original_h = h;
+	decoded.original_h = h;
 	if (sa_tex > VRAM_SIZE || size == 0 || sa + size > VRAM_SIZE)
 	{
 		if (sa < VRAM_SIZE && sa + size > VRAM_SIZE && tcw.ScanOrder && stride > 0)
@@ -559,19 +645,31 @@ void BaseTextureCacheData::Update()
 		else
 		{
 			WARN_LOG(RENDERER, "Warning: invalid texture. Address %08X %08X size %d", sa_tex, sa, size);
-			return;
+			return false;
 		}
 	}
+	//lock the texture to detect changes in it
+	//this is done before decoding so that concurrent writes invalidate it
+	LockVram();
+
 	if (settings.rend.CustomTextures)
 		custom_texture.LoadCustomTextureAsync(this);
 
-	void *temp_tex_buffer = NULL;
-	u32 upscaled_w = w;
-	u32 upscaled_h = h;
+	return true;
+}
+
+void BaseTextureCacheData::Decode()
+{
+	::palette_index = this->palette_index; // might be used if pal. tex
+	::vq_codebook = &vram[vq_codebook];    // might be used if VQ tex
+
+	u32 stride = decoded.stride;
+	decoded.width = w;
+	decoded.height = h;
 
-	PixelBuffer<u16> pb16;
-	PixelBuffer<u32> pb32;
-	PixelBuffer<u8> pb8;
+	PixelBuffer<u16>& pb16 = decoded.pb16;
+	PixelBuffer<u32>& pb32 = decoded.pb32;
+	PixelBuffer<u8>& pb8 = decoded.pb8;
 
 	// Figure out if we really need to use a 32-bit pixel buffer
 	bool textureUpscaling = settings.rend.TextureUpscale > 1
@@ -610,7 +708,8 @@ void BaseTextureCacheData::Update()
 					if (i == 0)
 					{
 						PixelBuffer<u32> pb0;
-						pb0.init(2, 2 ,false);
+						// pal4 converters write 4x4 blocks
+						pb0.init(4, 4, false);
 						texconv32(&pb0, (u8*)&vram[vram_addr], 2, 2);
 						*pb32.data() = *pb0.data(1, 1);
 						continue;
@@ -639,14 +738,14 @@ void BaseTextureCacheData::Update()
 
 				if (tcw.PixelFmt == Pixel1555 || tcw.PixelFmt == Pixel4444)
 					// Alpha channel formats. Palettes with alpha are already handled
-					has_alpha = true;
-				UpscalexBRZ(settings.rend.TextureUpscale, pb32.data(), tmp_buf.data(), w, h, has_alpha);
+					decoded.has_alpha = true;
+				UpscalexBRZ(settings.rend.TextureUpscale, pb32.data(), tmp_buf.data(), w, h, decoded.has_alpha);
 				pb32.steal_data(tmp_buf);
-				upscaled_w *= settings.rend.TextureUpscale;
-				upscaled_h *= settings.rend.TextureUpscale;
+				decoded.width *= settings.rend.TextureUpscale;
+				decoded.height *= settings.rend.TextureUpscale;
 			}
 		}
-		temp_tex_buffer = pb32.data();
+		decoded.data = (u8*)pb32.data();
 	}
 	else if (texconv8 != NULL && tex_type == TextureType::_8)
 	{
@@ -666,7 +765,7 @@ void BaseTextureCacheData::Update()
 			pb8.init(w, h);
 			texconv8(&pb8, &vram[sa], stride, h);
 		}
-		temp_tex_buffer = pb8.data();
+		decoded.data = pb8.data();
 	}
 	else if (texconv != NULL)
 	{
@@ -683,7 +782,8 @@ void BaseTextureCacheData::Update()
 					if (i == 0)
 					{
 						PixelBuffer<u16> pb0;
-						pb0.init(2, 2 ,false);
+						// pal4 converters write 4x4 blocks
+						pb0.init(4, 4, false);
 						texconv(&pb0, (u8*)&vram[vram_addr], 2, 2);
 						*pb16.data() = *pb0.data(1, 1);
 						continue;
@@ -700,7 +800,7 @@ void BaseTextureCacheData::Update()
 			pb16.init(w, h);
 			texconv(&pb16,(u8*)&vram[sa],stride,h);
 		}
-		temp_tex_buffer = pb16.data();
+		decoded.data = (u8*)pb16.data();
 	}
 	else
 	{
@@ -708,24 +808,62 @@ void BaseTextureCacheData::Update()
 		WARN_LOG(RENDERER, "UNHANDLED TEXTURE");
 		pb16.init(w, h);
 		memset(pb16.data(), 0x80, w * h * 2);
-		temp_tex_buffer = pb16.data();
+		decoded.data = (u8*)pb16.data();
 		mipmapped = false;
 	}
-	// Restore the original texture height if it was constrained to VRAM limits above
-	h = original_h;
+	decoded.mipmapped = mipmapped;
+}
 
-	//lock the texture to detect changes in it
-	if (lock_block == nullptr)
-		lock_block = libCore_vramlock_Lock(sa_tex,sa+size-1,this);
+void BaseTextureCacheData::FinishUpdate()
+{
+	// Restore the original texture height if it was constrained to VRAM limits
+	h = decoded.original_h;
 
-	UploadToGPU(upscaled_w, upscaled_h, (u8*)temp_tex_buffer, mipmapped, mipmapped);
+	UploadToGPU(decoded.width, decoded.height, decoded.data, decoded.mipmapped, decoded.mipmapped);
 	if (settings.rend.DumpTextures)
 	{
 		ComputeHash();
-		custom_texture.DumpTexture(texture_hash, upscaled_w, upscaled_h, tex_type, temp_tex_buffer);
+		custom_texture.DumpTexture(texture_hash, decoded.width, decoded.height, tex_type, decoded.data);
 		NOTICE_LOG(RENDERER, "Dumped texture %x.png. Old hash %x", texture_hash, old_texture_hash);
 	}
 	PrintTextureName();
+
+	decoded.pb16.deinit();
+	decoded.pb32.deinit();
+	decoded.pb8.deinit();
+	decoded.data = nullptr;
+	decoded.pending = false;
+}
+
+// Textures with fewer pixels are decoded on the render thread:
+// handing them over to a worker takes longer than decoding them
+#define PARALLEL_DECODE_MIN_PIXELS (64 * 64)
+
+void DecodeTextures(const std::vector<BaseTextureCacheData *>& textures)
+{
+#ifndef TARGET_NO_OPENMP
+	static std::vector<BaseTextureCacheData *> large;
+	large.clear();
+	for (BaseTextureCacheData *texture : textures)
+	{
+		if (texture->w * texture->h < PARALLEL_DECODE_MIN_PIXELS)
+			texture->Decode();
+		else
+			large.push_back(texture);
+	}
+	int count = (int)large.size();
+	if (count > 1)
+	{
+#pragma omp parallel for schedule(dynamic) num_threads(getThreadCount())
+		for (int i = 0; i < count; i++)
+			large[i]->Decode();
+	}
+	else if (count == 1)
+		large[0]->Decode();
+#else
+	for (BaseTextureCacheData *texture : textures)
+		texture->Decode();
+#endif
 }
 
 void BaseTextureCacheData::CheckCustomTexture()
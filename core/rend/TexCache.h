@@ -8,8 +8,9 @@
 #include <memory>
 #include <unordered_map>
 
-extern u8* vq_codebook;
-extern u32 palette_index;
+// Set by the texture being decoded
+extern thread_local u8* vq_codebook;
+extern thread_local u32 palette_index;
 extern u32 palette16_ram[1024];
 extern u32 palette32_ram[1024];
 extern bool pal_needs_update,fog_needs_update;
@@ -642,6 +643,25 @@ typedef void TexConvFP8(PixelBuffer<u8>* pb, u8* p_in, u32 Width, u32 Height);
 typedef void TexConvFP32(PixelBuffer<u32>* pb,u8* p_in,u32 Width,u32 Height);
 enum class TextureType { _565, _5551, _4444, _8888, _8 };
 
+// Texture data converted by Decode(), waiting to be uploaded
+struct DecodedTexture
+{
+	PixelBuffer<u16> pb16;
+	PixelBuffer<u32> pb32;
+	PixelBuffer<u8> pb8;
+	u8 *data = nullptr;
+	u32 width = 0;
+	u32 height = 0;
+	u32 stride = 0;
+	u32 original_h = 0;
+	bool has_alpha = false;
+	bool mipmapped = false;
+	bool pending = false;
+};
+
+class BaseTextureCacheData;
+void DecodeTextures(const std::vector<BaseTextureCacheData *>& textures);
+
 class BaseTextureCacheData
 {
 public:
@@ -663,6 +683,7 @@ public:
 
 	u32 dirty;
 	vram_block* lock_block;
+	u32 vram_version;			// Latest version of the vram pages at the time of the last update. 0 if unknown
 
 	u32 Updates;
 
@@ -676,6 +697,7 @@ public:
 	u32 custom_width;
 	u32 custom_height;
 	std::atomic_int custom_load_in_progress;
+	DecodedTexture decoded;
 
 	void PrintTextureName();
 	virtual std::string GetId() = 0;
@@ -712,12 +734,21 @@ public:
 
 	void Create();
 	void ComputeHash();
-	void Update();
+	// Texture updates are split in 3 steps so that textures can be decoded in parallel.
+	// StartUpdate() and FinishUpdate() must be called on the render thread.
+	// StartUpdate() returns false if the texture is invalid and must not be decoded.
+	bool StartUpdate();
+	void Decode();
+	void FinishUpdate();
 	virtual void UploadToGPU(int width, int height, u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) = 0;
 	virtual bool Force32BitTexture(TextureType type) const { return false; }
 	void CheckCustomTexture();
 	//true if : dirty or paletted texture and hashes don't match
 	bool NeedsUpdate();
+	// Locks the texture vram and records the version of its pages
+	void LockVram();
+	// Relocks a dirty texture. Returns true if its vram content hasn't changed since the last update
+	bool RevalidateVram();
 	virtual bool Delete();
 	virtual ~BaseTextureCacheData() {}
 	static bool IsGpuHandledPaletted(TSP tsp, TCW tcw)
@@ -796,8 +827,40 @@ public:
 		}
 	}
 
+	// The texture will be decoded and uploaded by UpdateTextures()
+	void QueueUpdate(Texture *texture)
+	{
+		// The texture may be invalidated again while the frame is being parsed
+		if (texture->decoded.pending)
+			return;
+		if (texture->StartUpdate())
+		{
+			texture->decoded.pending = true;
+			pendingUpdates.push_back(texture);
+		}
+	}
+
+	// Decodes all queued textures in parallel, then calls upload(texture) for each of them,
+	// which must call FinishUpdate()
+	template<typename Func>
+	void UpdateTextures(Func upload)
+	{
+		if (pendingUpdates.empty())
+			return;
+		DecodeTextures(pendingUpdates);
+		for (BaseTextureCacheData *texture : pendingUpdates)
+			upload(static_cast<Texture *>(texture));
+		pendingUpdates.clear();
+	}
+
+	void UpdateTextures()
+	{
+		UpdateTextures([](Texture *texture) { texture->FinishUpdate(); });
+	}
+
 	void Clear()
 	{
+		pendingUpdates.clear();
 		for (auto& pair : cache)
 			clearTexture(&pair.second);
 
@@ -813,6 +876,7 @@ protected:
 
 private:
 	std::unordered_map<u64, Texture> cache;
+	std::vector<BaseTextureCacheData *> pendingUpdates;
 	// Only use TexU and TexV from TSP in the cache key
 	//     TexV : 7, TexU : 7
 	const TSP TSPTextureCacheMask = { { 7, 7 } };
@@ -0,0 +1,437 @@
+#include "TexConvSimd.h"
+
+#ifdef TEXCONV_SIMD
+
+#ifdef __aarch64__
+#include <arm_neon.h>
+#else
+#include <emmintrin.h>
+#endif
+#include <cstring>
+
+#ifdef __aarch64__
+//
+// NEON
+//
+typedef uint16x8_t v16;	// 8 16-bit texels
+typedef uint32x4_t v32;	// 4 32-bit texels
+typedef uint8x16_t v8;	// 16 8-bit texels
+
+static inline v16 load16(const void *p) { return vld1q_u16((const u16 *)p); }
+static inline v16 load16(const void *lo, const void *hi) {
+	return vcombine_u16(vld1_u16((const u16 *)lo), vld1_u16((const u16 *)hi));
+}
+static inline void store16(void *p, v16 v) { vst1q_u16((u16 *)p, v); }
+static inline void store16Low(void *p, v16 v) { vst1_u16((u16 *)p, vget_low_u16(v)); }
+static inline void store16High(void *p, v16 v) { vst1_u16((u16 *)p, vget_high_u16(v)); }
+static inline void store32(void *p, v32 v) { vst1q_u32((u32 *)p, v); }
+static inline void store8(void *p, v8 v) { vst1q_u8((u8 *)p, v); }
+
+// a and b are the 16 texels of a 4x4 tile in twiddled order.
+// Returns rows 0 and 1 in r01 and rows 2 and 3 in r23
+static inline void detwiddle16(v16 a, v16 b, v16& r01, v16& r23)
+{
+	uint16x8x2_t t = vuzpq_u16(a, b);
+	uint32x4x2_t r = vuzpq_u32(vreinterpretq_u32_u16(t.val[0]), vreinterpretq_u32_u16(t.val[1]));
+	r01 = vreinterpretq_u16_u32(r.val[0]);
+	r23 = vreinterpretq_u16_u32(r.val[1]);
+}
+
+// Same as detwiddle16 for 8-bit texels. The 4 rows are returned in order
+static inline v8 detwiddle8(v8 v)
+{
+	static const u8 order[16] = { 0, 2, 8, 10, 1, 3, 9, 11, 4, 6, 12, 14, 5, 7, 13, 15 };
+	return vqtbl1q_u8(v, vld1q_u8(order));
+}
+
+static inline v8 loadPal8(const u8 *p) { return vld1q_u8(p); }
+static inline v8 loadPal4(const u8 *p)
+{
+	uint8x8_t v = vld1_u8(p);
+	uint8x8x2_t t = vzip_u8(vand_u8(v, vdup_n_u8(0xF)), vshr_n_u8(v, 4));
+	return vcombine_u8(t.val[0], t.val[1]);
+}
+
+template<int N>
+static inline v16 rotl16(v16 v) { return vorrq_u16(vshlq_n_u16(v, N), vshrq_n_u16(v, 16 - N)); }
+
+static inline v32 widenLow(v16 v) { return vmovl_u16(vget_low_u16(v)); }
+static inline v32 widenHigh(v16 v) { return vmovl_u16(vget_high_u16(v)); }
+template<int N>
+static inline v32 shl32(v32 v) { return vshlq_n_u32(v, N); }
+template<int N>
+static inline v32 shr32(v32 v) { return vshrq_n_u32(v, N); }
+static inline v32 or32(v32 a, v32 b) { return vorrq_u32(a, b); }
+static inline v32 and32(v32 a, v32 b) { return vandq_u32(a, b); }
+static inline v32 dup32(u32 v) { return vdupq_n_u32(v); }
+// All ones if bit 15 is set
+static inline v32 bit15Mask(v32 w) { return vtstq_u32(w, vdupq_n_u32(0x8000)); }
+
+// Signed division rounding toward zero like the scalar code
+template<int Shift>
+static inline int16x8_t div16(int16x8_t x) {
+	return vshrq_n_s16(vaddq_s16(x, vandq_s16(vshrq_n_s16(x, 15), vdupq_n_s16((1 << Shift) - 1))), Shift);
+}
+
+static inline uint16x8_t clamp16(int16x8_t x) {
+	return vreinterpretq_u16_s16(vminq_s16(vmaxq_s16(x, vdupq_n_s16(0)), vdupq_n_s16(255)));
+}
+
+// 8 YUV422 texels (U/Y0 V/Y1 pairs) -> 8 RGBA8888 texels, see YUV422()
+static inline void unpackYUV(v16 v, v32& lo, v32& hi)
+{
+	int16x8_t y = vreinterpretq_s16_u16(vshrq_n_u16(v, 8));
+	uint16x8_t uv = vandq_u16(v, vdupq_n_u16(0xFF));
+	// U is in even texels and V in odd ones, each shared by a pair of texels
+	int16x8_t yu = vsubq_s16(vreinterpretq_s16_u16(vtrn1q_u16(uv, uv)), vdupq_n_s16(128));
+	int16x8_t yv = vsubq_s16(vreinterpretq_s16_u16(vtrn2q_u16(uv, uv)), vdupq_n_s16(128));
+
+	uint16x8_t r = clamp16(vaddq_s16(y, div16<3>(vmulq_n_s16(yv, 11))));
+	uint16x8_t g = clamp16(vsubq_s16(y, div16<5>(vaddq_s16(vmulq_n_s16(yu, 11), vmulq_n_s16(yv, 22)))));
+	uint16x8_t b = clamp16(vaddq_s16(y, div16<6>(vmulq_n_s16(yu, 110))));
+
+	uint16x8_t rg = vorrq_u16(r, vshlq_n_u16(g, 8));
+	uint16x8_t ba = vorrq_u16(b, vdupq_n_u16(0xFF00));
+	lo = vreinterpretq_u32_u16(vzip1q_u16(rg, ba));
+	hi = vreinterpretq_u32_u16(vzip2q_u16(rg, ba));
+}
+
+#else
+//
+// SSE2
+//
+typedef __m128i v16;	// 8 16-bit texels
+typedef __m128i v32;	// 4 32-bit texels
+typedef __m128i v8;		// 16 8-bit texels
+
+static inline v16 load16(const void *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline v16 load16(const void *lo, const void *hi) {
+	return _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)lo), _mm_loadl_epi64((const __m128i *)hi));
+}
+static inline void store16(void *p, v16 v) { _mm_storeu_si128((__m128i *)p, v); }
+static inline void store16Low(void *p, v16 v) { _mm_storel_epi64((__m128i *)p, v); }
+static inline void store16High(void *p, v16 v) { _mm_storel_epi64((__m128i *)p, _mm_unpackhi_epi64(v, v)); }
+static inline void store32(void *p, v32 v) { _mm_storeu_si128((__m128i *)p, v); }
+static inline void store8(void *p, v8 v) { _mm_storeu_si128((__m128i *)p, v); }
+
+// a and b are the 16 texels of a 4x4 tile in twiddled order.
+// Returns rows 0 and 1 in r01 and rows 2 and 3 in r23
+static inline void detwiddle16(v16 a, v16 b, v16& r01, v16& r23)
+{
+	// 0 2 1 3 4 6 5 7
+	a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+	b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(b, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+	r01 = _mm_unpacklo_epi32(a, b);
+	r23 = _mm_unpackhi_epi32(a, b);
+}
+
+// Same as detwiddle16 for 8-bit texels. The 4 rows are returned in order
+static inline v8 detwiddle8(v8 v)
+{
+	// even bytes then odd bytes: 0 2 4 6 8 10 12 14 1 3 5 7 9 11 13 15
+	v = _mm_packus_epi16(_mm_and_si128(v, _mm_set1_epi16(0xFF)), _mm_srli_epi16(v, 8));
+	// rows 0, 2, 1, 3
+	v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+static inline v8 loadPal8(const u8 *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline v8 loadPal4(const u8 *p)
+{
+	__m128i v = _mm_loadl_epi64((const __m128i *)p);
+	const __m128i mask = _mm_set1_epi8(0xF);
+	return _mm_unpacklo_epi8(_mm_and_si128(v, mask), _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+}
+
+template<int N>
+static inline v16 rotl16(v16 v) { return _mm_or_si128(_mm_slli_epi16(v, N), _mm_srli_epi16(v, 16 - N)); }
+
+static inline v32 widenLow(v16 v) { return _mm_unpacklo_epi16(v, _mm_setzero_si128()); }
+static inline v32 widenHigh(v16 v) { return _mm_unpackhi_epi16(v, _mm_setzero_si128()); }
+template<int N>
+static inline v32 shl32(v32 v) { return _mm_slli_epi32(v, N); }
+template<int N>
+static inline v32 shr32(v32 v) { return _mm_srli_epi32(v, N); }
+static inline v32 or32(v32 a, v32 b) { return _mm_or_si128(a, b); }
+static inline v32 and32(v32 a, v32 b) { return _mm_and_si128(a, b); }
+static inline v32 dup32(u32 v) { return _mm_set1_epi32((int)v); }
+// All ones if bit 15 is set
+static inline v32 bit15Mask(v32 w) { return _mm_srai_epi32(_mm_slli_epi32(w, 16), 31); }
+
+// Signed division rounding toward zero like the scalar code
+template<int Shift>
+static inline __m128i div16(__m128i x) {
+	return _mm_srai_epi16(_mm_add_epi16(x, _mm_and_si128(_mm_srai_epi16(x, 15), _mm_set1_epi16((1 << Shift) - 1))), Shift);
+}
+
+static inline __m128i clamp16(__m128i x) {
+	return _mm_min_epi16(_mm_max_epi16(x, _mm_setzero_si128()), _mm_set1_epi16(255));
+}
+
+// 8 YUV422 texels (U/Y0 V/Y1 pairs) -> 8 RGBA8888 texels, see YUV422()
+static inline void unpackYUV(v16 v, v32& lo, v32& hi)
+{
+	__m128i y = _mm_srli_epi16(v, 8);
+	__m128i uv = _mm_and_si128(v, _mm_set1_epi16(0xFF));
+	// U is in even texels and V in odd ones, each shared by a pair of texels
+	__m128i yu = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+	__m128i yv = _mm_shufflehi_epi16(_mm_shufflelo_epi16(uv, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+	yu = _mm_sub_epi16(yu, _mm_set1_epi16(128));
+	yv = _mm_sub_epi16(yv, _mm_set1_epi16(128));
+
+	__m128i r = clamp16(_mm_add_epi16(y, div16<3>(_mm_mullo_epi16(yv, _mm_set1_epi16(11)))));
+	__m128i g = clamp16(_mm_sub_epi16(y, div16<5>(_mm_add_epi16(_mm_mullo_epi16(yu, _mm_set1_epi16(11)),
+			_mm_mullo_epi16(yv, _mm_set1_epi16(22))))));
+	__m128i b = clamp16(_mm_add_epi16(y, div16<6>(_mm_mullo_epi16(yu, _mm_set1_epi16(110)))));
+
+	__m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+	__m128i ba = _mm_or_si128(b, _mm_set1_epi16((short)0xFF00));
+	lo = _mm_unpacklo_epi16(rg, ba);
+	hi = _mm_unpackhi_epi16(rg, ba);
+}
+#endif
+
+//
+// Pixel conversion, same results as the ARGBxxxx macros
+//
+static inline v32 expand4(v32 c) { return or32(shl32<4>(c), c); }
+static inline v32 expand5(v32 c) { return or32(shl32<3>(c), shr32<2>(c)); }
+static inline v32 expand6(v32 c) { return or32(shl32<2>(c), shr32<4>(c)); }
+template<int Shift, u32 Mask>
+static inline v32 field(v32 w) { return and32(shr32<Shift>(w), dup32(Mask)); }
+
+static inline v32 unpack565(v32 w)
+{
+	return or32(or32(expand5(field<11, 0x1F>(w)), shl32<8>(expand6(field<5, 0x3F>(w)))),
+			or32(shl32<16>(expand5(and32(w, dup32(0x1F)))), dup32(0xFF000000)));
+}
+
+static inline v32 unpack1555(v32 w)
+{
+	return or32(or32(expand5(field<10, 0x1F>(w)), shl32<8>(expand5(field<5, 0x1F>(w)))),
+			or32(shl32<16>(expand5(and32(w, dup32(0x1F)))), and32(bit15Mask(w), dup32(0xFF000000))));
+}
+
+static inline v32 unpack4444(v32 w)
+{
+	return or32(or32(expand4(field<8, 0xF>(w)), shl32<8>(expand4(field<4, 0xF>(w)))),
+			or32(shl32<16>(expand4(and32(w, dup32(0xF)))), shl32<24>(expand4(field<12, 0xF>(w)))));
+}
+
+// 16-bit textures to 16-bit pixels: 565 is unchanged, 1555 and 4444 move alpha to the low bits
+template<int Rot>
+struct Out16
+{
+	typedef u16 pixel_type;
+
+	static inline void row(u16 *dst, v16 v) {
+		store16(dst, rotl16<Rot>(v));
+	}
+	static inline void tile(u16 *dst, u32 pitch, v16 r01, v16 r23)
+	{
+		r01 = rotl16<Rot>(r01);
+		r23 = rotl16<Rot>(r23);
+		store16Low(dst, r01);
+		store16High(dst + pitch, r01);
+		store16Low(dst + pitch * 2, r23);
+		store16High(dst + pitch * 3, r23);
+	}
+};
+
+template<v32 (*Unpack)(v32)>
+struct Unpack32
+{
+	static inline void convert(v16 v, v32& lo, v32& hi) {
+		lo = Unpack(widenLow(v));
+		hi = Unpack(widenHigh(v));
+	}
+};
+struct UnpackYUV
+{
+	static inline void convert(v16 v, v32& lo, v32& hi) {
+		unpackYUV(v, lo, hi);
+	}
+};
+
+// 16-bit textures to 32-bit pixels
+template<class Unpack>
+struct Out32
+{
+	typedef u32 pixel_type;
+
+	static inline void row(u32 *dst, v16 v)
+	{
+		v32 lo, hi;
+		Unpack::convert(v, lo, hi);
+		store32(dst, lo);
+		store32(dst + 4, hi);
+	}
+	static inline void tile(u32 *dst, u32 pitch, v16 r01, v16 r23)
+	{
+		v32 r0, r1, r2, r3;
+		Unpack::convert(r01, r0, r1);
+		Unpack::convert(r23, r2, r3);
+		store32(dst, r0);
+		store32(dst + pitch, r1);
+		store32(dst + pitch * 2, r2);
+		store32(dst + pitch * 3, r3);
+	}
+};
+
+//
+// Texture walkers. Sizes not handled are delegated to the scalar converter
+//
+template<typename pixel_type>
+using ConvFunc = void (PixelBuffer<pixel_type> *, u8 *, u32, u32);
+
+template<typename pixel_type>
+static inline u32 pitch(PixelBuffer<pixel_type> *pb) {
+	return (u32)(pb->data(0, 1) - pb->data(0, 0));
+}
+
+template<class Out, ConvFunc<typename Out::pixel_type> *Scalar>
+static void texturePL(PixelBuffer<typename Out::pixel_type> *pb, u8 *p_in, u32 width, u32 height)
+{
+	if (width % 8 != 0)
+	{
+		Scalar(pb, p_in, width, height);
+		return;
+	}
+	const u16 *src = (const u16 *)p_in;
+	for (u32 y = 0; y < height; y++)
+	{
+		typename Out::pixel_type *dst = pb->data(0, y);
+		for (u32 x = 0; x < width; x += 8, src += 8)
+			Out::row(dst + x, load16(src));
+	}
+}
+
+template<class Out, ConvFunc<typename Out::pixel_type> *Scalar>
+static void textureTW(PixelBuffer<typename Out::pixel_type> *pb, u8 *p_in, u32 width, u32 height)
+{
+	if (width < 4 || height < 4)
+	{
+		Scalar(pb, p_in, width, height);
+		return;
+	}
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+	const u32 stride = pitch(pb);
+	const u16 *src = (const u16 *)p_in;
+
+	for (u32 y = 0; y < height; y += 4)
+		for (u32 x = 0; x < width; x += 4)
+		{
+			const u16 *p = src + twop(x, y, bcx, bcy);
+			v16 r01, r23;
+			detwiddle16(load16(p), load16(p + 8), r01, r23);
+			Out::tile(pb->data(x, y), stride, r01, r23);
+		}
+}
+
+template<class Out, ConvFunc<typename Out::pixel_type> *Scalar>
+static void textureVQ(PixelBuffer<typename Out::pixel_type> *pb, u8 *p_in, u32 width, u32 height)
+{
+	if (width < 4 || height < 4)
+	{
+		Scalar(pb, p_in, width, height);
+		return;
+	}
+	p_in += 256 * 4 * 2;	// Skip VQ codebook
+	const u8 *codebook = vq_codebook;
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+	const u32 stride = pitch(pb);
+
+	for (u32 y = 0; y < height; y += 4)
+		for (u32 x = 0; x < width; x += 4)
+		{
+			// Each index is a 2x2 block, a tile is made of 4 consecutive ones
+			const u8 *idx = &p_in[twop(x, y, bcx, bcy) / 4];
+			v16 r01, r23;
+			detwiddle16(load16(&codebook[idx[0] * 8], &codebook[idx[1] * 8]),
+					load16(&codebook[idx[2] * 8], &codebook[idx[3] * 8]), r01, r23);
+			Out::tile(pb->data(x, y), stride, r01, r23);
+		}
+}
+
+// Detwiddled palette indices of a 4x4 tile
+template<bool Pal4>
+static inline void tileIndices(const u8 *p_in, u32 x, u32 y, u32 bcx, u32 bcy, u8 indices[16])
+{
+	if (Pal4)
+		store8(indices, detwiddle8(loadPal4(&p_in[twop(x, y, bcx, bcy) / 2])));
+	else
+		store8(indices, detwiddle8(loadPal8(&p_in[twop(x, y, bcx, bcy)])));
+}
+
+// Palette indices only: palette lookups are done by the gpu and are faster in scalar code
+template<bool Pal4, ConvFunc<u8> *Scalar>
+static void texturePalTW8(PixelBuffer<u8> *pb, u8 *p_in, u32 width, u32 height)
+{
+	if (width < 4 || height < 4)
+	{
+		Scalar(pb, p_in, width, height);
+		return;
+	}
+	const u32 bcx = bitscanrev(width);
+	const u32 bcy = bitscanrev(height);
+	const u32 stride = pitch(pb);
+
+	for (u32 y = 0; y < height; y += 4)
+		for (u32 x = 0; x < width; x += 4)
+		{
+			u8 indices[16];
+			tileIndices<Pal4>(p_in, x, y, bcx, bcy, indices);
+			u8 *dst = pb->data(x, y);
+			for (int row = 0; row < 4; row++)
+				memcpy(dst + stride * row, &indices[row * 4], 4);
+		}
+}
+
+typedef Out16<1> Out1555;
+typedef Out16<0> Out565;
+typedef Out16<4> Out4444;
+typedef Out32<Unpack32<unpack1555>> Out1555_32;
+typedef Out32<Unpack32<unpack565>> Out565_32;
+typedef Out32<Unpack32<unpack4444>> Out4444_32;
+typedef Out32<UnpackYUV> OutYUV;
+
+static const TexConvSimd simdConverters[7] =
+{
+	// 1555
+	{ texturePL<Out1555, tex1555_PL>, textureTW<Out1555, tex1555_TW>, textureVQ<Out1555, tex1555_VQ>,
+			texturePL<Out1555_32, tex1555_PL32>, textureTW<Out1555_32, tex1555_TW32>, textureVQ<Out1555_32, tex1555_VQ32>, nullptr },
+	// 565
+	{ texturePL<Out565, tex565_PL>, textureTW<Out565, tex565_TW>, textureVQ<Out565, tex565_VQ>,
+			texturePL<Out565_32, tex565_PL32>, textureTW<Out565_32, tex565_TW32>, textureVQ<Out565_32, tex565_VQ32>, nullptr },
+	// 4444
+	{ texturePL<Out4444, tex4444_PL>, textureTW<Out4444, tex4444_TW>, textureVQ<Out4444, tex4444_VQ>,
+			texturePL<Out4444_32, tex4444_PL32>, textureTW<Out4444_32, tex4444_TW32>, textureVQ<Out4444_32, tex4444_VQ32>, nullptr },
+	// yuv
+	{ nullptr, nullptr, nullptr,
+			texturePL<OutYUV, texYUV422_PL>, textureTW<OutYUV, texYUV422_TW>, textureVQ<OutYUV, texYUV422_VQ>, nullptr },
+	// bump map
+	{ texturePL<Out4444, texBMP_PL>, textureTW<Out4444, texBMP_TW>, textureVQ<Out4444, texBMP_VQ>,
+			texturePL<Out4444_32, tex4444_PL32>, textureTW<Out4444_32, tex4444_TW32>, textureVQ<Out4444_32, tex4444_VQ32>, nullptr },
+	// pal4
+	{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, texturePalTW8<true, texPAL4PT_TW> },
+	// pal8
+	{ nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, texturePalTW8<false, texPAL8PT_TW> },
+};
+
+const TexConvSimd *GetTexConvSimd(u32 pixelFmt)
+{
+	if (pixelFmt >= ARRAY_SIZE(simdConverters))
+		return nullptr;
+	return &simdConverters[pixelFmt];
+}
+
+#else
+
+const TexConvSimd *GetTexConvSimd(u32 pixelFmt)
+{
+	return nullptr;
+}
+
+#endif // TEXCONV_SIMD
@@ -0,0 +1,32 @@
+/*
+	SIMD texture converters
+
+	Twiddled and VQ textures are converted by 4x4 tiles: the 16 texels of a tile are
+	contiguous in twiddled order, so they can be loaded and reordered into rows with a
+	few shuffles, avoiding the per-pixel detwiddle table lookups of the scalar path.
+*/
+#pragma once
+#include "TexCache.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(__aarch64__)
+#define TEXCONV_SIMD
+#endif
+
+// Same layout as the conversion functions of PvrTexInfo. Null entries aren't accelerated.
+struct TexConvSimd
+{
+	// Conversion to 16 bpp
+	TexConvFP *PL;
+	TexConvFP *TW;
+	TexConvFP *VQ;
+	// Conversion to 32 bpp
+	TexConvFP32 *PL32;
+	TexConvFP32 *TW32;
+	TexConvFP32 *VQ32;
+	// Conversion to 8 bpp (palette)
+	TexConvFP8 *TW8;
+};
+
+// Returns the SIMD converters of the given pixel format,
+// or nullptr if none are available on this CPU
+const TexConvSimd *GetTexConvSimd(u32 pixelFmt);
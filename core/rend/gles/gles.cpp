@@ -1054,7 +1054,10 @@ bool ProcessFrame(TA_context* ctx)
 	}
 	else
 	{
-		if (!ta_parse_vdrc(ctx))
+		bool parsed = ta_parse_vdrc(ctx);
+		// Decode and upload the textures used by the frame
+		TexCache.UpdateTextures();
+		if (!parsed)
 			return false;
 	}
 	TexCache.CollectCleanup();
@@ -287,6 +287,7 @@ void ReadRTTBuffer() {
     		texture_data->Create();
     	texture_data->texID = gl.rtt.tex;
     	texture_data->dirty = 0;
+    	texture_data->vram_version = 0;	// rendered data, can't be revalidated from vram
     	if (texture_data->lock_block == NULL)
     		texture_data->lock_block = libCore_vramlock_Lock(texture_data->sa_tex, texture_data->sa + texture_data->size - 1, texture_data);
     }
@@ -316,7 +317,8 @@ u64 gl_GetTexture(TSP tsp, TCW tcw)
 
 	//update if needed
 	if (tf->NeedsUpdate())
-		tf->Update();
+		// Uploaded by TexCache.UpdateTextures() once the frame has been parsed
+		TexCache.QueueUpdate(tf);
 	else
 	{
 		if (tf->IsCustomTextureAvailable())
@@ -444,21 +444,21 @@ static const char *maple_expansion_device_name(MapleDeviceType type)
 const char *maple_ports[] = { "None", "A", "B", "C", "D", "All" };
 const DreamcastKey button_keys[] = {
 		DC_BTN_START, DC_BTN_A, DC_BTN_B, DC_BTN_X, DC_BTN_Y, DC_DPAD_UP, DC_DPAD_DOWN, DC_DPAD_LEFT, DC_DPAD_RIGHT,
-		EMU_BTN_MENU, EMU_BTN_ESCAPE, EMU_BTN_FFORWARD, EMU_BTN_TRIGGER_LEFT, EMU_BTN_TRIGGER_RIGHT,
+		EMU_BTN_MENU, EMU_BTN_ESCAPE, EMU_BTN_FFORWARD, EMU_BTN_REWIND, EMU_BTN_TRIGGER_LEFT, EMU_BTN_TRIGGER_RIGHT,
 		DC_BTN_C, DC_BTN_D, DC_BTN_Z, DC_DPAD2_UP, DC_DPAD2_DOWN, DC_DPAD2_LEFT, DC_DPAD2_RIGHT,
 		DC_BTN_RELOAD,
 		EMU_BTN_ANA_UP, EMU_BTN_ANA_DOWN, EMU_BTN_ANA_LEFT, EMU_BTN_ANA_RIGHT
 };
 const char *button_names[] = {
 		"Start", "A", "B", "X", "Y", "DPad Up", "DPad Down", "DPad Left", "DPad Right",
-		"Menu", "Exit", "Fast-forward", "Left Trigger", "Right Trigger",
+		"Menu", "Exit", "Fast-forward", "Rewind", "Left Trigger", "Right Trigger",
 		"C", "D", "Z", "Right Dpad Up", "Right DPad Down", "Right DPad Left", "Right DPad Right",
 		"Reload",
 		"Left Stick Up", "Left Stick Down", "Left Stick Left", "Left Stick Right"
 };
 const char *arcade_button_names[] = {
 		"Start", "Button 1", "Button 2", "Button 3", "Button 4", "Up", "Down", "Left", "Right",
-		"Menu", "Exit", "Fast-forward", "N/A", "N/A",
+		"Menu", "Exit", "Fast-forward", "Rewind", "N/A", "N/A",
 		"Service", "Coin", "Test", "Button 5", "Button 6", "Button 7", "Button 8",
 		"Reload",
 		"N/A", "N/A", "N/A", "N/A"
@@ -1155,6 +1155,9 @@ static void gui_display_settings()
 		    	ImGui::Checkbox("Synchronous Rendering", &settings.pvr.SynchronousRender);
 	            ImGui::SameLine();
 	            ShowHelpMarker("Reduce frame skipping by pausing the CPU when possible. Recommended for most platforms");
+		    	ImGui::SliderInt("Render Queue Depth", (int *)&settings.pvr.RenderQueueDepth, 1, 4);
+	            ImGui::SameLine();
+	            ShowHelpMarker("Number of frames that can be queued for rendering. Use 2 or more to let the CPU run ahead while the previous frame is rendered");
 		    	ImGui::Checkbox("Clipping", &settings.rend.Clipping);
 	            ImGui::SameLine();
 	            ShowHelpMarker("Enable clipping. May produce graphical errors when disabled");
@@ -1413,6 +1416,14 @@ static void gui_display_settings()
 		    	ImGui::Checkbox("Idle Skip", &settings.dynarec.idleskip);
 	            ImGui::SameLine();
 	            ShowHelpMarker("Skip wait loops. Recommended");
+		    	ImGui::Checkbox("Block Cache", &settings.dynarec.block_cache);
+	            ImGui::SameLine();
+	            ShowHelpMarker("Save decoded blocks to disk to speed up the next boot");
+#if HOST_CPU == CPU_X64 || HOST_CPU == CPU_ARM64
+		    	ImGui::Checkbox("Superblocks", &settings.dynarec.superblocks);
+	            ImGui::SameLine();
+	            ShowHelpMarker("Recompile hot code across static jumps");
+#endif
 		    }
 		    if (ImGui::CollapsingHeader("Network", ImGuiTreeNodeFlags_DefaultOpen))
 		    {
@@ -1440,6 +1451,30 @@ static void gui_display_settings()
 				ImGui::Checkbox("Force Windows CE", &settings.dreamcast.ForceWindowsCE);
 	            ImGui::SameLine();
 	            ShowHelpMarker("Enable full MMU emulation and other Windows CE settings. Do not enable unless necessary");
+				const char *load_timing[] = { "Default", "Accurate", "Instant" };
+				if (ImGui::BeginCombo("GD-ROM Loading", load_timing[(int)settings.imgread.LoadTiming], ImGuiComboFlags_None))
+				{
+					for (int i = 0; i < IM_ARRAYSIZE(load_timing); i++)
+					{
+						bool is_selected = (int)settings.imgread.LoadTiming == i;
+						if (ImGui::Selectable(load_timing[i], &is_selected))
+							settings.imgread.LoadTiming = (GDRomTiming)i;
+						if (is_selected)
+							ImGui::SetItemDefaultFocus();
+					}
+					ImGui::EndCombo();
+				}
+	            ImGui::SameLine();
+	            ShowHelpMarker("GD-ROM timing. Accurate emulates the seek time and transfer rate of the drive. Instant loads as fast as possible");
+				ImGui::Checkbox("Rewind", &settings.rewind.Enable);
+	            ImGui::SameLine();
+	            ShowHelpMarker("Keep a history of the last seconds of emulation. Hold the Rewind button to go back in time");
+				if (settings.rewind.Enable)
+				{
+					ImGui::SliderInt("Rewind Buffer (MB)", (int *)&settings.rewind.BufferSize, 16, 512);
+					ImGui::SameLine();
+					ShowHelpMarker("Memory used by the rewind history, in addition to one full save state");
+				}
 #ifndef __ANDROID
 				ImGui::Checkbox("Serial Console", &settings.debug.SerialConsole);
 	            ImGui::SameLine();
@@ -1899,6 +1934,8 @@ void gui_display_ui()
 static float LastFPSTime;
 static int lastFrameCount = 0;
 static float fps = -1;
+static u32 lastDroppedCount = 0;
+static float dropped = 0;
 
 extern bool fast_forward_mode;
 
@@ -1909,12 +1946,15 @@ static std::string getFPSNotification()
 		double now = os_GetSeconds();
 		if (now - LastFPSTime >= 1.0) {
 			fps = (FrameCount - lastFrameCount) / (now - LastFPSTime);
+			dropped = (rend_framesDropped() - lastDroppedCount) / (now - LastFPSTime);
 			LastFPSTime = now;
 			lastFrameCount = FrameCount;
+			lastDroppedCount = rend_framesDropped();
 		}
 		if (fps >= 0.f && fps < 9999.f) {
-			char text[32];
-			snprintf(text, sizeof(text), "F:%.1f%s", fps, fast_forward_mode ? " >>" : "");
+			char text[96];
+			snprintf(text, sizeof(text), "F:%.1f D:%.1f Q:%u A:%ums U:%u O:%u%s", fps, dropped, rend_framesQueued(),
+					GetAudioLatency(), GetAudioUnderruns(), GetAudioOverruns(), fast_forward_mode ? " >>" : "");
 
 			return std::string(text);
 		}
@@ -16,12 +16,21 @@
  */
 #include "sorter.h"
 #include <algorithm>
+#include <cstring>
+#ifndef TARGET_NO_OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 struct IndexTrig
 {
 	u32 id[3];
 	u16 pid;
-	f32 z;
 };
 
 #if 0
@@ -41,9 +50,127 @@ static float minZ(const Vertex *v, const u32 *mod)
 	return std::min(std::min(v[mod[0]].z, v[mod[1]].z), v[mod[2]].z);
 }
 
-static bool operator<(const IndexTrig& left, const IndexTrig& right)
+// Computes the minimum depth of each triangle of a strip, given the depth of its vertices
+static void stripMinZ(const f32 *zs, u32 trigCount, f32 *keys)
+{
+	u32 i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+	for (; i + 4 <= trigCount; i += 4)
+		_mm_storeu_ps(&keys[i], _mm_min_ps(_mm_min_ps(_mm_loadu_ps(&zs[i]), _mm_loadu_ps(&zs[i + 1])), _mm_loadu_ps(&zs[i + 2])));
+#elif defined(__aarch64__)
+	for (; i + 4 <= trigCount; i += 4)
+		vst1q_f32(&keys[i], vminq_f32(vminq_f32(vld1q_f32(&zs[i]), vld1q_f32(&zs[i + 1])), vld1q_f32(&zs[i + 2])));
+#endif
+	for (; i < trigCount; i++)
+		keys[i] = std::min(std::min(zs[i], zs[i + 1]), zs[i + 2]);
+}
+
+// Maps a float to an unsigned integer with the same ordering
+static u32 floatToKey(f32 f)
+{
+	u32 u = (u32&)f;
+	if ((u & 0x7FFFFFFF) == 0)
+		// -0 == +0
+		return 0x80000000;
+	return (u & 0x80000000) ? ~u : u | 0x80000000;
+}
+
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_MAX_THREADS 8
+
+// Stable LSD radix sort of the item indices by key.
+// The histograms and scatter of each digit are split across threads for large arrays.
+static void radixSort(const u32 *keys, u32 count, std::vector<u32>& order)
+{
+	static std::vector<u32> tmp;
+	static u32 histograms[RADIX_MAX_THREADS][RADIX_BUCKETS];
+	tmp.resize(count);
+	for (u32 i = 0; i < count; i++)
+		order[i] = i;
+
+	int threads = 1;
+#ifndef TARGET_NO_OPENMP
+	if (count >= 32768)
+		threads = std::max(1, std::min(std::min(omp_get_num_procs(), (int)settings.pvr.MaxThreads), RADIX_MAX_THREADS));
+#endif
+	u32 chunk = (count + threads - 1) / threads;
+
+	for (u32 shift = 0; shift < 32; shift += RADIX_BITS)
+	{
+		u32 *src = order.data();
+		u32 *dst = tmp.data();
+#ifndef TARGET_NO_OPENMP
+#pragma omp parallel for num_threads(threads) if(threads > 1)
+#endif
+		for (int thread = 0; thread < threads; thread++)
+		{
+			u32 *hist = histograms[thread];
+			memset(hist, 0, sizeof(histograms[0]));
+			u32 end = std::min(count, (thread + 1) * chunk);
+			for (u32 i = thread * chunk; i < end; i++)
+				hist[(keys[src[i]] >> shift) & (RADIX_BUCKETS - 1)]++;
+		}
+		// A digit shared by all the keys doesn't change the order
+		bool skip = false;
+		for (int b = 0; b < RADIX_BUCKETS && !skip; b++)
+		{
+			u32 total = 0;
+			for (int t = 0; t < threads; t++)
+				total += histograms[t][b];
+			skip = total == count;
+		}
+		if (skip)
+			continue;
+		// Bucket offsets. Threads handle consecutive chunks so stability is preserved.
+		u32 offset = 0;
+		for (int b = 0; b < RADIX_BUCKETS; b++)
+			for (int t = 0; t < threads; t++)
+			{
+				u32 n = histograms[t][b];
+				histograms[t][b] = offset;
+				offset += n;
+			}
+#ifndef TARGET_NO_OPENMP
+#pragma omp parallel for num_threads(threads) if(threads > 1)
+#endif
+		for (int thread = 0; thread < threads; thread++)
+		{
+			u32 *hist = histograms[thread];
+			u32 end = std::min(count, (thread + 1) * chunk);
+			for (u32 i = thread * chunk; i < end; i++)
+				dst[hist[(keys[src[i]] >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+		}
+		order.swap(tmp);
+	}
+}
+
+// Returns the order of the triangles sorted by depth. Equal depths keep their original order.
+static const std::vector<u32>& sortTriangles(const f32 *depths, u32 count)
 {
-	return left.z<right.z;
+	static std::vector<u32> keys;
+	static std::vector<u32> order;
+	keys.resize(count);
+	for (u32 i = 0; i < count; i++)
+		keys[i] = floatToKey(depths[i]);
+
+	// Try the order of the previous frame first. It's often still valid for static scenes.
+	if (order.size() == count && count > 0)
+	{
+		bool sorted = true;
+		for (u32 i = 1; i < count && sorted; i++)
+		{
+			u32 a = order[i - 1];
+			u32 b = order[i];
+			sorted = keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+		}
+		if (sorted)
+			return order;
+	}
+	order.resize(count);
+	radixSort(keys.data(), count, order);
+
+	return order;
 }
 
 static bool operator<(const PolyParam& left, const PolyParam& right)
@@ -239,8 +366,11 @@ void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort,
 
 	//make lists of all triangles, with their pid and vid
 	static std::vector<IndexTrig> lst;
+	static std::vector<f32> depths;
+	static std::vector<f32> strip_z;
 
 	lst.resize(vtx_count*4);
+	depths.resize(lst.size());
 
 
 	int pfsti=0;
@@ -254,6 +384,11 @@ void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort,
 			const u32 *idx = idx_base + pp->first;
 			u32 flip = 0;
 
+			strip_z.resize(pp->count);
+			for (u32 i = 0; i < pp->count; i++)
+				strip_z[i] = vtx_base[idx[i]].z;
+			stripMinZ(strip_z.data(), pp->count - 2, &depths[pfsti]);
+
 			for (u32 i = 0; i < pp->count - 2; i++)
 			{
 				const Vertex *v0, *v1;
@@ -314,22 +449,22 @@ void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort,
 
 						fill_id(lst[pfsti].id,v0,v3,v4,vtx_base);
 						lst[pfsti].pid= ppid ;
-						lst[pfsti].z = minZ(vtx_base,lst[pfsti].id);
+						depths[pfsti] = minZ(vtx_base,lst[pfsti].id);
 						pfsti++;
 
 						fill_id(lst[pfsti].id,v2,v3,v5,vtx_base);
 						lst[pfsti].pid= ppid ;
-						lst[pfsti].z = minZ(vtx_base,lst[pfsti].id);
+						depths[pfsti] = minZ(vtx_base,lst[pfsti].id);
 						pfsti++;
 
 						fill_id(lst[pfsti].id,v3,v4,v5,vtx_base);
 						lst[pfsti].pid= ppid ;
-						lst[pfsti].z = minZ(vtx_base,lst[pfsti].id);
+						depths[pfsti] = minZ(vtx_base,lst[pfsti].id);
 						pfsti++;
 
 						fill_id(lst[pfsti].id,v5,v4,v1,vtx_base);
 						lst[pfsti].pid= ppid ;
-						lst[pfsti].z = minZ(vtx_base,lst[pfsti].id);
+						depths[pfsti] = minZ(vtx_base,lst[pfsti].id);
 						pfsti++;
 
 						tess_gen+=3;
@@ -338,7 +473,7 @@ void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort,
 					{
 						fill_id(lst[pfsti].id,v0,v1,v2,vtx_base);
 						lst[pfsti].pid= ppid ;
-						lst[pfsti].z = minZ(vtx_base,lst[pfsti].id);
+						depths[pfsti] = minZ(vtx_base,lst[pfsti].id);
 						pfsti++;
 					}
 				}
@@ -347,7 +482,6 @@ void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort,
 				{
 					fill_id(lst[pfsti].id,v0,v1,v2,vtx_base);
 					lst[pfsti].pid= ppid ;
-					lst[pfsti].z = minZ(vtx_base,lst[pfsti].id);
 					pfsti++;
 				}
 
@@ -363,18 +497,20 @@ void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort,
 
 	//sort them
 #if 1
-	std::stable_sort(lst.begin(),lst.end());
+	const std::vector<u32>& order = sortTriangles(depths.data(), aused);
 
 	//Merge pids/draw cmds if two different pids are actually equal
 	if (true)
 	{
 		for (u32 k=1;k<aused;k++)
 		{
-			if (lst[k].pid!=lst[k-1].pid)
+			IndexTrig& trig = lst[order[k]];
+			const IndexTrig& prev_trig = lst[order[k - 1]];
+			if (trig.pid!=prev_trig.pid)
 			{
-				if (PP_EQ(&pp_base[lst[k].pid],&pp_base[lst[k-1].pid]))
+				if (PP_EQ(&pp_base[trig.pid],&pp_base[prev_trig.pid]))
 				{
-					lst[k].pid=lst[k-1].pid;
+					trig.pid=prev_trig.pid;
 				}
 			}
 		}
@@ -422,8 +558,8 @@ void GenSorted(int first, int count, std::vector<SortTrigDrawParam>& pidx_sort,
 
 	for (u32 i=0; i<aused; i++)
 	{
-		int pid=lst[i].pid;
-		u32* midx = lst[i].id;
+		int pid=lst[order[i]].pid;
+		u32* midx = lst[order[i]].id;
 
 		vidx_sort[i*3 + 0]=midx[0];
 		vidx_sort[i*3 + 1]=midx[1];
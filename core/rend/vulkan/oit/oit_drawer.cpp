@@ -666,6 +666,7 @@ void OITTextureDrawer::EndFrame()
 	//memset(&vram[fb_rtt.TexAddr << 3], '\0', size);
 
 	texture->dirty = 0;
+	texture->vram_version = 0;	// rendered data, can't be revalidated from vram
 	if (texture->lock_block == NULL)
 		texture->lock_block = libCore_vramlock_Lock(texture->sa_tex, texture->sa + texture->size - 1, texture);
 }
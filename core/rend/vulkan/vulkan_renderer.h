@@ -91,8 +91,7 @@ public:
 			// This kills performance when a frame is skipped and lots of texture updated each frame
 			//if (textureCache.IsInFlight(tf))
 			//	textureCache.DestroyLater(tf);
-			tf->SetCommandBuffer(texCommandPool.Allocate());
-			tf->Update();
+			textureCache.QueueUpdate(tf);
 		}
 		else if (tf->IsCustomTextureAvailable())
 		{
@@ -120,7 +119,15 @@ public:
 		if (ctx->rend.isRenderFramebuffer)
 			result = RenderFramebuffer(ctx);
 		else
+		{
 			result = ta_parse_vdrc(ctx);
+			// Decode the textures used by the frame and upload them
+			textureCache.UpdateTextures([this](Texture *tf) {
+				tf->SetCommandBuffer(texCommandPool.Allocate());
+				tf->FinishUpdate();
+				tf->SetCommandBuffer(nullptr);
+			});
+		}
 
 		if (result)
 		{
@@ -0,0 +1,223 @@
+/*
+	Copyright 2020 flyinghead
+
+	This file is part of flycast.
+
+    flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "rewind.h"
+#include "emulator.h"
+#include "hw/sh4/sh4_if.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <zlib.h>
+
+// Frames between two snapshots
+constexpr u32 SNAPSHOT_FRAMES = 10;
+// Frames between two steps back while rewinding
+constexpr u32 REWIND_FRAMES = 2;
+
+bool RewindBuffer::Snapshot()
+{
+	Wait();
+	// Guest memory is copied right away. With copy-on-write, most pages written between two snapshots
+	// would take a write fault and then be copied anyway.
+	if (!capture.Capture(nullptr, false))
+		return false;
+	pending = std::async(std::launch::async, [this]() {
+		return Update();
+	});
+	return true;
+}
+
+bool RewindBuffer::Wait()
+{
+	if (!pending.valid())
+		return true;
+	return pending.get();
+}
+
+bool RewindBuffer::Update()
+{
+	const std::vector<u8>& data = capture.Data();
+	if (data.size() != state.size())
+	{
+		// First snapshot or the state layout changed
+		Reset();
+		state = data;
+		return true;
+	}
+	restored = false;
+
+	Delta delta;
+	oldPages.clear();
+	for (u32 offset = 0; offset < state.size(); offset += CHUNK_SIZE)
+	{
+		u32 length = std::min<size_t>(CHUNK_SIZE, state.size() - offset);
+		if (memcmp(&state[offset], &data[offset], length) != 0)
+		{
+			delta.pages.push_back(offset / CHUNK_SIZE);
+			oldPages.insert(oldPages.end(), &state[offset], &state[offset] + length);
+			memcpy(&state[offset], &data[offset], length);
+		}
+	}
+	delta.size = (u32)oldPages.size();
+	if (!oldPages.empty())
+	{
+		uLongf compressedSize = compressBound(oldPages.size());
+		delta.data.resize(compressedSize);
+		if (compress2(delta.data.data(), &compressedSize, oldPages.data(), oldPages.size(), 1) != Z_OK)
+		{
+			Reset();
+			return false;
+		}
+		delta.data.resize(compressedSize);
+		delta.data.shrink_to_fit();
+	}
+	deltaSize += delta.data.size() + delta.pages.size() * sizeof(u32);
+	deltas.push_back(std::move(delta));
+	while (deltaSize > maxSize)
+	{
+		deltaSize -= deltas.front().data.size() + deltas.front().pages.size() * sizeof(u32);
+		deltas.pop_front();
+	}
+
+	return true;
+}
+
+bool RewindBuffer::Rewind()
+{
+	Wait();
+	if (state.empty())
+		return false;
+	if (!restored)
+	{
+		restored = true;
+		return true;
+	}
+	if (deltas.empty())
+		return false;
+
+	Delta& delta = deltas.back();
+	if (delta.size > 0)
+	{
+		oldPages.resize(delta.size);
+		uLongf size = delta.size;
+		if (uncompress(oldPages.data(), &size, delta.data.data(), delta.data.size()) != Z_OK || size != delta.size)
+		{
+			Clear();
+			return false;
+		}
+		const u8 *pageData = oldPages.data();
+		for (u32 page : delta.pages)
+		{
+			u32 length = std::min<size_t>(CHUNK_SIZE, state.size() - page * CHUNK_SIZE);
+			memcpy(&state[page * CHUNK_SIZE], pageData, length);
+			pageData += length;
+		}
+	}
+	deltaSize -= delta.data.size() + delta.pages.size() * sizeof(u32);
+	deltas.pop_back();
+
+	return true;
+}
+
+void RewindBuffer::Clear()
+{
+	Wait();
+	Reset();
+}
+
+void RewindBuffer::Reset()
+{
+	deltas.clear();
+	deltaSize = 0;
+	state.clear();
+	state.shrink_to_fit();
+	restored = false;
+}
+
+static std::unique_ptr<RewindBuffer> rewindBuffer;
+static std::atomic<bool> rewinding;
+static u32 frames;
+enum class RewindAction { None, Snapshot, StepBack };
+static RewindAction pending_action = RewindAction::None;
+
+void rewind_vblank()
+{
+	if (!settings.rewind.Enable)
+	{
+		rewindBuffer.reset();
+		return;
+	}
+	frames++;
+	if (rewinding)
+	{
+		if (frames < REWIND_FRAMES)
+			return;
+		pending_action = RewindAction::StepBack;
+	}
+	else
+	{
+		if (frames < SNAPSHOT_FRAMES)
+			return;
+		pending_action = RewindAction::Snapshot;
+	}
+	frames = 0;
+	sh4_cpu.Stop();
+}
+
+void rewind_set_active(bool active)
+{
+	rewinding = active;
+}
+
+bool rewind_run()
+{
+	RewindAction action = pending_action;
+	pending_action = RewindAction::None;
+	switch (action)
+	{
+	case RewindAction::Snapshot:
+		if (rewindBuffer == nullptr)
+			rewindBuffer = std::unique_ptr<RewindBuffer>(new RewindBuffer((size_t)settings.rewind.BufferSize * 1024 * 1024));
+		if (!rewindBuffer->Snapshot())
+			WARN_LOG(SAVESTATE, "Rewind snapshot failed");
+		return true;
+
+	case RewindAction::StepBack:
+		if (rewindBuffer != nullptr && rewindBuffer->Rewind())
+		{
+			if (!dc_restore_state(rewindBuffer->State(), rewindBuffer->StateSize()))
+			{
+				WARN_LOG(SAVESTATE, "Rewind failed");
+				rewindBuffer->Clear();
+			}
+		}
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+void rewind_reset()
+{
+	if (rewindBuffer != nullptr)
+		rewindBuffer->Clear();
+	pending_action = RewindAction::None;
+	frames = 0;
+}
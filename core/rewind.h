@@ -0,0 +1,86 @@
+/*
+	Copyright 2020 flyinghead
+
+	This file is part of flycast.
+
+    flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "types.h"
+#include "savestate.h"
+#include <deque>
+#include <future>
+#include <vector>
+
+//
+// In-memory savestate history.
+// Only the last snapshot is kept in full. For each older one, the pages of the serialized state
+// that changed in the following snapshot are kept zlib-compressed, up to a maximum size.
+// Snapshots are compared and compressed in the background.
+//
+class RewindBuffer
+{
+public:
+	static constexpr u32 CHUNK_SIZE = 4096;
+
+	RewindBuffer(size_t maxSize) : maxSize(maxSize) {}
+
+	// Captures the current emulator state
+	bool Snapshot();
+	// Waits until the last snapshot is added to the history. Returns false if it failed.
+	bool Wait();
+	// Goes back to the previous snapshot. The first call after Snapshot() keeps the last one.
+	// Returns false if the history is empty.
+	bool Rewind();
+	void Clear();
+
+	const u8 *State() const { return state.data(); }
+	u32 StateSize() const { return (u32)state.size(); }
+	// Number of snapshots older than the current one
+	size_t Count() const { return deltas.size(); }
+	// Memory used by older snapshots
+	size_t DeltaSize() const { return deltaSize; }
+
+private:
+	struct Delta
+	{
+		std::vector<u32> pages;
+		u32 size;				// uncompressed size
+		std::vector<u8> data;
+	};
+
+	// Adds the captured state to the history
+	bool Update();
+	void Reset();
+
+	size_t maxSize;
+	std::vector<u8> state;
+	bool restored = false;
+	std::deque<Delta> deltas;
+	size_t deltaSize = 0;
+	std::vector<u8> oldPages;
+
+	StateSnapshot capture;
+	std::future<bool> pending;
+};
+
+// Called at each vblank on the emulator thread
+void rewind_vblank();
+// Rewind while the hotkey is held
+void rewind_set_active(bool active);
+// Called by dc_run when the sh4 stops. Takes a snapshot or steps back if requested.
+// Returns true if the emulation must resume.
+bool rewind_run();
+// Forget the history, when a game is started, reset or loaded from a savestate
+void rewind_reset();
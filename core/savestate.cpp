@@ -0,0 +1,252 @@
+/*
+	Copyright 2020 flyinghead
+
+	This file is part of flycast.
+
+    flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+//
+// Save state files start with a header and a table of chunks, followed by the chunk data.
+// Each section of the serialized state is cut into chunks of 1 MB at most,
+// which are zlib-compressed in parallel. Chunks that don't compress are stored as is.
+// Files without the header are uncompressed states from older versions.
+//
+#include "savestate.h"
+#include "hw/mem/vmem_snapshot.h"
+#include "rend/gui.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <thread>
+#include <zlib.h>
+
+constexpr u32 STATE_MAGIC = 0x54534346;	// "FCST"
+constexpr u32 STATE_VERSION = 1;
+constexpr u32 STATE_CHUNK_SIZE = 1024 * 1024;
+
+struct StateHeader
+{
+	u32 magic;
+	u32 version;
+	u32 size;			// uncompressed state size
+	u32 chunkCount;
+};
+
+struct StateChunk
+{
+	u32 section;
+	u32 offset;
+	u32 size;
+	u32 compressedSize;	// equal to size if not compressed
+};
+
+std::vector<StateRange> *serialize_sections;
+static std::future<bool> pending_write;
+
+// Calls func(i) for i in [0, count) on all cores
+static void parallel_for(u32 count, const std::function<void(u32)>& func)
+{
+	std::atomic<u32> next(0);
+	auto worker = [&]() {
+		for (u32 i = next++; i < count; i = next++)
+			func(i);
+	};
+	const u32 thread_count = std::max(1u, std::min(std::thread::hardware_concurrency(), count));
+	std::vector<std::thread> threads;
+	for (u32 i = 1; i < thread_count; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+static bool savestate_write(const std::string& path, const std::vector<u8>& state, const std::vector<StateRange>& sections)
+{
+	std::vector<StateChunk> chunks;
+	for (size_t i = 0; i < sections.size(); i++)
+	{
+		u32 end = i + 1 < sections.size() ? sections[i + 1].offset : (u32)state.size();
+		for (u32 offset = sections[i].offset; offset < end; offset += STATE_CHUNK_SIZE)
+		{
+			u32 size = std::min(end - offset, STATE_CHUNK_SIZE);
+			chunks.push_back({ (u32)sections[i].section, offset, size, size });
+		}
+	}
+	std::vector<std::vector<u8>> compressed(chunks.size());
+	parallel_for(chunks.size(), [&](u32 i) {
+		StateChunk& chunk = chunks[i];
+		uLongf size = compressBound(chunk.size);
+		compressed[i].resize(size);
+		if (compress2(compressed[i].data(), &size, &state[chunk.offset], chunk.size, 1) == Z_OK && size < chunk.size)
+		{
+			compressed[i].resize(size);
+			chunk.compressedSize = size;
+		}
+		else
+		{
+			compressed[i].clear();
+		}
+	});
+
+	std::string temp_path = path + ".tmp";
+	FILE *f = fopen(temp_path.c_str(), "wb");
+	if (f == nullptr)
+	{
+		WARN_LOG(SAVESTATE, "Failed to save state - could not open %s for writing", temp_path.c_str());
+		return false;
+	}
+	StateHeader header = { STATE_MAGIC, STATE_VERSION, (u32)state.size(), (u32)chunks.size() };
+	bool written = fwrite(&header, sizeof(header), 1, f) == 1
+			&& fwrite(chunks.data(), sizeof(StateChunk), chunks.size(), f) == chunks.size();
+	for (size_t i = 0; i < chunks.size() && written; i++)
+	{
+		if (chunks[i].compressedSize != chunks[i].size)
+			written = fwrite(compressed[i].data(), 1, compressed[i].size(), f) == compressed[i].size();
+		else
+			written = fwrite(&state[chunks[i].offset], 1, chunks[i].size, f) == chunks[i].size;
+		std::vector<u8>().swap(compressed[i]);
+	}
+	written = fclose(f) == 0 && written;
+	if (written)
+	{
+		// rename() doesn't replace existing files on Windows
+		remove(path.c_str());
+		written = rename(temp_path.c_str(), path.c_str()) == 0;
+	}
+	if (!written)
+	{
+		WARN_LOG(SAVESTATE, "Failed to save state - I/O error writing %s", path.c_str());
+		remove(temp_path.c_str());
+		return false;
+	}
+	INFO_LOG(SAVESTATE, "Saved state to %s size %d", path.c_str(), (int)state.size());
+
+	return true;
+}
+
+bool StateSnapshot::Capture(std::vector<StateRange> *sections, bool copyOnWrite)
+{
+	Complete();
+	unsigned int size = 0;
+	void *p = nullptr;
+	if (!dc_serialize(&p, &size))
+		return false;
+	data.resize(size);
+	p = data.data();
+	size = 0;
+	serialize_sections = sections;
+	pending = copyOnWrite && vmem_snapshot_start();
+	bool rc = dc_serialize(&p, &size);
+	serialize_sections = nullptr;
+	if (pending)
+		vmem_snapshot_protect();
+	if (!rc)
+		Complete();
+
+	return rc;
+}
+
+void StateSnapshot::Complete()
+{
+	if (pending)
+	{
+		vmem_snapshot_complete();
+		pending = false;
+	}
+}
+
+void savestate_write_async(const std::string& path, const std::shared_ptr<StateSnapshot>& state, std::vector<StateRange>&& sections)
+{
+	savestate_wait();
+	if (sections.empty() || sections[0].offset != 0)
+		sections.insert(sections.begin(), StateRange{ StateSection::System, 0 });
+
+	pending_write = std::async(std::launch::async, [](std::string path, std::shared_ptr<StateSnapshot> state, std::vector<StateRange> sections) {
+		state->Complete();
+		bool rc = savestate_write(path, state->Data(), sections);
+		if (rc)
+			gui_display_notification("State saved", 1000);
+		else
+			gui_display_notification("Save state failed", 2000);
+		return rc;
+	}, path, state, std::move(sections));
+}
+
+bool savestate_wait()
+{
+	if (!pending_write.valid())
+		return true;
+	return pending_write.get();
+}
+
+bool savestate_read(FILE *file, std::vector<u8>& state)
+{
+	fseek(file, 0, SEEK_END);
+	const size_t file_size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	StateHeader header {};
+	if (file_size < sizeof(header) || fread(&header, sizeof(header), 1, file) != 1 || header.magic != STATE_MAGIC)
+	{
+		// Uncompressed state
+		state.resize(file_size);
+		fseek(file, 0, SEEK_SET);
+		return fread(state.data(), 1, file_size, file) == file_size;
+	}
+	if (header.version > STATE_VERSION)
+	{
+		WARN_LOG(SAVESTATE, "Unsupported save state version %d", header.version);
+		return false;
+	}
+	if ((u64)header.chunkCount * sizeof(StateChunk) > file_size - sizeof(header))
+		return false;
+	std::vector<StateChunk> chunks(header.chunkCount);
+	if (fread(chunks.data(), sizeof(StateChunk), chunks.size(), file) != chunks.size())
+		return false;
+
+	std::vector<u8> data(file_size - sizeof(header) - chunks.size() * sizeof(StateChunk));
+	if (fread(data.data(), 1, data.size(), file) != data.size())
+		return false;
+	std::vector<size_t> data_offsets;
+	size_t data_offset = 0;
+	for (const StateChunk& chunk : chunks)
+	{
+		if ((u64)chunk.offset + chunk.size > header.size || chunk.compressedSize > chunk.size
+				|| data_offset + chunk.compressedSize > data.size())
+			return false;
+		data_offsets.push_back(data_offset);
+		data_offset += chunk.compressedSize;
+	}
+
+	state.resize(header.size);
+	std::atomic<bool> success(true);
+	parallel_for(chunks.size(), [&](u32 i) {
+		const StateChunk& chunk = chunks[i];
+		if (chunk.compressedSize == chunk.size)
+		{
+			memcpy(&state[chunk.offset], &data[data_offsets[i]], chunk.size);
+		}
+		else
+		{
+			uLongf size = chunk.size;
+			if (uncompress(&state[chunk.offset], &size, &data[data_offsets[i]], chunk.compressedSize) != Z_OK
+					|| size != chunk.size)
+				success = false;
+		}
+	});
+
+	return success;
+}
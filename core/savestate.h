@@ -0,0 +1,74 @@
+/*
+	Copyright 2020 flyinghead
+
+	This file is part of flycast.
+
+    flycast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    flycast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with flycast.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#pragma once
+#include "types.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Subsystems of the serialized state
+enum class StateSection : u32
+{
+	AICA,
+	System,
+	GDROM,
+	Maple,
+	PVR,
+	VRAM,
+	SH4,
+	RAM,
+	Naomi,
+};
+
+// A section starts at the given offset and ends where the next one starts
+struct StateRange
+{
+	StateSection section;
+	u32 offset;
+};
+
+// Set to record the sections of the next dc_serialize() call
+extern std::vector<StateRange> *serialize_sections;
+
+// A serialized emulator state. Guest memory is copied after the capture, as it's written or by Complete().
+class StateSnapshot
+{
+public:
+	~StateSnapshot() { Complete(); }
+
+	// Serializes the emulator state and records its sections if not null. The emulator must be stopped.
+	// Guest memory is copied on write if possible, unless copyOnWrite is false.
+	bool Capture(std::vector<StateRange> *sections = nullptr, bool copyOnWrite = true);
+	// Copies the guest memory not written since the capture. Can be called from any thread.
+	void Complete();
+
+	const std::vector<u8>& Data() const { return data; }
+
+private:
+	std::vector<u8> data;
+	bool pending = false;
+};
+
+// Compresses a captured state and writes it to the given file in the background
+void savestate_write_async(const std::string& path, const std::shared_ptr<StateSnapshot>& state, std::vector<StateRange>&& sections);
+// Waits for the last write to complete. Returns false if it failed.
+bool savestate_wait();
+// Reads a compressed or uncompressed state file
+bool savestate_read(FILE *file, std::vector<u8>& state);
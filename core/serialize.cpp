@@ -16,7 +16,10 @@
 #include "hw/sh4/dyna/blockmanager.h"
 #include "hw/naomi/naomi_cart.h"
 #include "hw/sh4/sh4_cache.h"
+#include "hw/mem/vmem_snapshot.h"
+#include "savestate.h"
 
+#define REICAST_SECTION(id) do { if (serialize_sections != nullptr) serialize_sections->push_back({ StateSection::id, *total_size }); } while (false)
 #define REICAST_SKIP(size) do { if (*data) *(u8**)data += (size); *total_size += (size); } while (false)
 
 extern "C" void DYNACALL TAWriteSQ(u32 address,u8* sqb);
@@ -88,6 +91,8 @@ extern ata_cmd_t ata_cmd ;
 extern cdda_t cdda ;
 extern gd_states gd_state;
 extern DiscType gd_disk_type;
+extern u32 head_fad;
+extern int read_seek_ticks;
 extern u32 data_write_mode;
 //Registers
 extern u32 DriveSel;
@@ -225,7 +230,8 @@ bool rc_serialize(const void *src, unsigned int src_size, void **dest, unsigned
 {
 	if ( *dest != NULL )
 	{
-		memcpy(*dest, src, src_size) ;
+		if (!vmem_snapshot_defer(*dest, src, src_size))
+			memcpy(*dest, src, src_size) ;
 		*dest = ((unsigned char*)*dest) + src_size ;
 	}
 
@@ -275,7 +281,7 @@ bool dc_serialize(void **data, unsigned int *total_size)
 {
 	int i = 0;
 
-	serialize_version_enum version = V11;
+	serialize_version_enum version = V12;
 
 	*total_size = 0 ;
 
@@ -283,6 +289,7 @@ bool dc_serialize(void **data, unsigned int *total_size)
 	if ( p_sh4rcb == NULL )
 		return false ;
 
+	REICAST_SECTION(AICA);
 	REICAST_S(version) ;
 	REICAST_S(aica_interr) ;
 	REICAST_S(aica_reg_L) ;
@@ -317,6 +324,7 @@ bool dc_serialize(void **data, unsigned int *total_size)
 	REICAST_SA(cdda_sector,CDDA_SIZE);
 	REICAST_S(cdda_index);
 
+	REICAST_SECTION(System);
 	register_serialize(sb_regs, data, total_size) ;
 	REICAST_S(SB_ISTNRM);
 	REICAST_S(SB_FFST_rc);
@@ -326,6 +334,7 @@ bool dc_serialize(void **data, unsigned int *total_size)
 	sys_rom->Serialize(data, total_size);
 	sys_nvmem->Serialize(data, total_size);
 
+	REICAST_SECTION(GDROM);
 	REICAST_S(GD_HardwareInfo);
 
 
@@ -355,6 +364,7 @@ bool dc_serialize(void **data, unsigned int *total_size)
 	REICAST_S(ByteCount);
 
 
+	REICAST_SECTION(Maple);
 	REICAST_SA(EEPROM,0x100);
 	REICAST_S(EEPROM_loaded);
 
@@ -363,6 +373,7 @@ bool dc_serialize(void **data, unsigned int *total_size)
 
 	mcfg_SerializeDevices(data, total_size);
 
+	REICAST_SECTION(PVR);
 	REICAST_SA(YUV_tempdata,512/4);
 	REICAST_S(YUV_dest);
 	REICAST_S(YUV_blockcount);
@@ -381,8 +392,10 @@ bool dc_serialize(void **data, unsigned int *total_size)
 
 	SerializeTAContext(data, total_size);
 
+	REICAST_SECTION(VRAM);
 	REICAST_SA(vram.data, vram.size);
 
+	REICAST_SECTION(SH4);
 	REICAST_SA(OnChipRAM.data(), OnChipRAM_SIZE);
 
 	register_serialize(CCN, data, total_size) ;
@@ -398,8 +411,10 @@ bool dc_serialize(void **data, unsigned int *total_size)
 	icache.Serialize(data, total_size);
 	ocache.Serialize(data, total_size);
 
+	REICAST_SECTION(RAM);
 	REICAST_SA(mem_b.data, mem_b.size);
 
+	REICAST_SECTION(SH4);
 	REICAST_SA(InterruptEnvId,32);
 	REICAST_SA(InterruptBit,32);
 	REICAST_SA(InterruptLevelBit,16);
@@ -491,9 +506,11 @@ bool dc_serialize(void **data, unsigned int *total_size)
 	REICAST_S(sq_remap);
 	REICAST_S(ITLB_LRU_USE);
 
+	REICAST_SECTION(GDROM);
 	REICAST_S(NullDriveDiscType);
 	REICAST_SA(q_subchannel,96);
 
+	REICAST_SECTION(Naomi);
 	REICAST_S(GSerialBuffer);
 	REICAST_S(BSerialBuffer);
 	REICAST_S(GBufPos);
@@ -518,14 +535,19 @@ bool dc_serialize(void **data, unsigned int *total_size)
 	REICAST_S(reg_dimm_parameterh);
 	REICAST_S(reg_dimm_status);
 
+	REICAST_SECTION(System);
 	REICAST_S(settings.dreamcast.broadcast);
 	REICAST_S(settings.dreamcast.cable);
 	REICAST_S(settings.dreamcast.region);
 
+	REICAST_SECTION(Naomi);
 	if (CurrentCartridge != NULL)
 	   CurrentCartridge->Serialize(data, total_size);
 	
+	REICAST_SECTION(GDROM);
 	gd_hle_state.Serialize(data, total_size);
+	REICAST_S(head_fad);
+	REICAST_S(read_seek_ticks);
 
 	DEBUG_LOG(SAVESTATE, "Saved %d bytes", *total_size);
 
@@ -812,6 +834,8 @@ static bool dc_unserialize_libretro(void **data, unsigned int *total_size)
 	if (CurrentCartridge != NULL)
 		CurrentCartridge->Unserialize(data, total_size);
 	gd_hle_state.Unserialize(data, total_size);
+	head_fad = 150;
+	read_seek_ticks = 0;
 
 	DEBUG_LOG(SAVESTATE, "Loaded %d bytes (libretro compat)", *total_size);
 
@@ -1195,6 +1219,16 @@ bool dc_unserialize(void **data, unsigned int *total_size)
 		CurrentCartridge->Unserialize(data, total_size);
 	if (version >= V6)
 		gd_hle_state.Unserialize(data, total_size);
+	if (version >= V12)
+	{
+		REICAST_US(head_fad);
+		REICAST_US(read_seek_ticks);
+	}
+	else
+	{
+		head_fad = 150;
+		read_seek_ticks = 0;
+	}
 
 	DEBUG_LOG(SAVESTATE, "Loaded %d bytes", *total_size);
 
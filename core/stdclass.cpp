@@ -1,14 +1,15 @@
 #include "types.h"
 #include "stdclass.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <dirent.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <vector>
 
 #ifdef _WIN32
-	#include <algorithm>
 	#include <io.h>
 	#include <direct.h>
 	#define access _access
@@ -151,6 +152,48 @@ bool make_directory(const std::string& path)
 	return mkdir(path.c_str(), 0755) == 0;
 }
 
+void trim_directory(const std::string& path, u64 max_size)
+{
+	struct File
+	{
+		std::string path;
+		u64 size;
+		time_t mtime;
+	};
+	std::vector<File> files;
+	u64 totalSize = 0;
+
+	DIR *dir = opendir(path.c_str());
+	if (dir == NULL)
+		return;
+	const std::string dir_path = path.empty() || path.back() == '/' ? path : path + "/";
+	while (true)
+	{
+		struct dirent *entry = readdir(dir);
+		if (entry == NULL)
+			break;
+		std::string child_path = dir_path + entry->d_name;
+		struct stat st;
+		if (stat(child_path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+			continue;
+		files.push_back({ child_path, (u64)st.st_size, st.st_mtime });
+		totalSize += st.st_size;
+	}
+	closedir(dir);
+
+	std::sort(files.begin(), files.end(), [](const File& a, const File& b) { return a.mtime < b.mtime; });
+	for (const File& file : files)
+	{
+		if (totalSize <= max_size)
+			break;
+		if (remove(file.path.c_str()) == 0)
+		{
+			DEBUG_LOG(COMMON, "Deleted %s", file.path.c_str());
+			totalSize -= file.size;
+		}
+	}
+}
+
 void cThread::Start()
 {
 	verify(!thread.joinable());
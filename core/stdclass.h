@@ -62,6 +62,8 @@ std::string get_readonly_config_path(const std::string& filename);
 std::string get_readonly_data_path(const std::string& filename);
 bool file_exists(const std::string& filename);
 bool make_directory(const std::string& path);
+// Deletes the oldest files of the directory until their total size is at most max_size
+void trim_directory(const std::string& path, u64 max_size);
 
 std::string get_game_save_prefix();
 std::string get_game_basename();
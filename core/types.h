@@ -348,6 +348,12 @@ enum class JVS {
 	WaveRunnerGP,
 };
 
+enum class GDRomTiming {
+	Default,	// fixed transfer delays
+	Accurate,	// seek, rotation and transfer rate of the drive
+	Instant,	// whole transfers at once
+};
+
 struct settings_t
 {
 	struct {
@@ -400,6 +406,10 @@ struct settings_t
 		bool safemode;
 		bool disable_nvmem;
 		bool disable_vmem32;
+		bool vmem32_batch_remap;	// only unmap the changed translations when the ASID changes
+		bool vmem32_prefault;
+		bool block_cache;
+		bool superblocks;
 	} dynarec;
 
 	struct
@@ -458,8 +468,15 @@ struct settings_t
 	{
 		bool PatchRegion;
 		char ImagePath[512];
+		GDRomTiming LoadTiming;
 	} imgread;
 
+	struct
+	{
+		bool Enable;
+		u32 BufferSize;		// in MB, for the snapshots older than the last one
+	} rewind;
+
 	struct
 	{
 		u32 ta_skip;
@@ -467,6 +484,7 @@ struct settings_t
 
 		u32 MaxThreads;
 		bool SynchronousRender;
+		u32 RenderQueueDepth;
 
 		bool IsOpenGL() { return rend == 0 || rend == 3; }
 	} pvr;
@@ -529,6 +547,7 @@ void libCore_gdrom_disc_change();
 
 //IO
 void libGDR_ReadSector(u8 * buff,u32 StartSector,u32 SectorCount,u32 secsz);
+void libGDR_ReadAhead(u32 StartSector,u32 SectorCount);
 void libGDR_ReadSubChannel(u8 * buff, u32 format, u32 len);
 void libGDR_GetToc(u32* toc,u32 area);
 u32 libGDR_GetDiscType();
@@ -623,4 +642,5 @@ enum serialize_version_enum {
 	V9 = 804,
 	V10 = 805,
 	V11 = 806,
+	V12 = 807,
 } ;
@@ -115,6 +115,8 @@ PCHAR*
 bool VramLockedWrite(u8* address);
 bool ngen_Rewrite(unat& addr,unat retadr,unat acc);
 bool BM_LockedWrite(u8* address);
+bool naomi_cart_PageIn(void *address);
+bool vmem_snapshot_write_fault(void *address);
 
 static std::shared_ptr<WinKbGamepadDevice> kb_gamepad;
 static std::shared_ptr<WinMouseGamepadDevice> mouse_gamepad;
@@ -151,7 +153,11 @@ LONG ExeptionHandler(EXCEPTION_POINTERS *ExceptionInfo)
 	if (vmem32_handle_signal(address, write, 0))
 		return EXCEPTION_CONTINUE_EXECUTION;
 #endif
-	if (bm_RamWriteAccess(address))
+	if (vmem_snapshot_write_fault(address))
+	{
+		return EXCEPTION_CONTINUE_EXECUTION;
+	}
+	else if (bm_RamWriteAccess(address))
 	{
 		return EXCEPTION_CONTINUE_EXECUTION;
 	}
@@ -163,6 +169,10 @@ LONG ExeptionHandler(EXCEPTION_POINTERS *ExceptionInfo)
 	{
 		return EXCEPTION_CONTINUE_EXECUTION;
 	}
+	else if (naomi_cart_PageIn(address))
+	{
+		return EXCEPTION_CONTINUE_EXECUTION;
+	}
 #if FEAT_SHREC == DYNAREC_JIT
 #if HOST_CPU == CPU_X86
 		else if ( ngen_Rewrite((unat&)ep->ContextRecord->Eip,*(unat*)ep->ContextRecord->Esp,ep->ContextRecord->Eax) )
@@ -0,0 +1,244 @@
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "emulator.h"
+#include "hw/mem/_vmem.h"
+#include "hw/aica/aica.h"
+#include "hw/aica/aica_if.h"
+#include "hw/aica/aica_mem.h"
+#include "hw/aica/dsp.h"
+#include "hw/aica/sgc_if.h"
+#include "oslib/audiostream.h"
+#include "oslib/oslib.h"
+
+void install_fault_handler();
+
+// Compares the batched channel mixing (AICA_Sample32) with the per-sample one (AICA_Sample)
+class AicaTest : public ::testing::Test {
+protected:
+	struct Mix
+	{
+		std::vector<SampleType> left;
+		std::vector<SampleType> right;
+		std::vector<SampleType> dspInput;	// MIXS of each sample
+	};
+
+	void SetUp() override
+	{
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		dc_init();
+		install_fault_handler();
+		savedSettings = settings;
+		settings.aica.NoSound = false;
+		settings.aica.CDDAMute = true;
+	}
+
+	void TearDown() override
+	{
+		if (audioStarted)
+		{
+			TermAudio();
+			NullAudioCapture(false);
+		}
+		settings = savedSettings;
+	}
+
+	static void writeReg(u32 addr, u32 value)
+	{
+		libAICA_WriteReg(addr, value, 2);
+	}
+
+	// Resets the AICA and starts the same set of channels: all sample formats, with and without loop,
+	// LFOs and filter, various pitches, volumes, pans and DSP sends
+	static void startChannels(bool dspEnabled)
+	{
+		dc_reset(true);
+		settings.aica.DSPEnabled = dspEnabled;
+
+		std::mt19937 rng(11);
+		for (u32 i = 0; i < 0x100000; i++)
+			aica_ram[i] = (u8)rng();
+
+		for (u32 ch = 0; ch < 12; ch++)
+		{
+			const u32 base = ch * 0x80;
+			const u32 sa = 0x10000 + ch * 0x8000;
+			const u32 pcms = ch % 3;
+			const u32 loop = ch % 4 != 3;
+			writeReg(base + 0x04, sa & 0xFFFF);
+			writeReg(base + 0x08, 0x100);							// LSA
+			writeReg(base + 0x0C, 0x3000 + ch * 0x100);				// LEA
+			writeReg(base + 0x10, 0x1F | (ch << 6) | ((ch + 4) << 11));	// AR, D1R, D2R
+			writeReg(base + 0x14, 0x10 | ((ch * 2) << 5));			// RR, DL
+			writeReg(base + 0x18, ((rng() & 0x3FF)) | (((ch % 5) - 2) & 0xF) << 11);	// FNS, OCT
+			if (ch % 2 == 1)
+				// LFOs: ALFOS, ALFOWS, PLFOS, PLFOWS, LFOF
+				writeReg(base + 0x1C, (ch % 8) | ((ch % 4) << 3) | ((7 - ch % 8) << 5) | (((ch + 1) % 4) << 8) | ((ch * 3) << 10));
+			writeReg(base + 0x20, (ch % 16) | ((15 - ch) << 4));	// ISEL, IMXL
+			// No direct output for some channels: they use the DSP send when the DSP is disabled
+			writeReg(base + 0x24, ((ch * 5) & 0x1F) | ((ch % 6 == 2 ? 0 : 15 - ch) << 8));	// DIPAN, DISDL
+			writeReg(base + 0x28, (ch % 8) | ((ch % 3 == 0) << 5) | ((ch * 12) << 8));	// Q, LPOFF, TL
+			for (u32 i = 0; i < 5; i++)
+				writeReg(base + 0x2C + i * 4, rng() & 0x1FFF);		// FLV0-4
+			writeReg(base + 0x40, 0x1F00 | (ch + 2));				// FAR, FD1R
+			writeReg(base + 0x44, ((ch + 8) << 8) | 0x10);			// FD2R, FRR
+			writeReg(base + 0x00, (sa >> 16) | (pcms << 7) | (loop << 9) | (1 << 14));	// SA, PCMS, LPCTL, KYONB
+		}
+		// KYONEX
+		writeReg(0x00, ReadMemArr<2>(aica_reg, 0) | (1 << 15));
+
+		writeReg(0x2800, 0xF);	// MVOL
+		// DSP program: EFREG0 = MIXS0 * COEF0, EFREG1 = MIXS3 * COEF2
+		memset(DSPData->MPRO, 0, sizeof(DSPData->MPRO));
+		DSPData->MPRO[0 * 4 + 1] = 0xB000;	// XSEL IRA=0x20 YSEL=1
+		DSPData->MPRO[0 * 4 + 2] = 0x0002;	// ZERO
+		DSPData->MPRO[1 * 4 + 2] = 0x1002;	// EWT EWA=0 ZERO
+		DSPData->MPRO[2 * 4 + 1] = 0xB180;	// XSEL IRA=0x23 YSEL=1
+		DSPData->MPRO[2 * 4 + 2] = 0x0002;	// ZERO
+		DSPData->MPRO[3 * 4 + 2] = 0x1102;	// EWT EWA=1 ZERO
+		DSPData->COEF[0] = 0x6000;
+		DSPData->COEF[2] = 0x5000;
+		dsp.dyndirty = true;
+		writeReg(0x2000, 0xF00 | 0x03);	// EFSDL, EFPAN
+		writeReg(0x2004, 0xC00 | 0x13);
+	}
+
+	static Mix mixPerSample(u32 samples)
+	{
+		Mix mix;
+		for (u32 i = 0; i < samples; i++)
+		{
+			SampleType l = 0;
+			SampleType r = 0;
+			memset(dsp.MIXS, 0, sizeof(dsp.MIXS));
+			sgc_MixChannels(l, r);
+			mix.left.push_back(l);
+			mix.right.push_back(r);
+			if (settings.aica.DSPEnabled)
+				mix.dspInput.insert(mix.dspInput.end(), std::begin(dsp.MIXS), std::end(dsp.MIXS));
+		}
+		return mix;
+	}
+
+	static Mix mixBatched(u32 samples)
+	{
+		Mix mix;
+		for (u32 i = 0; i < samples; i += 32)
+		{
+			alignas(16) SampleType l[32] {};
+			alignas(16) SampleType r[32] {};
+			alignas(16) SampleType mixs[16][32] {};
+			sgc_MixChannels32(l, r, settings.aica.DSPEnabled ? mixs : nullptr);
+			mix.left.insert(mix.left.end(), std::begin(l), std::end(l));
+			mix.right.insert(mix.right.end(), std::begin(r), std::end(r));
+			if (settings.aica.DSPEnabled)
+				for (u32 s = 0; s < 32; s++)
+					for (u32 j = 0; j < 16; j++)
+						mix.dspInput.push_back(mixs[j][s]);
+		}
+		return mix;
+	}
+
+	// Some channel state, like the filter history, survives a reset so both paths must start from the same savestate
+	static std::vector<u8> saveState()
+	{
+		unsigned int total_size = 0;
+		void *data = nullptr;
+		dc_serialize(&data, &total_size);
+		std::vector<u8> state(total_size);
+		data = state.data();
+		total_size = 0;
+		dc_serialize(&data, &total_size);
+		return state;
+	}
+
+	static void loadState(std::vector<u8>& state)
+	{
+		void *data = state.data();
+		unsigned int total_size = 0;
+		ASSERT_TRUE(dc_unserialize(&data, &total_size));
+		dsp.dyndirty = true;
+	}
+
+	// Waits for the audio thread to push the given number of frames to the backend
+	static std::vector<u32> capture(size_t count)
+	{
+		std::vector<u32> frames;
+		auto start = std::chrono::steady_clock::now();
+		while (frames.size() < count && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+		{
+			std::vector<u32> captured = NullAudioCaptured();
+			frames.insert(frames.end(), captured.begin(), captured.end());
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return frames;
+	}
+
+	// Outputs the same samples with AICA_Sample and AICA_Sample32 and compares them
+	void checkOutput(bool dspEnabled)
+	{
+		settings.audio.backend = "null";
+		// The audio output paces the emulator: frames are output unchanged
+		settings.aica.LimitFPS = true;
+		NullAudioCapture(true);
+		InitAudio();
+		audioStarted = true;
+
+		const u32 samples = 512 * 8;
+		startChannels(dspEnabled);
+		std::vector<u8> state = saveState();
+		for (u32 i = 0; i < samples; i++)
+			AICA_Sample();
+		loadState(state);
+		for (u32 i = 0; i < samples; i += 32)
+			AICA_Sample32();
+		// One frame is kept to interpolate with
+		WriteSample(0, 0);
+		std::vector<u32> frames = capture(samples * 2);
+
+		ASSERT_EQ(samples * 2, frames.size());
+		std::vector<u32> expected(frames.begin(), frames.begin() + samples);
+		std::vector<u32> actual(frames.begin() + samples, frames.end());
+		ASSERT_TRUE(std::any_of(expected.begin(), expected.end(), [](u32 f) { return f != 0; }));
+		ASSERT_EQ(expected, actual);
+	}
+
+	settings_t savedSettings;
+	bool audioStarted = false;
+};
+
+TEST_F(AicaTest, MixChannels)
+{
+	const u32 samples = 32 * 200;
+	for (bool dspEnabled : { false, true })
+	{
+		startChannels(dspEnabled);
+		std::vector<u8> state = saveState();
+		Mix expected = mixPerSample(samples);
+		loadState(state);
+		Mix actual = mixBatched(samples);
+
+		const char *name = dspEnabled ? "DSP enabled" : "DSP disabled";
+		ASSERT_TRUE(std::any_of(expected.left.begin(), expected.left.end(), [](SampleType s) { return s != 0; })) << name;
+		ASSERT_EQ(expected.left, actual.left) << name;
+		ASSERT_EQ(expected.right, actual.right) << name;
+		ASSERT_EQ(expected.dspInput, actual.dspInput) << name;
+		if (dspEnabled)
+			ASSERT_TRUE(std::any_of(expected.dspInput.begin(), expected.dspInput.end(), [](SampleType s) { return s != 0; }));
+	}
+}
+
+TEST_F(AicaTest, Output)
+{
+	checkOutput(false);
+}
+
+TEST_F(AicaTest, OutputDsp)
+{
+	checkOutput(true);
+}
@@ -0,0 +1,302 @@
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include <zlib.h>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "archive/archive.h"
+#include "archive/7zArchive.h"
+#include "hw/naomi/naomi_cart.h"
+
+extern Cartridge *CurrentCartridge;
+
+// Random access to zip members, through the on-disk cache for compressed ones
+class ArchiveTest : public ::testing::Test {
+protected:
+	struct Member
+	{
+		std::string name;
+		bool deflated;
+		std::vector<u8> data;
+	};
+
+	void SetUp() override
+	{
+		path = "archive_test.zip";
+		std::mt19937 rng(1);
+		members.push_back({ "stored.bin", false, randomData(rng, 3 * 1024 * 1024 + 1234) });
+		members.push_back({ "deflated.bin", true, randomData(rng, 5 * 1024 * 1024 + 99) });
+		// Kept in memory
+		members.push_back({ "small.bin", true, randomData(rng, 1000) });
+		writeZip();
+	}
+
+	void TearDown() override
+	{
+		remove(path.c_str());
+		for (const Member& member : members)
+			remove(cachePath(member).c_str());
+		rmdir("archive_cache");
+	}
+
+	// Compressible random data
+	static std::vector<u8> randomData(std::mt19937& rng, u32 size)
+	{
+		std::vector<u8> data(size);
+		for (u8& b : data)
+			b = rng() % 16;
+		return data;
+	}
+
+	static void put16(std::vector<u8>& v, u32 value)
+	{
+		v.push_back((u8)value);
+		v.push_back((u8)(value >> 8));
+	}
+
+	static void put32(std::vector<u8>& v, u32 value)
+	{
+		put16(v, value & 0xffff);
+		put16(v, value >> 16);
+	}
+
+	static u32 crc(const Member& member)
+	{
+		return crc32(0, member.data.data(), member.data.size());
+	}
+
+	std::string cachePath(const Member& member)
+	{
+		char name[32];
+		sprintf(name, "%08x-%08x.bin", crc(member), (u32)member.data.size());
+		return std::string("archive_cache/") + name;
+	}
+
+	void writeZip()
+	{
+		std::vector<u8> zip;
+		std::vector<u8> directory;
+		for (const Member& member : members)
+		{
+			std::vector<u8> data = member.data;
+			if (member.deflated)
+			{
+				z_stream stream {};
+				ASSERT_EQ(Z_OK, deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY));
+				data.resize(deflateBound(&stream, member.data.size()));
+				stream.next_in = (Bytef *)member.data.data();
+				stream.avail_in = member.data.size();
+				stream.next_out = data.data();
+				stream.avail_out = data.size();
+				ASSERT_EQ(Z_STREAM_END, deflate(&stream, Z_FINISH));
+				data.resize(stream.total_out);
+				deflateEnd(&stream);
+			}
+			const u32 localOffset = zip.size();
+			// local header with some extra data
+			put32(zip, 0x04034b50);
+			put16(zip, 20);
+			put16(zip, 0);
+			put16(zip, member.deflated ? 8 : 0);
+			put32(zip, 0);
+			put32(zip, crc(member));
+			put32(zip, data.size());
+			put32(zip, member.data.size());
+			put16(zip, member.name.size());
+			put16(zip, 7);
+			zip.insert(zip.end(), member.name.begin(), member.name.end());
+			zip.insert(zip.end(), 7, 0);
+			zip.insert(zip.end(), data.begin(), data.end());
+
+			put32(directory, 0x02014b50);
+			put16(directory, 20);
+			put16(directory, 20);
+			put16(directory, 0);
+			put16(directory, member.deflated ? 8 : 0);
+			put32(directory, 0);
+			put32(directory, crc(member));
+			put32(directory, data.size());
+			put32(directory, member.data.size());
+			put16(directory, member.name.size());
+			put16(directory, 0);
+			put16(directory, 0);
+			put16(directory, 0);
+			put16(directory, 0);
+			put32(directory, 0);
+			put32(directory, localOffset);
+			directory.insert(directory.end(), member.name.begin(), member.name.end());
+		}
+		const u32 directoryOffset = zip.size();
+		zip.insert(zip.end(), directory.begin(), directory.end());
+		put32(zip, 0x06054b50);
+		put16(zip, 0);
+		put16(zip, 0);
+		put16(zip, members.size());
+		put16(zip, members.size());
+		put32(zip, directory.size());
+		put32(zip, directoryOffset);
+		put16(zip, 0);
+
+		FILE *f = fopen(path.c_str(), "wb");
+		ASSERT_NE(nullptr, f);
+		fwrite(zip.data(), 1, zip.size(), f);
+		fclose(f);
+	}
+
+	// Reads the file at random offsets, backwards and forwards
+	static void checkRandomReads(ArchiveFile *file, const Member& member)
+	{
+		ASSERT_EQ(member.data.size(), file->Size());
+		std::mt19937 rng(2);
+		std::vector<u8> buffer;
+		for (int i = 0; i < 50; i++)
+		{
+			u32 offset = rng() % member.data.size();
+			u32 length = rng() % 300000;
+			buffer.resize(length);
+			u32 expected = std::min<u32>(length, member.data.size() - offset);
+			ASSERT_EQ(expected, file->ReadAt(offset, buffer.data(), length)) << member.name << " offset " << offset;
+			ASSERT_EQ(0, memcmp(&member.data[offset], buffer.data(), expected)) << member.name << " offset " << offset;
+		}
+	}
+
+	std::string path;
+	std::vector<Member> members;
+};
+
+TEST_F(ArchiveTest, Zip)
+{
+	std::unique_ptr<Archive> archive(OpenArchive(path.c_str()));
+	ASSERT_NE(nullptr, archive);
+
+	for (const Member& member : members)
+	{
+		std::unique_ptr<ArchiveFile> file(archive->OpenFile(member.name.c_str()));
+		ASSERT_NE(nullptr, file) << member.name;
+		// Compressed members can only be read in place once fully cached
+		ASSERT_EQ(!member.deflated, file->CanReadInPlace()) << member.name;
+		checkRandomReads(file.get(), member);
+		u8 last;
+		ASSERT_EQ(1u, file->ReadAt(member.data.size() - 1, &last, 1));
+		ASSERT_TRUE(file->CanReadInPlace()) << member.name;
+
+		// Sequential reads aren't affected by random ones
+		std::vector<u8> data(member.data.size());
+		u32 half = data.size() / 2;
+		ASSERT_EQ(half, file->Read(data.data(), half));
+		ASSERT_EQ(data.size() - half, file->Read(&data[half], data.size() - half + 100));
+		ASSERT_EQ(member.data, data);
+
+		file.reset(archive->OpenFileByCrc(crc(member)));
+		ASSERT_NE(nullptr, file) << member.name;
+		checkRandomReads(file.get(), member);
+	}
+	// Large compressed members are cached
+	FILE *f = fopen(cachePath(members[1]).c_str(), "rb");
+	ASSERT_NE(nullptr, f);
+	fclose(f);
+	f = fopen(cachePath(members[0]).c_str(), "rb");
+	ASSERT_EQ(nullptr, f);
+}
+
+TEST_F(ArchiveTest, CacheIsReused)
+{
+	const Member& member = members[1];
+	int sourceOpens = 0;
+	auto source = [&]() -> ArchiveFile* {
+		sourceOpens++;
+		return new SzArchiveFile((u8 *)member.data.data(), 0, member.data.size());
+	};
+	u8 byte;
+	{
+		// Only decompress the first 3 chunks
+		CachedArchiveFile file(crc(member), member.data.size(), source);
+		ASSERT_EQ(1u, file.ReadAt(CachedArchiveFile::CHUNK_SIZE * 2, &byte, 1));
+		ASSERT_EQ(member.data[CachedArchiveFile::CHUNK_SIZE * 2], byte);
+		ASSERT_EQ(1, sourceOpens);
+	}
+	{
+		// Resume from the 4th chunk
+		CachedArchiveFile file(crc(member), member.data.size(), source);
+		ASSERT_EQ(1u, file.ReadAt(0, &byte, 1));
+		ASSERT_EQ(1, sourceOpens);
+		checkRandomReads(&file, member);
+		ASSERT_EQ(2, sourceOpens);
+	}
+	{
+		CachedArchiveFile file(crc(member), member.data.size(), source);
+		checkRandomReads(&file, member);
+		ASSERT_EQ(2, sourceOpens);
+	}
+}
+
+class TestCartridge : public Cartridge
+{
+public:
+	TestCartridge(u32 size) : Cartridge(size) {}
+	u32 ReadMem(u32 address, u32 size) override { return 0; }
+	void WriteMem(u32 address, u32 data, u32 size) override {}
+	void* GetDmaPtr(u32 &size) override { return nullptr; }
+	void AdvancePtr(u32 size) override {}
+};
+
+static void pageInHandler(int sn, siginfo_t *si, void *context)
+{
+	if (!naomi_cart_PageIn(si->si_addr))
+		abort();
+}
+
+TEST_F(ArchiveTest, CartridgePaging)
+{
+	std::unique_ptr<Archive> archive(OpenArchive(path.c_str()));
+	ASSERT_NE(nullptr, archive);
+	const u32 romSize = 16 * 1024 * 1024;
+	// Read from the zip file, the cache file and memory
+	const u32 offsets[] = { 0x100000, 0x600000, 0xC00000 + 0x1234 };
+	TestCartridge cart(romSize);
+	if (!cart.IsPaged())
+		return;
+
+	struct sigaction act {}, oldAct, oldBusAct;
+	act.sa_sigaction = pageInHandler;
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = SA_SIGINFO;
+	sigaction(SIGSEGV, &act, &oldAct);
+	sigaction(SIGBUS, &act, &oldBusAct);
+	CurrentCartridge = &cart;
+
+	for (u32 i = 0; i < members.size(); i++)
+	{
+		ArchiveFile *file = archive->OpenFile(members[i].name.c_str());
+		ASSERT_NE(nullptr, file);
+		// Compressed members must be fully cached
+		u8 last;
+		ASSERT_EQ(1u, file->ReadAt(members[i].data.size() - 1, &last, 1));
+		cart.LoadOnAccess(offsets[i], members[i].data.size(), file, {});
+	}
+	std::vector<u8> data(romSize);
+	u32 size = 4;
+	// A read in the middle of the file, then everything
+	ASSERT_TRUE(cart.Read(offsets[0] + 0x123456, size, &data[0]));
+	ASSERT_EQ(0, memcmp(&members[0].data[0x123456], &data[0], size));
+	size = romSize;
+	memcpy(data.data(), cart.GetPtr(0, size), romSize);
+
+	CurrentCartridge = nullptr;
+	sigaction(SIGSEGV, &oldAct, nullptr);
+	sigaction(SIGBUS, &oldBusAct, nullptr);
+
+	u32 end = 0;
+	for (u32 i = 0; i < members.size(); i++)
+	{
+		// Areas not loaded are filled with 0xFF
+		ASSERT_EQ(std::vector<u8>(offsets[i] - end, 0xff), std::vector<u8>(data.begin() + end, data.begin() + offsets[i])) << members[i].name;
+		ASSERT_EQ(0, memcmp(&members[i].data[0], &data[offsets[i]], members[i].data.size())) << members[i].name;
+		end = offsets[i] + members[i].data.size();
+	}
+	ASSERT_EQ(std::vector<u8>(romSize - end, 0xff), std::vector<u8>(data.begin() + end, data.end()));
+}
@@ -0,0 +1,159 @@
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/aica/aica.h"
+#include "hw/aica/aica_if.h"
+#include "hw/aica/aica_mem.h"
+#include "hw/arm7/arm7.h"
+#include "profiler/profiler.h"
+
+extern reg_pair arm_Reg[RN_ARM_REG_COUNT];
+
+class Arm7Test : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		savedRam = aica_ram;
+		ram.resize(2 * 1024 * 1024);
+		aica_ram.data = ram.data();
+		aica_ram.size = ram.size();
+		settings.platform.aram_size = ram.size();
+		settings.platform.aram_mask = ram.size() - 1;
+
+		CommonData = (CommonData_struct *)&aica_reg[0x2800];
+		SCIEB = (InterruptInfo *)&aica_reg[0x289C];
+		SCIPD = (InterruptInfo *)&aica_reg[0x289C + 4];
+		SCIRE = (InterruptInfo *)&aica_reg[0x289C + 8];
+		MCIEB = (InterruptInfo *)&aica_reg[0x28B4];
+		MCIPD = (InterruptInfo *)&aica_reg[0x28B4 + 4];
+		MCIRE = (InterruptInfo *)&aica_reg[0x28B4 + 8];
+		libAICA_Reset(false);
+		arm_Init();
+	}
+
+	void TearDown() override
+	{
+		arm_SetEnabled(false);
+		aica_ram = savedRam;
+	}
+
+	void load(const std::vector<u32>& program)
+	{
+		std::fill(ram.begin(), ram.end(), 0);
+		memcpy(ram.data(), program.data(), program.size() * 4);
+		arm_SetEnabled(false);
+		arm_SetEnabled(true);
+	}
+
+	// Runs the given number of samples and returns the registers and next pc after each one
+	std::vector<std::vector<u32>> run(u32 samples)
+	{
+		std::vector<std::vector<u32>> states;
+		for (u32 i = 0; i < samples; i++)
+		{
+			arm_Run(1);
+			std::vector<u32> state;
+			for (int r = 0; r < 16; r++)
+				state.push_back(arm_Reg[r].I);
+			state.push_back(arm_Reg[R15_ARM_NEXT].I);
+			states.push_back(state);
+		}
+		return states;
+	}
+
+	std::vector<u8> ram;
+	VArray2 savedRam;
+};
+
+// Polls a word in wave memory until it isn't zero.
+// With the second loop opcode, r3 depends on its previous value so the loop isn't idle,
+// but it runs exactly like the first one.
+static std::vector<u32> pollingLoop(u32 loopOpcode)
+{
+	return {
+		0xE3A01A01,	// mov r1, #0x1000
+		0xE3A04000,	// mov r4, #0
+		0xE5910000,	// loop: ldr r0, [r1]
+		loopOpcode,
+		0xE3530000,	// cmp r3, #0
+		0x0AFFFFFB,	// beq loop
+		0xE3A02001,	// mov r2, #1
+		0xEAFFFFFE,	// b .
+	};
+}
+
+TEST_F(Arm7Test, IdleLoop)
+{
+	// orr r3, r3, r0
+	load(pollingLoop(0xE1833000));
+	u64 idleCycles = prof.counters.arm7.idle_cycles;
+	std::vector<std::vector<u32>> busyStates = run(10);
+	ASSERT_EQ(idleCycles, prof.counters.arm7.idle_cycles);
+	ram[0x1000] = 1;
+	std::vector<std::vector<u32>> busyExit = run(10);
+	ASSERT_EQ(1u, arm_Reg[2].I);
+
+	// orr r3, r4, r0
+	load(pollingLoop(0xE1843000));
+	idleCycles = prof.counters.arm7.idle_cycles;
+	std::vector<std::vector<u32>> idleStates = run(10);
+	ASSERT_LT(idleCycles, prof.counters.arm7.idle_cycles);
+	ram[0x1000] = 1;
+	std::vector<std::vector<u32>> idleExit = run(10);
+	ASSERT_EQ(1u, arm_Reg[2].I);
+
+	// Skipping iterations must not change where each sample ends
+	ASSERT_EQ(busyStates, idleStates);
+	ASSERT_EQ(busyExit, idleExit);
+}
+
+TEST_F(Arm7Test, LoopWithStoreIsNotIdle)
+{
+	load({
+		0xE3A01A01,	// mov r1, #0x1000
+		0xE5910000,	// loop: ldr r0, [r1]
+		0xE5810004,	// str r0, [r1, #4]
+		0xE3500000,	// cmp r0, #0
+		0x0AFFFFFB,	// beq loop
+		0xE3A02001,	// mov r2, #1
+	});
+	u64 idleCycles = prof.counters.arm7.idle_cycles;
+	run(10);
+	ASSERT_EQ(idleCycles, prof.counters.arm7.idle_cycles);
+	ASSERT_EQ(0u, arm_Reg[2].I);
+}
+
+// Runs on the recompiler when there is one: blocks ending with a branch, a conditional branch
+// or a split are linked to their successors.
+TEST_F(Arm7Test, BlockLinking)
+{
+	load({
+		0xE3A00064,	// mov r0, #100
+		0xE3A01000,	// mov r1, #0
+		0xE2811003,	// loop: add r1, r1, #3
+		0xEA000000,	// b skip
+		0xE3A010FF,	// mov r1, #0xFF
+		0xE2500001,	// skip: subs r0, r0, #1
+		0x1AFFFFFA,	// bne loop
+		0xE3A02001,	// mov r2, #1
+		0xEAFFFFFE,	// b .
+	});
+	u64 linked = prof.counters.arm7.linked;
+	run(20);
+	ASSERT_EQ(0u, arm_Reg[0].I);
+	ASSERT_EQ(300u, arm_Reg[1].I);
+	ASSERT_EQ(1u, arm_Reg[2].I);
+#if FEAT_AREC != DYNAREC_NONE
+	ASSERT_LT(linked, prof.counters.arm7.linked);
+#else
+	(void)linked;
+#endif
+
+	// Blocks longer than 32 ops are split
+	std::vector<u32> program(40, 0xE2833001);	// add r3, r3, #1
+	program.push_back(0xEAFFFFFE);				// b .
+	load(program);
+	run(2);
+	ASSERT_EQ(40u, arm_Reg[3].I);
+	ASSERT_EQ(40u * 4, arm_Reg[R15_ARM_NEXT].I);
+}
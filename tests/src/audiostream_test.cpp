@@ -0,0 +1,70 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "oslib/audiostream.h"
+#include "oslib/oslib.h"
+
+class AudioStreamTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		settings.audio.backend = "null";
+		NullAudioCapture(true);
+		InitAudio();
+	}
+
+	void TearDown() override
+	{
+		TermAudio();
+		NullAudioCapture(false);
+	}
+
+	// Waits for the audio thread to push the given number of frames to the backend
+	std::vector<u32> capture(size_t count)
+	{
+		std::vector<u32> frames;
+		auto start = std::chrono::steady_clock::now();
+		while (frames.size() < count && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+		{
+			std::vector<u32> captured = NullAudioCaptured();
+			frames.insert(frames.end(), captured.begin(), captured.end());
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return frames;
+	}
+};
+
+TEST_F(AudioStreamTest, LimitFPS)
+{
+	// The audio output paces the emulator: frames must be output unchanged
+	settings.aica.LimitFPS = true;
+	const u32 overruns = GetAudioOverruns();
+	std::vector<u32> expected;
+	for (u32 i = 0; i < 512 * 10; i++)
+	{
+		s16 l = (s16)(i * 7);
+		s16 r = (s16)(-(s32)i);
+		WriteSample(r, l);
+		expected.push_back((u16)l | ((u32)(u16)r << 16));
+	}
+	// One frame is kept to interpolate with
+	WriteSample(0, 0);
+
+	ASSERT_EQ(expected, capture(expected.size()));
+	ASSERT_EQ(overruns, GetAudioOverruns());
+}
+
+TEST_F(AudioStreamTest, Resampling)
+{
+	// Constant input must stay constant when resampled
+	settings.aica.LimitFPS = false;
+	for (u32 i = 0; i < 512 * 3; i++)
+		WriteSample(-1000, 1000);
+
+	std::vector<u32> frames = capture(512 * 2);
+	ASSERT_LE(512u * 2, frames.size());
+	for (u32 frame : frames)
+		ASSERT_EQ(1000u | (u32)(u16)-1000 << 16, frame);
+}
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "imgread/common.h"
+
+Disc* chd_parse(const char* file);
+
+// Reads an uncompressed CHD v5 image through the hunk cache and prefetch thread
+class ChdTest : public ::testing::Test {
+protected:
+	static constexpr u32 FRAME_SIZE = 2352 + 96;
+	static constexpr u32 HUNK_FRAMES = 8;
+	static constexpr u32 HUNK_BYTES = FRAME_SIZE * HUNK_FRAMES;
+
+	struct TrackDesc
+	{
+		const char *type;
+		u32 frames;
+	};
+
+	void SetUp() override
+	{
+		path = "chd_test.chd";
+		// Enough hunks for the cache to evict some
+		static const TrackDesc trackDescs[] = { { "MODE1_RAW", 20 }, { "AUDIO", 30 }, { "MODE1_RAW", 700 } };
+
+		u32 fad = 150;
+		u32 chdFrames = 0;
+		std::vector<std::string> metadata;
+		for (const TrackDesc& desc : trackDescs)
+		{
+			char meta[256];
+			sprintf(meta, "TRACK:%d TYPE:%s SUBTYPE:NONE FRAMES:%d PREGAP:0 PGTYPE:MODE1 PGSUB:RW POSTGAP:0",
+					(int)metadata.size() + 1, desc.type, desc.frames);
+			metadata.push_back(meta);
+
+			for (u32 i = 0; i < desc.frames; i++)
+				frameOfFad.push_back({ fad + i, chdFrames + i, strcmp(desc.type, "AUDIO") == 0 });
+			fad += desc.frames;
+			// tracks are padded to 4 frames
+			chdFrames += (desc.frames + 3) / 4 * 4;
+		}
+		const u32 hunkCount = (chdFrames + HUNK_FRAMES - 1) / HUNK_FRAMES;
+
+		std::vector<u8> header(124);
+		memcpy(&header[0], "MComprHD", 8);
+		put32(&header[8], 124);
+		put32(&header[12], 5);
+		put64(&header[32], (u64)hunkCount * HUNK_BYTES);
+		put64(&header[40], 124);		// map
+		u64 metaOffset = 124 + hunkCount * 4;
+		put64(&header[48], metaOffset);
+		put32(&header[56], HUNK_BYTES);
+		put32(&header[60], FRAME_SIZE);
+
+		std::vector<u8> meta;
+		for (size_t i = 0; i < metadata.size(); i++)
+		{
+			u8 entry[16];
+			put32(&entry[0], ('C' << 24) | ('H' << 16) | ('T' << 8) | '2');
+			put32(&entry[4], metadata[i].size() + 1);
+			u64 next = metaOffset + meta.size() + 16 + metadata[i].size() + 1;
+			put64(&entry[8], i + 1 < metadata.size() ? next : 0);
+			meta.insert(meta.end(), entry, entry + 16);
+			meta.insert(meta.end(), metadata[i].c_str(), metadata[i].c_str() + metadata[i].size() + 1);
+		}
+
+		// Hunks are stored after the metadata, in order
+		const u32 firstHunk = (metaOffset + meta.size() + HUNK_BYTES - 1) / HUNK_BYTES;
+		std::vector<u8> map(hunkCount * 4);
+		for (u32 i = 0; i < hunkCount; i++)
+			put32(&map[i * 4], firstHunk + i);
+
+		FILE *f = fopen(path.c_str(), "wb");
+		ASSERT_NE(nullptr, f);
+		fwrite(header.data(), 1, header.size(), f);
+		fwrite(map.data(), 1, map.size(), f);
+		fwrite(meta.data(), 1, meta.size(), f);
+		std::vector<u8> data(firstHunk * HUNK_BYTES - ftell(f));
+		fwrite(data.data(), 1, data.size(), f);
+		data.resize(HUNK_BYTES);
+		for (u32 hunk = 0; hunk < hunkCount; hunk++)
+		{
+			for (u32 i = 0; i < HUNK_FRAMES; i++)
+				frameData(hunk * HUNK_FRAMES + i, &data[i * FRAME_SIZE]);
+			fwrite(data.data(), 1, data.size(), f);
+		}
+		fclose(f);
+	}
+
+	void TearDown() override
+	{
+		remove(path.c_str());
+	}
+
+	static void put32(u8 *p, u32 v)
+	{
+		for (int i = 0; i < 4; i++)
+			p[i] = v >> (24 - i * 8);
+	}
+
+	static void put64(u8 *p, u64 v)
+	{
+		put32(p, v >> 32);
+		put32(p + 4, (u32)v);
+	}
+
+	static void frameData(u32 chdFrame, u8 *data)
+	{
+		for (u32 i = 0; i < FRAME_SIZE; i++)
+			data[i] = (u8)(chdFrame * 31 + i * 7 + (i >> 8));
+	}
+
+	void checkSector(Disc *disc, size_t index)
+	{
+		const FadFrame& ff = frameOfFad[index];
+		u8 sector[2448];
+		SectorFormat secfmt;
+		u8 subcode[96];
+		SubcodeFormat subfmt;
+		ASSERT_TRUE(disc->ReadSector(ff.fad, sector, &secfmt, subcode, &subfmt)) << ff.fad;
+		ASSERT_EQ(SECFMT_2352, secfmt);
+
+		u8 expected[FRAME_SIZE];
+		frameData(ff.chdFrame, expected);
+		if (ff.audio)
+			// audio tracks are byteswapped in CHDv5
+			for (u32 i = 0; i < 2352; i += 2)
+				std::swap(expected[i], expected[i + 1]);
+		ASSERT_EQ(0, memcmp(expected, sector, 2352)) << ff.fad;
+	}
+
+	struct FadFrame
+	{
+		u32 fad;
+		u32 chdFrame;
+		bool audio;
+	};
+	std::vector<FadFrame> frameOfFad;
+	std::string path;
+};
+
+TEST_F(ChdTest, Read)
+{
+	Disc *disc = chd_parse(path.c_str());
+	ASSERT_NE(nullptr, disc);
+	ASSERT_EQ(3u, disc->tracks.size());
+
+	// forward then backward sequential reads
+	for (size_t i = 0; i < frameOfFad.size(); i++)
+		checkSector(disc, i);
+	for (size_t i = frameOfFad.size(); i-- > 0; )
+		checkSector(disc, i);
+
+	// short sequential reads at random positions, hinting the following sectors like the GD-ROM does
+	std::mt19937 rng(1);
+	for (int i = 0; i < 200; i++)
+	{
+		size_t start = rng() % frameOfFad.size();
+		size_t count = std::min<size_t>(rng() % 64 + 1, frameOfFad.size() - start);
+		for (size_t j = start; j < start + count; j++)
+			checkSector(disc, j);
+		if (start + count < frameOfFad.size())
+			disc->ReadAhead(frameOfFad[start + count].fad, rng() % 256);
+	}
+
+	delete disc;
+}
+
+TEST_F(ChdTest, ReadSectors)
+{
+	Disc *disc = chd_parse(path.c_str());
+	ASSERT_NE(nullptr, disc);
+
+	std::mt19937 rng(2);
+	for (int i = 0; i < 100; i++)
+	{
+		const u32 fmt = i % 2 ? 2048 : 2352;
+		size_t start = rng() % frameOfFad.size();
+		size_t count = std::min<size_t>(rng() % 100 + 1, frameOfFad.size() - start);
+		std::vector<u8> data(count * fmt);
+		disc->ReadSectors(frameOfFad[start].fad, count, data.data(), fmt);
+
+		for (size_t j = 0; j < count; j++)
+		{
+			const FadFrame& ff = frameOfFad[start + j];
+			u8 frame[FRAME_SIZE];
+			frameData(ff.chdFrame, frame);
+			if (ff.audio)
+				for (u32 k = 0; k < 2352; k += 2)
+					std::swap(frame[k], frame[k + 1]);
+			u8 expected[2352];
+			ConvertSector(frame, expected, 2352, fmt, ff.fad);
+			ASSERT_EQ(0, memcmp(expected, &data[j * fmt], fmt)) << ff.fad << " fmt " << fmt;
+		}
+	}
+
+	delete disc;
+}
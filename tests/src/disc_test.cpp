@@ -0,0 +1,129 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "imgread/common.h"
+
+// Reads raw track files, mapped or not
+class DiscTest : public ::testing::Test {
+protected:
+	static constexpr u32 SECTORS = 8192;
+
+	void SetUp() override
+	{
+		writeTrack(raw2352, 2352);
+		writeTrack(raw2048, 2048);
+		writeTrack(mode2, 2336);
+	}
+
+	void TearDown() override
+	{
+		remove(raw2352.c_str());
+		remove(raw2048.c_str());
+		remove(mode2.c_str());
+	}
+
+	static void sectorData(u32 s, u8 *sector, u32 sectorSize)
+	{
+		for (u32 i = 0; i < sectorSize; i++)
+			sector[i] = (u8)(s * 13 + i * 5 + (i >> 8));
+		if (sectorSize == 2352)
+			// mode 1 or mode 2 header
+			sector[15] = s % 3 == 0 ? 2 : 1;
+	}
+
+	void writeTrack(std::string& path, u32 sectorSize)
+	{
+		path = "disc_test_" + std::to_string(sectorSize) + ".bin";
+		FILE *f = fopen(path.c_str(), "wb");
+		ASSERT_NE(nullptr, f);
+		std::vector<u8> sector(sectorSize);
+		for (u32 s = 0; s < SECTORS; s++)
+		{
+			sectorData(s, sector.data(), sectorSize);
+			fwrite(sector.data(), 1, sector.size(), f);
+		}
+		fclose(f);
+	}
+
+	// Single track disc. The file isn't mapped if mapped is false.
+	Disc *openDisc(const std::string& path, u32 sectorSize, bool mapped)
+	{
+		Disc *disc = new Disc();
+		Track t;
+		t.StartFAD = 150;
+		t.EndFAD = 0;
+		RawTrackFile *file = new RawTrackFile(core_fopen(path.c_str()), 0, t.StartFAD, sectorSize);
+		if (mapped)
+			EXPECT_NE(nullptr, file->data);
+		else
+			file->data = nullptr;
+		t.file = file;
+		disc->tracks.push_back(t);
+		return disc;
+	}
+
+	void check(const std::string& path, u32 sectorSize, u32 fmt, bool mapped)
+	{
+		Disc *disc = openDisc(path, sectorSize, mapped);
+		static const u32 reads[][2] = { { 150, 1 }, { 151, 33 }, { 1000, 3000 }, { 150 + SECTORS - 10, 10 } };
+		for (const auto& read : reads)
+		{
+			std::vector<u8> data(read[1] * fmt, 0x55);
+			disc->ReadSectors(read[0], read[1], data.data(), fmt);
+
+			std::vector<u8> expected(read[1] * fmt);
+			u8 sector[2352];
+			for (u32 i = 0; i < read[1]; i++)
+			{
+				sectorData(read[0] + i - 150, sector, sectorSize);
+				ConvertSector(sector, &expected[i * fmt], sectorSize, fmt, read[0] + i);
+			}
+			ASSERT_TRUE(expected == data) << "size " << sectorSize << " fmt " << fmt << " FAD " << read[0] << " mapped " << mapped;
+		}
+		disc->ReadAhead(2000, 100);
+		delete disc;
+	}
+
+	// Reads the whole track the way the GD-ROM does. Returns MB/s
+	double throughput(const std::string& path, u32 sectorSize, u32 fmt, bool mapped)
+	{
+		Disc *disc = openDisc(path, sectorSize, mapped);
+		std::vector<u8> buffer(32 * fmt);
+		auto start = std::chrono::steady_clock::now();
+		for (int pass = 0; pass < 4; pass++)
+			for (u32 fad = 150; fad < 150 + SECTORS; fad += 32)
+				disc->ReadSectors(fad, 32, buffer.data(), fmt);
+		std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+		delete disc;
+		return 4.0 * SECTORS * fmt / duration.count() / 1024.0 / 1024.0;
+	}
+
+	std::string raw2352;
+	std::string raw2048;
+	std::string mode2;
+};
+
+TEST_F(DiscTest, ReadSectors)
+{
+	for (bool mapped : { true, false })
+	{
+		check(raw2352, 2352, 2352, mapped);
+		check(raw2352, 2352, 2048, mapped);
+		check(raw2352, 2352, 2336, mapped);
+		check(raw2048, 2048, 2048, mapped);
+		check(mode2, 2336, 2048, mapped);
+	}
+}
+
+TEST_F(DiscTest, Benchmark)
+{
+	RecordProperty("mapped_2352_MBps", (int)throughput(raw2352, 2352, 2352, true));
+	RecordProperty("file_2352_MBps", (int)throughput(raw2352, 2352, 2352, false));
+	RecordProperty("mapped_2352_to_2048_MBps", (int)throughput(raw2352, 2352, 2048, true));
+	RecordProperty("file_2352_to_2048_MBps", (int)throughput(raw2352, 2352, 2048, false));
+	RecordProperty("mapped_2048_MBps", (int)throughput(raw2048, 2048, 2048, true));
+	RecordProperty("file_2048_MBps", (int)throughput(raw2048, 2048, 2048, false));
+}
@@ -0,0 +1,362 @@
+#include "build.h"
+
+#if (HOST_CPU == CPU_X64 || HOST_CPU == CPU_ARM64) && FEAT_DSPREC == DYNAREC_JIT
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/aica/aica.h"
+#include "hw/aica/aica_if.h"
+#include "hw/aica/aica_mem.h"
+#include "hw/aica/dsp.h"
+
+// Hand-written DSP program: assembled steps, coefficients and memory addresses
+struct EffectProgram
+{
+	const char *name;
+	std::vector<std::pair<u32, std::string>> steps;
+	std::vector<std::pair<u32, u32>> coefs;
+	std::vector<u32> madrs;
+};
+
+// Compares the DSP recompiler with the interpreter
+class DspTest : public ::testing::Test {
+protected:
+	struct State
+	{
+		s32 TEMP[128];
+		s32 MEMS[32];
+		u32 MDEC_CT;
+	};
+
+	void SetUp() override
+	{
+		DSPData = (DSPData_struct *)&aica_reg[0x3000];
+		savedRam = aica_ram;
+		ram.resize(2 * 1024 * 1024);
+		aica_ram.data = ram.data();
+		aica_ram.size = ram.size();
+		settings.platform.aram_size = ram.size();
+		settings.platform.aram_mask = ram.size() - 1;
+		dsp_init();
+	}
+
+	void TearDown() override
+	{
+		aica_ram = savedRam;
+	}
+
+	static s32 random24(std::mt19937& rng)
+	{
+		return (s32)(rng() << 8) >> 8;
+	}
+
+	// Random program with the given proportion of NOP steps
+	void randomProgram(std::mt19937& rng, float nopRatio)
+	{
+		std::uniform_real_distribution<float> dist;
+		for (u32 step = 0; step < 128; step++)
+			for (u32 i = 0; i < 4; i++)
+				DSPData->MPRO[step * 4 + i] = dist(rng) < nopRatio ? 0 : rng() & 0xFFFF;
+		for (u32& coef : DSPData->COEF)
+			coef = rng() % 4 == 0 ? 0 : rng() & 0xFFF8;
+		for (u32& madrs : DSPData->MADRS)
+			madrs = rng() & 0xFFFF;
+	}
+
+	void randomState(std::mt19937& rng)
+	{
+		for (s32& v : dsp.TEMP)
+			v = random24(rng);
+		for (s32& v : dsp.MEMS)
+			v = random24(rng);
+		dsp.RBL = (8192 << (rng() % 4)) - 1;
+		dsp.RBP = (rng() % 1024 * 2048) & ARAM_MASK;
+		dsp.regs.MDEC_CT = rng() % (dsp.RBL + 1) + 1;
+		DSPData->EXTS[0] = rng() & 0xFFFF;
+		DSPData->EXTS[1] = rng() & 0xFFFF;
+		for (u8& b : ram)
+			b = (u8)rng();
+	}
+
+	State saveState()
+	{
+		State state;
+		memcpy(state.TEMP, dsp.TEMP, sizeof(state.TEMP));
+		memcpy(state.MEMS, dsp.MEMS, sizeof(state.MEMS));
+		state.MDEC_CT = dsp.regs.MDEC_CT;
+		return state;
+	}
+
+	void restoreState(const State& state)
+	{
+		memcpy(dsp.TEMP, state.TEMP, sizeof(state.TEMP));
+		memcpy(dsp.MEMS, state.MEMS, sizeof(state.MEMS));
+		dsp.regs.MDEC_CT = state.MDEC_CT;
+	}
+
+	// Runs the DSP for the given number of samples and returns its outputs
+	std::vector<u32> run(bool interpreter, u32 samples, u32 seed)
+	{
+		std::mt19937 rng(seed);
+		std::vector<u32> efreg;
+		for (u32 i = 0; i < samples; i++)
+		{
+			for (s32& mixs : dsp.MIXS)
+				mixs = (s32)(rng() << 12) >> 12;	// 20 bits
+			// The recompilers keep MEMVAL between samples but the interpreter doesn't
+			memset(dsp.MEMVAL, 0, sizeof(dsp.MEMVAL));
+			if (interpreter)
+				AICADSP_Step(&dsp);
+			else
+				dsp_step();
+			efreg.insert(efreg.end(), DSPData->EFREG, DSPData->EFREG + 16);
+		}
+		return efreg;
+	}
+
+	// Runs the current program with the recompiler then the interpreter, from the same random state
+	void compare(std::mt19937& rng, const std::string& name, bool recompile = true)
+	{
+		const u32 rbl = dsp.RBL;
+		const u32 rbp = dsp.RBP;
+		randomState(rng);
+		if (!recompile)
+		{
+			// The ring buffer is compiled in
+			dsp.RBL = rbl;
+			dsp.RBP = rbp;
+			dsp.regs.MDEC_CT = rng() % (dsp.RBL + 1) + 1;
+		}
+		const State initialState = saveState();
+		const std::vector<u8> initialRam = ram;
+		const u32 seed = rng();
+
+		if (recompile)
+			dsp.dyndirty = true;
+		std::vector<u32> recOutput = run(false, 64, seed);
+		State recState = saveState();
+		std::vector<u8> recRam = ram;
+
+		restoreState(initialState);
+		ram = initialRam;
+		std::vector<u32> interpOutput = run(true, 64, seed);
+		State interpState = saveState();
+
+		ASSERT_EQ(interpOutput, recOutput) << name;
+		ASSERT_EQ(0, memcmp(interpState.TEMP, recState.TEMP, sizeof(recState.TEMP))) << name;
+		ASSERT_EQ(0, memcmp(interpState.MEMS, recState.MEMS, sizeof(recState.MEMS))) << name;
+		ASSERT_EQ(interpState.MDEC_CT, recState.MDEC_CT) << name;
+		ASSERT_TRUE(ram == recRam) << name;
+	}
+
+	// Assembles a program step from its fields, such as "XSEL IRA=0x20 YSEL=1 ZERO". Missing fields are 0.
+	static void assemble(u32 step, const std::string& fields)
+	{
+		struct Field
+		{
+			const char *name;
+			u32 word;
+			u32 shift;
+			u32 mask;
+		};
+		static const Field layout[] = {
+			{ "TRA", 0, 9, 0x7f }, { "TWT", 0, 8, 1 }, { "TWA", 0, 1, 0x7f },
+			{ "XSEL", 1, 15, 1 }, { "YSEL", 1, 13, 3 }, { "IRA", 1, 7, 0x3f }, { "IWT", 1, 6, 1 }, { "IWA", 1, 1, 0x1f },
+			{ "TABLE", 2, 15, 1 }, { "MWT", 2, 14, 1 }, { "MRD", 2, 13, 1 }, { "EWT", 2, 12, 1 }, { "EWA", 2, 8, 0xf },
+			{ "ADRL", 2, 7, 1 }, { "FRCL", 2, 6, 1 }, { "SHIFT", 2, 4, 3 }, { "YRL", 2, 3, 1 }, { "NEGB", 2, 2, 1 },
+			{ "ZERO", 2, 1, 1 }, { "BSEL", 2, 0, 1 },
+			{ "NOFL", 3, 15, 1 }, { "MASA", 3, 9, 0x3f }, { "ADREB", 3, 8, 1 }, { "NXADR", 3, 7, 1 },
+		};
+		u32 *mpro = &DSPData->MPRO[step * 4];
+		std::stringstream tokens(fields);
+		std::string token;
+		while (tokens >> token)
+		{
+			size_t eq = token.find('=');
+			std::string name = token.substr(0, eq);
+			u32 value = eq == std::string::npos ? 1 : std::stoul(token.substr(eq + 1), nullptr, 0);
+			const Field *field = std::find_if(std::begin(layout), std::end(layout),
+					[&name](const Field& f) { return name == f.name; });
+			ASSERT_NE(std::end(layout), field) << token;
+			mpro[field->word] |= (value & field->mask) << field->shift;
+		}
+	}
+
+	void loadProgram(const EffectProgram& program)
+	{
+		memset(DSPData->MPRO, 0, sizeof(DSPData->MPRO));
+		memset(DSPData->COEF, 0, sizeof(DSPData->COEF));
+		memset(DSPData->MADRS, 0, sizeof(DSPData->MADRS));
+		for (const auto& step : program.steps)
+			assemble(step.first, step.second);
+		for (const auto& coef : program.coefs)
+			DSPData->COEF[coef.first] = coef.second;
+		for (u32 i = 0; i < program.madrs.size(); i++)
+			DSPData->MADRS[i] = program.madrs[i];
+	}
+
+	std::vector<u8> ram;
+	VArray2 savedRam;
+};
+
+// Programs written like the effects of sound drivers: long ACC chains, memory reads feeding MEMS two steps later,
+// ring buffer writes, TEMP delay lines, interpolated reads with FRC_REG and modulated addresses.
+// Unlike random programs, most of their results are used.
+static const std::vector<EffectProgram> effectPrograms = {
+	{
+		"stereo echo",
+		{
+			{ 0, "XSEL IRA=0x20 YSEL=1 ZERO" },			// ACC = MIXS0 * send
+			{ 1, "MRD MASA=1 BSEL" },					// read the delayed sample
+			{ 2, "BSEL" },
+			{ 3, "IWT IWA=0 BSEL" },					// MEMS0 = delayed sample
+			{ 4, "XSEL IRA=0 YSEL=1 BSEL" },			// ACC += MEMS0 * feedback
+			{ 5, "MWT MASA=0 XSEL IRA=0 YSEL=1 ZERO" },	// write to the delay line, ACC = MEMS0 * wet
+			{ 6, "XSEL IRA=0x20 YSEL=1 BSEL" },			// ACC += MIXS0 * dry
+			{ 7, "EWT EWA=0 TWT TWA=0 ZERO" },			// EFREG0 = TEMP[0] = output
+			{ 8, "XSEL IRA=0x21 YSEL=1 ZERO" },			// same for the right channel
+			{ 9, "MRD MASA=3 BSEL" },
+			{ 10, "BSEL" },
+			{ 11, "IWT IWA=1 BSEL" },
+			{ 12, "XSEL IRA=1 YSEL=1 BSEL" },
+			{ 13, "MWT MASA=2 XSEL IRA=1 YSEL=1 ZERO" },
+			{ 14, "XSEL IRA=0x21 YSEL=1 BSEL" },
+			{ 15, "EWT EWA=1 TWT TWA=1 ZERO" },
+		},
+		{ { 0, 0x6000 }, { 4, 0x3000 }, { 5, 0x4000 }, { 6, 0x5000 }, { 8, 0x6000 }, { 12, 0x2800 }, { 13, 0x4000 }, { 14, 0x5000 } },
+		{ 0x0000, 0x1800, 0x2000, 0x3600 },
+	},
+	{
+		"reverb",
+		{
+			{ 0, "XSEL IRA=0x20 YSEL=1 ZERO" },				// ACC = MIXS0 * send
+			{ 1, "XSEL IRA=0x21 YSEL=1 BSEL MRD MASA=0" },	// ACC += MIXS1 * send, read the comb filter tap
+			{ 2, "TWT TWA=2 ZERO" },							// TEMP[2] = input
+			{ 3, "IWT IWA=2 MRD MASA=1 NOFL ZERO" },			// MEMS2 = comb tap, read the all-pass tap
+			{ 4, "XSEL IRA=2 YSEL=1 ZERO" },					// ACC = comb * (1 - damping)
+			{ 5, "TRA=5 YSEL=1 BSEL IWT IWA=3" },			// ACC += TEMP[5] * damping, MEMS3 = all-pass tap
+			{ 6, "TWT TWA=5 ZERO" },							// TEMP[5] = low-passed comb
+			{ 7, "XSEL IRA=2 YSEL=1 TRA=2" },				// ACC = TEMP[2] + comb * feedback
+			{ 8, "BSEL" },
+			{ 9, "MWT MASA=2 TWT TWA=6 XSEL IRA=3 YSEL=1 ZERO" },	// write the comb filter, ACC = all-pass tap * g
+			{ 10, "TRA=6 YSEL=1 NEGB XSEL IRA=3" },			// ACC = all-pass tap - TEMP[6]
+			{ 11, "EWT EWA=0 TWT TWA=7 BSEL YSEL=1 TRA=6" },	// EFREG0 = all-pass out, ACC += TEMP[6] * g
+			{ 12, "BSEL" },
+			{ 13, "MWT MASA=3 NOFL SHIFT=2 ZERO" },			// write the all-pass delay line
+			{ 14, "YRL XSEL IRA=0x31 ZERO" },				// Y_REG = EXTS1 (level)
+			{ 15, "XSEL IRA=0x20 YSEL=2 TRA=7" },			// ACC = TEMP[7] + MIXS0 * (Y_REG >> 11)
+			{ 16, "EWT EWA=1 XSEL IRA=0x21 YSEL=3 ZERO" },	// EFREG1 = ACC, ACC = MIXS1 * (Y_REG >> 4)
+			{ 17, "EWT EWA=2 SHIFT=1 ZERO" },					// EFREG2 = clamp(ACC * 2)
+		},
+		{ { 0, 0x3000 }, { 1, 0x3000 }, { 4, 0x5800 }, { 5, 0x2000 }, { 7, 0x6800 }, { 9, 0x5000 }, { 10, 0x7FF8 }, { 11, 0xB000 } },
+		{ 0x2200, 0x0d00, 0x0000, 0x1000 },
+	},
+	{
+		"chorus",
+		{
+			{ 0, "XSEL IRA=0x30 ADRL YRL ZERO" },			// ADRS_REG = EXTS0 >> 8 (LFO), Y_REG = EXTS0
+			{ 1, "MRD MASA=0 ADREB ZERO" },					// read at the modulated delay
+			{ 2, "YSEL=3 XSEL IRA=0x30 ZERO" },				// ACC = LFO * fraction
+			{ 3, "MRD MASA=0 ADREB NXADR IWT IWA=4 FRCL SHIFT=3 ZERO" },	// read the next sample, MEMS4 = tap, FRC_REG = fraction
+			{ 4, "XSEL IRA=4 YSEL=1 ZERO" },				// ACC = tap
+			{ 5, "IWT IWA=5 XSEL IRA=4 YSEL=0 NEGB BSEL" },	// MEMS5 = next tap, ACC = tap * FRC_REG - ACC
+			{ 6, "XSEL IRA=5 YSEL=0 BSEL NEGB" },			// ACC = next tap * FRC_REG - ACC
+			{ 7, "EWT EWA=3 TWT TWA=8 XSEL IRA=0x20 YSEL=1 BSEL" },	// EFREG3 = TEMP[8] = chorus, ACC += MIXS0 * dry
+			{ 8, "BSEL YSEL=1 TRA=8" },
+			{ 9, "MWT MASA=1 SHIFT=1 ZERO" },				// write the input to the delay line
+			{ 10, "TRA=8 TWT TWA=9 SHIFT=3 ADRL YSEL=1" },	// ADRS_REG = SHIFTED >> 12
+			{ 11, "MRD MASA=2 TABLE ADREB ZERO" },			// table read
+			{ 12, "XSEL IRA=0x22 YSEL=1 ZERO" },
+			{ 13, "IWT IWA=6 EWT EWA=4 SHIFT=2 BSEL" },		// EFREG4 = ACC * 2, unclamped
+			{ 14, "XSEL IRA=6 YSEL=1 BSEL" },
+			{ 15, "EWT EWA=5 ZERO" },
+		},
+		{ { 2, 0x0FF8 }, { 4, 0x7FF8 }, { 7, 0x4000 }, { 8, 0x2000 }, { 10, 0x1000 }, { 12, 0x6000 }, { 14, 0x4000 } },
+		{ 0x0400, 0x0000, 0x0123 },
+	},
+};
+
+TEST_F(DspTest, RandomPrograms)
+{
+	std::mt19937 rng(1);
+	static const float nopRatios[] = { 0.f, 0.5f, 0.9f, 1.f };
+	for (float nopRatio : nopRatios)
+		for (int i = 0; i < 10; i++)
+		{
+			randomProgram(rng, nopRatio);
+			compare(rng, "nop ratio " + std::to_string(nopRatio) + " program " + std::to_string(i));
+		}
+}
+
+// Coefficients can change without recompiling the program
+TEST_F(DspTest, CoefficientWrites)
+{
+	std::mt19937 rng(2);
+	randomProgram(rng, 0.5f);
+	compare(rng, "initial coefficients");
+	for (u32& coef : DSPData->COEF)
+		coef = rng() & 0xFFF8;
+	dsp_writenmem(0x3000);
+	ASSERT_FALSE(dsp.dyndirty);
+	compare(rng, "new coefficients", false);
+}
+
+// Effect programs, then the programs given by the FLYCAST_DSP_PROGRAMS environment variable, separated by ':'.
+// Each file is a dump of the DSP registers: AICA registers 0x3000 to 0x45C7.
+TEST_F(DspTest, EffectPrograms)
+{
+	std::mt19937 rng(1);
+	for (const EffectProgram& program : effectPrograms)
+	{
+		loadProgram(program);
+		DSPProgram lowered;
+		dsp_lower(lowered);
+		ASSERT_EQ(program.steps.size(), lowered.steps.size()) << program.name;
+		compare(rng, program.name);
+		ASSERT_TRUE(std::any_of(std::begin(DSPData->EFREG), std::end(DSPData->EFREG), [](u32 v) { return v != 0; })) << program.name;
+	}
+
+	const char *programs = getenv("FLYCAST_DSP_PROGRAMS");
+	if (programs == nullptr)
+		return;
+	std::stringstream files(programs);
+	std::string file;
+	while (std::getline(files, file, ':'))
+	{
+		FILE *f = fopen(file.c_str(), "rb");
+		ASSERT_NE(nullptr, f) << file;
+		size_t read = fread(DSPData, 1, sizeof(*DSPData), f);
+		fclose(f);
+		ASSERT_EQ(sizeof(*DSPData), read) << file;
+		compare(rng, file);
+	}
+}
+
+TEST_F(DspTest, Benchmark)
+{
+	std::mt19937 rng(1);
+	// Most steps of typical programs are NOPs
+	randomProgram(rng, 0.75f);
+	randomState(rng);
+	dsp.dyndirty = true;
+
+	const int samples = 44100;
+	auto start = std::chrono::steady_clock::now();
+	run(false, samples, 1);
+	std::chrono::duration<double> recDuration = std::chrono::steady_clock::now() - start;
+	start = std::chrono::steady_clock::now();
+	run(true, samples, 1);
+	std::chrono::duration<double> interpDuration = std::chrono::steady_clock::now() - start;
+
+	RecordProperty("rec_ns_per_sample", (int)(recDuration.count() * 1000000000.0 / samples));
+	RecordProperty("interp_ns_per_sample", (int)(interpDuration.count() * 1000000000.0 / samples));
+}
+
+#endif
@@ -0,0 +1,317 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "emulator.h"
+#include "stdclass.h"
+#include "hw/mem/_vmem.h"
+#include "hw/sh4/sh4_if.h"
+#include "hw/sh4/sh4_core.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/sh4_sched.h"
+#include "hw/sh4/dyna/ngen.h"
+#include "hw/sh4/dyna/blockcache.h"
+
+#if FEAT_SHREC != DYNAREC_NONE
+
+void install_fault_handler();
+
+static int stopCpu(int tag, int cycles, int jitter)
+{
+	sh4_cpu.Stop();
+	return 0;
+}
+
+class DynarecTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		dc_init();
+		mem_map_default();
+		Get_Sh4Recompiler(&sh4_cpu);
+		dc_reset(true);
+		install_fault_handler();
+		// memory handlers are set when the emulator starts
+		mmu_set_state();
+	}
+
+	void TearDown() override
+	{
+		settings.dynarec.superblocks = false;
+		settings.dynarec.block_cache = false;
+		bc_Load();
+		dc_reset(true);
+		Get_Sh4Interpreter(&sh4_cpu);
+	}
+
+	void load(u32 addr, const std::vector<u16>& code)
+	{
+		for (size_t i = 0; i < code.size(); i++)
+			WriteMem16(addr + i * 2, code[i]);
+	}
+
+	// Runs from addr for about the given number of cycles
+	void run(u32 addr, int cycles)
+	{
+		static int stopId = sh4_sched_register(0, &stopCpu);
+		sh4_sched_request(stopId, cycles);
+		next_pc = addr;
+		sh4_cpu.Run();
+	}
+
+	RuntimeBlockInfoPtr compile(u32 addr)
+	{
+		next_pc = addr;
+		rdv_CompilePC(0);
+		return bm_GetBlock(addr);
+	}
+};
+
+// A block jumping over a literal pool is recompiled as a superblock
+// that goes on with the code at the jump target
+TEST_F(DynarecTest, Superblock)
+{
+	settings.dynarec.superblocks = true;
+	const u32 addr = 0x8C100000;
+	load(addr, {
+		0xE001,	// mov #1, r0
+		0xA003,	// bra skip
+		0x7002,	// add #2, r0
+		0x0009,	// nop
+		0x5678,	// .long 0x12345678
+		0x1234,
+		0x7003,	// skip: add #3, r0
+		0x000B,	// rts
+		0x0009,	// nop
+	});
+	RuntimeBlockInfoPtr block = compile(addr);
+	ASSERT_NE(nullptr, block);
+	ASSERT_FALSE(block->tier2);
+	ASSERT_EQ(BET_StaticJump, block->BlockType);
+	ASSERT_EQ(addr + 12, block->BranchBlock);
+	ASSERT_EQ(6u, block->sh4_code_size);
+	ASSERT_NE(0u, block->hot_runs);
+	ASSERT_TRUE(block->read_only);
+
+	rdv_PromoteBlock(addr);
+	RuntimeBlockInfoPtr superblock = bm_GetBlock(addr);
+	ASSERT_NE(nullptr, superblock);
+	ASSERT_NE(block, superblock);
+	ASSERT_TRUE(superblock->tier2);
+	ASSERT_EQ(0u, superblock->hot_runs);
+	ASSERT_EQ(BET_DynamicRet, superblock->BlockType);
+	// the skipped literal pool is part of the block
+	ASSERT_EQ(18u, superblock->sh4_code_size);
+	ASSERT_TRUE(superblock->read_only);
+
+	// Writing to the literal pool discards the superblock
+	WriteMem32(addr + 8, 0x87654321);
+	ASSERT_EQ(nullptr, bm_GetBlock(addr));
+
+	// Hot blocks are compiled as superblocks right away.
+	// The page isn't protected anymore so the block checks its code instead.
+	superblock = compile(addr);
+	ASSERT_NE(nullptr, superblock);
+	ASSERT_TRUE(superblock->tier2);
+	ASSERT_FALSE(superblock->read_only);
+	ASSERT_EQ(18u, superblock->sh4_code_size);
+}
+
+// Hot blocks are promoted while running
+TEST_F(DynarecTest, SuperblockRun)
+{
+	settings.dynarec.superblocks = true;
+	const u32 addr = 0x8C100000;
+	load(addr, {
+		0xE000,	// mov #0, r0
+		0x7001,	// loop: add #1, r0
+		0xA002,	// bra skip
+		0x0009,	// nop
+		0x5678,	// .long 0x12345678
+		0x1234,
+		0xAFF9,	// skip: bra loop
+		0x0009,	// nop
+	});
+	tier2_blocks = 0;
+	run(addr, 200000);
+	RuntimeBlockInfoPtr block = bm_GetBlock(addr + 2);
+	ASSERT_NE(nullptr, block);
+	ASSERT_TRUE(block->tier2);
+	ASSERT_EQ(BET_StaticJump, block->BlockType);
+	ASSERT_EQ(addr + 2, block->BranchBlock);
+	ASSERT_LT(1000u, r[0]);
+	ASSERT_NE(0u, tier2_blocks);
+}
+
+namespace {
+
+// Only used to look up blocks in the block cache
+struct CachedBlock : RuntimeBlockInfo
+{
+	u32 Relink() override { return 0; }
+	void Relocate(void* dst) override {}
+};
+
+}
+
+// Blocks are saved to disk, reloaded on the next boot and dropped when their code changes
+TEST_F(DynarecTest, BlockCache)
+{
+	settings.dynarec.block_cache = true;
+	strcpy(settings.imgread.ImagePath, "dynarec_test.gdi");
+	const std::string path = get_writable_data_path("dynarec_test.blockcache");
+	remove(path.c_str());
+	bc_Load();
+
+	const u32 addr = 0x8C100000;
+	load(addr, {
+		0xE001,	// mov #1, r0
+		0x7002,	// add #2, r0
+		0x000B,	// rts
+		0x0009,	// nop
+	});
+	RuntimeBlockInfoPtr block = compile(addr);
+	ASSERT_NE(nullptr, block);
+	ASSERT_TRUE(block->read_only);
+	bc_Save();
+	FILE *f = fopen(path.c_str(), "rb");
+	ASSERT_NE(nullptr, f);
+	fclose(f);
+
+	// Switching to another game unloads the cache
+	strcpy(settings.imgread.ImagePath, "dynarec_test_other.gdi");
+	bc_Load();
+	CachedBlock cached {};
+	cached.addr = addr;
+	cached.fpu_cfg = fpscr;
+	ASSERT_FALSE(bc_Lookup(&cached));
+
+	strcpy(settings.imgread.ImagePath, "dynarec_test.gdi");
+	bc_Load();
+	dc_reset(false);
+	ASSERT_TRUE(bc_Lookup(&cached));
+	ASSERT_EQ(block->sh4_code_size, cached.sh4_code_size);
+	ASSERT_EQ(block->guest_opcodes, cached.guest_opcodes);
+	ASSERT_EQ(block->BlockType, cached.BlockType);
+	ASSERT_EQ(block->oplist.size(), cached.oplist.size());
+	// blocks with another fpu config aren't shared
+	cached.fpu_cfg.PR ^= 1;
+	ASSERT_FALSE(bc_Lookup(&cached));
+	cached.fpu_cfg.PR ^= 1;
+
+	// Writing to the code unprotects the page
+	WriteMem16(addr + 2, 0x7003);	// add #3, r0
+	ASSERT_FALSE(bc_Lookup(&cached));
+	// and the hash of the code doesn't match anymore once it's protected again.
+	// RAM is kept by a soft reset
+	dc_reset(false);
+	ASSERT_FALSE(bc_Lookup(&cached));
+	block = compile(addr);
+	ASSERT_NE(nullptr, block);
+	ASSERT_TRUE(block->read_only);
+
+	// The new code replaces the stale entry
+	bc_Save();
+	strcpy(settings.imgread.ImagePath, "dynarec_test_other.gdi");
+	bc_Load();
+	strcpy(settings.imgread.ImagePath, "dynarec_test.gdi");
+	bc_Load();
+	ASSERT_TRUE(bc_Lookup(&cached));
+	remove(path.c_str());
+	settings.imgread.ImagePath[0] = '\0';
+}
+
+// Superblocks follow static jumps to other protected code, forward and backward,
+// and are discarded when any of their code pages is written to
+TEST_F(DynarecTest, Trace)
+{
+	settings.dynarec.superblocks = true;
+	const u32 addr = 0x8C100000;
+	const u32 start = addr + 0xF00;
+	load(start, {
+		0xE001,	// mov #1, r0
+		0xA47D,	// bra addr + 0x1800
+		0x7002,	// add #2, r0
+	});
+	load(addr + 0x1800, {
+		0x7004,	// add #4, r0
+		0xA8FD,	// bra addr + 0xA00
+		0x0009,	// nop
+	});
+	load(addr + 0xA00, {
+		0x7008,	// add #8, r0
+		0x000B,	// rts
+		0x0009,	// nop
+	});
+	load(addr + 0x100, {
+		0xAFFE,	// bra $
+		0x0009,	// nop
+	});
+	RuntimeBlockInfoPtr block = compile(start);
+	ASSERT_NE(nullptr, block);
+	ASSERT_FALSE(block->tier2);
+	ASSERT_EQ(addr + 0x1800, block->BranchBlock);
+	ASSERT_NE(0u, block->hot_runs);
+
+	rdv_PromoteBlock(start);
+	block = bm_GetBlock(start);
+	ASSERT_NE(nullptr, block);
+	ASSERT_TRUE(block->tier2);
+	ASSERT_TRUE(block->read_only);
+	ASSERT_EQ(BET_DynamicRet, block->BlockType);
+	ASSERT_EQ(6u, block->sh4_code_size);
+	const std::vector<std::pair<u32, u32>> ranges { { addr + 0x1800, 6 }, { addr + 0xA00, 6 } };
+	ASSERT_EQ(ranges, block->trace_code);
+
+	r[0] = 0;
+	pr = addr + 0x100;
+	run(start, 10000);
+	ASSERT_EQ(15u, r[0]);
+
+	// Writing to the page of the second code range discards the superblock
+	WriteMem32(addr + 0x1F00, 0);
+	ASSERT_EQ(nullptr, bm_GetBlock(start));
+
+	// Unprotected code isn't part of traces
+	block = compile(start);
+	ASSERT_NE(nullptr, block);
+	ASSERT_TRUE(block->tier2);
+	ASSERT_TRUE(block->read_only);
+	ASSERT_TRUE(block->trace_code.empty());
+	ASSERT_EQ(BET_StaticJump, block->BlockType);
+	ASSERT_EQ(addr + 0x1800, block->BranchBlock);
+}
+
+// Jumps that skip too much code or go backward aren't followed in unprotected code
+TEST_F(DynarecTest, NoSuperblock)
+{
+	settings.dynarec.superblocks = true;
+	// the first 64 KB of ram are never protected
+	const u32 addr = 0x8C008000;
+	std::vector<u16> code {
+		0xA0FF,	// bra addr + 0x202
+		0x0009,	// nop
+	};
+	code.resize(0x101, 0x0009);
+	code.push_back(0xAFFD);	// bra addr + 0x200
+	code.push_back(0x0009);	// nop
+	load(addr, code);
+
+	RuntimeBlockInfoPtr block = compile(addr);
+	ASSERT_NE(nullptr, block);
+	ASSERT_FALSE(block->read_only);
+	ASSERT_EQ(BET_StaticJump, block->BlockType);
+	ASSERT_EQ(addr + 0x202, block->BranchBlock);
+	ASSERT_EQ(0u, block->hot_runs);
+
+	block = compile(addr + 0x202);
+	ASSERT_NE(nullptr, block);
+	ASSERT_EQ(BET_StaticJump, block->BlockType);
+	ASSERT_EQ(addr + 0x200, block->BranchBlock);
+	ASSERT_EQ(0u, block->hot_runs);
+}
+
+#endif
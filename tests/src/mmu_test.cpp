@@ -0,0 +1,225 @@
+#include <atomic>
+#include <chrono>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/mem/vmem32.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/sh4/sh4_core.h"
+#include "hw/sh4/modules/mmu.h"
+#include "emulator.h"
+
+void install_fault_handler();
+void CCN_PTEH_write(u32 addr, u32 value);
+extern bool unprotected_pages[RAM_SIZE_MAX/PAGE_SIZE];
+
+class MmuTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		dc_init();
+		dc_reset(true);
+		CCN_PTEH.ASID = 0;
+	}
+
+	void setEntry(u32 index, u32 va, u32 pa, u32 asid, u32 sz = 1, bool shared = false)
+	{
+		TLB_Entry& entry = UTLB[index];
+		entry.Address.reg_data = 0;
+		entry.Address.VPN = va >> 10;
+		entry.Address.ASID = asid;
+		entry.Data.reg_data = 0;
+		entry.Data.PPN = (pa & 0x1FFFFFFF) >> 10;
+		entry.Data.SZ1 = sz >> 1;
+		entry.Data.SZ0 = sz & 1;
+		entry.Data.SH = shared;
+		entry.Data.PR = 3;		// read/write
+		entry.Data.V = 1;
+		entry.Assistance.reg_data = 0;
+		UTLB_Sync(index);
+	}
+
+	u32 translate(u32 va, u32 asid)
+	{
+		CCN_PTEH.ASID = asid;
+		u32 pa;
+		if (mmu_data_translation<MMU_TT_DREAD, u32>(va, pa) != MMU_ERROR_NONE)
+			return ~0u;
+		return pa;
+	}
+
+	// Reads through the vmem32 mappings. The fault handler must run before the stats are checked.
+	u8 vmem32Read(u32 va)
+	{
+		u8 v = *(volatile u8 *)&virt_ram_base[va];
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+		return v;
+	}
+};
+
+#ifdef FAST_MMU
+TEST_F(MmuTest, Translation)
+{
+	setEntry(0, 0x00010000, 0x0C100000, 1);
+	setEntry(1, 0x00010000, 0x0C200000, 2);
+	setEntry(2, 0x00400000, 0x0C300000, 1, 2);
+	setEntry(3, 0xC0000000, 0x0C400000, 0, 1, true);
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		// Second pass hits the soft TLB
+		ASSERT_EQ(0x0C100124u, translate(0x00010124, 1));
+		ASSERT_EQ(0x0C200124u, translate(0x00010124, 2));
+		ASSERT_EQ(0x0C30A000u, translate(0x0040A000, 1));
+		ASSERT_EQ(0x0C300FFCu, translate(0x00400FFC, 1));
+		ASSERT_EQ(0x0C400010u, translate(0xC0000010, 1));
+		ASSERT_EQ(0x0C400010u, translate(0xC0000010, 2));
+	}
+	// Untranslated areas
+	ASSERT_EQ(0x8C010000u, translate(0x8C010000, 1));
+	CCN_PTEH.ASID = 1;
+	u32 pa;
+	ASSERT_EQ((u32)MMU_ERROR_BADADDR, (mmu_data_translation<MMU_TT_DREAD, u32>(0x00010122, pa)));
+	ASSERT_EQ((u32)MMU_ERROR_NONE, (mmu_data_translation<MMU_TT_DREAD, u16>(0x00010122, pa)));
+	ASSERT_EQ(0x0C100122u, pa);
+}
+
+TEST_F(MmuTest, Invalidation)
+{
+	setEntry(0, 0x00010000, 0x0C100000, 1);
+	ASSERT_EQ(0x0C100000u, translate(0x00010000, 1));
+	ASSERT_EQ(0x0C100000u, translate(0x00010000, 1));
+
+	// A new UTLB entry overrides the cached page
+	setEntry(0, 0x00010000, 0x0C200000, 1);
+	ASSERT_EQ(0x0C200000u, translate(0x00010000, 1));
+
+	// So does a large page
+	setEntry(1, 0x00010000, 0x0C300000, 1, 2);
+	ASSERT_EQ(0x0C300000u, translate(0x00010000, 1));
+
+	// and a shared one
+	setEntry(2, 0x00010000, 0x0C400000, 2, 1, true);
+	ASSERT_EQ(0x0C400000u, translate(0x00010000, 1));
+
+	mmu_flush_table();
+	for (const SoftTLB_Entry& cached : mmu_soft_tlb)
+		ASSERT_EQ(SOFT_TLB_INVALID, cached.tag);
+}
+
+// Translates the data accesses of WinCE-like processes: each one has its own ASID and
+// a 32 MB slot where code, heap and stack pages are mapped with 4 KB pages.
+// The kernel data is shared. Processes switch every few hundred accesses.
+TEST_F(MmuTest, Benchmark)
+{
+	const u32 processes = 8;
+	const u32 pages = 96;
+	u32 utlb_index = 0;
+	for (u32 asid = 1; asid <= processes; asid++)
+		for (u32 page = 0; page < pages; page++)
+		{
+			u32 va = asid * 0x02000000 + (page < pages / 2 ? 0x10000 : 0x1000000) + (page % (pages / 2)) * 4096;
+			setEntry(utlb_index, va, 0x0C000000 + (asid * pages + page) * 4096, asid);
+			utlb_index = (utlb_index + 1) % 64;
+		}
+	setEntry(utlb_index, 0xC0000000, 0x0C800000, 0, 2, true);
+
+	std::vector<u32> addresses;
+	u32 seed = 1;
+	for (u32 i = 0; i < 4096; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		u32 page = (seed >> 16) % (pages + 8);
+		u32 offset = (seed >> 4) & 0xFFC;
+		if (page >= pages)
+			addresses.push_back(0xC0000000 + (page - pages) * 4096 + offset);
+		else
+			addresses.push_back((page < pages / 2 ? 0x10000 : 0x1000000) + (page % (pages / 2)) * 4096 + offset);
+	}
+
+	const u32 iterations = 1000;
+	const u32 switch_period = 256;
+	u64 checksum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (u32 i = 0; i < iterations; i++)
+		for (u32 j = 0; j < addresses.size(); j++)
+		{
+			u32 asid = (j / switch_period + i) % processes + 1;
+			u32 va = addresses[j];
+			if (va < 0xC0000000)
+				va += asid * 0x02000000;
+			checksum += translate(va, asid);
+		}
+	std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+	RecordProperty("translation_ns", (int)(duration.count() * 1e9 / iterations / addresses.size()));
+
+	u64 expected = 0;
+	for (u32 i = 0; i < iterations; i++)
+		for (u32 j = 0; j < addresses.size(); j++)
+		{
+			u32 asid = (j / switch_period + i) % processes + 1;
+			u32 va = addresses[j];
+			if (va >= 0xC0000000)
+				expected += va - 0xC0000000 + 0x0C800000;
+			else
+			{
+				u32 page = (va >= 0x1000000 ? pages / 2 + (va - 0x1000000) / 4096 : (va - 0x10000) / 4096);
+				expected += 0x0C000000 + (asid * pages + page) * 4096 + (va & 0xFFF);
+			}
+		}
+	ASSERT_EQ(expected, checksum);
+}
+
+TEST_F(MmuTest, Vmem32BatchRemap)
+{
+	install_fault_handler();
+	settings.dynarec.vmem32_batch_remap = true;
+	_vmem_enable_mmu(true);
+	if (!vmem32_enabled())
+	{
+		settings.dynarec.vmem32_batch_remap = false;
+		return;
+	}
+	setEntry(0, 0x00010000, 0x0C100000, 1);
+	setEntry(1, 0x00400000, 0x0C200000, 0, 2, true);
+	setEntry(2, 0x00020000, 0x0C300000, 2);
+	mem_b[0x100000] = 0x11;
+	mem_b[0x200000] = 0x22;
+	mem_b[0x300000] = 0x33;
+	CCN_PTEH_write(0, 1);
+	vmem32_stats = {};
+
+	ASSERT_EQ(0x11, vmem32Read(0x00010000));
+	ASSERT_EQ(0x22, vmem32Read(0x00400000));
+	ASSERT_EQ(2u, vmem32_stats.faults);
+
+	// Switching ASID only unmaps the private page
+	CCN_PTEH_write(0, 2);
+	ASSERT_EQ(1u, vmem32_stats.unmapped);
+	ASSERT_EQ(0x22, vmem32Read(0x00400000));
+	ASSERT_EQ(0x33, vmem32Read(0x00020000));
+	ASSERT_EQ(3u, vmem32_stats.faults);
+
+	// and writable pages that now contain code
+	setEntry(3, 0x00500000, 0x0C500000, 0, 1, true);
+	mem_b[0x500000] = 0x55;
+	unprotected_pages[0x500000 / PAGE_SIZE] = true;
+	ASSERT_EQ(0x55, vmem32Read(0x00500000));
+	ASSERT_EQ(4u, vmem32_stats.faults);
+	unprotected_pages[0x500000 / PAGE_SIZE] = false;
+	CCN_PTEH_write(0, 1);
+	ASSERT_EQ(3u, vmem32_stats.unmapped);
+	ASSERT_EQ(0x22, vmem32Read(0x00400000));
+	ASSERT_EQ(4u, vmem32_stats.faults);
+
+	// TLB flushes unmap everything
+	vmem32_flush_mmu();
+	ASSERT_EQ(4u, vmem32_stats.unmapped);
+	ASSERT_EQ(0x22, vmem32Read(0x00400000));
+	ASSERT_EQ(5u, vmem32_stats.faults);
+
+	_vmem_enable_mmu(false);
+	settings.dynarec.vmem32_batch_remap = false;
+}
+#endif
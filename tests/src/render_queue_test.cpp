@@ -0,0 +1,108 @@
+#include <chrono>
+#include <future>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "emulator.h"
+#include "hw/mem/_vmem.h"
+#include "hw/pvr/pvr_regs.h"
+#include "hw/pvr/Renderer_if.h"
+
+void install_fault_handler();
+extern cResetEvent re;
+
+class RenderQueueTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		dc_init();
+		dc_reset(true);
+		install_fault_handler();
+		savedDepth = settings.pvr.RenderQueueDepth;
+		savedSync = settings.pvr.SynchronousRender;
+		settings.pvr.SynchronousRender = false;
+	}
+
+	void TearDown() override
+	{
+		// Release the emulator if it's still waiting
+		rend_cancel_emu_wait();
+		if (endRender.valid())
+			endRender.wait();
+		TA_context *ctx;
+		while ((ctx = DequeueRender()) != nullptr)
+			FinishRender(ctx);
+		settings.pvr.RenderQueueDepth = savedDepth;
+		settings.pvr.SynchronousRender = savedSync;
+	}
+
+	// Starts a frame like a STARTRENDER register write
+	static void startRender()
+	{
+		SetCurrentTARC(CORE_CURRENT_CTX);
+		ta_ctx->Reset();
+		rend_start_render();
+	}
+
+	std::future<void> endRender;
+	u32 savedDepth;
+	bool savedSync;
+};
+
+TEST_F(RenderQueueTest, QueueSeveralFrames)
+{
+	settings.pvr.RenderQueueDepth = 3;
+	std::vector<TA_context *> contexts;
+	for (int i = 0; i < 3; i++)
+	{
+		TA_context *ctx = tactx_Alloc();
+		ASSERT_TRUE(QueueRender(ctx));
+		contexts.push_back(ctx);
+	}
+	ASSERT_EQ(3u, rend_framesQueued());
+	ASSERT_EQ(3u, rend_framesUnprocessed());
+
+	// The queue is full
+	u32 dropped = rend_framesDropped();
+	ASSERT_FALSE(QueueRender(tactx_Alloc()));
+	ASSERT_EQ(dropped + 1, rend_framesDropped());
+
+	// Frames are rendered in order
+	for (int i = 0; i < 3; i++)
+	{
+		TA_context *ctx = DequeueRender();
+		ASSERT_EQ(contexts[i], ctx);
+		rend_frameProcessed();
+		ASSERT_EQ(2u - i, rend_framesUnprocessed());
+		ASSERT_EQ(3u - i, rend_framesQueued());
+		FinishRender(ctx);
+	}
+	ASSERT_EQ(nullptr, DequeueRender());
+}
+
+TEST_F(RenderQueueTest, EmulatorRunsAhead)
+{
+	settings.pvr.RenderQueueDepth = 2;
+
+	// Nothing consumes the first frame but the emulator doesn't wait for it
+	startRender();
+	endRender = std::async(std::launch::async, rend_end_render);
+	ASSERT_EQ(std::future_status::ready, endRender.wait_for(std::chrono::seconds(5)));
+	ASSERT_EQ(1u, rend_framesQueued());
+
+	// The second frame fills the queue so the emulator waits until the renderer is done with the first one
+	startRender();
+	ASSERT_EQ(2u, rend_framesQueued());
+	endRender = std::async(std::launch::async, rend_end_render);
+	ASSERT_EQ(std::future_status::timeout, endRender.wait_for(std::chrono::milliseconds(100)));
+
+	TA_context *ctx = DequeueRender();
+	ASSERT_NE(nullptr, ctx);
+	rend_frameProcessed();
+	re.Set();
+	ASSERT_EQ(std::future_status::ready, endRender.wait_for(std::chrono::seconds(5)));
+	FinishRender(ctx);
+	ASSERT_EQ(1u, rend_framesQueued());
+}
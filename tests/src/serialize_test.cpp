@@ -1,9 +1,31 @@
+#include <algorithm>
+#include <cstdio>
 #include "gtest/gtest.h"
 #include "types.h"
 #include "hw/mem/_vmem.h"
 #include "hw/maple/maple_cfg.h"
 #include "hw/maple/maple_devs.h"
 #include "emulator.h"
+#include "rewind.h"
+#include "savestate.h"
+#include "hw/sh4/sh4_mem.h"
+#include "hw/pvr/pvr_mem.h"
+#include "hw/aica/aica_if.h"
+
+void install_fault_handler();
+extern u32 head_fad;
+extern int read_seek_ticks;
+
+static std::vector<u8> serialize()
+{
+	unsigned int total_size = 0;
+	void *data = nullptr;
+	dc_serialize(&data, &total_size);
+	std::vector<u8> state(total_size);
+	data = state.data();
+	dc_serialize(&data, &total_size);
+	return state;
+}
 
 class SerializeTest : public ::testing::Test {
 protected:
@@ -12,6 +34,7 @@ protected:
 			die("_vmem_reserve failed");
 		dc_init();
 		dc_reset(true);
+		install_fault_handler();
 	}
 };
 
@@ -28,8 +51,120 @@ TEST_F(SerializeTest, SizeTest)
 	unsigned int total_size = 0;
 	void *data = nullptr;
 	ASSERT_TRUE(dc_serialize(&data, &total_size));
-	ASSERT_EQ(28145458u, total_size);
+	ASSERT_EQ(28145466u, total_size);
 }
 
+TEST_F(SerializeTest, Snapshot)
+{
+	mem_b[0x2000] = 1;
+	vram[0x2000] = 2;
+	aica_ram[0x2000] = 3;
+	std::vector<u8> expected = serialize();
+	StateSnapshot snapshot;
+	ASSERT_TRUE(snapshot.Capture());
 
+	// Memory written after the capture isn't part of the snapshot
+	mem_b[0x2000] = 0x11;
+	mem_b[0x2000 + RAM_SIZE / 2] = 0x12;
+	vram[0x2000] = 0x22;
+	aica_ram[0x2000] = 0x33;
+	// including through the vram mirror
+	u8 *vramMirror = _nvmem_enabled() ? &virt_ram_base[0x06000000] : &vram[0];
+	*(volatile u8 *)&vramMirror[0x3000] = 0x23;
+	snapshot.Complete();
+	mem_b[0x3000] = 0x13;
+	*(volatile u8 *)&vramMirror[0x4000] = 0x24;
+	ASSERT_EQ(expected, snapshot.Data());
+	ASSERT_EQ(0x11, mem_b[0x2000]);
+	ASSERT_EQ(0x22, vram[0x2000]);
+	ASSERT_EQ(0x23, vram[0x3000]);
+	ASSERT_EQ(0x24, vram[0x4000]);
+	ASSERT_EQ(0x33, aica_ram[0x2000]);
+	ASSERT_EQ(0x13, mem_b[0x3000]);
+}
+
+TEST_F(SerializeTest, Rewind)
+{
+	RewindBuffer buffer(1024 * 1024);
+	std::vector<std::vector<u8>> states;
+	for (int i = 0; i < 4; i++)
+	{
+		mem_b[0x1000 + i * 0x10000] = i + 1;
+		ASSERT_TRUE(buffer.Snapshot());
+		ASSERT_TRUE(buffer.Wait());
+		states.push_back(serialize());
+		ASSERT_EQ(states.back(), std::vector<u8>(buffer.State(), buffer.State() + buffer.StateSize()));
+	}
+	// Only the changed pages are kept
+	ASSERT_EQ(3u, buffer.Count());
+	ASSERT_LT(buffer.DeltaSize(), 16u * 1024);
+
+	for (int i = 3; i >= 0; i--)
+	{
+		ASSERT_TRUE(buffer.Rewind());
+		ASSERT_EQ(states[i], std::vector<u8>(buffer.State(), buffer.State() + buffer.StateSize())) << i;
+	}
+	ASSERT_FALSE(buffer.Rewind());
+	ASSERT_TRUE(dc_restore_state(buffer.State(), buffer.StateSize()));
+	ASSERT_EQ(1, mem_b[0x1000]);
+	ASSERT_EQ(0, mem_b[0x11000]);
 
+	// Snapshots resume from the restored state and the oldest ones are dropped
+	RewindBuffer small(1);
+	ASSERT_TRUE(small.Snapshot());
+	mem_b[0x1000] = 0x55;
+	ASSERT_TRUE(small.Snapshot());
+	ASSERT_TRUE(small.Wait());
+	ASSERT_EQ(0u, small.Count());
+}
+
+TEST_F(SerializeTest, CompressedFile)
+{
+	auto state = std::make_shared<StateSnapshot>();
+	std::vector<StateRange> sections;
+	ASSERT_TRUE(state->Capture(&sections));
+	ASSERT_EQ(0u, sections[0].offset);
+	ASSERT_NE(sections.end(), std::find_if(sections.begin(), sections.end(),
+			[](const StateRange& range) { return range.section == StateSection::RAM; }));
+	std::vector<u8> expected = serialize();
+
+	const char *path = "serialize_test.state";
+	savestate_write_async(path, state, std::move(sections));
+	ASSERT_TRUE(savestate_wait());
+
+	FILE *f = fopen(path, "rb");
+	ASSERT_NE(nullptr, f);
+	fseek(f, 0, SEEK_END);
+	ASSERT_LT(ftell(f), (long)expected.size() / 4);
+	std::vector<u8> loaded;
+	ASSERT_TRUE(savestate_read(f, loaded));
+	fclose(f);
+	ASSERT_EQ(expected, loaded);
+
+	// Uncompressed states from older versions
+	f = fopen(path, "wb");
+	ASSERT_NE(nullptr, f);
+	fwrite(expected.data(), 1, expected.size(), f);
+	fclose(f);
+	f = fopen(path, "rb");
+	ASSERT_TRUE(savestate_read(f, loaded));
+	fclose(f);
+	remove(path);
+	ASSERT_EQ(expected, loaded);
+}
+
+TEST_F(SerializeTest, GdromSeekState)
+{
+	head_fad = 123456;
+	read_seek_ticks = 789;
+	std::vector<u8> state = serialize();
+	head_fad = 150;
+	read_seek_ticks = 0;
+
+	void *data = state.data();
+	unsigned int total_size = 0;
+	ASSERT_TRUE(dc_unserialize(&data, &total_size));
+	ASSERT_EQ(state.size(), total_size);
+	ASSERT_EQ(123456u, head_fad);
+	ASSERT_EQ(789, read_seek_ticks);
+}
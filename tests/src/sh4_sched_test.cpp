@@ -0,0 +1,389 @@
+#include <chrono>
+#include <string>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/mem/_vmem.h"
+#include "hw/sh4/sh4_if.h"
+#include "hw/sh4/sh4_interpreter.h"
+#include "hw/sh4/sh4_sched.h"
+#include "emulator.h"
+
+extern u64 sh4_sched_ffb;
+extern std::vector<sched_list> sch_list;
+
+// Hand-written re-arm trace of the most active callbacks: { callback, delay in cycles }
+// Delays follow the patterns of SPG, TMU, maple, GD-ROM, AICA and DMA. It isn't recorded from a game.
+static const struct {
+	int cb;
+	int cycles;
+} sched_trace[] = {
+	{ 0, 3200 }, { 1, 448 }, { 2, 1 }, { 3, 200000 }, { 4, 4535 },
+	{ 5, 0 }, { 1, 448 }, { 0, 3200 }, { 6, 96 }, { 7, 1000 },
+	{ 2, 57 }, { 4, 4535 }, { 5, 12000 }, { 1, 448 }, { 3, 3333333 },
+	{ 6, 96 }, { 0, 3200 }, { 7, 27000 }, { 2, 780 }, { 1, 448 },
+	{ 4, 4535 }, { 5, 0 }, { 6, 96 }, { 0, -1 }, { 7, 450 },
+};
+constexpr int CallbackCount = 8;
+// Period of each callback when it isn't re-armed explicitly
+static const int periods[CallbackCount] = { 3584, 448, 1000, 200000, 4535, 12000, 96, 27000 };
+
+// The linear scan scheduler that the heap replaced, kept to compare both on the same trace.
+// Same code as before, with its own state instead of the globals.
+struct LinearSched
+{
+	std::vector<sched_list> list;
+	u64 ffb = 0;
+	int next = 0;		// Sh4cntx.sh4_sched_next
+	int next_id = -1;
+
+	u32 now() { return ffb - next; }
+	u64 now64() { return ffb - next; }
+
+	u32 remaining(size_t id, u32 reference)
+	{
+		if (list[id].end != -1)
+			return list[id].end - reference;
+		else
+			return -1;
+	}
+
+	void ffts()
+	{
+		u32 diff = -1;
+		int slot = -1;
+
+		for (size_t i = 0; i < list.size(); i++)
+		{
+			if (remaining(i, now()) < diff)
+			{
+				slot = i;
+				diff = remaining(i, now());
+			}
+		}
+
+		ffb -= next;
+
+		next_id = slot;
+		if (slot != -1)
+			next = diff;
+		else
+			next = SH4_MAIN_CLOCK;
+
+		ffb += next;
+	}
+
+	void request(size_t id, int cycles)
+	{
+		list[id].start = now();
+
+		if (cycles == -1)
+		{
+			list[id].end = -1;
+		}
+		else
+		{
+			list[id].end = list[id].start + cycles;
+			if (list[id].end == -1)
+				list[id].end++;
+		}
+
+		ffts();
+	}
+
+	int elapsed(size_t id)
+	{
+		if (list[id].end != -1)
+		{
+			int rv = now() - list[id].start;
+			list[id].start = now();
+			return rv;
+		}
+		else
+			return -1;
+	}
+
+	void handle_cb(size_t id)
+	{
+		int remain = list[id].end - list[id].start;
+		int elapsd = elapsed(id);
+		int jitter = elapsd - remain;
+
+		list[id].end = -1;
+		int re_sch = list[id].cb(list[id].tag, remain, jitter);
+
+		if (re_sch > 0)
+			request(id, std::max(0, re_sch - jitter));
+	}
+
+	void tick(int cycles)
+	{
+		if (next < 0)
+		{
+			u32 fztime = now() - cycles;
+			if (next_id != -1)
+			{
+				for (size_t i = 0; i < list.size(); i++)
+				{
+					u32 rem = remaining(i, fztime);
+					if (rem <= (u32)cycles)
+						handle_cb(i);
+				}
+			}
+			ffts();
+		}
+	}
+};
+static LinearSched *linear;	// the trace is replayed on the linear scheduler when set
+
+static u64 sched_now()
+{
+	return linear != nullptr ? linear->now64() : sh4_sched_now64();
+}
+
+static void sched_request(size_t id, int cycles)
+{
+	if (linear != nullptr)
+		linear->request(id, cycles);
+	else
+		sh4_sched_request(id, cycles);
+}
+
+static int sched_ids[CallbackCount];
+static u64 deadlines[CallbackCount];
+static int fire_count;
+static int trace_pos;
+static bool bad_time;
+static std::vector<std::pair<int, u64>> *fire_log;	// callbacks run and their time, when set
+
+static int trace_cb(int tag, int cycles, int jitter)
+{
+	u64 now = sched_now();
+	if (now < deadlines[tag] || now > deadlines[tag] + SH4_TIMESLICE)
+		bad_time = true;
+	fire_count++;
+	if (fire_log != nullptr)
+		fire_log->emplace_back(tag, now);
+
+	// replay the next request of the trace
+	const auto& req = sched_trace[trace_pos++ % ARRAY_SIZE(sched_trace)];
+	deadlines[req.cb] = now + req.cycles;
+	sched_request(sched_ids[req.cb], req.cycles);
+	if (req.cb == tag)
+		return 0;
+
+	deadlines[tag] = now + std::max(0, periods[tag] - jitter);
+	return periods[tag];
+}
+
+class Sh4SchedTest : public ::testing::Test {
+protected:
+	void SetUp() override {
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		dc_init();
+		dc_reset(true);
+		static bool registered;
+		if (!registered)
+		{
+			for (int i = 0; i < CallbackCount; i++)
+				sched_ids[i] = sh4_sched_register(i, &trace_cb);
+			registered = true;
+		}
+		// Only run the test callbacks
+		for (size_t i = 0; i < sch_list.size(); i++)
+			sh4_sched_request(i, -1);
+		fire_count = 0;
+		trace_pos = 0;
+		bad_time = false;
+	}
+
+	void TearDown() override {
+		linear = nullptr;
+		fire_log = nullptr;
+	}
+
+	void start(u64 now)
+	{
+		if (linear != nullptr)
+		{
+			// same callbacks as the real scheduler, all disarmed
+			linear->list = sch_list;
+			for (sched_list& sched : linear->list)
+				sched.start = sched.end = -1;
+			linear->ffb = now;
+			linear->next = 0;
+			linear->ffts();
+		}
+		else
+		{
+			sh4_sched_ffb = now;
+			Sh4cntx.sh4_sched_next = 0;
+			sh4_sched_ffts();
+		}
+		for (int i = 0; i < CallbackCount; i++)
+		{
+			deadlines[i] = now + 100 * i;
+			sched_request(sched_ids[i], 100 * i);
+		}
+	}
+
+	void run(int cycles)
+	{
+		int& next = linear != nullptr ? linear->next : Sh4cntx.sh4_sched_next;
+		for (; cycles > 0; cycles -= SH4_TIMESLICE)
+		{
+			next -= SH4_TIMESLICE;
+			if (next < 0)
+			{
+				if (linear != nullptr)
+					linear->tick(SH4_TIMESLICE);
+				else
+					sh4_sched_tick(SH4_TIMESLICE);
+			}
+		}
+	}
+
+	// Replays the trace for one emulated second and returns the host time it took, in seconds
+	double benchmark()
+	{
+		fire_count = 0;
+		trace_pos = 0;
+		bad_time = false;
+		start(0);
+		auto t0 = std::chrono::steady_clock::now();
+		run(SH4_MAIN_CLOCK);
+		std::chrono::duration<double> duration = std::chrono::steady_clock::now() - t0;
+		return duration.count();
+	}
+
+	// Callbacks run in each time slice of the zero delay test
+	std::vector<std::string> zeroDelaySlices()
+	{
+		if (linear != nullptr)
+		{
+			linear->list = sch_list;
+			for (sched_list& sched : linear->list)
+				sched.start = sched.end = -1;
+			linear->ffb = 0;
+			linear->next = 0;
+			linear->ffts();
+		}
+		else
+		{
+			sh4_sched_ffb = 0;
+			Sh4cntx.sh4_sched_next = 0;
+			sh4_sched_ffts();
+		}
+		zero_delay_first = true;
+		sched_request(zero_ids[0], 0);
+		std::vector<std::string> slices;
+		for (int i = 0; i < 3; i++)
+		{
+			zero_delay_runs.clear();
+			run(SH4_TIMESLICE);
+			slices.push_back(zero_delay_runs);
+		}
+		return slices;
+	}
+
+	static int zero_ids[3];
+	static std::string zero_delay_runs;
+	static bool zero_delay_first;
+
+	// A re-arms itself and C, C re-arms B, all with a zero delay
+	static int zero_delay_cb(int tag, int cycles, int jitter)
+	{
+		zero_delay_runs += (char)('A' + tag);
+		if (tag == 0 && zero_delay_first)
+		{
+			zero_delay_first = false;
+			sched_request(zero_ids[2], 0);
+			sched_request(zero_ids[0], 0);
+		}
+		else if (tag == 2)
+			sched_request(zero_ids[1], 0);
+		return 0;
+	}
+};
+int Sh4SchedTest::zero_ids[3];
+std::string Sh4SchedTest::zero_delay_runs;
+bool Sh4SchedTest::zero_delay_first;
+
+TEST_F(Sh4SchedTest, TraceReplay)
+{
+	start(0);
+	run(SH4_MAIN_CLOCK / 10);
+	ASSERT_FALSE(bad_time);
+	ASSERT_GT(fire_count, 10000);
+}
+
+TEST_F(Sh4SchedTest, Wrap32)
+{
+	// start 1 ms before the 32-bit cycle counter wraps
+	start(0x100000000ull - SH4_MAIN_CLOCK / 1000);
+	run(SH4_MAIN_CLOCK / 100);
+	ASSERT_FALSE(bad_time);
+	ASSERT_GT(sh4_sched_now64(), 0x100000000ull);
+	ASSERT_GT(fire_count, 1000);
+}
+
+TEST_F(Sh4SchedTest, Cancel)
+{
+	start(0);
+	for (int i = 0; i < CallbackCount; i++)
+		sh4_sched_request(sched_ids[i], -1);
+	// nothing scheduled: wait for a full second
+	ASSERT_EQ(SH4_MAIN_CLOCK, Sh4cntx.sh4_sched_next);
+	run(SH4_MAIN_CLOCK / 100);
+	ASSERT_EQ(0, fire_count);
+}
+
+// A callback armed with a zero delay by another callback runs in the same time slice
+// if its id is higher, like with the linear scan, otherwise it runs on the next slice.
+TEST_F(Sh4SchedTest, ZeroDelay)
+{
+	static bool registered;
+	if (!registered)
+	{
+		for (int i = 0; i < 3; i++)
+			zero_ids[i] = sh4_sched_register(i, &zero_delay_cb);
+		registered = true;
+	}
+	const std::vector<std::string> expected { "AC", "AB", "" };
+	ASSERT_EQ(expected, zeroDelaySlices());
+
+	LinearSched linearSched;
+	linear = &linearSched;
+	ASSERT_EQ(expected, zeroDelaySlices());
+}
+
+// Replays the same trace on the linear scan scheduler and on the heap.
+// Both run the same callbacks at the same times.
+TEST_F(Sh4SchedTest, Benchmark)
+{
+	std::vector<std::pair<int, u64>> linearLog;
+	linearLog.reserve(1000000);
+	std::vector<std::pair<int, u64>> heapLog;
+	heapLog.reserve(1000000);
+
+	LinearSched linearSched;
+	linear = &linearSched;
+	fire_log = &linearLog;
+	double linearTime = benchmark();
+	ASSERT_FALSE(bad_time);
+
+	linear = nullptr;
+	fire_log = &heapLog;
+	double heapTime = benchmark();
+	ASSERT_FALSE(bad_time);
+
+	ASSERT_EQ(linearLog.size(), heapLog.size());
+	ASSERT_TRUE(linearLog == heapLog);
+
+	RecordProperty("callbacks", (int)heapLog.size());
+	RecordProperty("linear_us", (int)(linearTime * 1e6));
+	RecordProperty("linear_ns_per_callback", (int)(linearTime * 1e9 / linearLog.size()));
+	RecordProperty("heap_us", (int)(heapTime * 1e6));
+	RecordProperty("heap_ns_per_callback", (int)(heapTime * 1e9 / heapLog.size()));
+	printf("%zd callbacks: linear scan %.0f us, heap %.0f us\n", heapLog.size(), linearTime * 1e6, heapTime * 1e6);
+}
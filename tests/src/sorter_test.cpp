@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/pvr/Renderer_if.h"
+#include "hw/pvr/ta.h"
+#include "rend/sorter.h"
+
+extern VArray2 vram;
+TA_context* read_frame(const char* file, u8* vram_ref = NULL);
+
+// Only used for the texture lookups of the TA parser
+struct NullRenderer : Renderer
+{
+	bool Init() override { return true; }
+	void Resize(int w, int h) override {}
+	void Term() override {}
+	bool Process(TA_context* ctx) override { return true; }
+	bool Render() override { return true; }
+	void Present() override {}
+};
+
+class SorterTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		ctx = tactx_Alloc();
+		_pvrrc = ctx;
+	}
+
+	void TearDown() override
+	{
+		tactx_Recycle(ctx);
+		_pvrrc = nullptr;
+	}
+
+	// Random translucent strips, with depths quantized to get many equal values
+	void makeStrips(u32 polyCount)
+	{
+		std::mt19937 rng(42);
+		pvrrc.Clear();
+		for (u32 i = 0; i < polyCount; i++)
+		{
+			PolyParam *pp = pvrrc.global_param_tr.Append();
+			memset(pp, 0, sizeof(*pp));
+			pp->first = pvrrc.idx.used();
+			pp->count = 3 + rng() % 8;
+			pp->tsp.full = rng() % 4;
+			for (u32 j = 0; j < pp->count; j++)
+			{
+				Vertex *vtx = pvrrc.verts.Append();
+				vtx->z = (rng() % 1000) / 100.f;
+				*pvrrc.idx.Append() = pvrrc.verts.used() - 1;
+			}
+		}
+	}
+
+	// Sorted triangle indices, computed with a stable sort
+	std::vector<u32> reference()
+	{
+		struct Trig {
+			u32 id[3];
+			f32 z;
+		};
+		std::vector<Trig> trigs;
+		const u32 *idx = pvrrc.idx.head();
+		const Vertex *vtx = pvrrc.verts.head();
+		for (const PolyParam& pp : pvrrc.global_param_tr)
+			for (u32 i = 0; i + 2 < pp.count; i++)
+			{
+				Trig trig;
+				trig.id[0] = idx[pp.first + i + (i & 1)];
+				trig.id[1] = idx[pp.first + i + 1 - (i & 1)];
+				trig.id[2] = idx[pp.first + i + 2];
+				trig.z = std::min(std::min(vtx[trig.id[0]].z, vtx[trig.id[1]].z), vtx[trig.id[2]].z);
+				trigs.push_back(trig);
+			}
+		std::stable_sort(trigs.begin(), trigs.end(), [](const Trig& a, const Trig& b) { return a.z < b.z; });
+		std::vector<u32> indices;
+		for (const Trig& trig : trigs)
+			indices.insert(indices.end(), trig.id, trig.id + 3);
+
+		return indices;
+	}
+
+	void checkSorted()
+	{
+		std::vector<SortTrigDrawParam> sortedPolys;
+		std::vector<u32> sortedIndexes;
+		GenSorted(0, pvrrc.global_param_tr.used(), sortedPolys, sortedIndexes);
+		ASSERT_EQ(reference(), sortedIndexes);
+		u32 count = 0;
+		for (const SortTrigDrawParam& param : sortedPolys)
+		{
+			ASSERT_EQ(count, param.first);
+			count += param.count;
+		}
+		ASSERT_EQ(sortedIndexes.size(), count);
+	}
+
+	TA_context *ctx = nullptr;
+};
+
+TEST_F(SorterTest, GenSorted)
+{
+	makeStrips(100);
+	checkSorted();
+	// Large enough to be sorted by several threads
+	makeStrips(8000);
+	checkSorted();
+	// Same triangle count: reuses the previous order if still valid
+	checkSorted();
+}
+
+// Sorts the translucent polygons of the frames dumped with dump_frame()
+// Frame files are given by the FLYCAST_FRAMES environment variable, separated by ':'
+TEST_F(SorterTest, Benchmark)
+{
+	const char *frames = getenv("FLYCAST_FRAMES");
+	if (frames == nullptr)
+		return;
+
+	std::vector<u8> vmem(VRAM_SIZE_MAX);
+	VArray2 savedVram = vram;
+	vram.data = vmem.data();
+	vram.size = VRAM_SIZE_MAX;
+	settings.platform.vram_size = 8 * 1024 * 1024;
+	settings.platform.vram_mask = settings.platform.vram_size - 1;
+	NullRenderer nullRenderer;
+	Renderer *savedRenderer = renderer;
+	renderer = &nullRenderer;
+
+	std::stringstream files(frames);
+	std::string file;
+	while (std::getline(files, file, ':'))
+	{
+		TA_context *frame = read_frame(file.c_str());
+		ASSERT_NE(nullptr, frame) << file;
+		ta_parse_vdrc(frame);
+		_pvrrc = frame;
+
+		const int iterations = 20;
+		std::vector<SortTrigDrawParam> sortedPolys;
+		std::vector<u32> sortedIndexes;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			u32 first = 0;
+			for (const RenderPass& pass : pvrrc.render_passes)
+			{
+				GenSorted(first, pass.tr_count - first, sortedPolys, sortedIndexes);
+				first = pass.tr_count;
+			}
+		}
+		std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+		RecordProperty(file + "_us", (int)(duration.count() * 1000000.0 / iterations));
+
+		tactx_Recycle(frame);
+		_pvrrc = ctx;
+	}
+	renderer = savedRenderer;
+	vram = savedVram;
+}
@@ -0,0 +1,149 @@
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "hw/pvr/Renderer_if.h"
+#include "hw/pvr/ta.h"
+
+extern VArray2 vram;
+
+namespace {
+
+// Only used for the texture lookups of the TA parser
+struct NullRenderer : Renderer
+{
+	bool Init() override { return true; }
+	void Resize(int w, int h) override {}
+	void Term() override {}
+	bool Process(TA_context* ctx) override { return true; }
+	bool Render() override { return true; }
+	void Present() override {}
+};
+
+}
+
+class TaParseTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		// the background polygon is read from vram
+		vmem.resize(VRAM_SIZE_MAX);
+		savedVram = vram;
+		vram.data = vmem.data();
+		vram.size = VRAM_SIZE_MAX;
+		savedVramSize = settings.platform.vram_size;
+		settings.platform.vram_size = 8 * 1024 * 1024;
+		settings.platform.vram_mask = settings.platform.vram_size - 1;
+		ctx = tactx_Alloc();
+		savedRenderer = renderer;
+		renderer = &nullRenderer;
+		savedThreads = settings.pvr.MaxThreads;
+	}
+
+	void TearDown() override
+	{
+		settings.pvr.MaxThreads = savedThreads;
+		renderer = savedRenderer;
+		tactx_Recycle(ctx);
+		settings.platform.vram_size = savedVramSize;
+		settings.platform.vram_mask = savedVramSize - 1;
+		vram = savedVram;
+	}
+
+	void write(const std::vector<u32>& params)
+	{
+		memcpy(ctx->tad.thd_data, params.data(), params.size() * 4);
+		ctx->tad.thd_data += params.size() * 4;
+	}
+
+	// Opaque non-textured intensity polygon. Col_Type 3 uses the face color of the previous polygon.
+	void polygon(u32 colType, float r, float g, float b)
+	{
+		const float one = 1.f;
+		u32 pcw = (4 << 29) | (colType << 4);
+		if (colType == 2)
+			write({ pcw, 0, 0, 0, (u32&)one, (u32&)r, (u32&)g, (u32&)b });
+		else
+			write({ pcw, 0, 0, 0, 0, 0, 0, 0 });
+		for (int i = 0; i < 3; i++)
+		{
+			float x = (float)i * 10.f;
+			float y = (float)(i & 1) * 10.f;
+			write({ (7u << 29) | (i == 2 ? 1u << 28 : 0), (u32&)x, (u32&)y, (u32&)one, 0, 0, (u32&)one, 0 });
+		}
+		// end of list
+		write({ 0, 0, 0, 0, 0, 0, 0, 0 });
+	}
+
+	void endPass()
+	{
+		ctx->tad.Continue();
+	}
+
+	struct Result
+	{
+		std::vector<Vertex> verts;
+		std::vector<u32> idx;
+		std::vector<u32> polys;
+		std::vector<u32> passes;
+	};
+
+	Result parse(u32 threads)
+	{
+		settings.pvr.MaxThreads = threads;
+		ta_parse_vdrc(ctx);
+		Result result;
+		result.verts.assign(ctx->rend.verts.head(), ctx->rend.verts.end());
+		result.idx.assign(ctx->rend.idx.head(), ctx->rend.idx.end());
+		for (const PolyParam& pp : ctx->rend.global_param_op)
+		{
+			result.polys.push_back(pp.first);
+			result.polys.push_back(pp.count);
+			result.polys.push_back(pp.tileclip);
+		}
+		for (const RenderPass& pass : ctx->rend.render_passes)
+			result.passes.push_back(pass.op_count);
+		return result;
+	}
+
+	TA_context *ctx = nullptr;
+	std::vector<u8> vmem;
+	VArray2 savedVram;
+	u32 savedVramSize = 0;
+	NullRenderer nullRenderer;
+	Renderer *savedRenderer = nullptr;
+	u32 savedThreads = 0;
+};
+
+// Each pass after the first one uses the face color set by the previous pass
+TEST_F(TaParseTest, FaceColorCarriesOver)
+{
+	polygon(2, 1.f, 0.f, 0.f);
+	endPass();
+	polygon(3, 0.f, 0.f, 0.f);
+	endPass();
+	polygon(2, 0.f, 1.f, 0.f);
+	endPass();
+	polygon(3, 0.f, 0.f, 0.f);
+
+	Result serial = parse(1);
+	ASSERT_FALSE(ctx->rend.Overrun);
+	// background polygon + 4 triangles
+	ASSERT_EQ(4u + 4 * 3, serial.verts.size());
+	ASSERT_EQ(4u, serial.passes.size());
+	const u8 red[4] { 254, 0, 0, 255 };
+	const u8 green[4] { 0, 254, 0, 255 };
+	for (int pass = 0; pass < 4; pass++)
+		for (int i = 0; i < 3; i++)
+		{
+			const Vertex& vtx = serial.verts[4 + pass * 3 + i];
+			ASSERT_EQ(0, memcmp(pass < 2 ? red : green, vtx.col, sizeof(vtx.col))) << "pass " << pass;
+		}
+
+	Result parallel = parse(4);
+	ASSERT_FALSE(ctx->rend.Overrun);
+	ASSERT_EQ(serial.verts.size(), parallel.verts.size());
+	ASSERT_EQ(0, memcmp(serial.verts.data(), parallel.verts.data(), serial.verts.size() * sizeof(Vertex)));
+	ASSERT_EQ(serial.idx, parallel.idx);
+	ASSERT_EQ(serial.polys, parallel.polys);
+	ASSERT_EQ(serial.passes, parallel.passes);
+}
@@ -0,0 +1,243 @@
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "emulator.h"
+#include "hw/mem/_vmem.h"
+#include "hw/pvr/pvr_mem.h"
+#include "hw/pvr/pvr_regs.h"
+#include "rend/TexCache.h"
+
+void install_fault_handler();
+
+class TestTexture : public BaseTextureCacheData
+{
+public:
+	std::string GetId() override { return "test"; }
+	void UploadToGPU(int width, int height, u8 *temp_tex_buffer, bool mipmapped, bool mipmapsIncluded = false) override {}
+};
+
+class TexCacheTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		if (!_vmem_reserve())
+			die("_vmem_reserve failed");
+		dc_init();
+		dc_reset(true);
+		install_fault_handler();
+		savedSettings = settings;
+		settings.rend.TextureUpscale = 1;
+		settings.rend.UseMipmaps = true;
+		settings.rend.CustomTextures = false;
+		settings.rend.DumpTextures = false;
+		settings.pvr.MaxThreads = 4;
+
+		std::mt19937 rng(42);
+		for (u32 i = 0; i < VRAM_SIZE; i++)
+			vram[i] = (u8)rng();
+		for (u32& c : palette16_ram)
+			c = rng() & 0xFFFF;
+		for (u32& c : palette32_ram)
+			c = rng();
+	}
+
+	void TearDown() override
+	{
+		for (auto& texture : textures)
+			texture->Delete();
+		textures.clear();
+		settings = savedSettings;
+	}
+
+	TestTexture *createTexture(TSP tsp, TCW tcw)
+	{
+		textures.emplace_back(new TestTexture());
+		TestTexture *texture = textures.back().get();
+		texture->tsp = tsp;
+		texture->tcw = tcw;
+		texture->Create();
+		if (!texture->StartUpdate())
+			return nullptr;
+		return texture;
+	}
+
+	static size_t decodedSize(BaseTextureCacheData *texture)
+	{
+		size_t pixelSize = texture->tex_type == TextureType::_8888 ? 4
+				: texture->tex_type == TextureType::_8 ? 1 : 2;
+		u32 width = texture->decoded.width;
+		u32 height = texture->decoded.height;
+		size_t size = width * height;
+		if (texture->decoded.mipmapped)
+		{
+			do
+			{
+				width /= 2;
+				height /= 2;
+				size += width * height;
+			}
+			while (width != 0 && height != 0);
+		}
+		return size * pixelSize;
+	}
+
+	// 1555 twiddled texture of size 8 << texU by 8 << texU at the given vram offset
+	TestTexture *createTexture(u32 offset, u32 texU)
+	{
+		TSP tsp{};
+		tsp.TexU = texU;
+		tsp.TexV = texU;
+		TCW tcw{};
+		tcw.PixelFmt = Pixel1555;
+		tcw.TexAddr = offset >> 3;
+		return createTexture(tsp, tcw);
+	}
+
+	// Writes to vram like the SH4 does so that the vram locks fire
+	static void writeVram(u32 offset, u32 value)
+	{
+		if (_nvmem_enabled())
+			*(u32 *)&virt_ram_base[0x04000000 + offset] = value;
+		else
+		{
+			VramLockedWriteOffset(offset);
+			*(u32 *)&vram[offset] = value;
+		}
+	}
+
+	std::vector<std::unique_ptr<TestTexture>> textures;
+	settings_t savedSettings;
+};
+
+TEST_F(TexCacheTest, ParallelDecode)
+{
+	// Sizes on both sides of the parallel decode cutoff (64x64)
+	static const u32 sizes[][2] = { { 0, 0 }, { 2, 2 }, { 3, 2 }, { 3, 3 }, { 5, 4 } };
+
+	for (u32 palCtrl : { 1, 3 })
+	{
+		PAL_RAM_CTRL = palCtrl;
+		std::vector<TestTexture *> serial;
+		std::vector<TestTexture *> parallel;
+		for (u32 fmt = Pixel1555; fmt <= PixelPal8; fmt++)
+			// planar, twiddled, twiddled mipmapped, VQ, VQ mipmapped
+			for (u32 mode = 0; mode < 5; mode++)
+			{
+				bool paletted = fmt == PixelPal4 || fmt == PixelPal8;
+				if (mode == 0 && paletted)
+					continue;
+				for (const auto& size : sizes)
+					for (u32 filter = 0; filter < 2; filter++)
+					{
+						TSP tsp{};
+						tsp.TexU = size[0];
+						tsp.TexV = size[1];
+						tsp.FilterMode = filter;
+						TCW tcw{};
+						tcw.PixelFmt = fmt;
+						tcw.ScanOrder = mode == 0;
+						tcw.MipMapped = mode == 2 || mode == 4;
+						tcw.VQ_Comp = mode >= 3;
+						tcw.PalSelect = paletted ? 16 : 0;
+						tcw.TexAddr = 0x1000;
+
+						TestTexture *texture = createTexture(tsp, tcw);
+						ASSERT_NE(nullptr, texture);
+						serial.push_back(texture);
+						texture = createTexture(tsp, tcw);
+						ASSERT_NE(nullptr, texture);
+						parallel.push_back(texture);
+					}
+			}
+
+		for (TestTexture *texture : serial)
+			texture->Decode();
+		DecodeTextures(std::vector<BaseTextureCacheData *>(parallel.begin(), parallel.end()));
+
+		for (size_t i = 0; i < serial.size(); i++)
+		{
+			TestTexture *expected = serial[i];
+			TestTexture *actual = parallel[i];
+			std::string name = std::string(expected->GetPixelFormatName())
+					+ " " + std::to_string(expected->w) + "x" + std::to_string(expected->h)
+					+ " tcw " + std::to_string(expected->tcw.full) + " filter " + std::to_string(expected->tsp.FilterMode)
+					+ " palctrl " + std::to_string(palCtrl);
+			ASSERT_EQ(expected->tex_type, actual->tex_type) << name;
+			ASSERT_EQ(expected->decoded.width, actual->decoded.width) << name;
+			ASSERT_EQ(expected->decoded.height, actual->decoded.height) << name;
+			ASSERT_EQ(expected->decoded.mipmapped, actual->decoded.mipmapped) << name;
+			ASSERT_EQ(0, memcmp(expected->decoded.data, actual->decoded.data, decodedSize(expected))) << name;
+		}
+		for (TestTexture *texture : serial)
+			texture->FinishUpdate();
+		for (TestTexture *texture : parallel)
+			texture->FinishUpdate();
+	}
+}
+
+TEST_F(TexCacheTest, PageWriteInvalidatesOverlappingTextures)
+{
+	const u32 base = 0x100000;
+	// a and b each fit in one page, c spans the 2nd and 3rd pages
+	TestTexture *a = createTexture(base, 1);
+	TestTexture *b = createTexture(base + 2 * PAGE_SIZE + 0x800, 1);
+	TestTexture *c = createTexture(base + 2 * PAGE_SIZE - 0x400, 2);
+	ASSERT_TRUE(a != nullptr && b != nullptr && c != nullptr);
+	ASSERT_FALSE(a->NeedsUpdate());
+	ASSERT_FALSE(b->NeedsUpdate());
+	ASSERT_FALSE(c->NeedsUpdate());
+
+	writeVram(base + 0x10, *(u32 *)&vram[base + 0x10] ^ 1);
+	ASSERT_NE(0u, a->dirty);
+	ASSERT_EQ(0u, b->dirty);
+	ASSERT_EQ(0u, c->dirty);
+	ASSERT_TRUE(a->NeedsUpdate());
+	ASSERT_FALSE(b->NeedsUpdate());
+	ASSERT_FALSE(c->NeedsUpdate());
+
+	// Rewriting the same data fires the lock but the page hash is unchanged
+	a->StartUpdate();
+	writeVram(base + 0x10, *(u32 *)&vram[base + 0x10]);
+	ASSERT_NE(0u, a->dirty);
+	ASSERT_FALSE(a->NeedsUpdate());
+	ASSERT_EQ(0u, a->dirty);
+}
+
+TEST_F(TexCacheTest, SpanningTextureRevalidated)
+{
+	const u32 base = 0x100000;
+	TestTexture *a = createTexture(base, 1);
+	TestTexture *b = createTexture(base + 2 * PAGE_SIZE + 0x800, 1);
+	TestTexture *c = createTexture(base + 2 * PAGE_SIZE - 0x400, 2);
+	ASSERT_TRUE(a != nullptr && b != nullptr && c != nullptr);
+
+	// Write to the first page of c, outside of its data
+	writeVram(base + PAGE_SIZE + 0x10, *(u32 *)&vram[base + PAGE_SIZE + 0x10] ^ 1);
+	ASSERT_FALSE(a->NeedsUpdate());
+	ASSERT_FALSE(b->NeedsUpdate());
+	// The page content changed so c can't be revalidated
+	ASSERT_TRUE(c->NeedsUpdate());
+	c->StartUpdate();
+	ASSERT_FALSE(c->NeedsUpdate());
+
+	// Write to the second page of c, shared with b
+	writeVram(base + 2 * PAGE_SIZE + 0x10, *(u32 *)&vram[base + 2 * PAGE_SIZE + 0x10] ^ 1);
+	ASSERT_FALSE(a->NeedsUpdate());
+	ASSERT_TRUE(b->NeedsUpdate());
+	ASSERT_TRUE(c->NeedsUpdate());
+	b->StartUpdate();
+	c->StartUpdate();
+
+	// Unchanged content on either page revalidates c
+	writeVram(base + PAGE_SIZE + 0x10, *(u32 *)&vram[base + PAGE_SIZE + 0x10]);
+	ASSERT_NE(0u, c->dirty);
+	ASSERT_FALSE(c->NeedsUpdate());
+	writeVram(base + 2 * PAGE_SIZE + 0x10, *(u32 *)&vram[base + 2 * PAGE_SIZE + 0x10]);
+	ASSERT_NE(0u, b->dirty);
+	ASSERT_NE(0u, c->dirty);
+	ASSERT_FALSE(b->NeedsUpdate());
+	ASSERT_FALSE(c->NeedsUpdate());
+}
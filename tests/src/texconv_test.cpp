@@ -0,0 +1,153 @@
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "types.h"
+#include "rend/TexCache.h"
+#include "rend/TexConvSimd.h"
+
+#ifdef TEXCONV_SIMD
+
+// Scalar converters, in the same order as the PVR pixel formats
+static const TexConvSimd scalarConverters[7] =
+{
+	{ tex1555_PL, tex1555_TW, tex1555_VQ, tex1555_PL32, tex1555_TW32, tex1555_VQ32, nullptr },
+	{ tex565_PL, tex565_TW, tex565_VQ, tex565_PL32, tex565_TW32, tex565_VQ32, nullptr },
+	{ tex4444_PL, tex4444_TW, tex4444_VQ, tex4444_PL32, tex4444_TW32, tex4444_VQ32, nullptr },
+	{ nullptr, nullptr, nullptr, texYUV422_PL, texYUV422_TW, texYUV422_VQ, nullptr },
+	{ texBMP_PL, texBMP_TW, texBMP_VQ, tex4444_PL32, tex4444_TW32, tex4444_VQ32, nullptr },
+	{ nullptr, texPAL4_TW, texPAL4_VQ, nullptr, texPAL4_TW32, texPAL4_VQ32, texPAL4PT_TW },
+	{ nullptr, texPAL8_TW, texPAL8_VQ, nullptr, texPAL8_TW32, texPAL8_VQ32, texPAL8PT_TW },
+};
+static const char * const formatNames[7] = { "1555", "565", "4444", "yuv", "bumpmap", "pal4", "pal8" };
+
+class TexConvTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		// Synthetic VRAM: random texel data, VQ indices and codebook
+		std::mt19937 rng(42);
+		vram.resize(1024 * 1024);
+		for (u8& b : vram)
+			b = (u8)rng();
+		for (u32& c : palette16_ram)
+			c = rng() & 0xFFFF;
+		for (u32& c : palette32_ram)
+			c = rng();
+		palette_index = 0;
+		vq_codebook = &vram[0];
+	}
+
+	template<typename T>
+	void compare(const char *name, u32 fmt, void (*scalar)(PixelBuffer<T> *, u8 *, u32, u32),
+			void (*simd)(PixelBuffer<T> *, u8 *, u32, u32), u32 width, u32 height)
+	{
+		if (simd == nullptr)
+			return;
+		PixelBuffer<T> expected;
+		PixelBuffer<T> actual;
+		expected.init(width, height);
+		actual.init(width, height);
+		memset(expected.data(), 0, width * height * sizeof(T));
+		memset(actual.data(), 0, width * height * sizeof(T));
+		scalar(&expected, &vram[0], width, height);
+		simd(&actual, &vram[0], width, height);
+		ASSERT_EQ(0, memcmp(expected.data(), actual.data(), width * height * sizeof(T)))
+				<< formatNames[fmt] << " " << name << " " << width << "x" << height;
+	}
+
+	template<typename T>
+	double throughput(void (*conv)(PixelBuffer<T> *, u8 *, u32, u32), u32 size)
+	{
+		const int iterations = 20;
+		PixelBuffer<T> pb;
+		pb.init(size, size);
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+			conv(&pb, &vram[0], size, size);
+		std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+
+		return (double)size * size * sizeof(T) * iterations / duration.count() / 1000000.0;
+	}
+
+	template<typename T>
+	void benchmark(const char *name, u32 fmt, void (*scalar)(PixelBuffer<T> *, u8 *, u32, u32),
+			void (*simd)(PixelBuffer<T> *, u8 *, u32, u32))
+	{
+		if (simd == nullptr)
+			return;
+		std::string prefix = std::string(formatNames[fmt]) + "_" + name;
+		RecordProperty(prefix + "_scalar_MBps", (int)throughput(scalar, 512));
+		RecordProperty(prefix + "_simd_MBps", (int)throughput(simd, 512));
+	}
+
+	std::vector<u8> vram;
+};
+
+TEST_F(TexConvTest, Planar)
+{
+	static const u32 sizes[][2] = { { 8, 8 }, { 12, 4 }, { 64, 16 }, { 640, 480 } };
+	for (u32 fmt = 0; fmt < ARRAY_SIZE(scalarConverters); fmt++)
+	{
+		const TexConvSimd& scalar = scalarConverters[fmt];
+		const TexConvSimd *simd = GetTexConvSimd(fmt);
+		ASSERT_NE(nullptr, simd);
+		for (const auto& size : sizes)
+		{
+			compare("PL", fmt, scalar.PL, simd->PL, size[0], size[1]);
+			compare("PL32", fmt, scalar.PL32, simd->PL32, size[0], size[1]);
+		}
+	}
+}
+
+TEST_F(TexConvTest, Twiddled)
+{
+	static const u32 sizes[][2] = { { 4, 4 }, { 8, 8 }, { 64, 8 }, { 8, 256 }, { 512, 512 } };
+	for (u32 fmt = 0; fmt < ARRAY_SIZE(scalarConverters); fmt++)
+	{
+		const TexConvSimd& scalar = scalarConverters[fmt];
+		const TexConvSimd *simd = GetTexConvSimd(fmt);
+		ASSERT_NE(nullptr, simd);
+		for (const auto& size : sizes)
+		{
+			compare("TW", fmt, scalar.TW, simd->TW, size[0], size[1]);
+			compare("TW32", fmt, scalar.TW32, simd->TW32, size[0], size[1]);
+			compare("TW8", fmt, scalar.TW8, simd->TW8, size[0], size[1]);
+		}
+	}
+}
+
+TEST_F(TexConvTest, VQ)
+{
+	static const u32 sizes[] = { 2, 4, 8, 32, 256, 1024 };
+	for (u32 fmt = 0; fmt < ARRAY_SIZE(scalarConverters); fmt++)
+	{
+		const TexConvSimd& scalar = scalarConverters[fmt];
+		const TexConvSimd *simd = GetTexConvSimd(fmt);
+		ASSERT_NE(nullptr, simd);
+		for (u32 size : sizes)
+		{
+			compare("VQ", fmt, scalar.VQ, simd->VQ, size, size);
+			compare("VQ32", fmt, scalar.VQ32, simd->VQ32, size, size);
+		}
+	}
+}
+
+TEST_F(TexConvTest, Benchmark)
+{
+	for (u32 fmt = 0; fmt < ARRAY_SIZE(scalarConverters); fmt++)
+	{
+		const TexConvSimd& scalar = scalarConverters[fmt];
+		const TexConvSimd *simd = GetTexConvSimd(fmt);
+		benchmark("PL", fmt, scalar.PL, simd->PL);
+		benchmark("TW", fmt, scalar.TW, simd->TW);
+		benchmark("VQ", fmt, scalar.VQ, simd->VQ);
+		benchmark("PL32", fmt, scalar.PL32, simd->PL32);
+		benchmark("TW32", fmt, scalar.TW32, simd->TW32);
+		benchmark("VQ32", fmt, scalar.VQ32, simd->VQ32);
+		benchmark("TW8", fmt, scalar.TW8, simd->TW8);
+	}
+}
+
+#endif